@@ -1137,6 +1137,15 @@ status_t ANativeWindowDisplayAdapter::PostFrame(ANativeWindowDisplayAdapter::Dis
         }
 #endif
 
+        if ( CameraFrame::SNAPSHOT_FRAME == dispFrame.mType )
+            {
+            CameraTrace::end(CameraTrace::MILESTONE_SNAPSHOT);
+            }
+        else
+            {
+            CameraTrace::end(CameraTrace::MILESTONE_FIRST_PREVIEW_FRAME);
+            }
+
     }
     else
     {
@@ -1267,6 +1276,12 @@ void ANativeWindowDisplayAdapter::frameCallback(CameraFrame* caFrame)
     df.mWidth = caFrame->mWidth;
     df.mHeight = caFrame->mHeight;
     PostFrame(df);
+
+    nsecs_t posted = systemTime(SYSTEM_TIME_MONOTONIC);
+    CameraTrace::frameStage(CameraTrace::STAGE_ADAPTER_TO_DISPLAY,
+                            caFrame->mStamps[CameraFrame::STAMP_SEND_CALLBACKS], posted);
+    CameraTrace::frameStage(CameraTrace::STAGE_DUCATI_TO_DISPLAY,
+                            caFrame->mStamps[CameraFrame::STAMP_FILL_BUFFER_DONE], posted);
 }
 
 
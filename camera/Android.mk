@@ -4,6 +4,7 @@ LOCAL_PATH:= $(call my-dir)
 
 OMAP4_CAMERA_HAL_USES:= OMX
 # OMAP4_CAMERA_HAL_USES:= USB
+# OMAP4_CAMERA_HAL_USES:= SYNTHETIC
 
 ifdef TI_CAMERAHAL_DEBUG_ENABLED
     # Enable CameraHAL debug logs
@@ -20,6 +21,12 @@ ifdef TI_CAMERAHAL_DEBUG_FUNCTION_NAMES
     CAMERAHAL_CFLAGS += -DTI_UTILS_FUNCTION_LOGGER_ENABLE
 endif
 
+ifdef TI_CAMERAHAL_DEBUG_BINARY_LOG
+    # Record debug and function logs into per-thread binary rings,
+    # saved to debug.tiutils.binlog.file and decoded by tiutils-binlog-decode
+    CAMERAHAL_CFLAGS += -DTI_UTILS_BINARY_LOG_ENABLE
+endif
+
 ifdef TI_CAMERAHAL_DEBUG_TIMESTAMPS
     # Enable timestamp logging
     CAMERAHAL_CFLAGS += -DTI_UTILS_DEBUG_USE_TIMESTAMPS
@@ -34,8 +41,11 @@ OMAP4_CAMERA_HAL_SRC := \
 	AppCallbackNotifier.cpp \
 	ANativeWindowDisplayAdapter.cpp \
 	CameraProperties.cpp \
+	CameraPropertiesCache.cpp \
 	MemoryManager.cpp \
 	Encoder_libjpeg.cpp \
+	CameraKernels.cpp \
+	CameraTrace.cpp \
 	SensorListener.cpp  \
 	NV12_resize.c
 
@@ -62,6 +72,10 @@ OMAP4_CAMERA_USB_SRC:= \
 	BaseCameraAdapter.cpp \
 	V4LCameraAdapter/V4LCameraAdapter.cpp
 
+OMAP4_CAMERA_SYNTHETIC_SRC:= \
+	BaseCameraAdapter.cpp \
+	SyntheticCameraAdapter/SyntheticCameraAdapter.cpp
+
 #
 # OMX Camera HAL
 #
@@ -157,6 +171,55 @@ LOCAL_MODULE:= camera.$(TARGET_BOARD_PLATFORM)
 LOCAL_MODULE_TAGS:= optional
 
 include $(BUILD_HEAPTRACKED_SHARED_LIBRARY)
+
+else
+ifeq ($(OMAP4_CAMERA_HAL_USES),SYNTHETIC)
+
+#
+# Synthetic Camera Adapter, generates test frames without camera hardware
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	$(OMAP4_CAMERA_HAL_SRC) \
+	$(OMAP4_CAMERA_SYNTHETIC_SRC) \
+	$(OMAP4_CAMERA_COMMON_SRC)
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/inc/ \
+    $(LOCAL_PATH)/../hwc \
+    $(LOCAL_PATH)/../include \
+    $(LOCAL_PATH)/inc/SyntheticCameraAdapter \
+    $(LOCAL_PATH)/../libtiutils \
+    hardware/ti/omap4xxx/tiler \
+    hardware/ti/omap4xxx/ion \
+    frameworks/base/include/ui \
+    frameworks/base/include/utils \
+    frameworks/base/include/media/stagefright/openmax \
+    external/jpeg \
+    external/jhead
+
+LOCAL_SHARED_LIBRARIES:= \
+    libui \
+    libbinder \
+    libutils \
+    libcutils \
+    libtiutils \
+    libcamera_client \
+    libion \
+    libjpeg \
+    libexif
+
+# The capabilities cache would otherwise be shared with the OMX build
+LOCAL_CFLAGS := -fno-short-enums -DCOPY_IMAGE_BUFFER -DCAMERA_CAPS_CACHE_DISABLE $(CAMERAHAL_CFLAGS)
+
+LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
+LOCAL_MODULE:= camera.$(TARGET_BOARD_PLATFORM)
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HEAPTRACKED_SHARED_LIBRARY)
+endif
 endif
 endif
 endif
@@ -21,6 +21,7 @@
 #include <ui/GraphicBuffer.h>
 #include <ui/GraphicBufferMapper.h>
 #include "NV12_resize.h"
+#include "CameraKernels.h"
 
 namespace android {
 
@@ -434,177 +435,6 @@ void AppCallbackNotifier::notifyEvent()
 
 }
 
-static void copy2Dto1D(void *dst,
-                       void *src,
-                       int width,
-                       int height,
-                       size_t stride,
-                       uint32_t offset,
-                       unsigned int bytesPerPixel,
-                       size_t length,
-                       const char *pixelFormat)
-{
-    unsigned int alignedRow, row;
-    unsigned char *bufferDst, *bufferSrc;
-    unsigned char *bufferDstEnd, *bufferSrcEnd;
-    uint16_t *bufferSrc_UV;
-
-    unsigned int *y_uv = (unsigned int *)src;
-
-    CAMHAL_LOGVB("copy2Dto1D() y= %p ; uv=%p.",y_uv[0], y_uv[1]);
-    CAMHAL_LOGVB("pixelFormat = %s; offset=%d",pixelFormat,offset);
-
-    if (pixelFormat!=NULL) {
-        if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV422I) == 0) {
-            bytesPerPixel = 2;
-        } else if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0 ||
-                   strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420P) == 0) {
-            bytesPerPixel = 1;
-            bufferDst = ( unsigned char * ) dst;
-            bufferDstEnd = ( unsigned char * ) dst + width*height*bytesPerPixel;
-            bufferSrc = ( unsigned char * ) y_uv[0] + offset;
-            bufferSrcEnd = ( unsigned char * ) ( ( size_t ) y_uv[0] + length + offset);
-            row = width*bytesPerPixel;
-            alignedRow = stride-width;
-            int stride_bytes = stride / 8;
-            uint32_t xOff = offset % stride;
-            uint32_t yOff = offset / stride;
-
-            // going to convert from NV12 here and return
-            // Step 1: Y plane: iterate through each row and copy
-            for ( int i = 0 ; i < height ; i++) {
-                memcpy(bufferDst, bufferSrc, row);
-                bufferSrc += stride;
-                bufferDst += row;
-                if ( ( bufferSrc > bufferSrcEnd ) || ( bufferDst > bufferDstEnd ) ) {
-                    break;
-                }
-            }
-
-            bufferSrc_UV = ( uint16_t * ) ((uint8_t*)y_uv[1] + (stride/2)*yOff + xOff);
-
-            if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0) {
-                 uint16_t *bufferDst_UV;
-
-                // Step 2: UV plane: convert NV12 to NV21 by swapping U & V
-                bufferDst_UV = (uint16_t *) (((uint8_t*)dst)+row*height);
-
-                for (int i = 0 ; i < height/2 ; i++, bufferSrc_UV += alignedRow/2) {
-                    int n = width;
-                    asm volatile (
-                    "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   blt 1f                                                      \n\t"
-                    "0: @ 32 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #32                                         \n\t"
-                    "   vld2.8  {q0, q1} , [%[src]]!                                \n\t"
-                    "   vswp q0, q1                                                 \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   vst2.8  {q0,q1},[%[dst]]!                                   \n\t"
-                    "   bge 0b                                                      \n\t"
-                    "1: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   blt 3f                                                      \n\t"
-                    "2: @ 16 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #16                                         \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   vswp d0, d1                                                 \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   vst2.8  {d0,d1},[%[dst]]!                                   \n\t"
-                    "   bge 2b                                                      \n\t"
-                    "3: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   blt 5f                                                      \n\t"
-                    "4: @ 8 byte swap                                               \n\t"
-                    "   sub %[n], %[n], #8                                          \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   vswp d0, d1                                                 \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   vst2.8  {d0[0],d1[0]},[%[dst]]!                             \n\t"
-                    "   bge 4b                                                      \n\t"
-                    "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-                    "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-                    : [dst] "+r" (bufferDst_UV), [src] "+r" (bufferSrc_UV), [n] "+r" (n)
-                    : [src_stride] "r" (stride_bytes)
-                    : "cc", "memory", "q0", "q1"
-                    );
-                }
-            } else if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420P) == 0) {
-                 uint16_t *bufferDst_U;
-                 uint16_t *bufferDst_V;
-
-                // Step 2: UV plane: convert NV12 to YV12 by de-interleaving U & V
-                // TODO(XXX): This version of CameraHal assumes NV12 format it set at
-                //            camera adapter to support YV12. Need to address for
-                //            USBCamera
-
-                bufferDst_V = (uint16_t *) (((uint8_t*)dst)+row*height);
-                bufferDst_U = (uint16_t *) (((uint8_t*)dst)+row*height+row*height/4);
-
-                for (int i = 0 ; i < height/2 ; i++, bufferSrc_UV += alignedRow/2) {
-                    int n = width;
-                    asm volatile (
-                    "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   blt 1f                                                      \n\t"
-                    "0: @ 32 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #32                                         \n\t"
-                    "   vld2.8  {q0, q1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #32                                               \n\t"
-                    "   vst1.8  {q1},[%[dst_v]]!                                    \n\t"
-                    "   vst1.8  {q0},[%[dst_u]]!                                    \n\t"
-                    "   bge 0b                                                      \n\t"
-                    "1: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   blt 3f                                                      \n\t"
-                    "2: @ 16 byte swap                                              \n\t"
-                    "   sub %[n], %[n], #16                                         \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #16                                               \n\t"
-                    "   vst1.8  {d1},[%[dst_v]]!                                    \n\t"
-                    "   vst1.8  {d0},[%[dst_u]]!                                    \n\t"
-                    "   bge 2b                                                      \n\t"
-                    "3: @ Is there enough data?                                     \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   blt 5f                                                      \n\t"
-                    "4: @ 8 byte swap                                               \n\t"
-                    "   sub %[n], %[n], #8                                          \n\t"
-                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
-                    "   cmp %[n], #8                                                \n\t"
-                    "   vst1.8  {d1[0]},[%[dst_v]]!                                 \n\t"
-                    "   vst1.8  {d0[0]},[%[dst_u]]!                                 \n\t"
-                    "   bge 4b                                                      \n\t"
-                    "5: @ end                                                       \n\t"
-#ifdef NEEDS_ARM_ERRATA_754319_754320
-                    "   vmov s0,s0  @ add noop for errata item                      \n\t"
-#endif
-                    : [dst_u] "+r" (bufferDst_U), [dst_v] "+r" (bufferDst_V),
-                      [src] "+r" (bufferSrc_UV), [n] "+r" (n)
-                    : [src_stride] "r" (stride_bytes)
-                    : "cc", "memory", "q0", "q1"
-                    );
-                }
-            }
-            return ;
-
-        } else if(strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_RGB565) == 0) {
-            bytesPerPixel = 2;
-        }
-    }
-
-    bufferDst = ( unsigned char * ) dst;
-    bufferSrc = ( unsigned char * ) y_uv[0];
-    row = width*bytesPerPixel;
-    alignedRow = ( row + ( stride -1 ) ) & ( ~ ( stride -1 ) );
-
-    //iterate through each row
-    for ( int i = 0 ; i < height ; i++,  bufferSrc += alignedRow, bufferDst += row) {
-        memcpy(bufferDst, bufferSrc, row);
-    }
-}
-
 void AppCallbackNotifier::copyAndSendPictureFrame(CameraFrame* frame, int32_t msgType)
 {
     camera_memory_t* picture = NULL;
@@ -641,6 +471,22 @@ void AppCallbackNotifier::copyAndSendPictureFrame(CameraFrame* frame, int32_t ms
     }
 }
 
+///Accounts the time a preview frame took to reach the application once its data callback returns
+static void traceAppCallback(const CameraFrame* frame)
+{
+    if ( CameraFrame::PREVIEW_FRAME_SYNC != frame->mFrameType )
+        {
+        return;
+        }
+
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    CameraTrace::frameStage(CameraTrace::STAGE_NOTIFIER_TO_APP,
+                            frame->mStamps[CameraFrame::STAMP_NOTIFIER_DEQUEUE], now);
+    CameraTrace::frameStage(CameraTrace::STAGE_DUCATI_TO_APP,
+                            frame->mStamps[CameraFrame::STAMP_FILL_BUFFER_DONE], now);
+}
+
 void AppCallbackNotifier::copyAndSendPreviewFrame(CameraFrame* frame, int32_t msgType)
 {
     camera_memory_t* picture = NULL;
@@ -708,6 +554,7 @@ void AppCallbackNotifier::copyAndSendPreviewFrame(CameraFrame* frame, int32_t ms
        mCameraHal->msgTypeEnabled(msgType) &&
        (dest != NULL)) {
         mDataCb(msgType, mPreviewMemory, mPreviewBufCount, NULL, mCallbackCookie);
+        traceAppCallback(frame);
     }
 
     // increment for next buffer
@@ -782,6 +629,15 @@ void AppCallbackNotifier::notifyFrame()
                     break;
                     }
 
+                ///Only preview frames are accounted in the frame timelines
+                if ( CameraFrame::PREVIEW_FRAME_SYNC == frame->mFrameType )
+                    {
+                    frame->mStamps[CameraFrame::STAMP_NOTIFIER_DEQUEUE] = systemTime(SYSTEM_TIME_MONOTONIC);
+                    CameraTrace::frameStage(CameraTrace::STAGE_ADAPTER_TO_NOTIFIER,
+                                            frame->mStamps[CameraFrame::STAMP_SEND_CALLBACKS],
+                                            frame->mStamps[CameraFrame::STAMP_NOTIFIER_DEQUEUE]);
+                    }
+
                 if ( (CameraFrame::RAW_FRAME == frame->mFrameType )&&
                     ( NULL != mCameraHal ) &&
                     ( NULL != mDataCb) &&
@@ -1017,6 +873,7 @@ void AppCallbackNotifier::notifyFrame()
 
                             mDataCbTimestamp(frame->mTimestamp, CAMERA_MSG_VIDEO_FRAME,
                                                 videoMedatadaBufferMemory, 0, mCallbackCookie);
+                            traceAppCallback(frame);
                             }
                         else
                             {
@@ -1030,6 +887,7 @@ void AppCallbackNotifier::notifyFrame()
 
                             fakebuf->data = frame->mBuffer;
                             mDataCbTimestamp(frame->mTimestamp, CAMERA_MSG_VIDEO_FRAME, fakebuf, 0, mCallbackCookie);
+                            traceAppCallback(frame);
                             fakebuf->release(fakebuf);
                             }
                         }
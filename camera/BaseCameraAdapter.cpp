@@ -1020,6 +1020,8 @@ status_t BaseCameraAdapter::notifyFocusSubscribers(bool status)
 
 #endif
 
+    CameraTrace::end(CameraTrace::MILESTONE_AUTOFOCUS);
+
     focusEvent.mEventData = new CameraHalEvent::CameraHalEventData();
     if ( NULL == focusEvent.mEventData.get() ) {
         return -ENOMEM;
@@ -1062,6 +1064,8 @@ status_t BaseCameraAdapter::notifyShutterSubscribers()
         return -ENOMEM;
     }
 
+    CameraTrace::end(CameraTrace::MILESTONE_SHUTTER);
+
     shutterEvent.mEventType = CameraHalEvent::EVENT_SHUTTER;
     shutterEvent.mEventData->shutterEvent.shutterClosed = true;
 
@@ -1172,6 +1176,7 @@ status_t BaseCameraAdapter::sendFrameToSubscribers(CameraFrame *frame)
 #if PPM_INSTRUMENTATION || PPM_INSTRUMENTATION_ABS
             CameraHal::PPM("Shot to Jpeg: ", &mStartCapture);
 #endif
+            CameraTrace::end(CameraTrace::MILESTONE_JPEG);
             ret = __sendFrameToSubscribers(frame, &mImageSubscribers, CameraFrame::IMAGE_FRAME);
           }
           break;
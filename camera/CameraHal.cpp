@@ -1501,6 +1501,8 @@ status_t CameraHal::startPreview()
       return ALREADY_EXISTS;
     }
 
+    CameraTrace::begin(CameraTrace::MILESTONE_FIRST_PREVIEW_FRAME);
+
     if ( NULL != mCameraAdapter ) {
       ret = mCameraAdapter->setParameters(mParameters);
     }
@@ -2226,6 +2228,8 @@ status_t CameraHal::autoFocus()
 
 #endif
 
+    CameraTrace::begin(CameraTrace::MILESTONE_AUTOFOCUS);
+
     LOG_FUNCTION_NAME;
 
     Mutex::Autolock lock(mLock);
@@ -2289,6 +2293,8 @@ status_t CameraHal::cancelAutoFocus()
     CameraParameters adapterParams = mParameters;
     mMsgEnabled &= ~CAMERA_MSG_FOCUS;
 
+    CameraTrace::cancel(CameraTrace::MILESTONE_AUTOFOCUS);
+
     if( NULL != mCameraAdapter )
     {
         adapterParams.set(TICameraParameters::KEY_AUTO_FOCUS_LOCK, CameraParameters::FALSE);
@@ -2508,6 +2514,10 @@ status_t CameraHal::takePicture( )
 
 #endif
 
+    CameraTrace::begin(CameraTrace::MILESTONE_SHUTTER);
+    CameraTrace::begin(CameraTrace::MILESTONE_SNAPSHOT);
+    CameraTrace::begin(CameraTrace::MILESTONE_JPEG);
+
     LOG_FUNCTION_NAME;
 
     if(!previewEnabled() && !mDisplayPaused)
@@ -2760,6 +2770,17 @@ status_t CameraHal::sendCommand(int32_t cmd, int32_t arg1, int32_t arg2)
 
     LOG_FUNCTION_NAME;
 
+    //The frame statistics do not depend on the adapter or preview state
+    if ( CAMERA_CMD_DUMP_FRAME_STATS == cmd )
+        {
+        CameraTrace::dumpFrameStats(-1);
+        goto EXIT;
+        }
+    else if ( CAMERA_CMD_RESET_FRAME_STATS == cmd )
+        {
+        CameraTrace::resetFrameStats();
+        goto EXIT;
+        }
 
     if ( ( NO_ERROR == ret ) && ( NULL == mCameraAdapter ) )
         {
@@ -2803,6 +2824,7 @@ status_t CameraHal::sendCommand(int32_t cmd, int32_t arg1, int32_t arg2)
             };
         }
 
+EXIT:
     LOG_FUNCTION_NAME_EXIT;
 
     return ret;
@@ -2840,6 +2862,11 @@ status_t  CameraHal::dump(int fd) const
 {
     LOG_FUNCTION_NAME;
     ///Implement this method when the h/w dump function is supported on Ducati side
+
+    CameraTrace::dump(fd);
+    CameraTrace::saveIfRequested();
+    Ti::BinaryLog::saveIfRequested();
+
     return NO_ERROR;
 }
 
@@ -449,6 +449,9 @@ int camera_device_close(hw_device_t* device)
 
     ti_dev = (ti_camera_device_t*) device;
 
+    android::CameraTrace::saveIfRequested();
+    Ti::BinaryLog::saveIfRequested();
+
     if (ti_dev) {
         if (gCameraHals[ti_dev->cameraid]) {
             delete gCameraHals[ti_dev->cameraid];
@@ -493,6 +496,8 @@ int camera_device_open(const hw_module_t* module, const char* name,
 
     CAMHAL_LOGI("camera_device open");
 
+    android::CameraTrace::begin(android::CameraTrace::MILESTONE_OPEN);
+
     if (name != NULL) {
         cameraid = atoi(name);
         num_cameras = gCameraProperties.camerasSupported();
@@ -584,6 +589,10 @@ int camera_device_open(const hw_module_t* module, const char* name,
             goto fail;
         }
 
+        // the capabilities cache revalidation must not query the adapter
+        // while the camera is initialized
+        gCameraProperties.cancelRevalidation();
+
         if(properties && (camera->initialize(properties) != android::NO_ERROR))
         {
             LOGE("Couldn't initialize camera instance");
@@ -593,11 +602,14 @@ int camera_device_open(const hw_module_t* module, const char* name,
 
         gCameraHals[cameraid] = camera;
         gCamerasOpen++;
+
+        android::CameraTrace::end(android::CameraTrace::MILESTONE_OPEN);
     }
 
     return rv;
 
 fail:
+    android::CameraTrace::cancel(android::CameraTrace::MILESTONE_OPEN);
     if(camera_device) {
         free(camera_device);
         camera_device = NULL;
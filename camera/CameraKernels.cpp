@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file CameraKernels.cpp
+*
+* Pixel copy and format conversion kernels. They live in their own unit so
+* that they can be built into the camera kernel benchmark without the rest
+* of the HAL.
+*
+*/
+
+#include "CameraHal.h"
+#include "CameraKernels.h"
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+namespace android {
+
+void copy2Dto1D(void *dst,
+                void *src,
+                int width,
+                int height,
+                size_t stride,
+                uint32_t offset,
+                unsigned int bytesPerPixel,
+                size_t length,
+                const char *pixelFormat)
+{
+    unsigned int alignedRow, row;
+    unsigned char *bufferDst, *bufferSrc;
+    unsigned char *bufferDstEnd, *bufferSrcEnd;
+    uint16_t *bufferSrc_UV;
+
+    unsigned int *y_uv = (unsigned int *)src;
+
+    CAMHAL_LOGVB("copy2Dto1D() y= %p ; uv=%p.",y_uv[0], y_uv[1]);
+    CAMHAL_LOGVB("pixelFormat = %s; offset=%d",pixelFormat,offset);
+
+    if (pixelFormat!=NULL) {
+        if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV422I) == 0) {
+            bytesPerPixel = 2;
+        } else if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0 ||
+                   strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420P) == 0) {
+            bytesPerPixel = 1;
+            bufferDst = ( unsigned char * ) dst;
+            bufferDstEnd = ( unsigned char * ) dst + width*height*bytesPerPixel;
+            bufferSrc = ( unsigned char * ) y_uv[0] + offset;
+            bufferSrcEnd = ( unsigned char * ) ( ( size_t ) y_uv[0] + length + offset);
+            row = width*bytesPerPixel;
+            alignedRow = stride-width;
+            int stride_bytes = stride / 8;
+            uint32_t xOff = offset % stride;
+            uint32_t yOff = offset / stride;
+
+            // going to convert from NV12 here and return
+            // Step 1: Y plane: iterate through each row and copy
+            for ( int i = 0 ; i < height ; i++) {
+                memcpy(bufferDst, bufferSrc, row);
+                bufferSrc += stride;
+                bufferDst += row;
+                if ( ( bufferSrc > bufferSrcEnd ) || ( bufferDst > bufferDstEnd ) ) {
+                    break;
+                }
+            }
+
+            bufferSrc_UV = ( uint16_t * ) ((uint8_t*)y_uv[1] + (stride/2)*yOff + xOff);
+
+            if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420SP) == 0) {
+                 uint16_t *bufferDst_UV;
+
+                // Step 2: UV plane: convert NV12 to NV21 by swapping U & V
+                bufferDst_UV = (uint16_t *) (((uint8_t*)dst)+row*height);
+
+                for (int i = 0 ; i < height/2 ; i++, bufferSrc_UV += alignedRow/2) {
+                    int n = width;
+                    asm volatile (
+                    "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
+                    "   cmp %[n], #32                                               \n\t"
+                    "   blt 1f                                                      \n\t"
+                    "0: @ 32 byte swap                                              \n\t"
+                    "   sub %[n], %[n], #32                                         \n\t"
+                    "   vld2.8  {q0, q1} , [%[src]]!                                \n\t"
+                    "   vswp q0, q1                                                 \n\t"
+                    "   cmp %[n], #32                                               \n\t"
+                    "   vst2.8  {q0,q1},[%[dst]]!                                   \n\t"
+                    "   bge 0b                                                      \n\t"
+                    "1: @ Is there enough data?                                     \n\t"
+                    "   cmp %[n], #16                                               \n\t"
+                    "   blt 3f                                                      \n\t"
+                    "2: @ 16 byte swap                                              \n\t"
+                    "   sub %[n], %[n], #16                                         \n\t"
+                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
+                    "   vswp d0, d1                                                 \n\t"
+                    "   cmp %[n], #16                                               \n\t"
+                    "   vst2.8  {d0,d1},[%[dst]]!                                   \n\t"
+                    "   bge 2b                                                      \n\t"
+                    "3: @ Is there enough data?                                     \n\t"
+                    "   cmp %[n], #8                                                \n\t"
+                    "   blt 5f                                                      \n\t"
+                    "4: @ 8 byte swap                                               \n\t"
+                    "   sub %[n], %[n], #8                                          \n\t"
+                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
+                    "   vswp d0, d1                                                 \n\t"
+                    "   cmp %[n], #8                                                \n\t"
+                    "   vst2.8  {d0[0],d1[0]},[%[dst]]!                             \n\t"
+                    "   bge 4b                                                      \n\t"
+                    "5: @ end                                                       \n\t"
+#ifdef NEEDS_ARM_ERRATA_754319_754320
+                    "   vmov s0,s0  @ add noop for errata item                      \n\t"
+#endif
+                    : [dst] "+r" (bufferDst_UV), [src] "+r" (bufferSrc_UV), [n] "+r" (n)
+                    : [src_stride] "r" (stride_bytes)
+                    : "cc", "memory", "q0", "q1"
+                    );
+                }
+            } else if (strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_YUV420P) == 0) {
+                 uint16_t *bufferDst_U;
+                 uint16_t *bufferDst_V;
+
+                // Step 2: UV plane: convert NV12 to YV12 by de-interleaving U & V
+                // TODO(XXX): This version of CameraHal assumes NV12 format it set at
+                //            camera adapter to support YV12. Need to address for
+                //            USBCamera
+
+                bufferDst_V = (uint16_t *) (((uint8_t*)dst)+row*height);
+                bufferDst_U = (uint16_t *) (((uint8_t*)dst)+row*height+row*height/4);
+
+                for (int i = 0 ; i < height/2 ; i++, bufferSrc_UV += alignedRow/2) {
+                    int n = width;
+                    asm volatile (
+                    "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
+                    "   cmp %[n], #32                                               \n\t"
+                    "   blt 1f                                                      \n\t"
+                    "0: @ 32 byte swap                                              \n\t"
+                    "   sub %[n], %[n], #32                                         \n\t"
+                    "   vld2.8  {q0, q1} , [%[src]]!                                \n\t"
+                    "   cmp %[n], #32                                               \n\t"
+                    "   vst1.8  {q1},[%[dst_v]]!                                    \n\t"
+                    "   vst1.8  {q0},[%[dst_u]]!                                    \n\t"
+                    "   bge 0b                                                      \n\t"
+                    "1: @ Is there enough data?                                     \n\t"
+                    "   cmp %[n], #16                                               \n\t"
+                    "   blt 3f                                                      \n\t"
+                    "2: @ 16 byte swap                                              \n\t"
+                    "   sub %[n], %[n], #16                                         \n\t"
+                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
+                    "   cmp %[n], #16                                               \n\t"
+                    "   vst1.8  {d1},[%[dst_v]]!                                    \n\t"
+                    "   vst1.8  {d0},[%[dst_u]]!                                    \n\t"
+                    "   bge 2b                                                      \n\t"
+                    "3: @ Is there enough data?                                     \n\t"
+                    "   cmp %[n], #8                                                \n\t"
+                    "   blt 5f                                                      \n\t"
+                    "4: @ 8 byte swap                                               \n\t"
+                    "   sub %[n], %[n], #8                                          \n\t"
+                    "   vld2.8  {d0, d1} , [%[src]]!                                \n\t"
+                    "   cmp %[n], #8                                                \n\t"
+                    "   vst1.8  {d1[0]},[%[dst_v]]!                                 \n\t"
+                    "   vst1.8  {d0[0]},[%[dst_u]]!                                 \n\t"
+                    "   bge 4b                                                      \n\t"
+                    "5: @ end                                                       \n\t"
+#ifdef NEEDS_ARM_ERRATA_754319_754320
+                    "   vmov s0,s0  @ add noop for errata item                      \n\t"
+#endif
+                    : [dst_u] "+r" (bufferDst_U), [dst_v] "+r" (bufferDst_V),
+                      [src] "+r" (bufferSrc_UV), [n] "+r" (n)
+                    : [src_stride] "r" (stride_bytes)
+                    : "cc", "memory", "q0", "q1"
+                    );
+                }
+            }
+            return ;
+
+        } else if(strcmp(pixelFormat, CameraParameters::PIXEL_FORMAT_RGB565) == 0) {
+            bytesPerPixel = 2;
+        }
+    }
+
+    bufferDst = ( unsigned char * ) dst;
+    bufferSrc = ( unsigned char * ) y_uv[0];
+    row = width*bytesPerPixel;
+    alignedRow = ( row + ( stride -1 ) ) & ( ~ ( stride -1 ) );
+
+    //iterate through each row
+    for ( int i = 0 ; i < height ; i++,  bufferSrc += alignedRow, bufferDst += row) {
+        memcpy(bufferDst, bufferSrc, row);
+    }
+}
+
+void nv21_to_yuv(uint8_t* dst, uint8_t* y, uint8_t* uv, int width) {
+    if (!dst || !y || !uv) {
+        return;
+    }
+
+    while ((width--) > 0) {
+        uint8_t y0 = y[0];
+        uint8_t v0 = uv[0];
+        uint8_t u0 = *(uv+1);
+        dst[0] = y0;
+        dst[1] = u0;
+        dst[2] = v0;
+        dst += 3;
+        y++;
+        if(!(width % 2)) uv+=2;
+    }
+}
+
+void uyvy_to_yuv(uint8_t* dst, uint32_t* src, int width) {
+    if (!dst || !src) {
+        return;
+    }
+
+    if (width % 2) {
+        return; // not supporting odd widths
+    }
+
+    // currently, neon routine only supports multiple of 16 width
+    if (width % 16) {
+        while ((width-=2) >= 0) {
+            uint8_t u0 = (src[0] >> 0) & 0xFF;
+            uint8_t y0 = (src[0] >> 8) & 0xFF;
+            uint8_t v0 = (src[0] >> 16) & 0xFF;
+            uint8_t y1 = (src[0] >> 24) & 0xFF;
+            dst[0] = y0;
+            dst[1] = u0;
+            dst[2] = v0;
+            dst[3] = y1;
+            dst[4] = u0;
+            dst[5] = v0;
+            dst += 6;
+            src++;
+        }
+    } else {
+        int n = width;
+        asm volatile (
+        "   pld [%[src], %[src_stride], lsl #2]                         \n\t"
+        "   cmp %[n], #16                                               \n\t"
+        "   blt 5f                                                      \n\t"
+        "0: @ 16 pixel swap                                             \n\t"
+        "   vld2.8  {q0, q1} , [%[src]]! @ q0 = uv q1 = y               \n\t"
+        "   vuzp.8 q0, q2                @ d1 = u d5 = v                \n\t"
+        "   vmov d1, d0                  @ q0 = u0u1u2..u0u1u2...       \n\t"
+        "   vmov d5, d4                  @ q2 = v0v1v2..v0v1v2...       \n\t"
+        "   vzip.8 d0, d1                @ q0 = u0u0u1u1u2u2...         \n\t"
+        "   vzip.8 d4, d5                @ q2 = v0v0v1v1v2v2...         \n\t"
+        "   vswp q0, q1                  @ now q0 = y q1 = u q2 = v     \n\t"
+        "   vst3.8  {d0,d2,d4},[%[dst]]!                                \n\t"
+        "   vst3.8  {d1,d3,d5},[%[dst]]!                                \n\t"
+        "   sub %[n], %[n], #16                                         \n\t"
+        "   cmp %[n], #16                                               \n\t"
+        "   bge 0b                                                      \n\t"
+        "5: @ end                                                       \n\t"
+#ifdef NEEDS_ARM_ERRATA_754319_754320
+        "   vmov s0,s0  @ add noop for errata item                      \n\t"
+#endif
+        : [dst] "+r" (dst), [src] "+r" (src), [n] "+r" (n)
+        : [src_stride] "r" (width)
+        : "cc", "memory", "q0", "q1", "q2"
+        );
+    }
+}
+
+void convertYUYVtoUYVY(uint8_t *dst, int dstStride,
+                       const uint8_t *src, int srcStride,
+                       int width, int height)
+{
+    for ( int i = 0 ; i < height ; i++ )
+        {
+        const uint8_t *s = src;
+        uint8_t *d = dst;
+        int bytes = width << 1;
+
+#ifdef __ARM_NEON__
+
+        for ( ; bytes >= 16 ; bytes -= 16, s += 16, d += 16 )
+            {
+            vst1q_u8(d, vrev16q_u8(vld1q_u8(s)));
+            }
+
+#endif
+
+        for ( ; bytes >= 4 ; bytes -= 4, s += 4, d += 4 )
+            {
+            uint32_t w = *( const uint32_t * ) s;
+            *( uint32_t * ) d = ( ( w & 0x00FF00FF ) << 8 ) | ( ( w & 0xFF00FF00 ) >> 8 );
+            }
+
+        src += srcStride;
+        dst += dstStride;
+        }
+}
+
+void copyFrame(uint8_t *dst, int dstStride,
+               const uint8_t *src, int srcStride,
+               int bytesPerRow, int height)
+{
+    for ( int i = 0 ; i < height ; i++ )
+        {
+        memcpy(dst, src, bytesPerRow);
+        src += srcStride;
+        dst += dstStride;
+        }
+}
+
+};
@@ -211,4 +211,9 @@ const char* CameraProperties::Properties::valueAt(unsigned int index)
     return NULL;
 }
 
+unsigned int CameraProperties::Properties::size()
+{
+    return mProperties->size();
+}
+
 };
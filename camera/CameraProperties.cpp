@@ -23,6 +23,7 @@
 
 //#include "CameraHal.h"
 #include <utils/threads.h>
+#include <utils/Timers.h>
 
 #include "DebugUtils.h"
 #include "CameraProperties.h"
@@ -52,6 +53,7 @@ CameraProperties::CameraProperties() : mCamerasSupported(0)
 
     mCamerasSupported = 0;
     mInitialized = 0;
+    mRevalidationCancelled = false;
 
     LOG_FUNCTION_NAME_EXIT;
 }
@@ -60,6 +62,11 @@ CameraProperties::~CameraProperties()
 {
     LOG_FUNCTION_NAME;
 
+    if ( NULL != mRevalidationThread.get() ) {
+        mRevalidationThread->requestExitAndWait();
+        mRevalidationThread.clear();
+    }
+
     LOG_FUNCTION_NAME_EXIT;
 }
 
@@ -94,31 +101,134 @@ status_t CameraProperties::loadProperties()
     LOG_FUNCTION_NAME;
 
     status_t ret = NO_ERROR;
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    bool loadedFromCache = false;
 
-    // adapter updates capabilities and we update camera count
-    const status_t err = CameraAdapter_Capabilities(mCameraProps, mCamerasSupported,
-            MAX_CAMERAS_SUPPORTED, mCamerasSupported);
+    if ( isCacheEnabled() && (loadCache() == NO_ERROR) ) {
+        loadedFromCache = true;
 
-    if(err != NO_ERROR) {
-        LOGE("error while getting capabilities");
-        ret = UNKNOWN_ERROR;
-    } else if (mCamerasSupported > MAX_CAMERAS_SUPPORTED) {
-        LOGE("returned too many adapaters");
-        ret = UNKNOWN_ERROR;
+        // Ducati is queried anyway, but off the module load path. The cache is
+        // rewritten if the result differs and the change takes effect on the
+        // next boot.
+        mRevalidationThread = new CacheRevalidationThread(this);
+        mRevalidationThread->run("CameraCapsCache", PRIORITY_BACKGROUND);
     } else {
+        // adapter updates capabilities and we update camera count
+        const status_t err = CameraAdapter_Capabilities(mCameraProps, mCamerasSupported,
+                MAX_CAMERAS_SUPPORTED, mCamerasSupported);
+
+        if(err != NO_ERROR) {
+            LOGE("error while getting capabilities");
+            ret = UNKNOWN_ERROR;
+        } else if (mCamerasSupported > MAX_CAMERAS_SUPPORTED) {
+            LOGE("returned too many adapaters");
+            ret = UNKNOWN_ERROR;
+        } else {
+            for (int i = 0; i < mCamerasSupported; i++) {
+                mCameraProps[i].set(CAMERA_SENSOR_INDEX, i);
+            }
+
+            if ( isCacheEnabled() && (mCamerasSupported > 0) ) {
+                storeCache(mCameraProps, mCamerasSupported);
+            }
+        }
+    }
+
+    const nsecs_t loadTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    if ( NO_ERROR == ret ) {
         LOGE("num_cameras = %d", mCamerasSupported);
 
         for (int i = 0; i < mCamerasSupported; i++) {
-            mCameraProps[i].set(CAMERA_SENSOR_INDEX, i);
             mCameraProps[i].dump();
         }
     }
 
+    LOGI("Capabilities loaded from %s in %lld us",
+         loadedFromCache ? "cache" : "adapter", (long long) ns2us(loadTime));
+
     LOGV("mCamerasSupported = %d", mCamerasSupported);
     LOG_FUNCTION_NAME_EXIT;
     return ret;
 }
 
+///Queries the adapter again and refreshes the capabilities cache if needed
+void CameraProperties::revalidateCache()
+{
+    LOG_FUNCTION_NAME;
+
+    // held for the whole query, so an opening camera waits for it to finish
+    Mutex::Autolock lock(mRevalidationLock);
+
+    if ( mRevalidationCancelled ) {
+        LOGI("Capabilities cache revalidation cancelled, a camera was opened");
+        LOG_FUNCTION_NAME_EXIT;
+        return;
+    }
+
+    Properties *properties = new Properties[MAX_CAMERAS_SUPPORTED];
+    int count = 0;
+    bool changed = false;
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    const status_t err = CameraAdapter_Capabilities(properties, 0,
+            MAX_CAMERAS_SUPPORTED, count);
+
+    if ( (err != NO_ERROR) || (count <= 0) || (count > MAX_CAMERAS_SUPPORTED) ) {
+        // keep the cache, it is checked again on the next boot
+        LOGW("Capabilities cache revalidation skipped, error %d", err);
+        delete [] properties;
+        LOG_FUNCTION_NAME_EXIT;
+        return;
+    }
+
+    changed = (count != mCamerasSupported);
+
+    for ( int i = 0; i < count; i++ ) {
+        properties[i].set(CAMERA_SENSOR_INDEX, i);
+
+        if ( changed ) {
+            continue;
+        }
+
+        // keyed vectors are sorted, so equal sets compare index by index
+        if ( properties[i].size() != mCameraProps[i].size() ) {
+            changed = true;
+            continue;
+        }
+
+        for ( unsigned int j = 0; j < properties[i].size(); j++ ) {
+            if ( strcmp(properties[i].keyAt(j), mCameraProps[i].keyAt(j)) ||
+                 strcmp(properties[i].valueAt(j), mCameraProps[i].valueAt(j)) ) {
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    if ( changed ) {
+        LOGI("Capabilities changed since the cache was written, updating it");
+        storeCache(properties, count);
+    }
+
+    LOGI("Capabilities cache revalidated in %lld us",
+         (long long) ns2us(systemTime(SYSTEM_TIME_MONOTONIC) - start));
+
+    delete [] properties;
+
+    LOG_FUNCTION_NAME_EXIT;
+}
+
+void CameraProperties::cancelRevalidation()
+{
+    LOG_FUNCTION_NAME;
+
+    Mutex::Autolock lock(mRevalidationLock);
+    mRevalidationCancelled = true;
+
+    LOG_FUNCTION_NAME_EXIT;
+}
+
 // Returns the number of Cameras found
 int CameraProperties::camerasSupported()
 {
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file CameraPropertiesCache.cpp
+*
+* Persistent on-disk cache of the resolved camera capabilities. Querying
+* Ducati for the capabilities of every sensor is the dominant cost of the
+* camera module load, so the resolved property sets are serialized once and
+* mapped back in on the following boots.
+*
+* Cache layout:
+*   CacheHeader
+*   cameraCount x { CacheCameraRecord, propertyCount x "key\0value\0" }
+*
+* The cache is only valid for the firmware image and build it was created
+* with; both are part of the header and checked on every load.
+*
+*/
+
+#include "CameraHal.h"
+#include "CameraProperties.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+
+static const uint32_t CAMERA_CAPS_CACHE_MAGIC = 0x50414354; // "TCAP"
+
+struct CacheFirmwareKey
+{
+    int64_t firmwareSize;
+    int64_t firmwareMtime;
+    char fingerprint[PROPERTY_VALUE_MAX];
+};
+
+struct CacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t checksum;
+    CacheFirmwareKey key;
+    uint32_t cameraCount;
+};
+
+struct CacheCameraRecord
+{
+    int32_t sensorId;
+    uint32_t propertyCount;
+};
+
+static void getFirmwareKey(CacheFirmwareKey &key)
+{
+    struct stat st;
+
+    memset(&key, 0, sizeof(key));
+
+    if ( stat(CAMERA_CAPS_FIRMWARE_PATH, &st) == 0 ) {
+        key.firmwareSize = st.st_size;
+        key.firmwareMtime = st.st_mtime;
+    } else {
+        key.firmwareSize = -1;
+        key.firmwareMtime = -1;
+    }
+
+    property_get("ro.build.fingerprint", key.fingerprint, "");
+}
+
+static uint32_t cacheChecksum(const uint8_t *data, size_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+
+    for ( size_t i = 0; i < size; i++ ) {
+        hash ^= data[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+// Walks the payload of a cache image. With apply == false only the layout
+// is verified, so a corrupted image never leaves half-filled properties.
+static status_t parseCache(const uint8_t *data, size_t size,
+                           CameraProperties::Properties *properties,
+                           int cameraCount, bool apply)
+{
+    const uint8_t *end = data + size;
+
+    for ( int i = 0; i < cameraCount; i++ ) {
+        CacheCameraRecord record;
+
+        if ( (size_t)(end - data) < sizeof(record) ) {
+            return BAD_VALUE;
+        }
+
+        memcpy(&record, data, sizeof(record));
+        data += sizeof(record);
+
+        for ( uint32_t j = 0; j < record.propertyCount; j++ ) {
+            const char *key = (const char *) data;
+            const uint8_t *keyEnd = (const uint8_t *) memchr(data, '\0', end - data);
+            if ( NULL == keyEnd ) {
+                return BAD_VALUE;
+            }
+
+            const char *value = (const char *) (keyEnd + 1);
+            const uint8_t *valueEnd = (const uint8_t *) memchr(keyEnd + 1, '\0', end - keyEnd - 1);
+            if ( NULL == valueEnd ) {
+                return BAD_VALUE;
+            }
+
+            if ( apply ) {
+                properties[i].set(key, value);
+            }
+
+            data = valueEnd + 1;
+        }
+    }
+
+    return ( data == end ) ? NO_ERROR : BAD_VALUE;
+}
+
+bool CameraProperties::isCacheEnabled()
+{
+#ifdef CAMERA_CAPS_CACHE_DISABLE
+
+    return false;
+
+#else
+
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(CAMERA_CAPS_CACHE_PROPERTY, value, "1");
+
+    return atoi(value) != 0;
+
+#endif
+}
+
+status_t CameraProperties::loadCache()
+{
+    status_t ret = NO_ERROR;
+    struct stat st;
+    void *image = MAP_FAILED;
+    const CacheHeader *header = NULL;
+    CacheFirmwareKey key;
+
+    LOG_FUNCTION_NAME;
+
+    int fd = open(CAMERA_CAPS_CACHE_PATH, O_RDONLY);
+    if ( fd < 0 ) {
+        CAMHAL_LOGDB("No capabilities cache at %s", CAMERA_CAPS_CACHE_PATH);
+        LOG_FUNCTION_NAME_EXIT;
+        return NAME_NOT_FOUND;
+    }
+
+    if ( (fstat(fd, &st) != 0) || (st.st_size < (off_t) sizeof(CacheHeader)) ) {
+        CAMHAL_LOGEA("Capabilities cache is truncated");
+        ret = BAD_VALUE;
+        goto EXIT;
+    }
+
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if ( MAP_FAILED == image ) {
+        CAMHAL_LOGEB("Unable to map capabilities cache, error %d", errno);
+        ret = UNKNOWN_ERROR;
+        goto EXIT;
+    }
+
+    header = (const CacheHeader *) image;
+    getFirmwareKey(key);
+
+    if ( (header->magic != CAMERA_CAPS_CACHE_MAGIC) ||
+         (header->version != CAMERA_CAPS_CACHE_VERSION) ||
+         (header->size != (uint32_t) st.st_size) ) {
+        CAMHAL_LOGDA("Capabilities cache has a different layout, ignoring it");
+        ret = BAD_VALUE;
+        goto EXIT;
+    }
+
+    if ( memcmp(&header->key, &key, sizeof(key)) != 0 ) {
+        CAMHAL_LOGDA("Capabilities cache belongs to a different firmware, ignoring it");
+        ret = BAD_VALUE;
+        goto EXIT;
+    }
+
+    if ( (header->cameraCount == 0) || (header->cameraCount > MAX_CAMERAS_SUPPORTED) ||
+         (header->checksum != cacheChecksum((const uint8_t *) (header + 1),
+                                            header->size - sizeof(CacheHeader))) ) {
+        CAMHAL_LOGEA("Capabilities cache is corrupted");
+        ret = BAD_VALUE;
+        goto EXIT;
+    }
+
+    ret = parseCache((const uint8_t *) (header + 1), header->size - sizeof(CacheHeader),
+                     mCameraProps, header->cameraCount, false);
+    if ( NO_ERROR != ret ) {
+        CAMHAL_LOGEA("Capabilities cache is corrupted");
+        goto EXIT;
+    }
+
+    parseCache((const uint8_t *) (header + 1), header->size - sizeof(CacheHeader),
+               mCameraProps, header->cameraCount, true);
+    mCamerasSupported = header->cameraCount;
+
+ EXIT:
+    if ( MAP_FAILED != image ) {
+        munmap(image, st.st_size);
+    }
+    close(fd);
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return ret;
+}
+
+status_t CameraProperties::storeCache(Properties *properties, int count)
+{
+    status_t ret = NO_ERROR;
+    size_t size = sizeof(CacheHeader);
+    uint8_t *image = NULL;
+    uint8_t *data = NULL;
+    CacheHeader *header = NULL;
+    char tmpPath[PATH_MAX];
+    int fd = -1;
+
+    LOG_FUNCTION_NAME;
+
+    for ( int i = 0; i < count; i++ ) {
+        size += sizeof(CacheCameraRecord);
+        for ( unsigned int j = 0; j < properties[i].size(); j++ ) {
+            size += strlen(properties[i].keyAt(j)) + 1;
+            size += strlen(properties[i].valueAt(j)) + 1;
+        }
+    }
+
+    image = (uint8_t *) malloc(size);
+    if ( NULL == image ) {
+        LOG_FUNCTION_NAME_EXIT;
+        return NO_MEMORY;
+    }
+
+    header = (CacheHeader *) image;
+    memset(header, 0, sizeof(CacheHeader));
+    header->magic = CAMERA_CAPS_CACHE_MAGIC;
+    header->version = CAMERA_CAPS_CACHE_VERSION;
+    header->size = size;
+    header->cameraCount = count;
+    getFirmwareKey(header->key);
+
+    data = (uint8_t *) (header + 1);
+    for ( int i = 0; i < count; i++ ) {
+        CacheCameraRecord record;
+        record.sensorId = properties[i].getInt(CAMERA_SENSOR_ID);
+        record.propertyCount = properties[i].size();
+        memcpy(data, &record, sizeof(record));
+        data += sizeof(record);
+
+        for ( unsigned int j = 0; j < properties[i].size(); j++ ) {
+            const size_t keyLength = strlen(properties[i].keyAt(j)) + 1;
+            const size_t valueLength = strlen(properties[i].valueAt(j)) + 1;
+            memcpy(data, properties[i].keyAt(j), keyLength);
+            data += keyLength;
+            memcpy(data, properties[i].valueAt(j), valueLength);
+            data += valueLength;
+        }
+    }
+
+    header->checksum = cacheChecksum((const uint8_t *) (header + 1), size - sizeof(CacheHeader));
+
+    // write a temporary file and rename it so a crash never leaves a torn cache
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", CAMERA_CAPS_CACHE_PATH);
+    fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+    if ( fd < 0 ) {
+        CAMHAL_LOGEB("Unable to create %s, error %d", tmpPath, errno);
+        ret = UNKNOWN_ERROR;
+        goto EXIT;
+    }
+
+    if ( (write(fd, image, size) != (ssize_t) size) || (fsync(fd) != 0) ) {
+        CAMHAL_LOGEB("Unable to write %s, error %d", tmpPath, errno);
+        close(fd);
+        unlink(tmpPath);
+        ret = UNKNOWN_ERROR;
+        goto EXIT;
+    }
+    close(fd);
+
+    if ( rename(tmpPath, CAMERA_CAPS_CACHE_PATH) != 0 ) {
+        CAMHAL_LOGEB("Unable to rename %s, error %d", tmpPath, errno);
+        unlink(tmpPath);
+        ret = UNKNOWN_ERROR;
+        goto EXIT;
+    }
+
+    CAMHAL_LOGDB("Capabilities of %d cameras cached, %u bytes", count, size);
+
+ EXIT:
+    free(image);
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return ret;
+}
+
+};
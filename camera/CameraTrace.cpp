@@ -0,0 +1,573 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file CameraTrace.cpp
+*
+* Lock-free event ring and milestone latency histograms for the camera HAL.
+*
+*/
+
+#include "CameraHal.h"
+#include "CameraTrace.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+
+namespace android {
+
+#define CAMERA_TRACE_RING_MASK (CAMERA_TRACE_RING_SIZE - 1)
+#define CAMERA_TRACE_FRAME_MASK (CAMERA_TRACE_FRAME_WINDOW - 1)
+
+///Number of recent events printed by dump()
+#define CAMERA_TRACE_DUMP_EVENTS 64
+
+struct TraceEvent {
+    nsecs_t timestamp;
+    const char *name;
+    int32_t tid;
+    int32_t arg;
+    ///Ring index + 1 once the slot is completely written, 0 while it is being written
+    volatile int32_t seq;
+};
+
+struct TraceHistogram {
+    uint32_t count;
+    uint32_t buckets[CAMERA_TRACE_BUCKETS];
+    nsecs_t min;
+    nsecs_t max;
+    nsecs_t total;
+};
+
+static TraceEvent gTraceRing[CAMERA_TRACE_RING_SIZE];
+static volatile int32_t gTraceHead = 0;
+
+static nsecs_t gMilestoneStart[CameraTrace::MILESTONE_COUNT];
+static volatile int32_t gMilestonePending[CameraTrace::MILESTONE_COUNT];
+
+static Mutex gHistogramLock;
+static TraceHistogram gHistograms[CameraTrace::MILESTONE_COUNT];
+
+///Latencies in microseconds of the most recent frames through one stage
+struct StageWindow {
+    volatile int32_t head;
+    volatile int32_t maxUs;
+    int32_t samples[CAMERA_TRACE_FRAME_WINDOW];
+};
+
+struct FrameCountSample {
+    uint16_t ducati;
+    uint16_t display;
+    uint16_t encoder;
+};
+
+static StageWindow gStageWindows[CameraTrace::FRAME_STAGE_COUNT];
+static FrameCountSample gFrameCounts[CAMERA_TRACE_FRAME_WINDOW];
+static volatile int32_t gFrameCountHead = 0;
+
+static const char *gStageNames[CameraTrace::FRAME_STAGE_COUNT] = {
+    "ducati_to_adapter",
+    "adapter_to_display",
+    "adapter_to_notifier",
+    "notifier_to_app",
+    "ducati_to_display",
+    "ducati_to_app",
+};
+
+static const char *gMilestoneNames[CameraTrace::MILESTONE_COUNT] = {
+    "open",
+    "first_preview_frame",
+    "autofocus",
+    "shutter",
+    "snapshot",
+    "jpeg",
+};
+
+static const char *gMilestoneBeginEvents[CameraTrace::MILESTONE_COUNT] = {
+    "open:begin",
+    "first_preview_frame:begin",
+    "autofocus:begin",
+    "shutter:begin",
+    "snapshot:begin",
+    "jpeg:begin",
+};
+
+static const char *gMilestoneEndEvents[CameraTrace::MILESTONE_COUNT] = {
+    "open:end",
+    "first_preview_frame:end",
+    "autofocus:end",
+    "shutter:end",
+    "snapshot:end",
+    "jpeg:end",
+};
+
+void CameraTrace::event(const char *name, int32_t arg)
+{
+    //android_atomic_inc() returns the previous value, which is the slot we own
+    int32_t index = android_atomic_inc(&gTraceHead);
+    TraceEvent &e = gTraceRing[index & CAMERA_TRACE_RING_MASK];
+
+    android_atomic_release_store(0, &e.seq);
+    e.timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    e.name = name;
+    e.tid = gettid();
+    e.arg = arg;
+    android_atomic_release_store(index + 1, &e.seq);
+}
+
+void CameraTrace::begin(Milestone milestone)
+{
+    if ( milestone >= MILESTONE_COUNT )
+        {
+        return;
+        }
+
+    gMilestoneStart[milestone] = systemTime(SYSTEM_TIME_MONOTONIC);
+    android_atomic_release_store(1, &gMilestonePending[milestone]);
+
+    event(gMilestoneBeginEvents[milestone]);
+}
+
+void CameraTrace::end(Milestone milestone)
+{
+    nsecs_t latency;
+    uint64_t us;
+    int bucket = 0;
+
+    if ( milestone >= MILESTONE_COUNT )
+        {
+        return;
+        }
+
+    //Cheap early out for the per-frame callers once the milestone is done
+    if ( 0 == android_atomic_acquire_load(&gMilestonePending[milestone]) )
+        {
+        return;
+        }
+
+    //Only one caller gets to complete the milestone
+    if ( 0 != android_atomic_cmpxchg(1, 0, &gMilestonePending[milestone]) )
+        {
+        return;
+        }
+
+    latency = systemTime(SYSTEM_TIME_MONOTONIC) - gMilestoneStart[milestone];
+    us = ns2us(latency);
+
+    event(gMilestoneEndEvents[milestone], (int32_t) us);
+
+    while ( ( us > 0 ) && ( bucket < ( CAMERA_TRACE_BUCKETS - 1 ) ) )
+        {
+        us >>= 1;
+        bucket++;
+        }
+
+    Mutex::Autolock lock(gHistogramLock);
+
+    TraceHistogram &h = gHistograms[milestone];
+    if ( ( 0 == h.count ) || ( latency < h.min ) )
+        {
+        h.min = latency;
+        }
+    if ( latency > h.max )
+        {
+        h.max = latency;
+        }
+    h.total += latency;
+    h.buckets[bucket]++;
+    h.count++;
+}
+
+void CameraTrace::cancel(Milestone milestone)
+{
+    if ( milestone < MILESTONE_COUNT )
+        {
+        android_atomic_release_store(0, &gMilestonePending[milestone]);
+        }
+}
+
+const char *CameraTrace::milestoneName(Milestone milestone)
+{
+    if ( milestone >= MILESTONE_COUNT )
+        {
+        return "unknown";
+        }
+
+    return gMilestoneNames[milestone];
+}
+
+///Copies up to maxEvents of the most recent events, oldest first. Slots
+///overwritten while they are copied are skipped.
+static size_t collectEvents(TraceEvent *events, size_t maxEvents)
+{
+    uint32_t head = ( uint32_t ) android_atomic_acquire_load(&gTraceHead);
+    uint32_t count = head < maxEvents ? head : maxEvents;
+    size_t collected = 0;
+
+    for ( uint32_t i = head - count ; i != head ; i++ )
+        {
+        const TraceEvent &e = gTraceRing[i & CAMERA_TRACE_RING_MASK];
+        int32_t seq = ( int32_t ) ( i + 1 );
+
+        if ( android_atomic_acquire_load(&e.seq) != seq )
+            {
+            continue;
+            }
+
+        events[collected].timestamp = e.timestamp;
+        events[collected].name = e.name;
+        events[collected].tid = e.tid;
+        events[collected].arg = e.arg;
+
+        if ( android_atomic_acquire_load(&e.seq) != seq )
+            {
+            continue;
+            }
+
+        collected++;
+        }
+
+    return collected;
+}
+
+///Upper bound of the bucket holding the given percentile, clamped to the maximum
+static nsecs_t histogramPercentile(const TraceHistogram &h, int pct)
+{
+    uint32_t target = ( h.count * pct + 99 ) / 100;
+    uint32_t seen = 0;
+
+    for ( int i = 0 ; i < CAMERA_TRACE_BUCKETS ; i++ )
+        {
+        seen += h.buckets[i];
+        if ( seen >= target )
+            {
+            nsecs_t bound = us2ns(1LL << i);
+            return bound < h.max ? bound : h.max;
+            }
+        }
+
+    return h.max;
+}
+
+static void writeLine(int fd, const char *format, ...)
+{
+    char line[256];
+    va_list args;
+    int len;
+
+    va_start(args, format);
+    len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    if ( len <= 0 )
+        {
+        return;
+        }
+
+    if ( fd < 0 )
+        {
+        CAMHAL_LOGI("%s", line);
+        }
+    else
+        {
+        write(fd, line, len < ( int ) sizeof(line) ? len : sizeof(line) - 1);
+        }
+}
+
+status_t CameraTrace::dump(int fd)
+{
+    TraceHistogram histograms[MILESTONE_COUNT];
+    TraceEvent events[CAMERA_TRACE_DUMP_EVENTS];
+    size_t count;
+
+    {
+        Mutex::Autolock lock(gHistogramLock);
+        memcpy(histograms, gHistograms, sizeof(histograms));
+    }
+
+    writeLine(fd, "Camera latency milestones (us):\n");
+    writeLine(fd, "  %-20s %6s %9s %9s %9s %9s %9s %9s\n",
+              "milestone", "count", "min", "mean", "p50", "p90", "p99", "max");
+
+    for ( int i = 0 ; i < MILESTONE_COUNT ; i++ )
+        {
+        const TraceHistogram &h = histograms[i];
+
+        if ( 0 == h.count )
+            {
+            writeLine(fd, "  %-20s %6u\n", gMilestoneNames[i], 0);
+            continue;
+            }
+
+        writeLine(fd, "  %-20s %6u %9lld %9lld %9lld %9lld %9lld %9lld\n",
+                  gMilestoneNames[i], h.count,
+                  ns2us(h.min), ns2us(h.total / h.count),
+                  ns2us(histogramPercentile(h, 50)),
+                  ns2us(histogramPercentile(h, 90)),
+                  ns2us(histogramPercentile(h, 99)),
+                  ns2us(h.max));
+        }
+
+    dumpFrameStats(fd);
+
+    count = collectEvents(events, CAMERA_TRACE_DUMP_EVENTS);
+
+    writeLine(fd, "Camera trace, last %u events:\n", ( unsigned int ) count);
+    for ( size_t i = 0 ; i < count ; i++ )
+        {
+        writeLine(fd, "  %12lld.%06lld %5d %-28s %d\n",
+                  events[i].timestamp / 1000000000LL,
+                  ( events[i].timestamp / 1000 ) % 1000000,
+                  events[i].tid, events[i].name, events[i].arg);
+        }
+
+    return NO_ERROR;
+}
+
+void CameraTrace::frameStage(FrameStage stage, nsecs_t start, nsecs_t end)
+{
+    StageWindow *w;
+    int32_t us, max;
+
+    if ( ( stage >= FRAME_STAGE_COUNT ) || ( 0 == start ) || ( end < start ) )
+        {
+        return;
+        }
+
+    us = ( int32_t ) ns2us(end - start);
+    w = &gStageWindows[stage];
+    w->samples[android_atomic_inc(&w->head) & CAMERA_TRACE_FRAME_MASK] = us;
+
+    do
+        {
+        max = android_atomic_acquire_load(&w->maxUs);
+        }
+    while ( ( us > max ) && ( 0 != android_atomic_cmpxchg(max, us, &w->maxUs) ) );
+}
+
+void CameraTrace::frameCounts(uint32_t ducati, uint32_t display, uint32_t encoder)
+{
+    FrameCountSample &s = gFrameCounts[android_atomic_inc(&gFrameCountHead) & CAMERA_TRACE_FRAME_MASK];
+
+    s.ducati = ducati;
+    s.display = display;
+    s.encoder = encoder;
+}
+
+void CameraTrace::resetFrameStats()
+{
+    for ( int i = 0 ; i < FRAME_STAGE_COUNT ; i++ )
+        {
+        android_atomic_release_store(0, &gStageWindows[i].head);
+        android_atomic_release_store(0, &gStageWindows[i].maxUs);
+        }
+
+    android_atomic_release_store(0, &gFrameCountHead);
+}
+
+static int compareInt32(const void *a, const void *b)
+{
+    int32_t x = *( const int32_t * ) a;
+    int32_t y = *( const int32_t * ) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+void CameraTrace::dumpFrameStats(int fd)
+{
+    int32_t samples[CAMERA_TRACE_FRAME_WINDOW];
+
+    writeLine(fd, "Camera frame pipeline, last %d frames (us):\n", CAMERA_TRACE_FRAME_WINDOW);
+    writeLine(fd, "  %-20s %8s %9s %9s %9s\n", "stage", "frames", "p50", "p99", "max");
+
+    for ( int i = 0 ; i < FRAME_STAGE_COUNT ; i++ )
+        {
+        const StageWindow &w = gStageWindows[i];
+        uint32_t total = ( uint32_t ) android_atomic_acquire_load(&w.head);
+        uint32_t n = total < CAMERA_TRACE_FRAME_WINDOW ? total : CAMERA_TRACE_FRAME_WINDOW;
+
+        if ( 0 == n )
+            {
+            writeLine(fd, "  %-20s %8u\n", gStageNames[i], 0);
+            continue;
+            }
+
+        //The window may be written while it is copied, which only blurs the
+        //percentiles of a moving stream
+        memcpy(samples, w.samples, n * sizeof(int32_t));
+        qsort(samples, n, sizeof(int32_t), compareInt32);
+
+        writeLine(fd, "  %-20s %8u %9d %9d %9d\n", gStageNames[i], total,
+                  samples[( n - 1 ) * 50 / 100],
+                  samples[( n - 1 ) * 99 / 100],
+                  android_atomic_acquire_load(&w.maxUs));
+        }
+
+    uint32_t total = ( uint32_t ) android_atomic_acquire_load(&gFrameCountHead);
+    uint32_t n = total < CAMERA_TRACE_FRAME_WINDOW ? total : CAMERA_TRACE_FRAME_WINDOW;
+    uint32_t sum[3] = { 0, 0, 0 };
+    uint32_t min[3] = { UINT16_MAX, UINT16_MAX, UINT16_MAX };
+    uint32_t max[3] = { 0, 0, 0 };
+
+    if ( 0 == n )
+        {
+        return;
+        }
+
+    for ( uint32_t i = 0 ; i < n ; i++ )
+        {
+        const FrameCountSample &s = gFrameCounts[i];
+        uint32_t v[3] = { s.ducati, s.display, s.encoder };
+
+        for ( int j = 0 ; j < 3 ; j++ )
+            {
+            sum[j] += v[j];
+            min[j] = v[j] < min[j] ? v[j] : min[j];
+            max[j] = v[j] > max[j] ? v[j] : max[j];
+            }
+        }
+
+    const FrameCountSample &last = gFrameCounts[( total - 1 ) & CAMERA_TRACE_FRAME_MASK];
+
+    writeLine(fd, "Frames held, last %u samples:\n", n);
+    writeLine(fd, "  %-10s %5s %5s %7s %5s\n", "holder", "now", "min", "mean", "max");
+    writeLine(fd, "  %-10s %5u %5u %7.2f %5u\n", "ducati", last.ducati, min[0], ( float ) sum[0] / n, max[0]);
+    writeLine(fd, "  %-10s %5u %5u %7.2f %5u\n", "display", last.display, min[1], ( float ) sum[1] / n, max[1]);
+    writeLine(fd, "  %-10s %5u %5u %7.2f %5u\n", "encoder", last.encoder, min[2], ( float ) sum[2] / n, max[2]);
+}
+
+status_t CameraTrace::save(const char *path)
+{
+    TraceHistogram histograms[MILESTONE_COUNT];
+    TraceEvent *events;
+    FileHeader header;
+    char tmpPath[PATH_MAX];
+    size_t count;
+    status_t ret = NO_ERROR;
+    FILE *f;
+
+    if ( NULL == path )
+        {
+        return BAD_VALUE;
+        }
+
+    events = new TraceEvent[CAMERA_TRACE_RING_SIZE];
+    if ( NULL == events )
+        {
+        return NO_MEMORY;
+        }
+
+    {
+        Mutex::Autolock lock(gHistogramLock);
+        memcpy(histograms, gHistograms, sizeof(histograms));
+    }
+    count = collectEvents(events, CAMERA_TRACE_RING_SIZE);
+
+    //Write to a temporary file first so readers never see a partial trace
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    f = fopen(tmpPath, "wb");
+    if ( NULL == f )
+        {
+        CAMHAL_LOGEB("Unable to create camera trace file %s: %s", tmpPath, strerror(errno));
+        delete [] events;
+        return -errno;
+        }
+
+    memset(&header, 0, sizeof(header));
+    header.nMagic = CAMERA_TRACE_FILE_MAGIC;
+    header.nVersion = CAMERA_TRACE_FILE_VERSION;
+    header.nMilestones = MILESTONE_COUNT;
+    header.nBuckets = CAMERA_TRACE_BUCKETS;
+    header.nEvents = count;
+
+    if ( 1 != fwrite(&header, sizeof(header), 1, f) )
+        {
+        ret = UNKNOWN_ERROR;
+        }
+
+    for ( int i = 0 ; ( NO_ERROR == ret ) && ( i < MILESTONE_COUNT ) ; i++ )
+        {
+        FileHistogram fh;
+
+        memset(&fh, 0, sizeof(fh));
+        strncpy(fh.name, gMilestoneNames[i], sizeof(fh.name) - 1);
+        fh.count = histograms[i].count;
+        memcpy(fh.buckets, histograms[i].buckets, sizeof(fh.buckets));
+        fh.min = histograms[i].min;
+        fh.max = histograms[i].max;
+        fh.total = histograms[i].total;
+
+        if ( 1 != fwrite(&fh, sizeof(fh), 1, f) )
+            {
+            ret = UNKNOWN_ERROR;
+            }
+        }
+
+    for ( size_t i = 0 ; ( NO_ERROR == ret ) && ( i < count ) ; i++ )
+        {
+        FileEvent fe;
+
+        memset(&fe, 0, sizeof(fe));
+        fe.timestamp = events[i].timestamp;
+        strncpy(fe.name, events[i].name, sizeof(fe.name) - 1);
+        fe.tid = events[i].tid;
+        fe.arg = events[i].arg;
+
+        if ( 1 != fwrite(&fe, sizeof(fe), 1, f) )
+            {
+            ret = UNKNOWN_ERROR;
+            }
+        }
+
+    if ( 0 != fclose(f) )
+        {
+        ret = UNKNOWN_ERROR;
+        }
+
+    if ( ( NO_ERROR == ret ) && ( 0 != rename(tmpPath, path) ) )
+        {
+        ret = -errno;
+        }
+
+    if ( NO_ERROR != ret )
+        {
+        CAMHAL_LOGEB("Writing camera trace file %s failed %d", path, ret);
+        unlink(tmpPath);
+        }
+    else
+        {
+        CAMHAL_LOGDB("Camera trace saved to %s, %u events", path, ( unsigned int ) count);
+        }
+
+    delete [] events;
+
+    return ret;
+}
+
+void CameraTrace::saveIfRequested()
+{
+    char path[PROPERTY_VALUE_MAX];
+
+    property_get(CAMERA_TRACE_FILE_PROPERTY, path, "");
+    if ( '\0' != path[0] )
+        {
+        save(path);
+        }
+}
+
+};
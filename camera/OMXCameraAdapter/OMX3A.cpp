@@ -743,6 +743,13 @@ status_t OMXCameraAdapter::setScene(Gen3A_settings& Gen3A)
 }
 
 status_t OMXCameraAdapter::setEVCompensation(Gen3A_settings& Gen3A)
+{
+    return setExposureValues(Gen3A, SetEVCompensation);
+}
+
+// EV compensation and ISO live in the same OMX config structure. Updating
+// them together costs a single get/set round trip to Ducati instead of two.
+status_t OMXCameraAdapter::setExposureValues(Gen3A_settings& Gen3A, unsigned int settings)
 {
     OMX_ERRORTYPE eError = OMX_ErrorNone;
     OMX_CONFIG_EXPOSUREVALUETYPE expValues;
@@ -761,24 +768,43 @@ status_t OMXCameraAdapter::setEVCompensation(Gen3A_settings& Gen3A)
     OMX_GetConfig( mCameraAdapterParameters.mHandleComp,
                    OMX_IndexConfigCommonExposureValue,
                    &expValues);
-    CAMHAL_LOGDB("old EV Compensation for OMX = 0x%x", (int)expValues.xEVCompensation);
-    CAMHAL_LOGDB("EV Compensation for HAL = %d", Gen3A.EVCompensation);
 
-    expValues.xEVCompensation = ( Gen3A.EVCompensation * ( 1 << Q16_OFFSET ) )  / 10;
+    if ( settings & SetEVCompensation )
+        {
+        CAMHAL_LOGDB("old EV Compensation for OMX = 0x%x", (int)expValues.xEVCompensation);
+        CAMHAL_LOGDB("EV Compensation for HAL = %d", Gen3A.EVCompensation);
+
+        expValues.xEVCompensation = ( Gen3A.EVCompensation * ( 1 << Q16_OFFSET ) )  / 10;
+        }
+
+    if ( settings & SetISO )
+        {
+        if( 0 == Gen3A.ISO )
+            {
+            expValues.bAutoSensitivity = OMX_TRUE;
+            }
+        else
+            {
+            expValues.bAutoSensitivity = OMX_FALSE;
+            expValues.nSensitivity = Gen3A.ISO;
+            }
+        }
+
     eError = OMX_SetConfig( mCameraAdapterParameters.mHandleComp,
                             OMX_IndexConfigCommonExposureValue,
                             &expValues);
-    CAMHAL_LOGDB("new EV Compensation for OMX = 0x%x", (int)expValues.xEVCompensation);
     if ( OMX_ErrorNone != eError )
         {
-        CAMHAL_LOGEB("Error while configuring EV Compensation 0x%x error = 0x%x",
+        CAMHAL_LOGEB("Error while configuring EV Compensation 0x%x ISO 0x%x error = 0x%x",
                      ( unsigned int ) expValues.xEVCompensation,
+                     ( unsigned int ) expValues.nSensitivity,
                      eError);
         }
     else
         {
-        CAMHAL_LOGDB("EV Compensation 0x%x configured successfully",
-                     ( unsigned int ) expValues.xEVCompensation);
+        CAMHAL_LOGDB("EV Compensation 0x%x ISO 0x%x configured successfully",
+                     ( unsigned int ) expValues.xEVCompensation,
+                     ( unsigned int ) expValues.nSensitivity);
         }
 
     LOG_FUNCTION_NAME_EXIT;
@@ -1159,52 +1185,7 @@ status_t OMXCameraAdapter::getSaturation(Gen3A_settings& Gen3A)
 
 status_t OMXCameraAdapter::setISO(Gen3A_settings& Gen3A)
 {
-    OMX_ERRORTYPE eError = OMX_ErrorNone;
-    OMX_CONFIG_EXPOSUREVALUETYPE expValues;
-
-    LOG_FUNCTION_NAME;
-
-    if ( OMX_StateInvalid == mComponentState )
-        {
-        CAMHAL_LOGEA("OMX component is in invalid state");
-        return NO_INIT;
-        }
-
-    OMX_INIT_STRUCT_PTR (&expValues, OMX_CONFIG_EXPOSUREVALUETYPE);
-    expValues.nPortIndex = mCameraAdapterParameters.mPrevPortIndex;
-
-    OMX_GetConfig( mCameraAdapterParameters.mHandleComp,
-                   OMX_IndexConfigCommonExposureValue,
-                   &expValues);
-
-    if( 0 == Gen3A.ISO )
-        {
-        expValues.bAutoSensitivity = OMX_TRUE;
-        }
-    else
-        {
-        expValues.bAutoSensitivity = OMX_FALSE;
-        expValues.nSensitivity = Gen3A.ISO;
-        }
-
-    eError = OMX_SetConfig( mCameraAdapterParameters.mHandleComp,
-                         OMX_IndexConfigCommonExposureValue,
-                         &expValues);
-    if ( OMX_ErrorNone != eError )
-        {
-        CAMHAL_LOGEB("Error while configuring ISO 0x%x error = 0x%x",
-                     ( unsigned int ) expValues.nSensitivity,
-                     eError);
-        }
-    else
-        {
-        CAMHAL_LOGDB("ISO 0x%x configured successfully",
-                     ( unsigned int ) expValues.nSensitivity);
-        }
-
-    LOG_FUNCTION_NAME_EXIT;
-
-    return ErrorUtils::omxToAndroidError(eError);
+    return setExposureValues(Gen3A, SetISO);
 }
 
 status_t OMXCameraAdapter::getISO(Gen3A_settings& Gen3A)
@@ -1565,16 +1546,38 @@ status_t OMXCameraAdapter::setMeteringAreas(Gen3A_settings& Gen3A)
   return ret;
 }
 
+void OMXCameraAdapter::update3AApplyStats(unsigned int settings, nsecs_t start)
+{
+    const nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    m3AApplyCount++;
+    m3AApplyTotalTime += duration;
+    if ( duration > m3AApplyMaxTime ) {
+        m3AApplyMaxTime = duration;
+    }
+
+    CAMHAL_LOGDB("3A settings 0x%x applied in %lld us (avg %lld us, max %lld us over %u)",
+                 settings,
+                 (long long) ns2us(duration),
+                 (long long) ns2us(m3AApplyTotalTime / m3AApplyCount),
+                 (long long) ns2us(m3AApplyMaxTime),
+                 m3AApplyCount);
+}
+
 status_t OMXCameraAdapter::apply3Asettings( Gen3A_settings& Gen3A )
 {
     status_t ret = NO_ERROR;
     unsigned int currSett; // 32 bit
+    unsigned int applied;
     int portIndex;
+    nsecs_t start;
 
     LOG_FUNCTION_NAME;
 
     Mutex::Autolock lock(m3ASettingsUpdateLock);
 
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+
     /*
      * Scenes have a priority during the process
      * of applying 3A related parameters.
@@ -1591,6 +1594,7 @@ status_t OMXCameraAdapter::apply3Asettings( Gen3A_settings& Gen3A )
         if(Gen3A.EVCompensation) {
             setEVCompensation(Gen3A);
         }
+        update3AApplyStats(SetSceneMode, start);
         return ret;
     } else if (OMX_Manual != Gen3A.SceneMode) {
         // only certain settings are allowed when scene mode is set
@@ -1599,6 +1603,15 @@ status_t OMXCameraAdapter::apply3Asettings( Gen3A_settings& Gen3A )
         if ( mPending3Asettings == 0 ) return NO_ERROR;
     }
 
+    applied = mPending3Asettings;
+
+    // Settings sharing an OMX config structure are sent in one transaction
+    if ( (SetEVCompensation | SetISO) == (mPending3Asettings & (SetEVCompensation | SetISO)) )
+        {
+        ret |= setExposureValues(Gen3A, SetEVCompensation | SetISO);
+        mPending3Asettings &= ~(SetEVCompensation | SetISO);
+        }
+
     for( currSett = 1; currSett < E3aSettingMax; currSett <<= 1)
         {
         if( currSett & mPending3Asettings )
@@ -1702,6 +1715,8 @@ status_t OMXCameraAdapter::apply3Asettings( Gen3A_settings& Gen3A )
             }
         }
 
+        update3AApplyStats(applied, start);
+
         LOG_FUNCTION_NAME_EXIT;
 
         return ret;
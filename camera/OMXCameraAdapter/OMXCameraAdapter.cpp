@@ -239,6 +239,29 @@ status_t OMXCameraAdapter::initialize(CameraProperties::Properties* caps)
         }
     }
 
+    // initialize DCC data save thread
+    if(mDccDataSaveHandler.get() == NULL)
+        mDccDataSaveHandler = new DccDataSaveHandler(this);
+
+    if ( NULL == mDccDataSaveHandler.get() )
+    {
+        CAMHAL_LOGEA("Couldn't create DCC data save handler");
+        return NO_MEMORY;
+    }
+
+    ret = mDccDataSaveHandler->run("DccDataSaveThread", PRIORITY_BACKGROUND);
+    if ( ret != NO_ERROR )
+    {
+        if( ret == INVALID_OPERATION){
+            CAMHAL_LOGDA("DCC data save thread already runnning!!");
+            ret = NO_ERROR;
+        } else
+        {
+            CAMHAL_LOGEA("Couldn't run DCC data save thread");
+            return ret;
+        }
+    }
+
     // initialize omx callback handling thread
     if(mOMXCallbackHandler.get() == NULL)
         mOMXCallbackHandler = new OMXCallbackHandler(this);
@@ -276,6 +299,8 @@ status_t OMXCameraAdapter::initialize(CameraProperties::Properties* caps)
     mFaceDetectionRunning = false;
     mFaceDetectionPaused = false;
     mFDSkip = 1;
+    mFDNumFacesLastNotified = -1;
+    mFDUnchangedRuns = 0;
 
 
     memset(&mCameraAdapterParameters.mCameraPortParams[mCameraAdapterParameters.mImagePortIndex], 0, sizeof(OMXCameraPortParameters));
@@ -2928,6 +2953,7 @@ OMX_ERRORTYPE OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLETYPE hComponent,
         msg.command = OMXCameraAdapter::OMXCallbackHandler::CAMERA_FILL_BUFFER_DONE;
         msg.arg1 = ( void * ) hComponent;
         msg.arg2 = ( void * ) pBuffHeader;
+        msg.id = systemTime(SYSTEM_TIME_MONOTONIC);
         adapter->mOMXCallbackHandler->put(&msg);
         }
 
@@ -2938,7 +2964,8 @@ OMX_ERRORTYPE OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLETYPE hComponent,
 /* @ fn SampleTest_FillBufferDone ::  Application callback*/
 /*========================================================*/
 OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLETYPE hComponent,
-                                   OMX_IN OMX_BUFFERHEADERTYPE* pBuffHeader)
+                                   OMX_IN OMX_BUFFERHEADERTYPE* pBuffHeader,
+                                   nsecs_t fillBufferDoneTime)
 {
 
     status_t  stat = NO_ERROR;
@@ -2958,6 +2985,8 @@ OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLE
     OMX_TI_ANCILLARYDATATYPE *ancillaryData;
     bool snapshotFrame = false;
 
+    cameraFrame.mStamps[CameraFrame::STAMP_FILL_BUFFER_DONE] = fillBufferDoneTime;
+
     res1 = res2 = NO_ERROR;
     pPortParam = &(mCameraAdapterParameters.mCameraPortParams[pBuffHeader->nOutputPortIndex]);
 
@@ -3041,6 +3070,8 @@ OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLE
 
         mFramesWithDucati--;
 
+        CameraTrace::frameCounts(mFramesWithDucati, mFramesWithDisplay, mFramesWithEncoder);
+
 #ifdef CAMERAHAL_DEBUG
         if(mBuffersWithDucati.indexOfKey((int)pBuffHeader->pBuffer)<0)
             {
@@ -3058,12 +3089,18 @@ OMX_ERRORTYPE OMXCameraAdapter::OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLE
         if ( 0 == ( mFrameCount % mFDSkip ) ) {
             Mutex::Autolock lock(mFaceDetectionLock);
             if ( mFaceDetectionRunning && !mFaceDetectionPaused ) {
+                bool facesChanged = false;
                 detectFaces(pBuffHeader, fdResult, pPortParam->mWidth, pPortParam->mHeight);
                 if ( NULL != fdResult.get() ) {
-                    notifyFaceSubscribers(fdResult);
+                    // Applications keep showing the last reported faces,
+                    // so an unchanged face set needs no callback
+                    facesChanged = haveFacesChanged(fdResult->getFaceResult());
+                    if ( facesChanged ) {
+                        notifyFaceSubscribers(fdResult);
+                    }
                     fdResult.clear();
                 }
-                recalculateFDSkip(mFDSkip, mFPS, FD_PERIOD);
+                recalculateFDSkip(mFDSkip, mFPS, FD_PERIOD, facesChanged);
             }
         }
 
@@ -3235,9 +3272,11 @@ status_t OMXCameraAdapter::recalculateFPS()
     return NO_ERROR;
 }
 
-status_t OMXCameraAdapter::recalculateFDSkip(uint32_t &skip, uint32_t currentFPS, uint32_t period)
+status_t OMXCameraAdapter::recalculateFDSkip(uint32_t &skip, uint32_t currentFPS, uint32_t period,
+                                             bool facesChanged)
 {
     size_t framePeriod;
+    size_t pending;
 
     LOG_FUNCTION_NAME;
 
@@ -3249,9 +3288,33 @@ status_t OMXCameraAdapter::recalculateFDSkip(uint32_t &skip, uint32_t currentFPS
             skip = 1;
         }
     } else {
+        framePeriod = 0;
         skip = 1;
     }
 
+    // Slow down while the face set stays the same and while the notifier
+    // still holds results it has not delivered yet. Any change in the
+    // faces brings the nominal rate back immediately.
+    if ( facesChanged ) {
+        mFDUnchangedRuns = 0;
+    } else if ( mFDUnchangedRuns < FD_RESULT_POOL_SIZE ) {
+        mFDUnchangedRuns++;
+    }
+
+    pending = pendingFDResults();
+
+    skip <<= ( mFDUnchangedRuns / 2 ) + pending;
+
+    if ( ( 0 < framePeriod ) && ( ( skip * framePeriod ) > FD_MAX_PERIOD ) ) {
+        skip = FD_MAX_PERIOD / framePeriod;
+        if ( 0 == skip ) {
+            skip = 1;
+        }
+    }
+
+    CAMHAL_LOGVB("FD skip %u, unchanged runs %u, pending results %u",
+                 skip, mFDUnchangedRuns, pending);
+
     LOG_FUNCTION_NAME_EXIT;
 
     return NO_ERROR;
@@ -3313,6 +3376,14 @@ status_t OMXCameraAdapter::sendCallBacks(CameraFrame frame, OMX_IN OMX_BUFFERHEA
 
   frame.mTimestamp = (pBuffHeader->nTimeStamp * 1000) - mTimeSourceDelta;
 
+  frame.mStamps[CameraFrame::STAMP_SEND_CALLBACKS] = systemTime(SYSTEM_TIME_MONOTONIC);
+  if ( mask & CameraFrame::PREVIEW_FRAME_SYNC )
+    {
+      CameraTrace::frameStage(CameraTrace::STAGE_DUCATI_TO_ADAPTER,
+                              frame.mStamps[CameraFrame::STAMP_FILL_BUFFER_DONE],
+                              frame.mStamps[CameraFrame::STAMP_SEND_CALLBACKS]);
+    }
+
   ret = setInitFrameRefCount(frame.mBuffer, mask);
 
   if (ret != NO_ERROR) {
@@ -3448,7 +3519,8 @@ bool OMXCameraAdapter::OMXCallbackHandler::Handler()
             case OMXCallbackHandler::CAMERA_FILL_BUFFER_DONE:
             {
                 ret = mCameraAdapter->OMXCameraAdapterFillBufferDone(( OMX_HANDLETYPE ) msg.arg1,
-                                                                     ( OMX_BUFFERHEADERTYPE *) msg.arg2);
+                                                                     ( OMX_BUFFERHEADERTYPE *) msg.arg2,
+                                                                     ( nsecs_t ) msg.id);
                 break;
             }
             case CommandHandler::COMMAND_EXIT:
@@ -3518,6 +3590,10 @@ OMXCameraAdapter::OMXCameraAdapter(size_t sensor_index)
     mFramesWithDisplay = 0;
     mFramesWithEncoder = 0;
 
+    m3AApplyCount = 0;
+    m3AApplyTotalTime = 0;
+    m3AApplyMaxTime = 0;
+
     LOG_FUNCTION_NAME_EXIT;
 }
 
@@ -3575,6 +3651,17 @@ OMXCameraAdapter::~OMXCameraAdapter()
         mCommandHandler.clear();
     }
 
+    //Write out pending DCC data and free ref to DCC data save thread
+    if ( NULL != mDccDataSaveHandler.get() )
+    {
+        TIUTILS::Message msg;
+        flushDccFileDataSave();
+        msg.command = DccDataSaveHandler::COMMAND_EXIT;
+        mDccDataSaveHandler->put(&msg);
+        mDccDataSaveHandler->requestExitAndWait();
+        mDccDataSaveHandler.clear();
+    }
+
     //Exit and free ref to callback handling thread
     if ( NULL != mOMXCallbackHandler.get() )
     {
@@ -24,6 +24,9 @@
 #include "CameraHal.h"
 #include "OMXCameraAdapter.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 
 namespace android {
 
@@ -176,10 +179,11 @@ status_t OMXCameraAdapter::sniffDccFileDataSave(OMX_BUFFERHEADERTYPE* pBuffHeade
 // enough length!!! (260 should suffice). Path must end with "/".
 // The directory must also be closed in the caller function.
 // If the correct camera DCC file is found (based on the OMX measurement data)
-// its file stream pointer is returned. NULL is returned otherwise
-FILE * OMXCameraAdapter::parseDCCsubDir(DIR *pDir, char *path)
+// it is opened for writing and its file descriptor is returned. -1 is
+// returned otherwise
+int OMXCameraAdapter::parseDCCsubDir(DIR *pDir, char *path, const OMX_TI_DCCDATATYPE &dccData)
 {
-    FILE *pFile;
+    int fd;
     DIR *pSubDir;
     struct dirent *dirEntry;
     int initialPathLength = strlen(path);
@@ -198,47 +202,33 @@ FILE * OMXCameraAdapter::parseDCCsubDir(DIR *pDir, char *path)
         if (pSubDir) {
             // dirEntry is sub directory -> parse it
             strcat(path, "/");
-            pFile = parseDCCsubDir(pSubDir, path);
+            fd = parseDCCsubDir(pSubDir, path, dccData);
             closedir(pSubDir);
-            if (pFile) {
+            if (fd >= 0) {
                 // the correct DCC file found!
                 LOG_FUNCTION_NAME_EXIT;
-                return pFile;
+                return fd;
             }
         } else {
             // dirEntry is file -> open it
-            pFile = fopen(path, "rb");
-            if (pFile) {
-                // now check if this is the correct DCC file for that camera
-                OMX_U32 dccFileIDword;
-                OMX_U32 *dccFileDesc = (OMX_U32 *) &mDccData.nCameraModuleId;
-                int i;
-
+            fd = open(path, O_RDWR);
+            if (fd >= 0) {
+                // now check if this is the correct DCC file for that camera.
                 // DCC file ID is 3 4-byte words
-                for (i = 0; i < 3; i++) {
-                    if (fread(&dccFileIDword, sizeof(OMX_U32), 1, pFile) != 1) {
-                        // file too short
-                        break;
-                    }
-                    if (dccFileIDword != dccFileDesc[i]) {
-                        // DCC file ID word i does not match
-                        break;
-                    }
-                }
+                OMX_U32 dccFileID[3];
+                const OMX_U32 *dccFileDesc = (const OMX_U32 *) &dccData.nCameraModuleId;
 
-                fclose(pFile);
-                if (i == 3) {
+                if ((pread(fd, dccFileID, sizeof(dccFileID), 0) == sizeof(dccFileID)) &&
+                    (memcmp(dccFileID, dccFileDesc, sizeof(dccFileID)) == 0)) {
                     // the correct DCC file found!
                     CAMHAL_LOGDB("DCC file to be updated: %s", path);
-                    // reopen it for modification
-                    pFile = fopen(path, "rb+");
-                    if (!pFile)
-                        CAMHAL_LOGEB("ERROR: DCC file %s failed to open for modification", path);
                     LOG_FUNCTION_NAME_EXIT;
-                    return pFile;
+                    return fd;
                 }
+
+                close(fd);
             } else {
-                CAMHAL_LOGEB("ERROR: Failed to open file %s for reading", path);
+                CAMHAL_LOGEB("ERROR: Failed to open file %s for modification", path);
             }
         }
         // restore original path
@@ -248,16 +238,16 @@ FILE * OMXCameraAdapter::parseDCCsubDir(DIR *pDir, char *path)
     LOG_FUNCTION_NAME_EXIT;
 
     // DCC file not found in this directory tree
-    return NULL;
+    return -1;
 }
 
-// Finds the DCC file corresponding to the current camera based on the
-// OMX measurement data, opens it and returns the file stream pointer
-// (NULL on error or if file not found).
+// Finds the DCC file corresponding to the given DCC data based on the
+// OMX measurement data, opens it and returns the file descriptor
+// (-1 on error or if file not found).
 // The folder string dccFolderPath must end with "/"
-FILE * OMXCameraAdapter::fopenCameraDCC(const char *dccFolderPath)
+int OMXCameraAdapter::openCameraDCC(const char *dccFolderPath, const OMX_TI_DCCDATATYPE &dccData)
 {
-    FILE *pFile;
+    int fd;
     DIR *pDir;
     char dccPath[260];
 
@@ -269,83 +259,122 @@ FILE * OMXCameraAdapter::fopenCameraDCC(const char *dccFolderPath)
     if (!pDir) {
         CAMHAL_LOGEB("ERROR: Opening DCC directory %s failed", dccPath);
         LOG_FUNCTION_NAME_EXIT;
-        return NULL;
+        return -1;
     }
 
-    pFile = parseDCCsubDir(pDir, dccPath);
+    fd = parseDCCsubDir(pDir, dccPath, dccData);
     closedir(pDir);
-    if (pFile) {
+    if (fd >= 0) {
         CAMHAL_LOGDB("DCC file %s opened for modification", dccPath);
     }
 
     LOG_FUNCTION_NAME_EXIT;
 
-    return pFile;
+    return fd;
 }
 
-// Positions the DCC file stream pointer to the correct offset within the
-// correct usecase based on the OMX mesurement data. Returns 0 on success
-status_t OMXCameraAdapter::fseekDCCuseCasePos(FILE *pFile)
+// Computes the file offset of the data to be modified within the correct
+// usecase based on the OMX mesurement data. Returns 0 on success
+status_t OMXCameraAdapter::getDCCuseCaseOffset(int fd, const OMX_TI_DCCDATATYPE &dccData,
+                                               off_t &offset)
 {
     OMX_U32 dccNumUseCases = 0;
     OMX_U32 dccUseCaseData[3];
+    off_t pos;
     OMX_U32 i;
 
     LOG_FUNCTION_NAME;
 
-    // position the file pointer to the DCC use cases section
-    if (fseek(pFile, 80, SEEK_SET)) {
-        CAMHAL_LOGEA("ERROR: Unexpected end of DCC file");
-        LOG_FUNCTION_NAME_EXIT;
-        return -EINVAL;
-    }
+    // the DCC use cases section starts at offset 80
+    pos = 80;
 
-    if (fread(&dccNumUseCases, sizeof(OMX_U32), 1, pFile) != 1 ||
+    if (pread(fd, &dccNumUseCases, sizeof(OMX_U32), pos) != sizeof(OMX_U32) ||
         dccNumUseCases == 0) {
         CAMHAL_LOGEA("ERROR: DCC file contains 0 use cases");
         LOG_FUNCTION_NAME_EXIT;
         return -EINVAL;
     }
+    pos += sizeof(OMX_U32);
 
     for (i = 0; i < dccNumUseCases; i++) {
-        if (fread(dccUseCaseData, sizeof(OMX_U32), 3, pFile) != 3) {
+        if (pread(fd, dccUseCaseData, sizeof(dccUseCaseData), pos) != sizeof(dccUseCaseData)) {
             CAMHAL_LOGEA("ERROR: Unexpected end of DCC file");
             LOG_FUNCTION_NAME_EXIT;
             return -EINVAL;
         }
+        pos += sizeof(dccUseCaseData);
 
-        if (dccUseCaseData[0] == mDccData.nUseCaseId) {
+        if (dccUseCaseData[0] == dccData.nUseCaseId) {
             // DCC use case match!
             break;
         }
     }
 
     if (i == dccNumUseCases) {
-        CAMHAL_LOGEB("ERROR: Use case ID %lu not found in DCC file", mDccData.nUseCaseId);
+        CAMHAL_LOGEB("ERROR: Use case ID %lu not found in DCC file", dccData.nUseCaseId);
         LOG_FUNCTION_NAME_EXIT;
         return -EINVAL;
     }
 
     // dccUseCaseData[1] is the offset to the beginning of the actual use case
     // from the beginning of the file
-    // mDccData.nOffset is the offset within the actual use case (from the
+    // dccData.nOffset is the offset within the actual use case (from the
     // beginning of the use case to the data to be modified)
+    offset = dccUseCaseData[1] + dccData.nOffset;
 
-    if (fseek(pFile,dccUseCaseData[1] + mDccData.nOffset, SEEK_SET ))
-    {
-        CAMHAL_LOGEA("ERROR: Error setting the correct offset");
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+// Writes staged DCC data to its DCC file. Runs on the DCC data save thread.
+// Returns the file descriptor of the updated file, which the caller must
+// sync and close, or -1 if nothing was written.
+int OMXCameraAdapter::writeDccFileDataSave(const OMX_TI_DCCDATATYPE &dccData)
+{
+    off_t offset;
+    int dccDataSize;
+    int fd;
+
+    LOG_FUNCTION_NAME;
+
+    fd = openCameraDCC(DCC_PATH, dccData);
+    if (fd < 0) {
+        CAMHAL_LOGEA("ERROR: Correct DCC file not found or failed to open for modification");
         LOG_FUNCTION_NAME_EXIT;
-        return -EINVAL;
+        return -1;
+    }
+
+    if (getDCCuseCaseOffset(fd, dccData, offset)) {
+        close(fd);
+        LOG_FUNCTION_NAME_EXIT;
+        return -1;
+    }
+
+    dccDataSize = (int)dccData.nSize - (int)(&(((OMX_TI_DCCDATATYPE*)0)->pData));
+
+    if (pwrite(fd, dccData.pData, dccDataSize, offset) != dccDataSize) {
+        CAMHAL_LOGEA("ERROR: Writing to DCC file failed");
+        close(fd);
+        LOG_FUNCTION_NAME_EXIT;
+        return -1;
     }
 
+    CAMHAL_LOGDA("DCC file successfully updated");
+
     LOG_FUNCTION_NAME_EXIT;
 
-    return NO_ERROR;
+    return fd;
 }
 
+// Stages the last DCC data received from Ducati and hands it over to the
+// DCC data save thread, so the file system is kept out of the capture path
 status_t OMXCameraAdapter::saveDccFileDataSave()
 {
     status_t ret = NO_ERROR;
+    OMX_TI_DCCDATATYPE *staged;
+    TIUTILS::Message msg;
+    int dccDataSize;
 
     LOG_FUNCTION_NAME;
 
@@ -353,29 +382,79 @@ status_t OMXCameraAdapter::saveDccFileDataSave()
 
     if (mDccData.pData)
         {
-        FILE *fd = fopenCameraDCC(DCC_PATH);
+        dccDataSize = (int)mDccData.nSize - (int)(&(((OMX_TI_DCCDATATYPE*)0)->pData));
 
-        if (fd)
+        staged = (OMX_TI_DCCDATATYPE *) malloc(sizeof(OMX_TI_DCCDATATYPE));
+        if (NULL == staged)
             {
-            if (!fseekDCCuseCasePos(fd))
-                {
-                int dccDataSize = (int)mDccData.nSize - (int)(&(((OMX_TI_DCCDATATYPE*)0)->pData));
-
-                if (fwrite(mDccData.pData, dccDataSize, 1, fd) != 1)
-                    {
-                    CAMHAL_LOGEA("ERROR: Writing to DCC file failed");
-                    }
-                else
-                    {
-                    CAMHAL_LOGDA("DCC file successfully updated");
-                    }
-                }
-            fclose(fd);
+            LOG_FUNCTION_NAME_EXIT;
+            return NO_MEMORY;
+            }
+
+        memcpy(staged, &mDccData, sizeof(OMX_TI_DCCDATATYPE));
+        staged->pData = malloc(dccDataSize);
+        if (NULL == staged->pData)
+            {
+            free(staged);
+            LOG_FUNCTION_NAME_EXIT;
+            return NO_MEMORY;
+            }
+        memcpy(staged->pData, mDccData.pData, dccDataSize);
+
+        if (NULL != mDccDataSaveHandler.get())
+            {
+            msg.command = DccDataSaveHandler::DCC_DATA_SAVE;
+            msg.arg1 = staged;
+            ret = mDccDataSaveHandler->put(&msg);
             }
         else
             {
-            CAMHAL_LOGEA("ERROR: Correct DCC file not found or failed to open for modification");
+            ret = NO_INIT;
             }
+
+        if (NO_ERROR != ret)
+            {
+            // no writer thread, save synchronously
+            int fd = writeDccFileDataSave(*staged);
+            if (fd >= 0)
+                {
+                fsync(fd);
+                close(fd);
+                }
+            free(staged->pData);
+            free(staged);
+            ret = NO_ERROR;
+            }
+        }
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return ret;
+}
+
+// Blocks until all DCC data handed to the save thread is on disk
+status_t OMXCameraAdapter::flushDccFileDataSave()
+{
+    status_t ret = NO_ERROR;
+    TIUTILS::Message msg;
+    Semaphore flushSem;
+
+    LOG_FUNCTION_NAME;
+
+    if (NULL == mDccDataSaveHandler.get())
+        {
+        LOG_FUNCTION_NAME_EXIT;
+        return NO_ERROR;
+        }
+
+    flushSem.Create(0);
+
+    msg.command = DccDataSaveHandler::DCC_DATA_FLUSH;
+    msg.arg1 = &flushSem;
+    ret = mDccDataSaveHandler->put(&msg);
+    if (NO_ERROR == ret)
+        {
+        flushSem.Wait();
         }
 
     LOG_FUNCTION_NAME_EXIT;
@@ -400,4 +479,66 @@ status_t OMXCameraAdapter::closeDccFileDataSave()
     return ret;
 }
 
+bool OMXCameraAdapter::DccDataSaveHandler::Handler()
+{
+    TIUTILS::Message msg;
+    volatile int forever = 1;
+    Vector<int> pendingSync;
+    bool queueEmpty;
+
+    LOG_FUNCTION_NAME;
+
+    while ( forever )
+        {
+        TIUTILS::MessageQueue::waitForMsg(&mCommandMsgQ, NULL, NULL, -1);
+        {
+        Mutex::Autolock lock(mLock);
+        mCommandMsgQ.get(&msg);
+        queueEmpty = mCommandMsgQ.isEmpty();
+        }
+
+        switch ( msg.command ) {
+            case DccDataSaveHandler::DCC_DATA_SAVE:
+            {
+                OMX_TI_DCCDATATYPE *staged = (OMX_TI_DCCDATATYPE *) msg.arg1;
+                int fd = mCameraAdapter->writeDccFileDataSave(*staged);
+                if ( 0 <= fd ) {
+                    pendingSync.add(fd);
+                }
+                free(staged->pData);
+                free(staged);
+                break;
+            }
+            case DccDataSaveHandler::DCC_DATA_FLUSH:
+            {
+                break;
+            }
+            case DccDataSaveHandler::COMMAND_EXIT:
+            {
+                CAMHAL_LOGDA("Exiting DCC data save handler");
+                forever = 0;
+                break;
+            }
+        }
+
+        // Writes queued back to back are synced together once the queue
+        // drains, or right away when a flush barrier is requested
+        if ( queueEmpty || !forever || ( DccDataSaveHandler::DCC_DATA_FLUSH == msg.command ) ) {
+            for ( unsigned int i = 0 ; i < pendingSync.size() ; i++ ) {
+                fsync(pendingSync[i]);
+                close(pendingSync[i]);
+            }
+            pendingSync.clear();
+        }
+
+        if ( DccDataSaveHandler::DCC_DATA_FLUSH == msg.command ) {
+            ( ( Semaphore * ) msg.arg1 )->Signal();
+        }
+        }
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return false;
+}
+
 };
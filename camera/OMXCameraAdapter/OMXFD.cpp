@@ -74,6 +74,8 @@ status_t OMXCameraAdapter::startFaceDetection()
     // regions alone.
 
     faceDetectionNumFacesLastOutput = 0;
+    mFDNumFacesLastNotified = -1;
+    mFDUnchangedRuns = 0;
  out:
     return ret;
 }
@@ -103,6 +105,8 @@ status_t OMXCameraAdapter::stopFaceDetection()
     }
 
     faceDetectionNumFacesLastOutput = 0;
+    mFDNumFacesLastNotified = -1;
+    mFDUnchangedRuns = 0;
  out:
     return ret;
 }
@@ -114,6 +118,8 @@ void OMXCameraAdapter::pauseFaceDetection(bool pause)
     if (mFaceDetectionRunning) {
         mFaceDetectionPaused = pause;
         faceDetectionNumFacesLastOutput = 0;
+        mFDNumFacesLastNotified = -1;
+        mFDUnchangedRuns = 0;
     }
 }
 
@@ -215,7 +221,6 @@ status_t OMXCameraAdapter::detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader,
     OMX_OTHER_EXTRADATATYPE *extraData;
     OMX_FACEDETECTIONTYPE *faceData;
     OMX_TI_PLATFORMPRIVATE *platformPrivate;
-    camera_frame_metadata_t *faces;
 
     LOG_FUNCTION_NAME;
 
@@ -294,11 +299,14 @@ status_t OMXCameraAdapter::detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader,
         return -EINVAL;
     }
 
-    ret = encodeFaceCoordinates(faceData, &faces, previewWidth, previewHeight);
+    result = getFDResult();
+    if ( NULL == result.get() ) {
+        return -ENOMEM;
+    }
 
-    if ( NO_ERROR == ret ) {
-        result = new CameraFDResult(faces);
-    } else {
+    ret = encodeFaceCoordinates(faceData, result->getFaceResult(), previewWidth, previewHeight);
+
+    if ( NO_ERROR != ret ) {
         result.clear();
         result = NULL;
     }
@@ -308,20 +316,107 @@ status_t OMXCameraAdapter::detectFaces(OMX_BUFFERHEADERTYPE* pBuffHeader,
     return ret;
 }
 
+// Returns a face detection result with room for MAX_NUM_FACES_SUPPORTED
+// faces. Results the notifier has already released are recycled, a new
+// one is allocated only when all pooled results are still in flight.
+sp<CameraFDResult> OMXCameraAdapter::getFDResult()
+{
+    sp<CameraFDResult> result;
+    camera_frame_metadata_t *faceResult;
+    int freeSlot = -1;
+
+    for ( int i = 0; i < FD_RESULT_POOL_SIZE; i++ ) {
+        if ( NULL == mFDResultPool[i].get() ) {
+            if ( 0 > freeSlot ) {
+                freeSlot = i;
+            }
+        } else if ( 1 == mFDResultPool[i]->getStrongCount() ) {
+            // only the pool references it
+            return mFDResultPool[i];
+        }
+    }
+
+    faceResult = ( camera_frame_metadata_t * ) malloc(sizeof(camera_frame_metadata_t));
+    if ( NULL == faceResult ) {
+        return NULL;
+    }
+
+    faceResult->number_of_faces = 0;
+    faceResult->faces = ( camera_face_t * ) malloc(sizeof(camera_face_t) * MAX_NUM_FACES_SUPPORTED);
+    if ( NULL == faceResult->faces ) {
+        free(faceResult);
+        return NULL;
+    }
+
+    result = new CameraFDResult(faceResult);
+    if ( 0 <= freeSlot ) {
+        mFDResultPool[freeSlot] = result;
+    }
+
+    return result;
+}
+
+// Number of face detection results still waiting for the notifier
+size_t OMXCameraAdapter::pendingFDResults()
+{
+    size_t pending = 0;
+
+    for ( int i = 0; i < FD_RESULT_POOL_SIZE; i++ ) {
+        if ( ( NULL != mFDResultPool[i].get() ) &&
+             ( 1 < mFDResultPool[i]->getStrongCount() ) ) {
+            pending++;
+        }
+    }
+
+    return pending;
+}
+
+// Compares a new face set against the last one sent to the subscribers,
+// using the same tolerances as the face smoothing filter. Records the new
+// set when it differs.
+bool OMXCameraAdapter::haveFacesChanged(const camera_frame_metadata_t *faceResult)
+{
+    bool changed = false;
+
+    if ( faceResult->number_of_faces != mFDNumFacesLastNotified ) {
+        changed = true;
+    } else {
+        for ( int i = 0; i < faceResult->number_of_faces; i++ ) {
+            const int32_t *rect = faceResult->faces[i].rect;
+            const int32_t *lastRect = mFDLastNotified[i].rect;
+
+            if ( ( abs(rect[0] - lastRect[0]) >= HorizontalFilterThreshold ) ||
+                 ( abs(rect[1] - lastRect[1]) >= VerticalFilterThreshold ) ||
+                 ( abs(rect[2] - lastRect[2]) >= HorizontalFilterThreshold ) ||
+                 ( abs(rect[3] - lastRect[3]) >= VerticalFilterThreshold ) ) {
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    if ( changed ) {
+        memcpy(mFDLastNotified, faceResult->faces,
+               sizeof(camera_face_t) * faceResult->number_of_faces);
+        mFDNumFacesLastNotified = faceResult->number_of_faces;
+    }
+
+    return changed;
+}
+
 status_t OMXCameraAdapter::encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *faceData,
-                                                 camera_frame_metadata_t **pFaces,
+                                                 camera_frame_metadata_t *faceResult,
                                                  size_t previewWidth,
                                                  size_t previewHeight)
 {
     status_t ret = NO_ERROR;
     camera_face_t *faces;
-    camera_frame_metadata_t *faceResult;
     size_t hRange, vRange;
     double tmp;
 
     LOG_FUNCTION_NAME;
 
-    if ( NULL == faceData ) {
+    if ( ( NULL == faceData ) || ( NULL == faceResult ) ) {
         CAMHAL_LOGEA("Invalid OMX_FACEDETECTIONTYPE parameter");
         return EINVAL;
     }
@@ -329,18 +424,15 @@ status_t OMXCameraAdapter::encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *fa
     hRange = CameraFDResult::RIGHT - CameraFDResult::LEFT;
     vRange = CameraFDResult::BOTTOM - CameraFDResult::TOP;
 
-    faceResult = ( camera_frame_metadata_t * ) malloc(sizeof(camera_frame_metadata_t));
-    if ( NULL == faceResult ) {
-        return -ENOMEM;
-    }
+    faces = faceResult->faces;
 
     if ( 0 < faceData->ulFaceCount ) {
         int orient_mult;
         int trans_left, trans_top, trans_right, trans_bot;
+        int faceCount = faceData->ulFaceCount;
 
-        faces = ( camera_face_t * ) malloc(sizeof(camera_face_t)*faceData->ulFaceCount);
-        if ( NULL == faces ) {
-            return -ENOMEM;
+        if ( MAX_NUM_FACES_SUPPORTED < faceCount ) {
+            faceCount = MAX_NUM_FACES_SUPPORTED;
         }
 
         /**
@@ -391,7 +483,7 @@ status_t OMXCameraAdapter::encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *fa
         }
 
         int j = 0, i = 0;
-        for ( ; j < faceData->ulFaceCount ; j++)
+        for ( ; j < faceCount ; j++)
             {
              OMX_S32 nLeft = 0;
              OMX_S32 nTop = 0;
@@ -444,7 +536,6 @@ status_t OMXCameraAdapter::encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *fa
             }
 
         faceResult->number_of_faces = i;
-        faceResult->faces = faces;
 
         for (int i = 0; i  < faceResult->number_of_faces; i++)
         {
@@ -494,11 +585,8 @@ status_t OMXCameraAdapter::encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *fa
         faceDetectionNumFacesLastOutput = faceResult->number_of_faces;
     } else {
         faceResult->number_of_faces = 0;
-        faceResult->faces = NULL;
     }
 
-    *pFaces = faceResult;
-
     LOG_FUNCTION_NAME_EXIT;
 
     return ret;
@@ -0,0 +1,706 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file SyntheticCameraAdapter.cpp
+*
+* This file implements a camera adapter generating test frames, used to
+* exercise and benchmark the Camera HAL without camera hardware.
+*
+*/
+
+
+#include "SyntheticCameraAdapter.h"
+#include "CameraHal.h"
+#include "TICameraParameters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <cutils/properties.h>
+
+namespace android {
+
+#define SYNTHETIC_DEFAULT_FPS 30
+
+//Number of vertical color bars in the test pattern
+#define PATTERN_BARS 8
+
+Mutex gAdapterLock;
+
+//U and V of the color bars, from white to black
+static const uint8_t sBarU[PATTERN_BARS] = { 128, 16, 166, 54, 202, 90, 240, 128 };
+static const uint8_t sBarV[PATTERN_BARS] = { 128, 146, 16, 34, 222, 240, 110, 128 };
+
+static void fillNV12(uint8_t *y, uint8_t *uv, int stride, int width, int height)
+{
+    for ( int i = 0 ; i < height ; i++ )
+        {
+        for ( int j = 0 ; j < width ; j++ )
+            {
+            y[j] = ( uint8_t ) ( ( i + j ) & 0xFF );
+            }
+        y += stride;
+        }
+
+    for ( int i = 0 ; i < height / 2 ; i++ )
+        {
+        for ( int j = 0 ; j < width / 2 ; j++ )
+            {
+            int bar = ( j * 2 * PATTERN_BARS ) / width;
+            uv[2 * j] = sBarU[bar];
+            uv[2 * j + 1] = sBarV[bar];
+            }
+        uv += stride;
+        }
+}
+
+static void fillUYVY(uint8_t *buffer, int stride, int width, int height)
+{
+    for ( int i = 0 ; i < height ; i++ )
+        {
+        uint8_t *p = buffer + i * stride;
+        for ( int j = 0 ; j < width / 2 ; j++ )
+            {
+            int bar = ( j * 2 * PATTERN_BARS ) / width;
+            p[4 * j] = sBarU[bar];
+            p[4 * j + 1] = ( uint8_t ) ( ( i + 2 * j ) & 0xFF );
+            p[4 * j + 2] = sBarV[bar];
+            p[4 * j + 3] = ( uint8_t ) ( ( i + 2 * j + 1 ) & 0xFF );
+            }
+        }
+}
+
+/*--------------------Camera Adapter Class STARTS here-----------------------------*/
+
+SyntheticCameraAdapter::SyntheticCameraAdapter(size_t sensor_index)
+{
+    LOG_FUNCTION_NAME;
+
+    mSensorIndex = sensor_index;
+    mPreviewWidth = 0;
+    mPreviewHeight = 0;
+    mPreviewNV12 = true;
+    mPictureWidth = 0;
+    mPictureHeight = 0;
+    mPreviewing = false;
+    mCapturePending = false;
+    mFramePeriod = s2ns(1) / SYNTHETIC_DEFAULT_FPS;
+    mStreamStart = 0;
+    mFrameIndex = 0;
+    mDroppedFrames = 0;
+
+    LOG_FUNCTION_NAME_EXIT;
+}
+
+SyntheticCameraAdapter::~SyntheticCameraAdapter()
+{
+    LOG_FUNCTION_NAME;
+
+    stopPreview();
+
+    LOG_FUNCTION_NAME_EXIT;
+}
+
+status_t SyntheticCameraAdapter::initialize(CameraProperties::Properties* caps)
+{
+    LOG_FUNCTION_NAME;
+
+    mRecording = false;
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+status_t SyntheticCameraAdapter::setParameters(const CameraParameters &params)
+{
+    char value[PROPERTY_VALUE_MAX];
+    const char *format;
+    int fps;
+
+    LOG_FUNCTION_NAME;
+
+    Mutex::Autolock lock(mGeneratorLock);
+
+    params.getPreviewSize(&mPreviewWidth, &mPreviewHeight);
+    params.getPictureSize(&mPictureWidth, &mPictureHeight);
+
+    format = params.getPreviewFormat();
+    mPreviewNV12 = ( NULL == format ) ||
+                   ( strcmp(format, CameraParameters::PIXEL_FORMAT_YUV422I) != 0 );
+
+    property_get(SYNTHETIC_FPS_PROPERTY, value, "0");
+    fps = atoi(value);
+    if ( 0 >= fps )
+        {
+        fps = params.getPreviewFrameRate();
+        }
+    if ( 0 >= fps )
+        {
+        fps = SYNTHETIC_DEFAULT_FPS;
+        }
+    mFramePeriod = s2ns(1) / fps;
+
+    CAMHAL_LOGDB("Synthetic preview %dx%d %s @ %d fps, picture %dx%d",
+                 mPreviewWidth,
+                 mPreviewHeight,
+                 mPreviewNV12 ? "NV12" : "YUV422I",
+                 fps,
+                 mPictureWidth,
+                 mPictureHeight);
+
+    // Udpate the current parameter set
+    mParams = params;
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+void SyntheticCameraAdapter::getParameters(CameraParameters& params)
+{
+    LOG_FUNCTION_NAME;
+
+    // Return the current parameter set
+    params = mParams;
+
+    LOG_FUNCTION_NAME_EXIT;
+}
+
+status_t SyntheticCameraAdapter::useBuffers(CameraMode mode, void* bufArr, int num, size_t length, unsigned int queueable)
+{
+    status_t ret = NO_ERROR;
+    int *buffers = ( int * ) bufArr;
+
+    LOG_FUNCTION_NAME;
+
+    if ( NULL == bufArr )
+        {
+        return BAD_VALUE;
+        }
+
+    switch ( mode )
+        {
+        case CAMERA_PREVIEW:
+        case CAMERA_VIDEO:
+            {
+            Mutex::Autolock lock(mGeneratorLock);
+
+            //Only the queueable buffers start out with the adapter, the
+            //rest are handed over through fillThisBuffer()
+            mFreeBuffers.clear();
+            mPatternBuffers.clear();
+            for ( unsigned int i = 0 ; i < queueable && i < ( unsigned int ) num ; i++ )
+                {
+                mFreeBuffers.add(( void * ) buffers[i]);
+                }
+            break;
+            }
+
+        case CAMERA_IMAGE_CAPTURE:
+            //Capture buffers are tracked by BaseCameraAdapter
+            break;
+
+        default:
+            ret = BAD_VALUE;
+            break;
+        }
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return ret;
+}
+
+status_t SyntheticCameraAdapter::fillThisBuffer(void* frameBuf, CameraFrame::FrameType frameType)
+{
+    LOG_FUNCTION_NAME;
+
+    if ( NULL == frameBuf )
+        {
+        return -EINVAL;
+        }
+
+    if ( ( CameraFrame::IMAGE_FRAME == frameType ) ||
+         ( CameraFrame::RAW_FRAME == frameType ) )
+        {
+        // Signal end of image capture
+        if ( NULL != mEndImageCaptureCallback )
+            {
+            mEndImageCaptureCallback(mEndCaptureData);
+            }
+        return NO_ERROR;
+        }
+
+    Mutex::Autolock lock(mGeneratorLock);
+
+    if ( mPreviewing )
+        {
+        mFreeBuffers.add(frameBuf);
+        }
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+status_t SyntheticCameraAdapter::startPreview()
+{
+    LOG_FUNCTION_NAME;
+
+    {
+    Mutex::Autolock lock(mGeneratorLock);
+
+    if ( mPreviewing )
+        {
+        return ALREADY_EXISTS;
+        }
+
+    mFrameIndex = 0;
+    mDroppedFrames = 0;
+    mStreamStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    mPreviewing = true;
+    }
+
+    mGeneratorThread = new FrameGeneratorThread(this);
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+status_t SyntheticCameraAdapter::stopPreview()
+{
+    LOG_FUNCTION_NAME;
+
+    {
+    Mutex::Autolock lock(mGeneratorLock);
+
+    if ( !mPreviewing )
+        {
+        return NO_INIT;
+        }
+
+    mPreviewing = false;
+    mCapturePending = false;
+    }
+
+    if ( NULL != mGeneratorThread.get() )
+        {
+        mGeneratorThread->requestExitAndWait();
+        mGeneratorThread.clear();
+        }
+
+    {
+    Mutex::Autolock lock(mGeneratorLock);
+    mFreeBuffers.clear();
+    mPatternBuffers.clear();
+    }
+
+    CAMHAL_LOGI("Synthetic camera generated %u frames, %u dropped for lack of buffers",
+                mFrameIndex,
+                mDroppedFrames);
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+status_t SyntheticCameraAdapter::takePicture()
+{
+    LOG_FUNCTION_NAME;
+
+    Mutex::Autolock lock(mGeneratorLock);
+
+    if ( !mPreviewing )
+        {
+        return NO_INIT;
+        }
+
+    //The picture is delivered in place of the next preview frame
+    mCapturePending = true;
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+status_t SyntheticCameraAdapter::getFrameSize(size_t &width, size_t &height)
+{
+    LOG_FUNCTION_NAME;
+
+    mParams.getPreviewSize(( int * ) &width,
+                           ( int * ) &height);
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+status_t SyntheticCameraAdapter::getFrameDataSize(size_t &dataFrameSize, size_t bufferCount)
+{
+    // No measurement data is generated
+    dataFrameSize = 0;
+
+    return NO_ERROR;
+}
+
+status_t SyntheticCameraAdapter::getPictureBufferSize(size_t &length, size_t bufferCount)
+{
+    int width, height;
+
+    LOG_FUNCTION_NAME;
+
+    //Pictures are generated as YUV422I and encoded by AppCallbackNotifier
+    mParams.getPictureSize(&width, &height);
+    length = width * height * 2;
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+/* Frame generation */
+// ---------------------------------------------------------------------------
+
+void SyntheticCameraAdapter::fillPreviewFrame(void *buffer, uint32_t index)
+{
+    uint8_t *y = NULL;
+    uint8_t *uv = NULL;
+    SyntheticFrameStamp stamp;
+
+    {
+    Mutex::Autolock lock(mSubscriberLock);
+    ssize_t i = mFrameQueue.indexOfKey(buffer);
+    if ( 0 <= i )
+        {
+        y = ( uint8_t * ) mFrameQueue.valueAt(i)->mYuv[0];
+        uv = ( uint8_t * ) mFrameQueue.valueAt(i)->mYuv[1];
+        }
+    }
+
+    if ( NULL == y )
+        {
+        CAMHAL_LOGEB("No mapping for preview buffer %p", buffer);
+        return;
+        }
+
+    //A sensor writes frames without any CPU involvement, so the pattern is
+    //only drawn once per buffer and each frame just gets a new stamp
+    if ( mPatternBuffers.indexOfKey(buffer) < 0 )
+        {
+        if ( mPreviewNV12 && ( NULL != uv ) )
+            {
+            fillNV12(y, uv, SYNTHETIC_PREVIEW_STRIDE, mPreviewWidth, mPreviewHeight);
+            }
+        else
+            {
+            fillUYVY(y, SYNTHETIC_PREVIEW_STRIDE, mPreviewWidth, mPreviewHeight);
+            }
+        mPatternBuffers.add(buffer, true);
+        }
+
+    stamp.magic = SYNTHETIC_FRAME_STAMP_MAGIC;
+    stamp.index = index;
+    stamp.generated = systemTime(SYSTEM_TIME_MONOTONIC);
+    memcpy(y, &stamp, sizeof(stamp));
+}
+
+status_t SyntheticCameraAdapter::sendImageFrame()
+{
+    status_t ret = NO_ERROR;
+    CameraFrame frame;
+    void *buffer = NULL;
+    SyntheticFrameStamp stamp;
+
+    {
+    Mutex::Autolock lock(mCaptureBufferLock);
+    if ( ( NULL != mCaptureBuffers ) && ( 0 < mCaptureBuffersAvailable.size() ) )
+        {
+        buffer = ( void * ) mCaptureBuffers[0];
+        }
+    }
+
+    if ( NULL == buffer )
+        {
+        CAMHAL_LOGEA("No capture buffer available");
+        return NO_MEMORY;
+        }
+
+    notifyShutterSubscribers();
+
+    fillUYVY(( uint8_t * ) buffer, mPictureWidth * 2, mPictureWidth, mPictureHeight);
+
+    stamp.magic = SYNTHETIC_FRAME_STAMP_MAGIC;
+    stamp.index = mFrameIndex;
+    stamp.generated = systemTime(SYSTEM_TIME_MONOTONIC);
+    memcpy(buffer, &stamp, sizeof(stamp));
+
+    // signals to callbacks that this needs to be coverted to jpeg
+    // before returning to framework
+    frame.mFrameType = CameraFrame::IMAGE_FRAME;
+    frame.mFrameMask = CameraFrame::IMAGE_FRAME;
+    frame.mQuirks = CameraFrame::ENCODE_RAW_YUV422I_TO_JPEG;
+    frame.mBuffer = buffer;
+    frame.mLength = mPictureWidth * mPictureHeight * 2;
+    frame.mAlignment = mPictureWidth * 2;
+    frame.mOffset = 0;
+    frame.mWidth = mPictureWidth;
+    frame.mHeight = mPictureHeight;
+    frame.mTimestamp = mFrameIndex * mFramePeriod;
+
+    ret = setInitFrameRefCount(frame.mBuffer, frame.mFrameMask);
+    if ( NO_ERROR == ret )
+        {
+        ret = sendFrameToSubscribers(&frame);
+        }
+
+    return ret;
+}
+
+bool SyntheticCameraAdapter::generateFrame()
+{
+    status_t ret = NO_ERROR;
+    CameraFrame frame;
+    void *buffer = NULL;
+    bool capture = false;
+    uint32_t index;
+    nsecs_t deadline, now;
+
+    {
+    Mutex::Autolock lock(mGeneratorLock);
+    if ( !mPreviewing )
+        {
+        return false;
+        }
+    deadline = mStreamStart + mFrameIndex * mFramePeriod;
+    }
+
+    now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if ( deadline > now )
+        {
+        usleep(ns2us(deadline - now));
+        }
+
+    {
+    Mutex::Autolock lock(mGeneratorLock);
+    if ( !mPreviewing )
+        {
+        return false;
+        }
+
+    index = mFrameIndex++;
+
+    capture = mCapturePending;
+    mCapturePending = false;
+
+    if ( !capture )
+        {
+        if ( mFreeBuffers.isEmpty() )
+            {
+            //Like a sensor, keep the frame cadence and skip this frame
+            mDroppedFrames++;
+            return true;
+            }
+
+        buffer = mFreeBuffers[0];
+        mFreeBuffers.removeAt(0);
+        }
+    }
+
+    if ( capture )
+        {
+        ret = sendImageFrame();
+        if ( NO_ERROR != ret )
+            {
+            CAMHAL_LOGEB("Synthetic capture failed %d", ret);
+            }
+        return true;
+        }
+
+    fillPreviewFrame(buffer, index);
+
+    frame.mFrameType = CameraFrame::PREVIEW_FRAME_SYNC;
+    frame.mFrameMask = CameraFrame::PREVIEW_FRAME_SYNC;
+    if ( mRecording )
+        {
+        frame.mFrameMask |= CameraFrame::VIDEO_FRAME_SYNC;
+        }
+    frame.mBuffer = buffer;
+    frame.mLength = mPreviewNV12 ? ( mPreviewWidth * mPreviewHeight * 3 / 2 ) :
+                                   ( mPreviewWidth * mPreviewHeight * 2 );
+    frame.mAlignment = SYNTHETIC_PREVIEW_STRIDE;
+    frame.mOffset = 0;
+    frame.mWidth = mPreviewWidth;
+    frame.mHeight = mPreviewHeight;
+    //Timestamps only depend on the frame index, not on scheduling jitter
+    frame.mTimestamp = index * mFramePeriod;
+
+    ret = setInitFrameRefCount(frame.mBuffer, frame.mFrameMask);
+    if ( NO_ERROR == ret )
+        {
+        ret = sendFrameToSubscribers(&frame);
+        }
+
+    if ( NO_ERROR != ret )
+        {
+        CAMHAL_LOGDB("sendFrameToSubscribers error: %d", ret);
+        returnFrame(buffer, CameraFrame::PREVIEW_FRAME_SYNC);
+        }
+
+    return true;
+}
+
+extern "C" CameraAdapter* CameraAdapter_Factory(size_t sensor_index)
+{
+    CameraAdapter *adapter = NULL;
+    Mutex::Autolock lock(gAdapterLock);
+
+    LOG_FUNCTION_NAME;
+
+    adapter = new SyntheticCameraAdapter(sensor_index);
+    if ( adapter ) {
+        CAMHAL_LOGDB("New synthetic camera adapter instance created for sensor %d", sensor_index);
+    } else {
+        CAMHAL_LOGEA("Camera adapter create failed!");
+    }
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return adapter;
+}
+
+//Capabilities of the synthetic camera, covering every key CameraHal reads
+static const char *sSyntheticCapabilities[][2] = {
+    { CameraProperties::CAMERA_NAME, "SyntheticCamera" },
+    { CameraProperties::FACING_INDEX, TICameraParameters::FACING_BACK },
+    { CameraProperties::ORIENTATION_INDEX, "0" },
+    { CameraProperties::SUPPORTED_PREVIEW_SIZES, "1920x1080,1280x720,864x480,800x480,720x480,640x480,352x288,320x240,176x144" },
+    { CameraProperties::SUPPORTED_PREVIEW_FORMATS, "yuv420sp,yuv422i-yuyv" },
+    { CameraProperties::SUPPORTED_PREVIEW_FRAME_RATES, "30,24,15" },
+    { CameraProperties::FRAMERATE_RANGE_SUPPORTED, "(15000,15000),(24000,24000),(30000,30000)" },
+    { CameraProperties::FRAMERATE_RANGE, "30000,30000" },
+    { CameraProperties::FRAMERATE_RANGE_IMAGE, "15000,30000" },
+    { CameraProperties::FRAMERATE_RANGE_VIDEO, "24000,30000" },
+    { CameraProperties::SUPPORTED_PICTURE_SIZES, "2592x1944,1920x1080,1280x720,640x480,320x240" },
+    { CameraProperties::SUPPORTED_PICTURE_FORMATS, "jpeg" },
+    { CameraProperties::SUPPORTED_THUMBNAIL_SIZES, "160x120,0x0" },
+    { CameraProperties::SUPPORTED_VIDEO_SIZES, "1920x1080,1280x720,640x480" },
+    { CameraProperties::PREFERRED_PREVIEW_SIZE_FOR_VIDEO, "1920x1080" },
+    { CameraProperties::VIDEO_SIZE, "1920x1080" },
+    { CameraProperties::SUPPORTED_WHITE_BALANCE, "auto" },
+    { CameraProperties::SUPPORTED_EFFECTS, "none" },
+    { CameraProperties::SUPPORTED_ANTIBANDING, "auto" },
+    { CameraProperties::SUPPORTED_EXPOSURE_MODES, "auto" },
+    { CameraProperties::SUPPORTED_EV_MIN, "0" },
+    { CameraProperties::SUPPORTED_EV_MAX, "0" },
+    { CameraProperties::SUPPORTED_EV_STEP, "0.1" },
+    { CameraProperties::SUPPORTED_ISO_VALUES, "auto" },
+    { CameraProperties::SUPPORTED_SCENE_MODES, "auto" },
+    { CameraProperties::SUPPORTED_FLASH_MODES, "off" },
+    { CameraProperties::SUPPORTED_FOCUS_MODES, "infinity" },
+    { CameraProperties::SUPPORTED_ZOOM_RATIOS, "100" },
+    { CameraProperties::SUPPORTED_ZOOM_STAGES, "0" },
+    { CameraProperties::ZOOM_SUPPORTED, "false" },
+    { CameraProperties::SMOOTH_ZOOM_SUPPORTED, "false" },
+    { CameraProperties::SUPPORTED_IPP_MODES, "off" },
+    { CameraProperties::VSTAB_SUPPORTED, "false" },
+    { CameraProperties::VNF_SUPPORTED, "false" },
+    { CameraProperties::AUTO_EXPOSURE_LOCK_SUPPORTED, "false" },
+    { CameraProperties::AUTO_WHITEBALANCE_LOCK_SUPPORTED, "false" },
+    { CameraProperties::VIDEO_SNAPSHOT_SUPPORTED, "false" },
+    { CameraProperties::REQUIRED_PREVIEW_BUFS, "6" },
+    { CameraProperties::REQUIRED_IMAGE_BUFS, "1" },
+    { CameraProperties::PREVIEW_SIZE, "640x480" },
+    { CameraProperties::PREVIEW_FORMAT, "yuv420sp" },
+    { CameraProperties::PREVIEW_FRAME_RATE, "30" },
+    { CameraProperties::PICTURE_SIZE, "640x480" },
+    { CameraProperties::PICTURE_FORMAT, "jpeg" },
+    { CameraProperties::JPEG_THUMBNAIL_SIZE, "160x120" },
+    { CameraProperties::JPEG_QUALITY, "95" },
+    { CameraProperties::JPEG_THUMBNAIL_QUALITY, "60" },
+    { CameraProperties::WHITEBALANCE, "auto" },
+    { CameraProperties::EFFECT, "none" },
+    { CameraProperties::ANTIBANDING, "auto" },
+    { CameraProperties::EXPOSURE_MODE, "auto" },
+    { CameraProperties::EV_COMPENSATION, "0" },
+    { CameraProperties::ISO_MODE, "auto" },
+    { CameraProperties::FOCUS_MODE, "infinity" },
+    { CameraProperties::SCENE_MODE, "auto" },
+    { CameraProperties::FLASH_MODE, "off" },
+    { CameraProperties::ZOOM, "0" },
+    { CameraProperties::BRIGHTNESS, "50" },
+    { CameraProperties::SATURATION, "100" },
+    { CameraProperties::SHARPNESS, "100" },
+    { CameraProperties::CONTRAST, "100" },
+    { CameraProperties::IPP, "off" },
+    { CameraProperties::GBCE, "disable" },
+    { CameraProperties::VSTAB, "false" },
+    { CameraProperties::VNF, "false" },
+    { CameraProperties::AUTO_EXPOSURE_LOCK, "false" },
+    { CameraProperties::AUTO_WHITEBALANCE_LOCK, "false" },
+    { CameraProperties::MAX_FOCUS_AREAS, "0" },
+    { CameraProperties::MAX_NUM_METERING_AREAS, "0" },
+    { CameraProperties::MAX_FD_HW_FACES, "0" },
+    { CameraProperties::MAX_FD_SW_FACES, "0" },
+    { CameraProperties::SENSOR_ORIENTATION, "0" },
+    { CameraProperties::SENSOR_ORIENTATION_VALUES, "0" },
+    { CameraProperties::FOCAL_LENGTH, "3.43" },
+    { CameraProperties::HOR_ANGLE, "54.8" },
+    { CameraProperties::VER_ANGLE, "42.5" },
+    { CameraProperties::EXIF_MAKE, "TI" },
+    { CameraProperties::EXIF_MODEL, "Synthetic" },
+};
+
+extern "C" status_t CameraAdapter_Capabilities(CameraProperties::Properties* properties_array,
+                                               const int starting_camera,
+                                               const int max_camera,
+                                               int & supported_cameras) {
+    int num_cameras_supported = 0;
+    CameraProperties::Properties* properties = NULL;
+
+    LOG_FUNCTION_NAME;
+
+    supported_cameras = 0;
+
+    if(!properties_array)
+    {
+        return BAD_VALUE;
+    }
+
+    if (starting_camera + num_cameras_supported < max_camera) {
+        properties = properties_array + starting_camera + num_cameras_supported;
+        for (unsigned int i = 0;
+             i < sizeof(sSyntheticCapabilities) / sizeof(sSyntheticCapabilities[0]);
+             i++) {
+            properties->set(sSyntheticCapabilities[i][0], sSyntheticCapabilities[i][1]);
+        }
+        num_cameras_supported++;
+    }
+
+    supported_cameras = num_cameras_supported;
+
+    LOG_FUNCTION_NAME_EXIT;
+
+    return NO_ERROR;
+}
+
+};
+
+
+/*--------------------Camera Adapter Class ENDS here-----------------------------*/
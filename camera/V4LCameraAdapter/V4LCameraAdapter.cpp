@@ -25,6 +25,7 @@
 #include "V4LCameraAdapter.h"
 #include "CameraHal.h"
 #include "TICameraParameters.h"
+#include "CameraKernels.h"
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,10 +36,11 @@
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/select.h>
+#include <poll.h>
 #include <linux/videodev.h>
 
-
 #include <cutils/properties.h>
+#include <cutils/atomic.h>
 #define UNLIKELY( exp ) (__builtin_expect( (exp) != 0, false ))
 static int mDebugFps = 0;
 
@@ -51,9 +53,10 @@ namespace android {
 //frames skipped before recalculating the framerate
 #define FPS_PERIOD 30
 
-Mutex gAdapterLock;
-const char *device = DEVICE;
+//frames between pipeline statistics reports when debug.camera.showfps is set
+#define PIPELINE_STATS_PERIOD 300
 
+Mutex gAdapterLock;
 
 /*--------------------Camera Adapter Class STARTS here-----------------------------*/
 
@@ -74,7 +77,31 @@ status_t V4LCameraAdapter::initialize(CameraProperties::Properties* caps)
         return NO_MEMORY;
         }
 
-    if ((mCameraHandle = open(device, O_RDWR)) == -1)
+    property_get(IO_MODE_PROPERTY, value, "auto");
+    if ( strcmp(value, "mmap") == 0 )
+        {
+        mIOMode = V4L_IO_MMAP;
+        }
+    else if ( strcmp(value, "userptr") == 0 )
+        {
+        mIOMode = V4L_IO_USERPTR;
+        }
+    else
+        {
+        mIOMode = V4L_IO_AUTO;
+        }
+
+    property_get(PIPELINE_DEPTH_PROPERTY, value, "0");
+    mPipelineDepth = atoi(value);
+    if ( 0 >= mPipelineDepth )
+        {
+        mPipelineDepth = PIPELINE_DEPTH_DEFAULT;
+        }
+
+    //The device node can be overridden, e.g. to run against the vivid driver
+    property_get(DEVICE_PROPERTY, value, DEVICE);
+
+    if ((mCameraHandle = open(value, O_RDWR)) == -1)
         {
         CAMHAL_LOGEB("Error while opening handle to V4L2 Camera: %s", strerror(errno));
         return -EINVAL;
@@ -125,20 +152,41 @@ status_t V4LCameraAdapter::fillThisBuffer(void* frameBuf, CameraFrame::FrameType
         return BAD_VALUE;
         }
 
-    mVideoInfo->buf.index = i;
+    //Requeueing is left to the dequeue thread, which owns the V4L queue
+    TIUTILS::Message msg;
+    msg.command = PIPELINE_QUEUE_BUFFER;
+    msg.arg1 = ( void * ) i;
+    ret = mReturnQ.put(&msg);
+
+    return ret;
+
+}
+
+status_t V4LCameraAdapter::queueBuffer(int index)
+{
+    status_t ret = NO_ERROR;
+
+    memset (&mVideoInfo->buf, 0, sizeof (struct v4l2_buffer));
+
+    mVideoInfo->buf.index = index;
     mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    mVideoInfo->buf.memory = V4L2_MEMORY_MMAP;
+    mVideoInfo->buf.memory = mVideoInfo->memory;
+
+    if ( V4L2_MEMORY_USERPTR == mVideoInfo->memory )
+        {
+        mVideoInfo->buf.m.userptr = ( unsigned long ) mVideoInfo->previewBuf[index];
+        mVideoInfo->buf.length = mVideoInfo->format.fmt.pix.sizeimage;
+        }
 
     ret = ioctl(mCameraHandle, VIDIOC_QBUF, &mVideoInfo->buf);
     if (ret < 0) {
-       CAMHAL_LOGEA("Init: VIDIOC_QBUF Failed");
+       CAMHAL_LOGEB("VIDIOC_QBUF Failed: %s", strerror(errno));
        return -1;
     }
 
      nQueued++;
 
     return ret;
-
 }
 
 status_t V4LCameraAdapter::setParameters(const CameraParameters &params)
@@ -151,23 +199,48 @@ status_t V4LCameraAdapter::setParameters(const CameraParameters &params)
 
     params.getPreviewSize(&width, &height);
 
-    CAMHAL_LOGDB("Width * Height %d x %d format 0x%x", width, height, DEFAULT_PIXEL_FORMAT);
-
     mVideoInfo->width = width;
     mVideoInfo->height = height;
-    mVideoInfo->framesizeIn = (width * height << 1);
-    mVideoInfo->formatIn = DEFAULT_PIXEL_FORMAT;
 
+    //Ask for the preview format and stride first, so that frames can be
+    //captured straight into the preview buffers. Sensors that can't
+    //deliver UYVY fall back to YUYV and a conversion stage.
     mVideoInfo->format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     mVideoInfo->format.fmt.pix.width = width;
     mVideoInfo->format.fmt.pix.height = height;
-    mVideoInfo->format.fmt.pix.pixelformat = DEFAULT_PIXEL_FORMAT;
+    mVideoInfo->format.fmt.pix.pixelformat = PREVIEW_PIXEL_FORMAT;
+    mVideoInfo->format.fmt.pix.field = V4L2_FIELD_NONE;
+    mVideoInfo->format.fmt.pix.bytesperline = PREVIEW_STRIDE;
 
     ret = ioctl(mCameraHandle, VIDIOC_S_FMT, &mVideoInfo->format);
-    if (ret < 0) {
-        CAMHAL_LOGEB("Open: VIDIOC_S_FMT Failed: %s", strerror(errno));
-        return ret;
-    }
+    if ( ( ret < 0 ) ||
+         ( PREVIEW_PIXEL_FORMAT != mVideoInfo->format.fmt.pix.pixelformat ) )
+        {
+        mVideoInfo->format.fmt.pix.width = width;
+        mVideoInfo->format.fmt.pix.height = height;
+        mVideoInfo->format.fmt.pix.pixelformat = DEFAULT_PIXEL_FORMAT;
+        mVideoInfo->format.fmt.pix.bytesperline = 0;
+
+        ret = ioctl(mCameraHandle, VIDIOC_S_FMT, &mVideoInfo->format);
+        if (ret < 0) {
+            CAMHAL_LOGEB("Open: VIDIOC_S_FMT Failed: %s", strerror(errno));
+            return ret;
+        }
+        }
+
+    mVideoInfo->formatIn = mVideoInfo->format.fmt.pix.pixelformat;
+    mVideoInfo->bytesperline = mVideoInfo->format.fmt.pix.bytesperline;
+    if ( mVideoInfo->bytesperline < ( width << 1 ) )
+        {
+        mVideoInfo->bytesperline = width << 1;
+        }
+    mVideoInfo->framesizeIn = mVideoInfo->bytesperline * height;
+
+    CAMHAL_LOGDB("Width * Height %d x %d format 0x%x stride %d",
+                 width,
+                 height,
+                 mVideoInfo->formatIn,
+                 mVideoInfo->bytesperline);
 
     // Udpate the current parameter set
     mParams = params;
@@ -221,11 +294,93 @@ status_t V4LCameraAdapter::UseBuffersPreview(void* bufArr, int num)
 {
     int ret = NO_ERROR;
 
-    if(NULL == bufArr)
+    if ( ( NULL == bufArr ) || ( num > NB_BUFFER ) )
         {
         return BAD_VALUE;
         }
 
+    uint32_t *ptr = (uint32_t*) bufArr;
+    for (int i = 0; i < num; i++) {
+        mVideoInfo->previewBuf[i] = (void *) ptr[i];
+
+        //Associate each Camera internal buffer with the one from Overlay
+        mPreviewBufs.add((int)ptr[i], i);
+    }
+
+    //Frames can only be captured in place when the sensor delivers
+    //exactly the preview layout
+    bool inPlace = ( PREVIEW_PIXEL_FORMAT == mVideoInfo->formatIn ) &&
+                   ( PREVIEW_STRIDE == mVideoInfo->bytesperline );
+
+    if ( ( V4L_IO_USERPTR == mIOMode ) && !inPlace )
+        {
+        CAMHAL_LOGEB("USERPTR capture needs UYVY with a %d byte stride, sensor delivers 0x%x/%d, "
+                     "falling back to MMAP capture",
+                     PREVIEW_STRIDE,
+                     mVideoInfo->formatIn,
+                     mVideoInfo->bytesperline);
+        }
+
+    ret = -EINVAL;
+    if ( ( V4L_IO_MMAP != mIOMode ) && inPlace )
+        {
+        ret = initUserPtrBuffers(bufArr, num);
+        }
+
+    if ( NO_ERROR != ret )
+        {
+        ret = initMmapBuffers(bufArr, num);
+        }
+
+    if ( NO_ERROR == ret )
+        {
+        // Update the preview buffer count
+        mPreviewBufferCount = num;
+        }
+    else
+        {
+        mPreviewBufs.clear();
+        }
+
+    return ret;
+}
+
+status_t V4LCameraAdapter::initUserPtrBuffers(void* bufArr, int num)
+{
+    int ret = NO_ERROR;
+
+    mVideoInfo->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    mVideoInfo->rb.memory = V4L2_MEMORY_USERPTR;
+    mVideoInfo->rb.count = num;
+
+    ret = ioctl(mCameraHandle, VIDIOC_REQBUFS, &mVideoInfo->rb);
+    if ( ret < 0 )
+        {
+        CAMHAL_LOGDB("USERPTR capture not available: %s", strerror(errno));
+        return -errno;
+        }
+
+    if ( mVideoInfo->rb.count < ( unsigned int ) num )
+        {
+        CAMHAL_LOGEB("Driver only accepted %d of %d preview buffers",
+                     mVideoInfo->rb.count,
+                     num);
+        mVideoInfo->rb.count = 0;
+        ioctl(mCameraHandle, VIDIOC_REQBUFS, &mVideoInfo->rb);
+        return -EINVAL;
+        }
+
+    mVideoInfo->memory = V4L2_MEMORY_USERPTR;
+
+    CAMHAL_LOGDA("Capturing directly into the preview buffers");
+
+    return NO_ERROR;
+}
+
+status_t V4LCameraAdapter::initMmapBuffers(void* bufArr, int num)
+{
+    int ret = NO_ERROR;
+
     //First allocate adapter internal buffers at V4L level for USB Cam
     //These are the buffers from which we will copy the data into overlay buffers
     /* Check if camera can handle NB_BUFFER buffers */
@@ -239,6 +394,8 @@ status_t V4LCameraAdapter::UseBuffersPreview(void* bufArr, int num)
         return ret;
     }
 
+    mVideoInfo->memory = V4L2_MEMORY_MMAP;
+
     for (int i = 0; i < num; i++) {
 
         memset (&mVideoInfo->buf, 0, sizeof (struct v4l2_buffer));
@@ -260,24 +417,46 @@ status_t V4LCameraAdapter::UseBuffersPreview(void* bufArr, int num)
                mCameraHandle,
                mVideoInfo->buf.m.offset);
 
+        mVideoInfo->memSize[i] = mVideoInfo->buf.length;
+
         if (mVideoInfo->mem[i] == MAP_FAILED) {
             CAMHAL_LOGEB("Unable to map buffer (%s)", strerror(errno));
             return -1;
         }
 
-        uint32_t *ptr = (uint32_t*) bufArr;
-
-        //Associate each Camera internal buffer with the one from Overlay
-        mPreviewBufs.add((int)ptr[i], i);
-
     }
 
-    // Update the preview buffer count
-    mPreviewBufferCount = num;
+    CAMHAL_LOGDB("Capturing through driver buffers, %s",
+                 ( PREVIEW_PIXEL_FORMAT == mVideoInfo->formatIn ) ? "copy" : "YUYV to UYVY conversion");
 
     return ret;
 }
 
+//The driver accepted USERPTR buffers but could not queue the preview
+//buffers, e.g. because it cannot pin tiler or VM_IO memory. Release them
+//and capture through driver buffers instead.
+status_t V4LCameraAdapter::fallBackToMmapBuffers()
+{
+    int ret = NO_ERROR;
+
+    mVideoInfo->rb.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    mVideoInfo->rb.memory = V4L2_MEMORY_USERPTR;
+    mVideoInfo->rb.count = 0;
+
+    ret = ioctl(mCameraHandle, VIDIOC_REQBUFS, &mVideoInfo->rb);
+    if ( ret < 0 )
+        {
+        CAMHAL_LOGEB("Unable to release USERPTR buffers: %s", strerror(errno));
+        return -errno;
+        }
+
+    //Releasing the buffers dequeues them all
+    nQueued = 0;
+    nDequeued = 0;
+
+    return initMmapBuffers(mVideoInfo->previewBuf, mPreviewBufferCount);
+}
+
 status_t V4LCameraAdapter::startPreview()
 {
     status_t ret = NO_ERROR;
@@ -289,19 +468,27 @@ status_t V4LCameraAdapter::startPreview()
     return BAD_VALUE;
     }
 
+   //Returns posted after the last stopPreview refer to the old buffers
+   mReturnQ.clear();
+
    for (int i = 0; i < mPreviewBufferCount; i++) {
 
-       mVideoInfo->buf.index = i;
-       mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-       mVideoInfo->buf.memory = V4L2_MEMORY_MMAP;
+       ret = queueBuffer(i);
+       if ( ( ret < 0 ) &&
+            ( V4L2_MEMORY_USERPTR == mVideoInfo->memory ) &&
+            ( V4L_IO_AUTO == mIOMode ) ) {
+           CAMHAL_LOGEA("Preview buffers can't be queued as USERPTR, falling back to MMAP capture");
+           ret = fallBackToMmapBuffers();
+           if ( NO_ERROR == ret ) {
+               //Queue all buffers again, now as driver buffers
+               i = -1;
+               continue;
+           }
+       }
 
-       ret = ioctl(mCameraHandle, VIDIOC_QBUF, &mVideoInfo->buf);
        if (ret < 0) {
-           CAMHAL_LOGEA("VIDIOC_QBUF Failed");
            return -EINVAL;
        }
-
-       nQueued++;
    }
 
     enum v4l2_buf_type bufType;
@@ -317,10 +504,14 @@ status_t V4LCameraAdapter::startPreview()
        mVideoInfo->isStreaming = true;
    }
 
-   // Create and start preview thread for receiving buffers from V4L Camera
-   mPreviewThread = new PreviewThread(this);
+   resetPipelineStats();
 
-   CAMHAL_LOGDA("Created preview thread");
+   // Create and start the pipeline receiving buffers from V4L Camera
+   mDeliverThread = new DeliverThread(this);
+   mConvertThread = new ConvertThread(this);
+   mDequeueThread = new DequeueThread(this);
+
+   CAMHAL_LOGDB("Created preview pipeline, depth %d", mPipelineDepth);
 
 
    //Update the flag to indicate we are previewing
@@ -342,6 +533,27 @@ status_t V4LCameraAdapter::stopPreview()
         return NO_INIT;
         }
 
+    //Stop the stages in pipeline order, so that frames already dequeued
+    //are flushed through before the buffers go away
+    TIUTILS::Message msg;
+    msg.command = PIPELINE_EXIT;
+
+    mReturnQ.put(&msg);
+    mDequeueThread->requestExitAndWait();
+    mDequeueThread.clear();
+
+    mConvertQ.put(&msg);
+    mConvertThread->requestExitAndWait();
+    mConvertThread.clear();
+
+    mDeliverQ.put(&msg);
+    mDeliverThread->requestExitAndWait();
+    mDeliverThread.clear();
+
+    mReturnQ.clear();
+
+    dumpPipelineStats();
+
     if (mVideoInfo->isStreaming) {
         bufType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
@@ -354,21 +566,26 @@ status_t V4LCameraAdapter::stopPreview()
         mVideoInfo->isStreaming = false;
     }
 
+    //fillThisBuffer posts returns until streaming stops, drop those too
+    mReturnQ.clear();
+
     mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    mVideoInfo->buf.memory = V4L2_MEMORY_MMAP;
+    mVideoInfo->buf.memory = mVideoInfo->memory;
 
     nQueued = 0;
     nDequeued = 0;
 
-    /* Unmap buffers */
-    for (int i = 0; i < mPreviewBufferCount; i++)
-        if (munmap(mVideoInfo->mem[i], mVideoInfo->buf.length) < 0)
-            CAMHAL_LOGEA("Unmap failed");
+    /* Unmap buffers, preview buffers queued as USERPTR belong to the display */
+    if ( V4L2_MEMORY_MMAP == mVideoInfo->memory )
+        {
+        for (int i = 0; i < mPreviewBufferCount; i++)
+            if (munmap(mVideoInfo->mem[i], mVideoInfo->memSize[i]) < 0)
+                CAMHAL_LOGEA("Unmap failed");
+        }
 
     mPreviewBufs.clear();
 
-    mPreviewThread->requestExitAndWait();
-    mPreviewThread.clear();
+    mPreviewing = false;
 
     return ret;
 
@@ -378,22 +595,48 @@ char * V4LCameraAdapter::GetFrame(int &index)
 {
     int ret;
 
+    memset (&mVideoInfo->buf, 0, sizeof (struct v4l2_buffer));
     mVideoInfo->buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    mVideoInfo->buf.memory = V4L2_MEMORY_MMAP;
+    mVideoInfo->buf.memory = mVideoInfo->memory;
 
     /* DQ */
     ret = ioctl(mCameraHandle, VIDIOC_DQBUF, &mVideoInfo->buf);
     if (ret < 0) {
-        CAMHAL_LOGEA("GetFrame: VIDIOC_DQBUF Failed");
+        //the caller tells a lost device from a transient error by errno
+        const int err = errno;
+        CAMHAL_LOGEB("GetFrame: VIDIOC_DQBUF Failed: %s", strerror(err));
+        errno = err;
         return NULL;
     }
     nDequeued++;
 
     index = mVideoInfo->buf.index;
 
+    if ( V4L2_MEMORY_USERPTR == mVideoInfo->memory )
+        {
+        return (char *)mVideoInfo->buf.m.userptr;
+        }
+
     return (char *)mVideoInfo->mem[mVideoInfo->buf.index];
 }
 
+void V4LCameraAdapter::convertFrame(uint8_t *dst, const uint8_t *src)
+{
+    if ( PREVIEW_PIXEL_FORMAT == mVideoInfo->formatIn )
+        {
+        copyFrame(dst, PREVIEW_STRIDE,
+                  src, mVideoInfo->bytesperline,
+                  mVideoInfo->width << 1, mVideoInfo->height);
+        }
+    else
+        {
+        //convert from YUYV to UYVY supported in Camera service
+        convertYUYVtoUYVY(dst, PREVIEW_STRIDE,
+                          src, mVideoInfo->bytesperline,
+                          mVideoInfo->width, mVideoInfo->height);
+        }
+}
+
 //API to get the frame size required to be allocated. This size is used to override the size passed
 //by camera service when VSTAB/VNF is turned ON for example
 status_t V4LCameraAdapter::getFrameSize(size_t &width, size_t &height)
@@ -482,7 +725,8 @@ V4LCameraAdapter::V4LCameraAdapter(size_t sensor_index)
 {
     LOG_FUNCTION_NAME;
 
-    // Nothing useful to do in the constructor
+    mVideoInfo = NULL;
+    mIOMode = V4L_IO_AUTO;
 
     LOG_FUNCTION_NAME_EXIT;
 }
@@ -503,57 +747,208 @@ V4LCameraAdapter::~V4LCameraAdapter()
     LOG_FUNCTION_NAME_EXIT;
 }
 
-/* Preview Thread */
+/* Preview pipeline */
 // ---------------------------------------------------------------------------
 
-int V4LCameraAdapter::previewThread()
+bool V4LCameraAdapter::dequeueThread()
 {
-    status_t ret = NO_ERROR;
-    int width, height;
-    CameraFrame frame;
+    struct pollfd fds[2];
+    TIUTILS::Message msg;
+    int index = 0;
+    int nfds = 1;
+    int ret;
+
+    fds[0].fd = mReturnQ.getInFd();
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
 
-    if (mPreviewing)
+    //With no buffer queued to the driver, uvc and videobuf2 flag the device
+    //with POLLERR until one is returned, so only wait for the returns then
+    if ( nQueued > nDequeued )
         {
-        int index = 0;
-        char *fp = this->GetFrame(index);
-        if(!fp)
+        fds[1].fd = mCameraHandle;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        nfds = 2;
+        }
+
+    ret = poll(fds, nfds, -1);
+    if ( ret < 0 )
+        {
+        if ( EINTR == errno )
             {
-            return BAD_VALUE;
+            return true;
             }
 
-        uint8_t* ptr = (uint8_t*) mPreviewBufs.keyAt(index);
+        CAMHAL_LOGEB("poll() failed: %s", strerror(errno));
+        return false;
+        }
+
+    //Requeue returned buffers first, the driver needs them to keep streaming
+    if ( fds[0].revents & POLLIN )
+        {
+        mReturnQ.get(&msg);
 
-        int width, height;
-        uint16_t* dest = (uint16_t*)ptr;
-        uint16_t* src = (uint16_t*) fp;
-        mParams.getPreviewSize(&width, &height);
-        for(int i=0;i<height;i++)
+        if ( PIPELINE_EXIT == ( int ) msg.command )
             {
-            for(int j=0;j<width;j++)
+            return false;
+            }
+
+        queueBuffer(( int ) msg.arg1);
+        }
+
+    //An error on the device is only final if dequeueing reports it as gone
+    if ( ( nfds > 1 ) && ( fds[1].revents & ( POLLIN | POLLERR | POLLHUP ) ) )
+        {
+        if ( NULL == GetFrame(index) )
+            {
+            if ( ENODEV == errno )
                 {
-                //*dest = *src;
-                //convert from YUYV to UYVY supported in Camera service
-                *dest = (((*src & 0xFF000000)>>24)<<16)|(((*src & 0x00FF0000)>>16)<<24) |
-                        (((*src & 0xFF00)>>8)<<0)|(((*src & 0x00FF)>>0)<<8);
-                src++;
-                dest++;
+                CAMHAL_LOGEA("V4L device gone, stopping capture");
+                return false;
                 }
-                dest += 4096/2-width;
+
+            //Don't spin on an error the driver keeps reporting
+            if ( fds[1].revents & ( POLLERR | POLLHUP ) )
+                {
+                usleep(DEQUEUE_ERROR_RETRY_US);
+                }
+
+            return true;
+            }
+
+        //Drop the frame instead of stalling the capture queue when the
+        //later stages fall behind
+        if ( android_atomic_inc(&mFramesInFlight) >= mPipelineDepth )
+            {
+            android_atomic_dec(&mFramesInFlight);
+            mDroppedFrames++;
+            queueBuffer(index);
+            return true;
             }
 
-        mParams.getPreviewSize(&width, &height);
-        frame.mFrameType = CameraFrame::PREVIEW_FRAME_SYNC;
-        frame.mBuffer = ptr;
-        frame.mLength = width*height*2;
-        frame.mAlignment = width*2;
-        frame.mOffset = 0;
-        frame.mTimestamp = systemTime(SYSTEM_TIME_MONOTONIC);;
+        mDequeueTime[index] = systemTime(SYSTEM_TIME_MONOTONIC);
+
+        msg.command = PIPELINE_FRAME;
+        msg.arg1 = ( void * ) index;
+        mConvertQ.put(&msg);
+        }
 
-        ret = sendFrameToSubscribers(&frame);
+    return true;
+}
 
+bool V4LCameraAdapter::convertThread()
+{
+    TIUTILS::Message msg;
+    nsecs_t start;
+    int index;
+
+    if ( NO_ERROR != mConvertQ.get(&msg) )
+        {
+        return false;
         }
 
-    return ret;
+    if ( PIPELINE_EXIT == ( int ) msg.command )
+        {
+        return false;
+        }
+
+    index = ( int ) msg.arg1;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    updateStageStats(mQueueStats, start - mDequeueTime[index]);
+
+    //Frames captured through USERPTR are already in place
+    if ( V4L2_MEMORY_MMAP == mVideoInfo->memory )
+        {
+        convertFrame(( uint8_t * ) mVideoInfo->previewBuf[index],
+                     ( uint8_t * ) mVideoInfo->mem[index]);
+        }
+
+    mConvertTime[index] = systemTime(SYSTEM_TIME_MONOTONIC);
+    updateStageStats(mConvertStats, mConvertTime[index] - start);
+
+    mDeliverQ.put(&msg);
+
+    return true;
+}
+
+bool V4LCameraAdapter::deliverThread()
+{
+    TIUTILS::Message msg;
+    CameraFrame frame;
+    int index;
+
+    if ( NO_ERROR != mDeliverQ.get(&msg) )
+        {
+        return false;
+        }
+
+    if ( PIPELINE_EXIT == ( int ) msg.command )
+        {
+        return false;
+        }
+
+    index = ( int ) msg.arg1;
+
+    frame.mFrameType = CameraFrame::PREVIEW_FRAME_SYNC;
+    frame.mBuffer = mVideoInfo->previewBuf[index];
+    frame.mLength = mVideoInfo->width * mVideoInfo->height * 2;
+    frame.mAlignment = mVideoInfo->width * 2;
+    frame.mOffset = 0;
+    frame.mTimestamp = mDequeueTime[index];
+
+    sendFrameToSubscribers(&frame);
+
+    android_atomic_dec(&mFramesInFlight);
+
+    updateStageStats(mDeliverStats,
+                     systemTime(SYSTEM_TIME_MONOTONIC) - mConvertTime[index]);
+
+    if ( mDebugFps && ( 0 == ( mDeliverStats.count % PIPELINE_STATS_PERIOD ) ) )
+        {
+        dumpPipelineStats();
+        }
+
+    return true;
+}
+
+void V4LCameraAdapter::updateStageStats(StageStats &stats, nsecs_t latency)
+{
+    stats.count++;
+    stats.total += latency;
+    if ( latency > stats.max )
+        {
+        stats.max = latency;
+        }
+}
+
+void V4LCameraAdapter::resetPipelineStats()
+{
+    memset(&mQueueStats, 0, sizeof(mQueueStats));
+    memset(&mConvertStats, 0, sizeof(mConvertStats));
+    memset(&mDeliverStats, 0, sizeof(mDeliverStats));
+    mDroppedFrames = 0;
+    mFramesInFlight = 0;
+}
+
+void V4LCameraAdapter::dumpPipelineStats()
+{
+    const StageStats *stages[] = { &mQueueStats, &mConvertStats, &mDeliverStats };
+    const char *names[] = { "queue", "convert", "deliver" };
+
+    for ( unsigned int i = 0 ; i < sizeof(stages) / sizeof(stages[0]) ; i++ )
+        {
+        const StageStats *stats = stages[i];
+        CAMHAL_LOGI("Preview %s stage: %u frames, avg %lld us, max %lld us",
+                    names[i],
+                    stats->count,
+                    stats->count ? ns2us(stats->total / stats->count) : 0,
+                    ns2us(stats->max));
+        }
+
+    CAMHAL_LOGI("Preview pipeline: %u frames delivered, %u dropped",
+                mDeliverStats.count,
+                mDroppedFrames);
 }
 
 extern "C" CameraAdapter* CameraAdapter_Factory()
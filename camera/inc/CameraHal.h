@@ -42,6 +42,7 @@
 #include "CameraProperties.h"
 #include "DebugUtils.h"
 #include "SensorListener.h"
+#include "CameraTrace.h"
 
 #include <ui/GraphicBufferAllocator.h>
 #include <ui/GraphicBuffer.h>
@@ -71,10 +72,16 @@
                              GRALLOC_USAGE_SW_READ_RARELY | \
                              GRALLOC_USAGE_SW_WRITE_NEVER
 
-//Enables Absolute PPM measurements in logcat
-#define PPM_INSTRUMENTATION_ABS 1
+//Enables Absolute PPM measurements in logcat. The same milestones are always
+//recorded by CameraTrace and reported through CameraHal::dump()
+//#define PPM_INSTRUMENTATION_ABS 1
 
 #define LOCK_BUFFER_TRIES 5
+
+//Vendor send_command() ids to report or restart the CameraTrace frame
+//pipeline statistics from the field
+#define CAMERA_CMD_DUMP_FRAME_STATS 0x1000
+#define CAMERA_CMD_RESET_FRAME_STATS 0x1001
 #define HAL_PIXEL_FORMAT_NV12 0x100
 
 #define CAMHAL_LOGI LOGI
@@ -253,6 +260,15 @@ class CameraFrame
         HAS_EXIF_DATA = 0x1 << 1,
     };
 
+    ///Points of the preview pipeline at which a frame is timestamped, see CameraTrace
+    enum TimelineStamp
+    {
+        STAMP_FILL_BUFFER_DONE = 0, ///Ducati returned the buffer
+        STAMP_SEND_CALLBACKS,       ///The adapter hands the frame to its subscribers
+        STAMP_NOTIFIER_DEQUEUE,     ///AppCallbackNotifier picked the frame up
+        STAMP_COUNT
+    };
+
     //default contrustor
     CameraFrame():
     mCookie(NULL),
@@ -271,6 +287,7 @@ class CameraFrame
 
       mYuv[0] = NULL;
       mYuv[1] = NULL;
+      memset(mStamps, 0, sizeof(mStamps));
     }
 
     //copy constructor
@@ -291,6 +308,7 @@ class CameraFrame
 
       mYuv[0] = frame.mYuv[0];
       mYuv[1] = frame.mYuv[1];
+      memcpy(mStamps, frame.mStamps, sizeof(mStamps));
     }
 
     void *mCookie;
@@ -306,6 +324,7 @@ class CameraFrame
     unsigned mFrameMask;
     unsigned int mQuirks;
     unsigned int mYuv[2];
+    nsecs_t mStamps[STAMP_COUNT];
     ///@todo add other member vars like  stride etc
 };
 
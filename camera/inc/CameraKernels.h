@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file CameraKernels.h
+*
+* Pixel copy and format conversion kernels shared by the camera HAL,
+* the camera adapters and the camera kernel benchmark.
+*
+*/
+
+#ifndef CAMERA_KERNELS_H
+#define CAMERA_KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace android {
+
+///Copies a 2D (tiler) preview frame to a packed 1D buffer, converting NV12
+///to NV21 or YV12 for the preview callback formats
+void copy2Dto1D(void *dst,
+                void *src,
+                int width,
+                int height,
+                size_t stride,
+                uint32_t offset,
+                unsigned int bytesPerPixel,
+                size_t length,
+                const char *pixelFormat);
+
+///Converts one NV21 line to packed YUV444 for libjpeg
+void nv21_to_yuv(uint8_t* dst, uint8_t* y, uint8_t* uv, int width);
+
+///Converts one UYVY line to packed YUV444 for libjpeg
+void uyvy_to_yuv(uint8_t* dst, uint32_t* src, int width);
+
+///Converts a YUYV frame to UYVY, the two only differ by the byte order
+///within each 16-bit pair
+void convertYUYVtoUYVY(uint8_t *dst, int dstStride,
+                       const uint8_t *src, int srcStride,
+                       int width, int height);
+
+///Copies a frame between buffers of different line strides
+void copyFrame(uint8_t *dst, int dstStride,
+               const uint8_t *src, int srcStride,
+               int bytesPerRow, int height);
+
+};
+
+#endif //CAMERA_KERNELS_H
@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <utils/threads.h>
 #include "cutils/properties.h"
 
 namespace android {
@@ -40,6 +41,12 @@ namespace android {
 #define EXIF_MAKE_DEFAULT "default_make"
 #define EXIF_MODEL_DEFAULT "default_model"
 
+// Persistent capabilities cache, see CameraPropertiesCache.cpp
+#define CAMERA_CAPS_CACHE_PATH      "/data/misc/camera/capabilities.cache"
+#define CAMERA_CAPS_FIRMWARE_PATH   "/vendor/firmware/ducati-m3.bin"
+#define CAMERA_CAPS_CACHE_PROPERTY  "camera.caps.cache"
+#define CAMERA_CAPS_CACHE_VERSION   1
+
 #define REMAINING_BYTES(buff) ((((int)sizeof(buff) - 1 - (int)strlen(buff)) < 0) ? 0 : (sizeof(buff) - 1 - strlen(buff)))
 
 
@@ -189,10 +196,12 @@ public:
         protected:
             const char* keyAt(unsigned int);
             const char* valueAt(unsigned int);
+            unsigned int size();
 
         private:
             DefaultKeyedVector<String8, String8>* mProperties;
 
+        friend class CameraProperties;
     };
 
     ///Initializes the CameraProperties class
@@ -201,12 +210,40 @@ public:
     int camerasSupported();
     int getProperties(int cameraIndex, Properties** properties);
 
+    ///Stops the background cache revalidation for good, waiting for a query
+    ///in progress. Called before a camera is opened, the adapter does not
+    ///support querying capabilities while a camera is initialized.
+    void cancelRevalidation();
+
+private:
+    class CacheRevalidationThread : public Thread {
+        CameraProperties* mCameraProperties;
+    public:
+        CacheRevalidationThread(CameraProperties* cp)
+            : Thread(false), mCameraProperties(cp) { }
+        virtual bool threadLoop() {
+            mCameraProperties->revalidateCache();
+            return false;
+        }
+    };
+
+    friend class CacheRevalidationThread;
+
+    static bool isCacheEnabled();
+    status_t loadCache();
+    status_t storeCache(Properties* properties, int count);
+    void revalidateCache();
+
 private:
 
     int mCamerasSupported;
     int mInitialized;
     mutable Mutex mLock;
 
+    sp<CacheRevalidationThread> mRevalidationThread;
+    Mutex mRevalidationLock;
+    bool mRevalidationCancelled;
+
     Properties mCameraProps[MAX_CAMERAS_SUPPORTED];
 
 };
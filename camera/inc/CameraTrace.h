@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+* @file CameraTrace.h
+*
+* Always-on latency tracing for the camera HAL. Named events are recorded
+* with monotonic timestamps in a per-process lock-free ring, and the
+* latency of each milestone (open, first preview frame, AF, shutter, JPEG)
+* is accumulated in a log2 histogram. Both can be dumped as text through
+* CameraHal::dump() or saved as a binary trace file.
+*
+* Preview frames are additionally followed through the pipeline: the time
+* spent between stages is kept for a sliding window of recent frames, along
+* with the number of frames held by Ducati, the display and the encoder.
+*
+*/
+
+#ifndef CAMERA_TRACE_H
+#define CAMERA_TRACE_H
+
+#include <stdint.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+///Number of events kept in the ring, must be a power of two
+#define CAMERA_TRACE_RING_SIZE 1024
+
+///Histogram buckets, bucket n counts latencies in [2^(n-1), 2^n) microseconds
+#define CAMERA_TRACE_BUCKETS 24
+
+///When set to a path, the binary trace is written there on dump and close
+#define CAMERA_TRACE_FILE_PROPERTY "debug.camera.trace.file"
+
+#define CAMERA_TRACE_FILE_MAGIC 0x43545243 // "CTRC"
+#define CAMERA_TRACE_FILE_VERSION 1
+#define CAMERA_TRACE_NAME_LEN 32
+
+///Recent frames kept for the pipeline stage percentiles, must be a power of two
+#define CAMERA_TRACE_FRAME_WINDOW 512
+
+class CameraTrace
+{
+public:
+
+    enum Milestone {
+        MILESTONE_OPEN = 0,             ///camera_device_open() until the HAL is initialized
+        MILESTONE_FIRST_PREVIEW_FRAME,  ///startPreview() until the first frame is displayed
+        MILESTONE_AUTOFOCUS,            ///autoFocus() until the focus result
+        MILESTONE_SHUTTER,              ///takePicture() until the shutter event
+        MILESTONE_SNAPSHOT,             ///takePicture() until the snapshot is displayed
+        MILESTONE_JPEG,                 ///takePicture() until the image frame is ready
+        MILESTONE_COUNT
+    };
+
+    ///Latency between two stamps of CameraFrame::TimelineStamp or the
+    ///consumer reached by the frame
+    enum FrameStage {
+        STAGE_DUCATI_TO_ADAPTER = 0,    ///FillBufferDone until sendCallBacks
+        STAGE_ADAPTER_TO_DISPLAY,       ///sendCallBacks until PostFrame queued the buffer
+        STAGE_ADAPTER_TO_NOTIFIER,      ///sendCallBacks until AppCallbackNotifier dequeued it
+        STAGE_NOTIFIER_TO_APP,          ///Notifier dequeue until the app data callback returned
+        STAGE_DUCATI_TO_DISPLAY,        ///End to end for the display path
+        STAGE_DUCATI_TO_APP,            ///End to end for the data callback path
+        FRAME_STAGE_COUNT
+    };
+
+    ///Records a named event. name must point to storage that outlives the trace,
+    ///normally a string literal.
+    static void event(const char *name, int32_t arg = 0);
+
+    ///Starts timing a milestone, restarting it if it is already pending
+    static void begin(Milestone milestone);
+
+    ///Completes a pending milestone and adds its latency to the histogram.
+    ///Does nothing when the milestone was not started, so it can sit on hot paths.
+    static void end(Milestone milestone);
+
+    ///Drops a pending milestone without recording it
+    static void cancel(Milestone milestone);
+
+    ///Writes the histograms and the most recent events as text
+    static status_t dump(int fd);
+
+    ///Writes the binary trace file
+    static status_t save(const char *path);
+
+    ///Writes the binary trace file if CAMERA_TRACE_FILE_PROPERTY is set
+    static void saveIfRequested();
+
+    static const char *milestoneName(Milestone milestone);
+
+    ///Adds the latency between two stamps to a stage. Missing (zero) stamps are ignored.
+    static void frameStage(FrameStage stage, nsecs_t start, nsecs_t end);
+
+    ///Samples the number of preview buffers held by each part of the pipeline
+    static void frameCounts(uint32_t ducati, uint32_t display, uint32_t encoder);
+
+    ///Writes the frame pipeline statistics as text, to logcat if fd is negative
+    static void dumpFrameStats(int fd);
+
+    static void resetFrameStats();
+
+public:
+
+    ///Layout of the binary trace file: a header, MILESTONE_COUNT histograms
+    ///and nEvents events, oldest first. All fields are little endian.
+    struct FileHeader {
+        uint32_t nMagic;
+        uint32_t nVersion;
+        uint32_t nMilestones;
+        uint32_t nBuckets;
+        uint32_t nEvents;
+        uint32_t nReserved;
+    };
+
+    struct FileHistogram {
+        char name[CAMERA_TRACE_NAME_LEN];
+        uint32_t count;
+        uint32_t buckets[CAMERA_TRACE_BUCKETS];
+        int64_t min;
+        int64_t max;
+        int64_t total;
+    };
+
+    struct FileEvent {
+        int64_t timestamp;
+        char name[CAMERA_TRACE_NAME_LEN];
+        int32_t tid;
+        int32_t arg;
+    };
+};
+
+};
+
+#endif //CAMERA_TRACE_H
@@ -62,6 +62,8 @@ namespace android {
 #define EXP_BRACKET_RANGE           10
 
 #define FD_PERIOD                   400 //[ms.]
+#define FD_MAX_PERIOD               1200 //[ms.]
+#define FD_RESULT_POOL_SIZE         3
 
 #define FOCUS_DIST_SIZE             100
 #define FOCUS_DIST_BUFFER_SIZE      500
@@ -388,7 +390,8 @@ public:
                                     OMX_IN OMX_BUFFERHEADERTYPE* pBuffer);
 
  OMX_ERRORTYPE OMXCameraAdapterFillBufferDone(OMX_IN OMX_HANDLETYPE hComponent,
-                                    OMX_IN OMX_BUFFERHEADERTYPE* pBuffHeader);
+                                    OMX_IN OMX_BUFFERHEADERTYPE* pBuffHeader,
+                                    nsecs_t fillBufferDoneTime = 0);
 
  static OMX_ERRORTYPE OMXCameraGetHandle(OMX_HANDLETYPE *handle, OMX_PTR pAppData,
         const OMX_CALLBACKTYPE & callbacks);
@@ -513,6 +516,7 @@ private:
     status_t setSharpness(Gen3A_settings& Gen3A);
     status_t setSaturation(Gen3A_settings& Gen3A);
     status_t setISO(Gen3A_settings& Gen3A);
+    status_t setExposureValues(Gen3A_settings& Gen3A, unsigned int settings);
     status_t setEffect(Gen3A_settings& Gen3A);
     status_t setMeteringAreas(Gen3A_settings& Gen3A);
 
@@ -565,11 +569,15 @@ private:
                          size_t previewWidth,
                          size_t previewHeight);
     status_t encodeFaceCoordinates(const OMX_FACEDETECTIONTYPE *faceData,
-                                   camera_frame_metadata_t **pFaces,
+                                   camera_frame_metadata_t *faceResult,
                                    size_t previewWidth,
                                    size_t previewHeight);
+    sp<CameraFDResult> getFDResult();
+    size_t pendingFDResults();
+    bool haveFacesChanged(const camera_frame_metadata_t *faceResult);
     void pauseFaceDetection(bool pause);
-    status_t recalculateFDSkip(uint32_t &skip, uint32_t currentFPS, uint32_t period);
+    status_t recalculateFDSkip(uint32_t &skip, uint32_t currentFPS, uint32_t period,
+                               bool facesChanged);
 
     //3A Algorithms priority configuration
     status_t setAlgoPriority(AlgoPriority priority, Algorithm3A algo, bool enable);
@@ -667,6 +675,7 @@ private:
     status_t sendCallBacks(CameraFrame frame, OMX_IN OMX_BUFFERHEADERTYPE *pBuffHeader, unsigned int mask, OMXCameraPortParameters *port);
 
     status_t apply3Asettings( Gen3A_settings& Gen3A );
+    void update3AApplyStats(unsigned int settings, nsecs_t start);
 
     // AutoConvergence
     status_t setAutoConvergence(const char *valstr,const CameraParameters &params);
@@ -680,10 +689,42 @@ private:
     status_t initDccFileDataSave(OMX_HANDLETYPE* omxHandle, int portIndex);
     status_t sniffDccFileDataSave(OMX_BUFFERHEADERTYPE* pBuffHeader);
     status_t saveDccFileDataSave();
+    status_t flushDccFileDataSave();
     status_t closeDccFileDataSave();
-    status_t fseekDCCuseCasePos(FILE *pFile);
-    FILE * fopenCameraDCC(const char *dccFolderPath);
-    FILE * parseDCCsubDir(DIR *pDir, char *path);
+    int writeDccFileDataSave(const OMX_TI_DCCDATATYPE &dccData);
+    status_t getDCCuseCaseOffset(int fd, const OMX_TI_DCCDATATYPE &dccData, off_t &offset);
+    int openCameraDCC(const char *dccFolderPath, const OMX_TI_DCCDATATYPE &dccData);
+    int parseDCCsubDir(DIR *pDir, char *path, const OMX_TI_DCCDATATYPE &dccData);
+
+    class DccDataSaveHandler : public Thread {
+        public:
+            DccDataSaveHandler(OMXCameraAdapter* ca)
+                : Thread(false), mCameraAdapter(ca) { }
+
+            virtual bool threadLoop() {
+                bool ret;
+                ret = Handler();
+                return ret;
+            }
+
+            status_t put(TIUTILS::Message* msg){
+                Mutex::Autolock lock(mLock);
+                return mCommandMsgQ.put(msg);
+            }
+
+            enum {
+                COMMAND_EXIT = -1,
+                DCC_DATA_SAVE = 0,
+                DCC_DATA_FLUSH
+            };
+
+        private:
+            bool Handler();
+            TIUTILS::MessageQueue mCommandMsgQ;
+            OMXCameraAdapter* mCameraAdapter;
+            Mutex mLock;
+    };
+    sp<DccDataSaveHandler> mDccDataSaveHandler;
 
     class CommandHandler : public Thread {
         public:
@@ -895,6 +936,12 @@ private:
     camera_face_t  faceDetectionLastOutput [MAX_NUM_FACES_SUPPORTED];
     int faceDetectionNumFacesLastOutput;
 
+    //Adaptive face detection scheduling
+    sp<CameraFDResult> mFDResultPool[FD_RESULT_POOL_SIZE];
+    camera_face_t mFDLastNotified[MAX_NUM_FACES_SUPPORTED];
+    int mFDNumFacesLastNotified;
+    uint32_t mFDUnchangedRuns;
+
     //Geo-tagging
     EXIFData mEXIFData;
 
@@ -937,6 +984,11 @@ private:
     Mutex m3ASettingsUpdateLock;
     Gen3A_settings mParameters3A;
 
+    //apply3Asettings() statistics
+    unsigned int m3AApplyCount;
+    nsecs_t m3AApplyTotalTime;
+    nsecs_t m3AApplyMaxTime;
+
     OMX_TI_CONFIG_3A_FACE_PRIORITY mFacePriority;
     OMX_TI_CONFIG_3A_REGION_PRIORITY mRegionPriority;
 
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef SYNTHETIC_CAMERA_ADAPTER_H
+#define SYNTHETIC_CAMERA_ADAPTER_H
+
+#include "CameraHal.h"
+#include "BaseCameraAdapter.h"
+#include "DebugUtils.h"
+#include "SyntheticFrameStamp.h"
+
+namespace android {
+
+///Preview buffers are 2D tiler buffers with a fixed line stride
+#define SYNTHETIC_PREVIEW_STRIDE 4096
+
+///Overrides the frame rate requested through the preview parameters
+#define SYNTHETIC_FPS_PROPERTY "camera.synthetic.fps"
+
+/**
+  * Camera adapter generating NV12 or YUV422I test frames without any camera
+  * hardware. Frames are produced at the preview frame rate with timestamps
+  * that only depend on the frame index, so CameraHal, AppCallbackNotifier,
+  * the JPEG encoder and the display path can be benchmarked reproducibly.
+  */
+class SyntheticCameraAdapter : public BaseCameraAdapter
+{
+public:
+
+    SyntheticCameraAdapter(size_t sensor_index);
+    ~SyntheticCameraAdapter();
+
+    ///Initialzes the camera adapter creates any resources required
+    virtual status_t initialize(CameraProperties::Properties*);
+
+    //APIs to configure Camera adapter and get the current parameter set
+    virtual status_t setParameters(const CameraParameters& params);
+    virtual void getParameters(CameraParameters& params);
+
+protected:
+
+//----------Parent class method implementation------------------------------------
+    virtual status_t startPreview();
+    virtual status_t stopPreview();
+    virtual status_t takePicture();
+    virtual status_t useBuffers(CameraMode mode, void* bufArr, int num, size_t length, unsigned int queueable);
+    virtual status_t fillThisBuffer(void* frameBuf, CameraFrame::FrameType frameType);
+    virtual status_t getFrameSize(size_t &width, size_t &height);
+    virtual status_t getPictureBufferSize(size_t &length, size_t bufferCount);
+    virtual status_t getFrameDataSize(size_t &dataFrameSize, size_t bufferCount);
+//-----------------------------------------------------------------------------
+
+private:
+
+    class FrameGeneratorThread : public Thread {
+            SyntheticCameraAdapter* mAdapter;
+        public:
+            FrameGeneratorThread(SyntheticCameraAdapter* hw) :
+                    Thread(false), mAdapter(hw) { }
+            virtual void onFirstRef() {
+                run("CameraSyntheticThread", PRIORITY_URGENT_DISPLAY);
+            }
+            virtual bool threadLoop() {
+                return mAdapter->generateFrame();
+            }
+        };
+
+    bool generateFrame();
+    void fillPreviewFrame(void *buffer, uint32_t index);
+    status_t sendImageFrame();
+
+private:
+
+    CameraParameters mParams;
+    int mSensorIndex;
+
+    mutable Mutex mGeneratorLock;
+
+    ///Preview buffers owned by the adapter, ready to be filled
+    Vector<void *> mFreeBuffers;
+
+    ///Preview buffers which already hold the test pattern
+    KeyedVector<void *, bool> mPatternBuffers;
+
+    int mPreviewWidth;
+    int mPreviewHeight;
+    bool mPreviewNV12;
+    int mPictureWidth;
+    int mPictureHeight;
+
+    bool mPreviewing;
+    bool mCapturePending;
+
+    nsecs_t mFramePeriod;
+    nsecs_t mStreamStart;
+    uint32_t mFrameIndex;
+    uint32_t mDroppedFrames;
+
+    sp<FrameGeneratorThread> mGeneratorThread;
+};
+
+}; //// namespace
+#endif //SYNTHETIC_CAMERA_ADAPTER_H
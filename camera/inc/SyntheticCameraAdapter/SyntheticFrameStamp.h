@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#ifndef SYNTHETIC_FRAME_STAMP_H
+#define SYNTHETIC_FRAME_STAMP_H
+
+#include <stdint.h>
+
+///Stamp written by the synthetic camera adapter at the start of the first
+///line of every frame it generates. Consumers of the frames (display,
+///callbacks, encoder) can read it back to measure pipeline latency.
+#define SYNTHETIC_FRAME_STAMP_MAGIC 0x53594e46 // "SYNF"
+
+struct SyntheticFrameStamp {
+    uint32_t magic;
+    uint32_t index;         ///Frame sequence number since preview start
+    int64_t generated;      ///systemTime(SYSTEM_TIME_MONOTONIC) when the frame was filled
+};
+
+#endif //SYNTHETIC_FRAME_STAMP_H
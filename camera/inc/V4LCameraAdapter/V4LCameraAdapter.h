@@ -26,8 +26,28 @@
 namespace android {
 
 #define DEFAULT_PIXEL_FORMAT V4L2_PIX_FMT_YUYV
+#define PREVIEW_PIXEL_FORMAT V4L2_PIX_FMT_UYVY
 #define NB_BUFFER 10
 #define DEVICE "/dev/video4"
+#define DEVICE_PROPERTY "camera.v4l.device"
+
+///Preview buffers are 2D tiler buffers with a fixed line stride
+#define PREVIEW_STRIDE 4096
+
+///Capture I/O mode, selected through the camera.v4l.iomode property
+#define IO_MODE_PROPERTY "camera.v4l.iomode"
+///Maximum number of frames between the dequeue and delivery stages,
+///overridden through the camera.v4l.pipeline.depth property
+#define PIPELINE_DEPTH_DEFAULT 2
+#define PIPELINE_DEPTH_PROPERTY "camera.v4l.pipeline.depth"
+///Back-off before dequeueing again after a transient device error
+#define DEQUEUE_ERROR_RETRY_US 10000
+
+enum V4LIOMode {
+    V4L_IO_AUTO,    //USERPTR when the sensor output matches the preview buffers, MMAP otherwise
+    V4L_IO_MMAP,    //Driver buffers, copied/converted into the preview buffers
+    V4L_IO_USERPTR, //Preview buffers queued directly, frames arrive in place
+};
 
 
 struct VideoInfo {
@@ -36,11 +56,15 @@ struct VideoInfo {
     struct v4l2_buffer buf;
     struct v4l2_requestbuffers rb;
     void *mem[NB_BUFFER];
+    size_t memSize[NB_BUFFER];
+    void *previewBuf[NB_BUFFER];
     bool isStreaming;
     int width;
     int height;
     int formatIn;
     int framesizeIn;
+    int bytesperline;
+    enum v4l2_memory memory;
 };
 
 
@@ -94,18 +118,58 @@ protected:
 
 private:
 
-    class PreviewThread : public Thread {
+    enum PipelineCommands {
+        PIPELINE_EXIT = -1,
+        PIPELINE_FRAME = 0,
+        PIPELINE_QUEUE_BUFFER,
+    };
+
+    ///Latency accumulated by one pipeline stage
+    struct StageStats {
+        unsigned int count;
+        nsecs_t total;
+        nsecs_t max;
+    };
+
+    ///Only dequeues and requeues V4L buffers
+    class DequeueThread : public Thread {
+            V4LCameraAdapter* mAdapter;
+        public:
+            DequeueThread(V4LCameraAdapter* hw) :
+                    Thread(false), mAdapter(hw) { }
+            virtual void onFirstRef() {
+                run("CameraDequeueThread", PRIORITY_URGENT_DISPLAY);
+            }
+            virtual bool threadLoop() {
+                return mAdapter->dequeueThread();
+            }
+        };
+
+    ///Copies or converts driver buffers into the preview buffers
+    class ConvertThread : public Thread {
+            V4LCameraAdapter* mAdapter;
+        public:
+            ConvertThread(V4LCameraAdapter* hw) :
+                    Thread(false), mAdapter(hw) { }
+            virtual void onFirstRef() {
+                run("CameraConvertThread", PRIORITY_URGENT_DISPLAY);
+            }
+            virtual bool threadLoop() {
+                return mAdapter->convertThread();
+            }
+        };
+
+    ///Sends the finished preview frames to the subscribers
+    class DeliverThread : public Thread {
             V4LCameraAdapter* mAdapter;
         public:
-            PreviewThread(V4LCameraAdapter* hw) :
+            DeliverThread(V4LCameraAdapter* hw) :
                     Thread(false), mAdapter(hw) { }
             virtual void onFirstRef() {
-                run("CameraPreviewThread", PRIORITY_URGENT_DISPLAY);
+                run("CameraDeliverThread", PRIORITY_URGENT_DISPLAY);
             }
             virtual bool threadLoop() {
-                mAdapter->previewThread();
-                // loop until we need to quit
-                return true;
+                return mAdapter->deliverThread();
             }
         };
 
@@ -114,7 +178,19 @@ private:
 
     char * GetFrame(int &index);
 
-    int previewThread();
+    status_t queueBuffer(int index);
+    status_t initUserPtrBuffers(void* bufArr, int num);
+    status_t initMmapBuffers(void* bufArr, int num);
+    status_t fallBackToMmapBuffers();
+    void convertFrame(uint8_t *dst, const uint8_t *src);
+
+    bool dequeueThread();
+    bool convertThread();
+    bool deliverThread();
+
+    void updateStageStats(StageStats &stats, nsecs_t latency);
+    void resetPipelineStats();
+    void dumpPipelineStats();
 
 public:
 
@@ -140,10 +216,28 @@ private:
     int mSensorIndex;
 
      // protected by mLock
-     sp<PreviewThread>   mPreviewThread;
+     sp<DequeueThread>   mDequeueThread;
+     sp<ConvertThread>   mConvertThread;
+     sp<DeliverThread>   mDeliverThread;
+
+     ///Buffers returned by the subscribers, requeued by the dequeue thread
+     TIUTILS::MessageQueue mReturnQ;
+     TIUTILS::MessageQueue mConvertQ;
+     TIUTILS::MessageQueue mDeliverQ;
+
+     int mPipelineDepth;
+     volatile int32_t mFramesInFlight;
+     nsecs_t mDequeueTime[NB_BUFFER];
+     nsecs_t mConvertTime[NB_BUFFER];
+
+     StageStats mQueueStats;
+     StageStats mConvertStats;
+     StageStats mDeliverStats;
+     unsigned int mDroppedFrames;
 
      struct VideoInfo *mVideoInfo;
      int mCameraHandle;
+     int mIOMode;
 
 
     int nQueued;
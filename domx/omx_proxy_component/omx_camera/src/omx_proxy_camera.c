@@ -64,6 +64,10 @@
 #include <string.h>
 #include <pthread.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <stdlib.h>
 
 #include <timm_osal_interfaces.h>
@@ -99,6 +103,19 @@
 #endif
 #define LINUX_PAGE_SIZE (4 * 1024)
 
+/* Packed copy of all DCC profiles, rebuilt whenever a profile changes.
+   The leading '.' keeps it out of the DCC directory scans. */
+#define DCC_CACHE_FILE  DCC_PATH ".dcc_profiles.cache"
+#define DCC_CACHE_MAGIC 0x43434344	/* "DCCC" */
+#define DCC_CACHE_VERSION 1
+
+typedef struct DCC_CACHE_HEADER {
+	OMX_U32 nMagic;
+	OMX_U32 nVersion;
+	OMX_U32 nManifest;
+	OMX_S32 nSize;
+} DCC_CACHE_HEADER;
+
 #define _PROXY_OMX_INIT_PARAM(param,type) do {		\
 	TIMM_OSAL_Memset((param), 0, sizeof (type));	\
 	(param)->nSize = sizeof (type);			\
@@ -128,6 +145,9 @@ MemAllocBlock *MemReqDescTiler;
 #endif
 
 OMX_S32 read_DCCdir(OMX_PTR, OMX_STRING *, OMX_U16);
+OMX_S32 stat_DCCdir(OMX_STRING *, OMX_U16, OMX_U32 *);
+OMX_S32 DCC_LoadCache(OMX_PTR, OMX_U32, OMX_S32);
+void DCC_StoreCache(OMX_PTR, OMX_U32, OMX_S32);
 OMX_ERRORTYPE DCC_Init(OMX_HANDLETYPE);
 OMX_ERRORTYPE send_DCCBufPtr(OMX_HANDLETYPE hComponent);
 void DCC_DeInit();
@@ -402,6 +422,8 @@ OMX_ERRORTYPE DCC_Init(OMX_HANDLETYPE hComponent)
 	OMX_S32 status = 0;
 	OMX_STRING dcc_dir[200];
 	OMX_U16 i;
+	OMX_U32 manifest = 0;
+	OMX_S32 dcc_size = 0;
 	_PROXY_OMX_INIT_PARAM(&param, OMX_TI_PARAM_DCCURIINFO);
 
 	DOMX_ENTER("ENTER");
@@ -438,7 +460,10 @@ OMX_ERRORTYPE DCC_Init(OMX_HANDLETYPE hComponent)
 		eError = OMX_ErrorNone;
 	}
 
-	dccbuf_size = read_DCCdir(NULL, dcc_dir, nIndex);
+	/* Only the directory entries are examined here, the profiles
+	   themselves are read at most once below */
+	dcc_size = stat_DCCdir(dcc_dir, nIndex, &manifest);
+	dccbuf_size = dcc_size;
 
     if(dccbuf_size <= 0)
     {
@@ -481,7 +506,16 @@ OMX_ERRORTYPE DCC_Init(OMX_HANDLETYPE hComponent)
 		OMX_ErrorInsufficientResources, "ERROR Allocating 1D TILER BUF");
 	ptempbuf = DCC_Buff;
 #endif
-	dccbuf_size = read_DCCdir(ptempbuf, dcc_dir, nIndex);
+	dccbuf_size = DCC_LoadCache(ptempbuf, manifest, dcc_size);
+	if (dccbuf_size != dcc_size)
+	{
+		DOMX_DEBUG("DCC cache is stale, reading the DCC profiles");
+		dccbuf_size = read_DCCdir(ptempbuf, dcc_dir, nIndex);
+		if (dccbuf_size == dcc_size)
+		{
+			DCC_StoreCache(ptempbuf, manifest, dccbuf_size);
+		}
+	}
 
 	PROXY_assert(dccbuf_size > 0, OMX_ErrorInsufficientResources,
 		"ERROR in copy DCC files into buffer");
@@ -624,6 +658,193 @@ OMX_S32 read_DCCdir(OMX_PTR buffer, OMX_STRING * dir_path, OMX_U16 numofURI)
 	return ret;
 }
 
+/* ===========================================================================*/
+/**
+ * @name stat_DCCdir()
+ * @brief : walks the DCC directories in the same order as read_DCCdir()
+ *          without opening the profiles. Directory and profile names, sizes
+ *          and modification times are folded into a manifest hash which
+ *          identifies the exact set of profiles a DCC cache was built from.
+ * @param pManifest : receives the manifest hash
+ * @return return = size of the DCC directory or error in case of any failures
+ * @sa read_DCCdir
+ *
+ */
+/* ===========================================================================*/
+OMX_S32 stat_DCCdir(OMX_STRING * dir_path, OMX_U16 numofURI,
+    OMX_U32 * pManifest)
+{
+	OMX_S32 dcc_buf_size = 0;
+	OMX_STRING filename;
+	char temp[200];
+	OMX_STRING dotdot = "..";
+	DIR *d;
+	struct dirent *dir;
+	struct stat st;
+	OMX_U16 i = 0;
+	OMX_S32 ret = 0;
+	OMX_U32 hash = 2166136261U;	/* FNV-1a */
+	OMX_U8 *p;
+	size_t n;
+
+#define DCC_HASH(ptr, len) \
+	for (p = (OMX_U8 *) (ptr), n = (len); n > 0; n--, p++) \
+		hash = (hash ^ *p) * 16777619U
+
+	DOMX_ENTER("ENTER");
+	for (i = 0; i < numofURI - 1; i++)
+	{
+		DCC_HASH(dir_path[i], strlen(dir_path[i]));
+		d = opendir(dir_path[i]);
+		if (d)
+		{
+			while ((dir = readdir(d)) != NULL)
+			{
+				filename = dir->d_name;
+				strcpy(temp, dir_path[i]);
+				strcat(temp, filename);
+				if ((*filename != *dotdot))
+				{
+					if (stat(temp, &st) != 0)
+					{
+						DOMX_ERROR("File stat error");
+						ret = -1;
+					} else
+					{
+						DCC_HASH(filename, strlen(filename));
+						DCC_HASH(&st.st_size, sizeof(st.st_size));
+						DCC_HASH(&st.st_mtime, sizeof(st.st_mtime));
+						dcc_buf_size =
+						    dcc_buf_size + st.st_size;
+					}
+				}
+			}
+			closedir(d);
+		}
+	}
+#undef DCC_HASH
+
+	*pManifest = hash;
+	if (ret == 0)
+		ret = dcc_buf_size;
+
+	DOMX_EXIT("return %d", ret);
+	return ret;
+}
+
+/* ===========================================================================*/
+/**
+ * @name DCC_LoadCache()
+ * @brief : maps the DCC cache and copies it into the DCC buffer if it was
+ *          built from the current set of profiles.
+ * @param buffer : DCC buffer, at least size bytes long
+ * @return return = number of bytes copied, or -1 if the cache can't be used
+ * @sa DCC_StoreCache
+ *
+ */
+/* ===========================================================================*/
+OMX_S32 DCC_LoadCache(OMX_PTR buffer, OMX_U32 manifest, OMX_S32 size)
+{
+	DCC_CACHE_HEADER *header;
+	struct stat st;
+	OMX_PTR image;
+	OMX_S32 ret = -1;
+	int fd;
+
+	DOMX_ENTER("ENTER");
+
+	fd = open(DCC_CACHE_FILE, O_RDONLY);
+	if (fd < 0)
+	{
+		DOMX_DEBUG("No DCC cache found");
+		goto EXIT;
+	}
+
+	if (fstat(fd, &st) != 0 ||
+	    st.st_size != (off_t) (sizeof(DCC_CACHE_HEADER) + size))
+	{
+		close(fd);
+		goto EXIT;
+	}
+
+	image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (image == MAP_FAILED)
+	{
+		DOMX_ERROR("DCC cache mmap failed");
+		goto EXIT;
+	}
+
+	header = (DCC_CACHE_HEADER *) image;
+	if (header->nMagic == DCC_CACHE_MAGIC &&
+	    header->nVersion == DCC_CACHE_VERSION &&
+	    header->nManifest == manifest && header->nSize == size)
+	{
+		TIMM_OSAL_Memcpy(buffer, header + 1, size);
+		ret = size;
+	}
+
+	munmap(image, st.st_size);
+
+      EXIT:
+	DOMX_EXIT("return %d", ret);
+	return ret;
+}
+
+/* ===========================================================================*/
+/**
+ * @name DCC_StoreCache()
+ * @brief : writes the packed DCC profiles out as the new DCC cache. Errors
+ *          are not fatal, the profiles are simply read again next time.
+ * @param buffer : DCC buffer holding size bytes of profiles
+ * @return void
+ * @sa DCC_LoadCache
+ *
+ */
+/* ===========================================================================*/
+void DCC_StoreCache(OMX_PTR buffer, OMX_U32 manifest, OMX_S32 size)
+{
+	DCC_CACHE_HEADER header;
+	char temp[200];
+	int fd;
+
+	DOMX_ENTER("ENTER");
+
+	header.nMagic = DCC_CACHE_MAGIC;
+	header.nVersion = DCC_CACHE_VERSION;
+	header.nManifest = manifest;
+	header.nSize = size;
+
+	strcpy(temp, DCC_CACHE_FILE);
+	strcat(temp, ".tmp");
+
+	fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+	if (fd < 0)
+	{
+		DOMX_DEBUG("Unable to create DCC cache");
+		goto EXIT;
+	}
+
+	if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+	    write(fd, buffer, size) != size || fsync(fd) != 0)
+	{
+		DOMX_ERROR("Writing DCC cache failed");
+		close(fd);
+		unlink(temp);
+		goto EXIT;
+	}
+	close(fd);
+
+	if (rename(temp, DCC_CACHE_FILE) != 0)
+	{
+		DOMX_ERROR("Renaming DCC cache failed");
+		unlink(temp);
+	}
+
+      EXIT:
+	DOMX_EXIT("EXIT");
+}
+
 /* ===========================================================================*/
 /**
  * @name DCC_Deinit()
@@ -22,7 +22,8 @@ LOCAL_PRELINK_MODULE := false
 LOCAL_ARM_MODE := arm
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 LOCAL_SHARED_LIBRARIES := liblog libEGL libcutils libtimemmgr libutils
-LOCAL_SRC_FILES := hwc_init.cpp hwc.cpp hwc_dss.cpp hwc_buffers.cpp hwc_hdmi.cpp
+LOCAL_SRC_FILES := hwc_init.cpp hwc.cpp hwc_dss.cpp hwc_buffers.cpp hwc_hdmi.cpp hwc_stats.cpp \
+    hwc_capture.cpp
 
 LOCAL_MODULE_TAGS := optional
 LOCAL_C_INCLUDES := \
@@ -32,6 +32,9 @@
 
 #include "hwc_priv.h"
 #include "hwc_dss.h"
+#include "hwc_stats.h"
+#include "hwc_capture.h"
+#include "hwc_hdmi.h"
 
 #define UNLIKELY( x ) (__builtin_expect( (x), 0 ))
 
@@ -73,8 +76,14 @@ int ti_hwc_prepare(struct hwc_composer_device *dev, hwc_layer_list_t* list)
     int ret;
     HWC_UNUSED(dev);
 
+    hwc_stats_prepare_begin();
+
+    hwc_capture_layers(list);
+
     ret = prepare_dss_layers(list);
 
+    hwc_stats_prepare_end(list);
+
     return ret;
 }
 
@@ -89,9 +98,16 @@ int ti_hwc_set(struct hwc_composer_device *dev, hwc_display_t dpy,
      * HWC_FRAMEBUFFER we need to call eglSwapBuffers.
      */
 
+    hwc_stats_set_begin();
+
     set_dss_layers(list);
 
     EGLBoolean sucess = eglSwapBuffers((EGLDisplay)dpy, (EGLSurface)sur);
+
+    hwc_stats_set_end();
+
+    hwc_hdmi_frame_done();
+
     if (!sucess)
         return HWC_EGL_ERROR;
 
@@ -99,3 +115,10 @@ int ti_hwc_set(struct hwc_composer_device *dev, hwc_display_t dpy,
 
     return 0;
 }
+
+void ti_hwc_dump(struct hwc_composer_device *dev, char *buff, int buff_len)
+{
+    HWC_UNUSED(dev);
+
+    hwc_stats_dump(buff, buff_len);
+}
@@ -21,6 +21,9 @@
 #include <errno.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <linux/types.h>
 
 #include <hardware/hwcomposer.h>
 #include <cutils/native_handle.h>
@@ -35,59 +38,141 @@ extern "C" {
 #define PAGE_MASK (~4095)
 #define PAGE_ALIGN(x) (((x) + ~PAGE_MASK) & PAGE_MASK)
 
-#define MAP_CACHE_MAX_SZ 6
+/* Number of buffers kept mapped into Tiler-1D */
+#define MAP_CACHE_MAX_SZ 16
+
+/* Hash buckets, must be a power of two */
+#define MAP_CACHE_HASH_SZ 32
+
+/*
+ * Buffers used by one of the last MAP_CACHE_KEEP_FRAMES frames survive a
+ * geometry change. This covers all the buffers of a triple buffered layer.
+ */
+#define MAP_CACHE_KEEP_FRAMES 4
+
 static hwc_cached_buffer_t g_map_cache[MAP_CACHE_MAX_SZ];
-static hwc_cached_buffer_t *g_head = &g_map_cache[0];
+static hwc_cached_buffer_t *g_hash[MAP_CACHE_HASH_SZ];
+
+/* LRU order, unused entries are kept at the tail */
+static hwc_cached_buffer_t *g_head;
+static hwc_cached_buffer_t *g_tail;
+
+static unsigned int g_generation;
+static unsigned int g_committed_generation;
+static hwc_buffer_stats_t g_stats;
+
+static unsigned int hash_stamp(unsigned long long stamp)
+{
+    __u32 v = (__u32) (stamp ^ (stamp >> 32));
+    v ^= v >> 5;
+    v ^= v >> 11;
+    return v & (MAP_CACHE_HASH_SZ - 1);
+}
+
+static void hash_insert(hwc_cached_buffer_t *buf)
+{
+    unsigned int h = hash_stamp(buf->mapped_stamp);
+    buf->hash_next = g_hash[h];
+    g_hash[h] = buf;
+}
+
+static void hash_remove(hwc_cached_buffer_t *buf)
+{
+    hwc_cached_buffer_t **pp = &g_hash[hash_stamp(buf->mapped_stamp)];
+    while (*pp && *pp != buf)
+        pp = &(*pp)->hash_next;
+    if (*pp)
+        *pp = buf->hash_next;
+    buf->hash_next = NULL;
+}
+
+static void list_remove(hwc_cached_buffer_t *buf)
+{
+    if (buf->l.prev)
+        buf->l.prev->l.next = buf->l.next;
+    else
+        g_head = buf->l.next;
+
+    if (buf->l.next)
+        buf->l.next->l.prev = buf->l.prev;
+    else
+        g_tail = buf->l.prev;
+
+    buf->l.next = buf->l.prev = NULL;
+}
+
+static void list_push_head(hwc_cached_buffer_t *buf)
+{
+    buf->l.prev = NULL;
+    buf->l.next = g_head;
+    if (g_head)
+        g_head->l.prev = buf;
+    else
+        g_tail = buf;
+    g_head = buf;
+}
+
+static void list_push_tail(hwc_cached_buffer_t *buf)
+{
+    buf->l.next = NULL;
+    buf->l.prev = g_tail;
+    if (g_tail)
+        g_tail->l.next = buf;
+    else
+        g_head = buf;
+    g_tail = buf;
+}
 
 /*
- * Find a matching buffer in the list according to the layer
- * buffer handle
+ * Find a matching buffer according to the allocation stamp of the layer
+ * buffer. A new buffer can be allocated at the address of a freed one, in
+ * this or another process, so the address alone does not identify it. The
+ * cached handle itself is not dereferenced since the layer may have gone
+ * away.
  */
-hwc_cached_buffer_t* find_buf(hwc_layer_t *layer)
+static hwc_cached_buffer_t* find_buf(IMG_native_handle_t *hndl)
 {
-    IMG_native_handle_t *hndl = (IMG_native_handle_t*)layer->handle;
-    hwc_cached_buffer_t* cbuf2 = g_head;
-    hwc_cached_buffer_t* found = NULL;
-    do {
-        if ((cbuf2->layer_buffer) &&
-            (hndl->vptr == cbuf2->layer_buffer->vptr)) {
-            found = cbuf2;
-            break;
-        }
-        cbuf2 = cbuf2->l.next;
-    } while (cbuf2);
-    return found;
+    hwc_cached_buffer_t *cbuf = g_hash[hash_stamp(hndl->ui64Stamp)];
+    while (cbuf && (cbuf->mapped_stamp != hndl->ui64Stamp ||
+                    cbuf->mapped_pid != hndl->pid ||
+                    cbuf->mapped_vptr != hndl->vptr))
+        cbuf = cbuf->hash_next;
+    return cbuf;
 }
 
 /*
- * The least recently used buffer is at the end of the list
+ * The buffers of the frame being prepared and of the last frame committed
+ * to the DSS, which it still scans out, must stay mapped
  */
-static hwc_cached_buffer_t* get_lru(void)
+static int buf_in_use(hwc_cached_buffer_t *cbuf)
 {
-    hwc_cached_buffer_t *ptr = g_head;
-    while (ptr->l.next != NULL)
-        ptr = ptr->l.next;
-    return ptr;
+    return cbuf->generation == g_generation ||
+           cbuf->generation >= g_committed_generation;
 }
 
 /*
- * Make the cached buffer passed in the the most recently
- * used buffer i.e. the head of the list
+ * Unmap a buffer and move its entry to the tail, ready for reuse
  */
-static void swap_head(hwc_cached_buffer_t *buf)
+static void release_buf(hwc_cached_buffer_t *cbuf)
 {
-    if (buf == g_head) {
-        return;
-    }
-    hwc_cached_buffer_t *prev = g_head;
-    while (prev->l.next != buf) {
-        prev = prev->l.next;
-    }
+    int err = MemMgr_UnMap(cbuf->mapped_ptr);
+    LOGE_IF(err, "Unable to unmap buffer %p", cbuf->mapped_vptr);
 
-    hwc_cached_buffer_t *oldhead = g_head;
-    prev->l.next = buf->l.next;
-    buf->l.next = oldhead;
-    g_head = buf;
+    hash_remove(cbuf);
+    list_remove(cbuf);
+
+    cbuf->layer_buffer = NULL;
+    cbuf->mapped_ptr = NULL;
+    cbuf->mapped_vptr = NULL;
+    cbuf->mapped_stamp = 0;
+    cbuf->mapped_pid = 0;
+    cbuf->mapped_size = 0;
+    cbuf->use_cnt = 0;
+
+    list_push_tail(cbuf);
+
+    g_stats.unmaps++;
+    g_stats.mapped--;
 }
 
 int get_cached_buffer(hwc_layer_t *layer, hwc_cached_buffer_t *cbuf)
@@ -101,20 +186,45 @@ int get_cached_buffer(hwc_layer_t *layer, hwc_cached_buffer_t *cbuf)
         return 0;
     }
 
-    int rv = -ENOENT;
-    hwc_cached_buffer_t* found = find_buf(layer);
-    if (found) {
-        swap_head(found);
-        *cbuf = *found;
-        rv = 0;
-    } 
-    return rv;
+    hwc_cached_buffer_t* found = find_buf(hndl);
+    if (found && found->mapped_size != hndl->m_size) {
+        /* a different buffer was allocated at the same address */
+        release_buf(found);
+        found = NULL;
+    }
+
+    if (!found) {
+        g_stats.misses++;
+        return -ENOENT;
+    }
+
+    g_stats.hits++;
+    list_remove(found);
+    list_push_head(found);
+    found->generation = g_generation;
+    found->layer_buffer = hndl;
+    *cbuf = *found;
+    return 0;
+}
+
+static void *map_buf(IMG_native_handle_t *hndl)
+{
+    void *buf = hndl->vptr;
+    __u32 bufi = (__u32) (uintptr_t) buf;
+    __u32 st = bufi & PAGE_MASK;
+    MemAllocBlock block[1];
+    memset(&block, 0, sizeof(block));
+
+    block[0].pixelFormat = PIXEL_FMT_PAGE;
+    block[0].dim.len = PAGE_ALIGN(bufi - st + hndl->m_size);
+    block[0].ptr = (void *) (uintptr_t) st;
+
+    return MemMgr_Map(block, 1);
 }
 
 int map_cached_buffer(hwc_layer_t *layer)
 {
     IMG_native_handle_t* hndl;
-    int rv = 0;
 
     if (!layer)
         return -ENOENT;
@@ -124,50 +234,114 @@ int map_cached_buffer(hwc_layer_t *layer)
         return 0;    /* Don't need to map or cache */
     }
 
-    hwc_cached_buffer_t* cbuf = get_lru();
-    if (cbuf->layer_buffer) {
-        int err = MemMgr_UnMap(cbuf->mapped_ptr);
-        LOGE_IF(err, "Unable to unmap buffer %p", cbuf->layer_buffer->vptr);
-        bzero(cbuf, sizeof(cbuf));
+    hwc_cached_buffer_t* cbuf = find_buf(hndl);
+    if (cbuf) {
+        if (cbuf->mapped_size == hndl->m_size)
+            return 0;
+        release_buf(cbuf);
     }
 
-    void *buf = hndl->vptr;
-    __u32 bufi = (__u32) buf;
-    __u32 st = bufi & PAGE_MASK;
-    MemAllocBlock block[1];
-    memset(&block, 0, sizeof(block));
+    cbuf = g_tail;
+    if (cbuf->layer_buffer) {
+        if (buf_in_use(cbuf)) {
+            LOGE("No free Tiler1D cache entry for %p", (void*) hndl->vptr);
+            g_stats.failures++;
+            return -ENOMEM;
+        }
+        g_stats.evictions++;
+        release_buf(cbuf);
+    }
 
-    block[0].pixelFormat = PIXEL_FMT_PAGE;
-    block[0].dim.len = PAGE_ALIGN(bufi - st + hndl->m_size);
-    block[0].ptr = (void *)st;
+    void *mapped_ptr = map_buf(hndl);
 
-    cbuf->mapped_ptr = MemMgr_Map(block, 1);
+    /*
+     * Tiler-1D may be exhausted, give back the buffers that neither this
+     * frame nor the one on screen use before failing
+     */
+    while (mapped_ptr == NULL) {
+        hwc_cached_buffer_t *lru = g_tail;
+        while (lru && !lru->layer_buffer)
+            lru = lru->l.prev;
+        if (!lru || buf_in_use(lru))
+            break;
+        g_stats.evictions++;
+        release_buf(lru);
+        mapped_ptr = map_buf(hndl);
+    }
 
-    if (cbuf->mapped_ptr == NULL) {
+    if (mapped_ptr == NULL) {
         LOGE("Tiler1D mapping failed %p", (void*) hndl->vptr);
-        bzero(cbuf, sizeof(cbuf));
-        rv = -EINVAL;
-        goto end;
+        g_stats.failures++;
+        return -EINVAL;
     }
 
+    cbuf = g_tail;
+    list_remove(cbuf);
+
+    cbuf->mapped_ptr = mapped_ptr;
+    cbuf->mapped_vptr = hndl->vptr;
+    cbuf->mapped_stamp = hndl->ui64Stamp;
+    cbuf->mapped_pid = hndl->pid;
+    cbuf->mapped_size = hndl->m_size;
     cbuf->type = BUF_USER;
     cbuf->layer_buffer = hndl;
     cbuf->use_cnt = 1;
+    cbuf->generation = g_generation;
+
+    hash_insert(cbuf);
+    list_push_head(cbuf);
+
+    g_stats.maps++;
+    g_stats.mapped++;
 
     LOGV("Buffer %p cached with tiler addr %p", hndl->vptr, cbuf->mapped_ptr);
-end:
-    return rv;
+    return 0;
+}
+
+void update_cached_buffers(int geometry_changed)
+{
+    g_generation++;
+
+    if (!geometry_changed)
+        return;
+
+    for (int idx = 0; idx < MAP_CACHE_MAX_SZ; idx++) {
+        hwc_cached_buffer_t *cbuf = &g_map_cache[idx];
+        if (cbuf->layer_buffer &&
+            g_generation - cbuf->generation > MAP_CACHE_KEEP_FRAMES) {
+            LOGV("Releasing stale buffer %p", cbuf->mapped_vptr);
+            release_buf(cbuf);
+        }
+    }
+}
+
+void commit_cached_buffers(void)
+{
+    g_committed_generation = g_generation;
 }
 
 void unmap_cached_buffers(void)
 {
+    for (int idx = 0; idx < MAP_CACHE_MAX_SZ; idx++) {
+        if (g_map_cache[idx].layer_buffer)
+            release_buf(&g_map_cache[idx]);
+    }
+}
+
+void get_cached_buffer_stats(hwc_buffer_stats_t *stats)
+{
+    *stats = g_stats;
 }
 
 void init_cached_buffers(void)
 {
-    const int tail = MAP_CACHE_MAX_SZ-1;
-    for (int idx=0; idx < tail; idx++) {
-        g_map_cache[idx].l.next = &g_map_cache[idx+1];
-    }
-    g_map_cache[tail].l.next = NULL;
+    memset(g_map_cache, 0, sizeof(g_map_cache));
+    memset(g_hash, 0, sizeof(g_hash));
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_head = g_tail = NULL;
+    g_generation = 1;
+    g_committed_generation = 1;
+
+    for (int idx = 0; idx < MAP_CACHE_MAX_SZ; idx++)
+        list_push_tail(&g_map_cache[idx]);
 }
@@ -30,6 +30,11 @@
  * However, other buffers such as RGB buffers will be dynamically mapped
  * into a limited region of Tiler-1D memory (effectively a cache). This is
  * done so they can be rendered directly by the DSS.
+ *
+ * Mapped buffers are found through a hash on the buffer's allocation
+ * stamp and kept in least recently used order. A geometry change only unmaps the
+ * buffers that were not used by a recent frame, so the buffers of layers
+ * that are still on screen stay mapped across rotations and resizes.
  */
 
 typedef enum {
@@ -41,17 +46,33 @@ typedef struct hwc_cached_buffer hwc_cached_buffer_t;
 
 typedef struct hwc_cache_list {
     hwc_cached_buffer_t *next;
-//    hwc_cached_buffer_t *prev;
+    hwc_cached_buffer_t *prev;
 } hwc_cache_list_t;
 
 typedef struct hwc_cached_buffer {
     hwc_cache_list_t l; /* private */
+    hwc_cached_buffer_t *hash_next; /* private */
+    unsigned int generation; /* private, last frame the buffer was used in */
+    unsigned long long mapped_stamp; /* private, hash key */
+    int mapped_pid; /* private */
+    void *mapped_vptr; /* private */
+    int mapped_size; /* private */
     IMG_native_handle_t* layer_buffer;
     void *mapped_ptr;
     HWC_BUF_TYPE type;
     int use_cnt; /* private */
 } hwc_cached_buffer_t;
 
+typedef struct hwc_buffer_stats {
+    unsigned int hits;      /* lookups of a mapped buffer */
+    unsigned int misses;    /* lookups of a buffer that needed mapping */
+    unsigned int maps;
+    unsigned int unmaps;
+    unsigned int evictions; /* buffers unmapped to make room for another */
+    unsigned int failures;  /* Tiler-1D mappings that failed */
+    unsigned int mapped;    /* buffers currently mapped */
+} hwc_buffer_stats_t;
+
 /* api */
 
 /*
@@ -80,11 +101,30 @@ int get_cached_buffer(hwc_layer_t *layer, hwc_cached_buffer_t *cbuf);
 int map_cached_buffer(hwc_layer_t *layer);
 
 /*
- * This doesn't really do anything yet. The cache will unmap buffers dynamically
+ * Called when the buffers looked up since the last update_cached_buffers()
+ * are committed to the DSS. They stay mapped while it shows them, even if
+ * Tiler-1D runs out.
+ */
+void commit_cached_buffers(void);
+
+/*
+ * Unmap every cached buffer. The cache unmaps buffers dynamically
  * so this is only useful for unloading the HAL
  */
 void unmap_cached_buffers(void);
 
+/*
+ * Called at the start of every prepare. Starts a new frame generation and,
+ * if the geometry changed, unmaps the buffers no recent frame has used since
+ * those most likely went away with their layer.
+ */
+void update_cached_buffers(int geometry_changed);
+
+/*
+ * Copy the mapping statistics collected since the HAL was opened
+ */
+void get_cached_buffer_stats(hwc_buffer_stats_t *stats);
+
 /*
  * Initialise the buffer cache module
  */
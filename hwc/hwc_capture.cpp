@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/properties.h>
+
+#include "hwc_priv.h"
+#include "hwc_capture.h"
+#include "hwc_dss.h"
+
+/* Only touched by the composition thread and the HWC open and close */
+static FILE *g_capture_file;
+static int g_capture_frames;
+
+void hwc_capture_init(void)
+{
+    char path[PROPERTY_VALUE_MAX];
+    char value[PROPERTY_VALUE_MAX];
+    int width, height, bpp;
+
+    property_get(HWC_CAPTURE_PROPERTY, path, "");
+    if (!path[0])
+        return;
+
+    property_get(HWC_CAPTURE_FRAMES_PROPERTY, value, "0");
+    g_capture_frames = atoi(value) > 0 ? atoi(value) : HWC_CAPTURE_DEFAULT_FRAMES;
+
+    g_capture_file = fopen(path, "w");
+    if (g_capture_file == NULL) {
+        LOGE("unable to create %s: %s", path, strerror(errno));
+        return;
+    }
+
+    get_dss_display_info(&width, &height, &bpp);
+    fprintf(g_capture_file, "hwc-capture %d\n", HWC_CAPTURE_VERSION);
+    fprintf(g_capture_file, "display %d %d %d\n", width, height, bpp);
+
+    LOGI("capturing %d layer lists to %s", g_capture_frames, path);
+}
+
+void hwc_capture_layers(hwc_layer_list_t *list)
+{
+    if (g_capture_file == NULL || list == NULL)
+        return;
+
+    fprintf(g_capture_file, "frame %x %d\n", list->flags, (int)list->numHwLayers);
+
+    for (size_t n = 0; n < list->numHwLayers; n++) {
+        hwc_layer_t *layer = &list->hwLayers[n];
+        IMG_native_handle_t *handle = (IMG_native_handle_t *) layer->handle;
+        hwc_rect_t *crop = &layer->sourceCrop;
+        hwc_rect_t *frame = &layer->displayFrame;
+
+        if (handle) {
+            fprintf(g_capture_file, "layer %lx %lx %d %d %d %u %d", (unsigned long) handle,
+                    (unsigned long) handle->vptr, handle->iFormat, handle->iWidth, handle->iHeight,
+                    handle->uiBpp, handle->m_size);
+        } else {
+            fprintf(g_capture_file, "layer 0 0 0 0 0 0 0");
+        }
+
+        fprintf(g_capture_file, " %u %x %x %d %d %d %d %d %d %d %d %d\n",
+                layer->transform, layer->blending, layer->flags,
+                crop->left, crop->top, crop->right, crop->bottom,
+                frame->left, frame->top, frame->right, frame->bottom,
+                (int)layer->visibleRegionScreen.numRects);
+    }
+
+    if (--g_capture_frames <= 0)
+        hwc_capture_deinit();
+}
+
+void hwc_capture_deinit(void)
+{
+    if (g_capture_file == NULL)
+        return;
+
+    fclose(g_capture_file);
+    g_capture_file = NULL;
+    LOGI("layer capture done");
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef _HWC_CAPTURE_H
+#define _HWC_CAPTURE_H
+
+#include "hwc_priv.h"
+
+/*
+ * Layer list capture for offline replay.
+ *
+ * Setting debug.hwc.capture to a file name makes the composer write the
+ * layer lists it is given to prepare into that file, up to
+ * debug.hwc.capture.frames lists (HWC_CAPTURE_DEFAULT_FRAMES by default).
+ * The properties are read when the HWC is opened. The replay harness in
+ * test/HwcReplay runs the lists through the composer against a mock DSS.
+ *
+ * The file is text, one record per line, fields separated by spaces:
+ *
+ *   hwc-capture <version>
+ *   display <width> <height> <bpp>
+ *   frame <list flags> <number of layers>
+ *   layer <handle> <vptr> <format> <width> <height> <bpp> <size>
+ *         <transform> <blending> <flags> <crop l t r b> <frame l t r b>
+ *         <visible rects>
+ *
+ * Each frame record is followed by its layer records. Handles and vptrs
+ * only identify buffers across frames, a null handle is written as 0.
+ * Flags, handles and vptrs are hexadecimal, everything else is decimal.
+ * Lines starting with '#' are comments.
+ */
+
+#define HWC_CAPTURE_VERSION 1
+
+#define HWC_CAPTURE_DEFAULT_FRAMES 600
+
+#define HWC_CAPTURE_PROPERTY "debug.hwc.capture"
+#define HWC_CAPTURE_FRAMES_PROPERTY "debug.hwc.capture.frames"
+
+/* api */
+
+/*
+ * Read the properties and open the capture file. Called when the HWC is
+ * opened, after the display has been set up
+ */
+void hwc_capture_init(void);
+
+/*
+ * Append the list given to prepare, before it is modified
+ */
+void hwc_capture_layers(hwc_layer_list_t *list);
+
+/*
+ * Close the capture file. Called when the HWC is closed
+ */
+void hwc_capture_deinit(void);
+
+#endif // _HWC_CAPTURE_H
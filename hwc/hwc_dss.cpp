@@ -28,20 +28,31 @@
 #include <sys/ioctl.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
 #include <linux/fb.h>
 
 #include <hardware/hardware.h>
 #include <hardware/hwcomposer.h>
 #include <cutils/native_handle.h>
+#include <cutils/properties.h>
 
 #include "hwc_dss.h"
 #include "hwc_priv.h"
 #include "hwc_buffers.h"
 #include "ti_hwc_ioctl.h"
 #include "hwc_hdmi.h"
+#include "hwc_stats.h"
 
 #define MAX_OVERLAYS 4
 
+/* Scaling range of the video pipelines */
+#define MAX_UPSCALE 8
+#define MAX_DOWNSCALE 4
+
+/* Let RGB and 4:2:2 layers use the video pipelines */
+#define RGB_OVERLAYS_PROPERTY "debug.hwc.rgb_overlays"
+
 /*
  * this is to mark temporary code for hdmi cloning
  */
@@ -82,6 +93,7 @@ struct pipeline_state {
 struct display_info {
     int width;
     int height;
+    int bpp;
 };
 
 /* Create a 'right sized' data structure for the dss_hwc_set_info interface */
@@ -90,6 +102,35 @@ struct dss_hwc_set_info_container {
     struct dss_hwc_ovl_info ovls[MAX_OVERLAYS];
 };
 
+/*
+ * struct pipeline_shadow dirty mask
+ */
+enum {
+    HWCIMPL_DIRTY_BUFFER = 0x1,     /* buffer or its tiler mapping */
+    HWCIMPL_DIRTY_FORMAT = 0x2,     /* color format or blending */
+    HWCIMPL_DIRTY_TRANSFORM = 0x4,
+    HWCIMPL_DIRTY_POSITION = 0x8,   /* display frame or crop */
+    HWCIMPL_DIRTY_ZORDER = 0x10,
+    HWCIMPL_DIRTY_ALL = 0x1f,
+};
+
+/*
+ * Layer state the overlay info of a pipeline was last derived from,
+ * so update_buffer only runs for pipelines whose layer changed
+ */
+struct pipeline_shadow {
+    int valid;
+    IMG_native_handle_t *handle;
+    void *mapped_ptr;
+    int format;
+    int blending;
+    int transform;
+    hwc_rect_t display_frame;
+    hwc_rect_t source_crop;
+    int z;
+    struct dss_hwc_ovl_info info;
+};
+
 /* Global pipeline state */
 static struct pipeline_state g_pipelines[HWCIMPL_PIPE_MAX];
 static int g_top_vid_pipe = HWCIMPL_PIPE_VID1;
@@ -103,9 +144,21 @@ static int g_devfd;
 /* Misc debug stuff */
 static int calls_to_prepare_before_set = 0;
 
-/* Force rgb layers to be rendered to the framebuffer */
+/*
+ * Force rgb layers to be rendered to the framebuffer, they need a Tiler-1D
+ * mapping to be scanned out
+ */
 static int g_force_rgb_to_fb = 1;
 
+/* Overlay info derived for each pipeline */
+static struct pipeline_shadow g_shadow[HWCIMPL_PIPE_MAX];
+
+/* Last composition committed with OMAPDSS_HWC_SET */
+static struct dss_hwc_set_info_container g_committed;
+static int g_committed_valid;
+
+static hwc_dss_commit_stats_t g_commit_stats;
+
 static void dump_layer(int i, hwc_layer_t const* l) {
     IMG_native_handle_t *handle = (IMG_native_handle_t *) l->handle;
 
@@ -176,7 +229,8 @@ static int update_buffer(int pipe_idx, hwc_cached_buffer_t *cbuf, struct dss_hwc
             pipe_dss_info->color_mode = OMAP_DSS_COLOR_YUV2;
             break;
         case HAL_PIXEL_FORMAT_YCbCr_422_I:
-            pipe_dss_info->color_mode = OMAP_DSS_COLOR_UYVY;
+            /* YUYV in memory */
+            pipe_dss_info->color_mode = OMAP_DSS_COLOR_YUV2;
             break;
         default:
             return -EINVAL;
@@ -208,7 +262,7 @@ static int update_buffer(int pipe_idx, hwc_cached_buffer_t *cbuf, struct dss_hwc
     /* from buffer handle: */
     pipe_dss_info->width = layer_buffer->iWidth;
     pipe_dss_info->height = layer_buffer->iHeight;
-    pipe_dss_info->handle = (__u32) cbuf->mapped_ptr;
+    pipe_dss_info->handle = (__u32) (uintptr_t) cbuf->mapped_ptr;
 
     if(cbuf->type == BUF_USER)
         pipe_dss_info->stride = layer_buffer->iWidth * layer_buffer->uiBpp;
@@ -230,6 +284,225 @@ static int update_buffer(int pipe_idx, hwc_cached_buffer_t *cbuf, struct dss_hwc
     return 0;
 }
 
+/* Compare a pipeline's layer with the state its overlay info came from */
+static int get_pipeline_dirty(int pipe_idx, hwc_cached_buffer_t *cbuf)
+{
+    struct pipeline_shadow *shadow = &g_shadow[pipe_idx];
+    hwc_layer_t *layer = g_pipelines[pipe_idx].layer;
+    IMG_native_handle_t *handle = (IMG_native_handle_t*) layer->handle;
+    int dirty = 0;
+
+    if (!shadow->valid)
+        return HWCIMPL_DIRTY_ALL;
+
+    if (shadow->handle != handle || shadow->mapped_ptr != cbuf->mapped_ptr)
+        dirty |= HWCIMPL_DIRTY_BUFFER;
+    if (shadow->format != handle->iFormat || shadow->blending != (int)layer->blending)
+        dirty |= HWCIMPL_DIRTY_FORMAT;
+    if (shadow->transform != (int)layer->transform)
+        dirty |= HWCIMPL_DIRTY_TRANSFORM;
+    if (memcmp(&shadow->display_frame, &layer->displayFrame, sizeof(hwc_rect_t)) ||
+        memcmp(&shadow->source_crop, &layer->sourceCrop, sizeof(hwc_rect_t)))
+        dirty |= HWCIMPL_DIRTY_POSITION;
+    if (shadow->z != g_pipelines[pipe_idx].z)
+        dirty |= HWCIMPL_DIRTY_ZORDER;
+
+    return dirty;
+}
+
+static void save_pipeline_shadow(int pipe_idx, hwc_cached_buffer_t *cbuf,
+                                 struct dss_hwc_ovl_info *pipe_dss_info)
+{
+    struct pipeline_shadow *shadow = &g_shadow[pipe_idx];
+    hwc_layer_t *layer = g_pipelines[pipe_idx].layer;
+    IMG_native_handle_t *handle = (IMG_native_handle_t*) layer->handle;
+
+    shadow->valid = 1;
+    shadow->handle = handle;
+    shadow->mapped_ptr = cbuf->mapped_ptr;
+    shadow->format = handle->iFormat;
+    shadow->blending = layer->blending;
+    shadow->transform = layer->transform;
+    shadow->display_frame = layer->displayFrame;
+    shadow->source_crop = layer->sourceCrop;
+    shadow->z = g_pipelines[pipe_idx].z;
+    shadow->info = *pipe_dss_info;
+}
+
+/*
+ * Bits per pixel of the layer formats the DSS scans out with the right
+ * component order, 0 for the others. The DSS has no layout matching the
+ * RGBA/RGBX 8888, RGB 888, 5551 and 4444 formats of Android
+ */
+static int get_dss_format_bpp(int format)
+{
+    switch (format) {
+        case HAL_PIXEL_FORMAT_NV12:
+            return 12;
+        case HAL_PIXEL_FORMAT_RGB_565:
+        case HAL_PIXEL_FORMAT_YCbCr_422_I:
+            return 16;
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+            return 32;
+        default:
+            return 0;
+    }
+}
+
+static int rects_overlap(const hwc_rect_t *a, const hwc_rect_t *b)
+{
+    return a->left < b->right && b->left < a->right &&
+           a->top < b->bottom && b->top < a->bottom;
+}
+
+/*
+ * Returns the GLES composition bandwidth in bytes a frame saves when the
+ * layer is scanned out by a video pipeline, 0 if no pipeline can take it
+ */
+static unsigned int get_overlay_score(hwc_layer_t *layer, int ignore_rgb)
+{
+    IMG_native_handle_t *handle = (IMG_native_handle_t *) layer->handle;
+    hwc_rect_t *dst = &layer->displayFrame;
+    hwc_rect_t *crop = &layer->sourceCrop;
+
+    if (handle == NULL || (layer->flags & HWC_SKIP_LAYER))
+        return 0;
+
+    /*
+     * Inspect the visible region - 2nd guessing from old
+     * surfaceflinger * behaviour that we might need to ignore
+     * layers which are not visible
+     */
+    hwc_region_t *region = &layer->visibleRegionScreen;
+    if (!region->numRects || !region->rects)
+        return 0;
+
+    /*
+     * Assume that layers with multiple rectangle regions of a single
+     * buffer can't be handled by the DSS
+     */
+    if (region->numRects > 1)
+        return 0;
+
+    int bpp = get_dss_format_bpp(handle->iFormat);
+    if (!bpp)
+        return 0;
+
+    /* Only NV12 buffers are in Tiler-2D, the others have to be mapped */
+    if (handle->iFormat != HAL_PIXEL_FORMAT_NV12) {
+        if (ignore_rgb)
+            return 0;
+        /* rotation and mirroring are only supported for tiler 2D buffers */
+        if (layer->transform)
+            return 0;
+    }
+
+    /* The DSS does not clip, the layer has to be on screen */
+    if (dst->left < 0 || dst->top < 0 ||
+        dst->right > g_displays[0].width || dst->bottom > g_displays[0].height)
+        return 0;
+
+    int dst_w = dst->right - dst->left;
+    int dst_h = dst->bottom - dst->top;
+    int src_w = crop->right - crop->left;
+    int src_h = crop->bottom - crop->top;
+    if (layer->transform & HWC_TRANSFORM_ROT_90) {
+        int tmp = src_w;
+        src_w = src_h;
+        src_h = tmp;
+    }
+
+    if (dst_w <= 0 || dst_h <= 0 || src_w <= 0 || src_h <= 0)
+        return 0;
+
+    if (dst_w > src_w * MAX_UPSCALE || dst_h > src_h * MAX_UPSCALE ||
+        src_w > dst_w * MAX_DOWNSCALE || src_h > dst_h * MAX_DOWNSCALE)
+        return 0;
+
+    /* GLES reads the source and writes the framebuffer, blending reads it too */
+    unsigned int bits = bpp + g_displays[0].bpp;
+    if (layer->blending != HWC_BLENDING_NONE)
+        bits += g_displays[0].bpp;
+
+    return (unsigned int) dst_w * dst_h * bits / 8;
+}
+
+/*
+ * The framebuffer is blended over the overlays with the overlay areas
+ * cleared, so a layer that is not opaque can only go to an overlay when
+ * none of the layers below it that it covers is composited with GLES
+ */
+static int covers_gles_layer(hwc_layer_list_t *list, int n, int *chosen, int num_chosen)
+{
+    hwc_layer_t *layer = &list->hwLayers[n];
+
+    for (int m = 0; m < n; m++) {
+        hwc_layer_t *below = &list->hwLayers[m];
+        int i;
+
+        if (below->handle == NULL || !below->visibleRegionScreen.numRects)
+            continue;
+        if (!rects_overlap(&below->displayFrame, &layer->displayFrame))
+            continue;
+
+        for (i = 0; i < num_chosen && chosen[i] != m; i++)
+            ;
+        if (i == num_chosen)
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Pick the layers saving the most GLES bandwidth for the free pipelines,
+ * chosen holds their indices in layer order on return
+ */
+static int assign_overlays(hwc_layer_list_t *list, int num_pipes, int ignore_rgb, int *chosen)
+{
+    int nlayers = list->numHwLayers;
+    int num_chosen = 0;
+
+    while (num_chosen < num_pipes) {
+        unsigned int best_score = 0;
+        int best = -1;
+
+        for (int n = 0; n < nlayers; n++) {
+            hwc_layer_t *layer = &list->hwLayers[n];
+            int i;
+
+            for (i = 0; i < num_chosen && chosen[i] != n; i++)
+                ;
+            if (i < num_chosen)
+                continue;
+
+            unsigned int score = get_overlay_score(layer, ignore_rgb);
+            if (score <= best_score)
+                continue;
+
+            if (layer->blending != HWC_BLENDING_NONE &&
+                covers_gles_layer(list, n, chosen, num_chosen))
+                continue;
+
+            best = n;
+            best_score = score;
+        }
+
+        if (best < 0)
+            break;
+
+        LOGV("Layer %d saves %u bytes", best, best_score);
+
+        /* keep layer order, it decides the z-order of the pipelines */
+        int i = num_chosen++;
+        for (; i > 0 && chosen[i - 1] > best; i--)
+            chosen[i] = chosen[i - 1];
+        chosen[i] = best;
+    }
+
+    return num_chosen;
+}
+
 /*******************************************************************
  * start implementation of external functions exposed by hwc hal api
  *******************************************************************/
@@ -255,15 +528,14 @@ int prepare_dss_layers(hwc_layer_list_t *list)
 
     if (list->flags & HWC_GEOMETRY_CHANGED) {
         LOGV("PREPARE: Geometry changed, parsing %i ", nlayers);
-        /*
-         * TODO: If the geometry changed we need to unmap buffers
-         * from the layers we used with HWC_OVERLAY previously, a more
-         * sophisticated method would be to have a cache of buffers that have
-         * been mapped before to prevent remapping on every geometry change
-         */
-        unmap_cached_buffers();
     }
 
+    /*
+     * Buffers of layers that went away with a geometry change are
+     * unmapped, the ones still on screen stay in the cache
+     */
+    update_cached_buffers(list->flags & HWC_GEOMETRY_CHANGED);
+
 #ifdef HDMI_DEMO
     /*
      * If external display connected (hdmi) we reserve VID1/OVL1 to UI FB cloning.
@@ -287,67 +559,19 @@ int prepare_dss_layers(hwc_layer_list_t *list)
 
 parse_layers_again:
     int startz = 1;
-
-    for (n=0; n<nlayers; n++) {
-//      LOGV("%i", n); /* Noisy logging */
-        hwc_layer_t *layer = &list->hwLayers[n];
-        IMG_native_handle_t *handle = (IMG_native_handle_t *) layer->handle;
-
-        if (handle == NULL) {
-            LOGV("Null layer: %d", n);
-            continue;
-        }
-
-        if (layer->flags & HWC_SKIP_LAYER) {
-            LOGV("Skipping layer: %d", n);
-            continue;
-        }
-
-        /*
-         * Inspect the visible region - 2nd guessing from old
-         * surfaceflinger * behaviour that we might need to ignore
-         * layers which are not visible
-         */
-        hwc_region_t *region = &layer->visibleRegionScreen;
-
-        if (!region->numRects || !region->rects) {
-            LOGV("DSS skipping layer: %d", n);
-            continue;
-        }
-
-        /*
-         * Assume that layers with multiple rectangle regions of a single
-         * buffer can't be handled by the DSS
-         */
-        if (region->numRects > 1) {
-            LOGV("DSS skip multi rect layer: %d, %d", n, region->numRects);
-            continue;
-        }
-
-        if (handle->iFormat != HAL_PIXEL_FORMAT_NV12) {
-             if (state_ignore_rgb)
-                 continue;
-             /* Valid RGB formats  - this will be expanded later. For now
-                only allow RGB565 */
-             if (handle->iFormat != HAL_PIXEL_FORMAT_RGB_565)
-                 continue;
-        }
-
-        if (!state_ignore_rgb && (next_pipe >= HWCIMPL_PIPE_MAX)) {
-            state_ignore_rgb = 1;
-            goto parse_layers_again;
-        }
-
-        if (next_pipe >= HWCIMPL_PIPE_MAX)
-            break;
-
-        g_pipelines[next_pipe].layer = layer;
+    int chosen[HWCIMPL_PIPE_MAX];
+    int num_chosen = assign_overlays(list, HWCIMPL_PIPE_MAX - g_top_vid_pipe,
+                                     state_ignore_rgb, chosen);
+
+    next_pipe = g_top_vid_pipe;
+    for (int i = 0; i < num_chosen; i++) {
+        n = chosen[i];
+        g_pipelines[next_pipe].layer = &list->hwLayers[n];
         g_pipelines[next_pipe].flags = HWCIMPL_PIPE_INUSE;
         g_pipelines[next_pipe].layer_no = n;
         g_pipelines[next_pipe].z = startz++;
         next_pipe++;
-
-    } /* End parse layer state */
+    }
 
     /* Reset state for the unused pipes */
     int extra_pipes = next_pipe;
@@ -398,6 +622,10 @@ parse_layers_again:
         goto end_fb; /* No pipelines used */
     }
 
+    /*
+     * Map every chosen buffer before any layer is handed to an overlay, a
+     * retry without the RGB layers must not leave one marked from this pass
+     */
     for (next_pipe = g_top_vid_pipe; next_pipe <= last_pipe; next_pipe++) {
         hwc_cached_buffer_t cbuf;
         hwc_layer_t *layer = g_pipelines[next_pipe].layer;
@@ -421,6 +649,18 @@ parse_layers_again:
                 }
             }
         }
+    }
+
+    for (next_pipe = g_top_vid_pipe; next_pipe <= last_pipe; next_pipe++) {
+        hwc_cached_buffer_t cbuf;
+        hwc_layer_t *layer = g_pipelines[next_pipe].layer;
+        if (!layer)
+            break;
+
+        /* an unmapped buffer stays with GLES, set has no pipeline for it */
+        if (get_cached_buffer(layer, &cbuf) < 0)
+            continue;
+
         LOGV("Going to ovl");
         layer->compositionType = HWC_OVERLAY;
         if(clear_fb)
@@ -474,7 +714,7 @@ int set_dss_layers(hwc_layer_list_t *list)
     int next_pipe = g_top_vid_pipe;
 
     /* All these are OVERLAY layers */
-    while (g_pipelines[next_pipe].layer) {
+    while (next_pipe < HWCIMPL_PIPE_MAX && g_pipelines[next_pipe].layer) {
 
         hwc_cached_buffer_t cbuf;
         hwc_layer_t *layer = g_pipelines[next_pipe].layer;
@@ -486,12 +726,22 @@ int set_dss_layers(hwc_layer_list_t *list)
             /* No failure mode for this, SurfaceFlinger has started off
                the rendering of the FB layers already */
         } else {
-            int err = update_buffer(next_pipe, &cbuf, s->ovls+n_ovls);
-            if (err)
-                LOGE("Error presenting buffer %p", cbuf.layer_buffer);
-            else{
-                LOGV("Updated buffer %p", cbuf.layer_buffer);
-                n_ovls++;
+            int dirty = get_pipeline_dirty(next_pipe, &cbuf);
+            if (!dirty) {
+                /* same layer state as last frame, reuse its overlay info */
+                s->ovls[n_ovls++] = g_shadow[next_pipe].info;
+                g_commit_stats.reused++;
+            } else {
+                LOGV("Pipe %d dirty %02x", next_pipe, dirty);
+                int err = update_buffer(next_pipe, &cbuf, s->ovls+n_ovls);
+                if (err) {
+                    LOGE("Error presenting buffer %p", cbuf.layer_buffer);
+                    g_shadow[next_pipe].valid = 0;
+                } else {
+                    LOGV("Updated buffer %p", cbuf.layer_buffer);
+                    save_pipeline_shadow(next_pipe, &cbuf, s->ovls+n_ovls);
+                    n_ovls++;
+                }
             }
         }
         next_pipe++;
@@ -504,9 +754,29 @@ int set_dss_layers(hwc_layer_list_t *list)
         LOGV("mgr(dis%d alpha=%d col=%08x ilace=%d)\n", s->mgr.ix, s->mgr.alpha_blending, s->mgr.default_color, s->mgr.interlaced);
         LOGV("set(udpate%d x=%d y=%d w=%d h=%d num_ovls=%d)\n", s->update, s->x, s->y, s->w, s->h, s->num_ovls);
 
-        ret = ioctl(g_devfd, OMAPDSS_HWC_SET, s);
-        if(ret)
-            LOGE("Error OMAPDSS_HWC_SET %d", ret);
+        /*
+         * The DSS keeps showing the last composition, only commit when
+         * something changed. Both containers are zeroed before being
+         * filled so they compare equal when the settings are.
+         */
+        if (g_committed_valid && !memcmp(&g_committed, &setinfo, sizeof(setinfo))) {
+            LOGV("Skipping unchanged OMAPDSS_HWC_SET");
+            g_commit_stats.skipped++;
+            commit_cached_buffers();
+        } else {
+            hwc_stats_dss_begin();
+            ret = ioctl(g_devfd, OMAPDSS_HWC_SET, s);
+            hwc_stats_dss_end();
+            g_commit_stats.issued++;
+            if(ret) {
+                LOGE("Error OMAPDSS_HWC_SET %d", ret);
+                g_committed_valid = 0;
+            } else {
+                memcpy(&g_committed, &setinfo, sizeof(setinfo));
+                g_committed_valid = 1;
+                commit_cached_buffers();
+            }
+        }
 
 #ifdef HDMI_DEMO
         if (list->flags & HWC_EXTERNAL_DISPLAY_CONNECTED) {
@@ -535,10 +805,25 @@ int set_dss_layers(hwc_layer_list_t *list)
 #endif
     }
 
+    /* nothing committed, the next composition always goes to the DSS */
+    if (n_ovls == 0)
+        g_committed_valid = 0;
 
     return ret;
 }
 
+void get_dss_commit_stats(hwc_dss_commit_stats_t *stats)
+{
+    *stats = g_commit_stats;
+}
+
+void get_dss_display_info(int *width, int *height, int *bpp)
+{
+    *width = g_displays[0].width;
+    *height = g_displays[0].height;
+    *bpp = g_displays[0].bpp;
+}
+
 /*
  * Called when the HWC is opened
  */
@@ -574,9 +859,17 @@ int init_hwc_dss()
     /* Main display only */
     g_displays[0].width = fb_var.xres;
     g_displays[0].height = fb_var.yres;
+    g_displays[0].bpp = fb_var.bits_per_pixel;
 
     LOGD("Display size is x = %i, y = %i", g_displays[0].width, g_displays[0].height);
 
+    char value[PROPERTY_VALUE_MAX];
+    property_get(RGB_OVERLAYS_PROPERTY, value, "0");
+    g_force_rgb_to_fb = !atoi(value);
+
+    memset(g_shadow, 0, sizeof(g_shadow));
+    g_committed_valid = 0;
+
     init_cached_buffers();
 end:
     if (rv != 0 && g_devfd)
@@ -590,6 +883,9 @@ end:
 int deinit_hwc_dss()
 {
     /* TODO: Wait here until all buffers have been released */
+    unmap_cached_buffers();
+    hwc_hdmi_deinit();
+
     if (g_devfd >= 0)
         close(g_devfd);
     return 0;
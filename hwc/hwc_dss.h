@@ -46,9 +46,17 @@
 #define FB_DEV_NAME "/dev/graphics/fb0"
 #define FB_DEV_NAME_FALLBACK "/dev/graphics/fb0"
 
+typedef struct hwc_dss_commit_stats {
+    unsigned int issued;    /* OMAPDSS_HWC_SET ioctls sent */
+    unsigned int skipped;   /* compositions identical to the last one sent */
+    unsigned int reused;    /* overlays whose info was not derived again */
+} hwc_dss_commit_stats_t;
+
 int init_hwc_dss(void);
 int deinit_hwc_dss(void);
 int prepare_dss_layers(hwc_layer_list_t *list);
 int set_dss_layers(hwc_layer_list_t *list);
+void get_dss_commit_stats(hwc_dss_commit_stats_t *stats);
+void get_dss_display_info(int *width, int *height, int *bpp);
 
 #endif // _HWC_DSS_H
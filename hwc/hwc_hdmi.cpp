@@ -22,9 +22,15 @@
 #include <errno.h>
 
 #include <fcntl.h>
+#include <limits.h>
 #include <sys/ioctl.h>
 #include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <utils/Timers.h>
 
 #include "hwc_hdmi.h"
 #include "hwc_priv.h"
@@ -42,16 +48,16 @@
  * 5. For cloning of fb0 on Overlay1, fb1 is switched off.
  */
 
-const char fb0Overlays [PATH_MAX] = "/sys/class/graphics/fb0/overlays";
-const char fb1Overlays [PATH_MAX] = "/sys/class/graphics/fb1/overlays";
-const char fb0FitToScreenOption[PATH_MAX] = "/sys/class/graphics/fb0/fit_to_screen";
-
-const char overlay1Manager[PATH_MAX] = "/sys/devices/platform/omapdss/overlay1/manager";
-const char overlay1Alpha[PATH_MAX]   = "/sys/devices/platform/omapdss/overlay1/global_alpha";
-const char overlay1Enabled[PATH_MAX] = "/sys/devices/platform/omapdss/overlay1/enabled";
-const char overlay1ZOrder[PATH_MAX]  = "/sys/devices/platform/omapdss/overlay1/zorder";
+/*
+ * The sysfs attributes used for cloning are opened on first use and kept
+ * open. Their last known contents are cached so writes that would not
+ * change anything are skipped. A clone configuration is applied as one
+ * transaction: the attributes are read back first, written in order,
+ * and the writes already done are undone if one fails.
+ */
 
-const char overlay3Enabled[PATH_MAX] = "/sys/devices/platform/omapdss/overlay3/enabled";
+/* Longest attribute value cached */
+#define SYSFS_VALUE_MAX 16
 
 enum displayId {
     DISPLAYID_NONE = -1,
@@ -66,24 +72,209 @@ enum OverlayZorder {
     OMAP_DSS_OVL_ZORDER_3 = 0x3,
 };
 
+enum sysfs_attr_id {
+    ATTR_FB0_OVERLAYS = 0,
+    ATTR_FB1_OVERLAYS,
+    ATTR_FB0_FIT_TO_SCREEN,
+    ATTR_OVERLAY1_MANAGER,
+    ATTR_OVERLAY1_ENABLED,
+    ATTR_OVERLAY1_ZORDER,
+    ATTR_OVERLAY3_ENABLED,
+    ATTR_MAX,
+};
 
-int sysfile_write(const char* pathname, const void* buf, size_t size) {
-    int fd = open(pathname, O_WRONLY);
-    if (fd == -1) {
-        LOGE("Can't open [%s]", pathname);
-        return -1;
+struct sysfs_attr {
+    const char *path;
+    int fd;
+    int readable;
+    int known;      /* value holds the contents of the attribute */
+    char value[SYSFS_VALUE_MAX];
+};
+
+struct sysfs_write {
+    int attr;
+    const char *value;
+};
+
+static struct sysfs_attr g_attrs[ATTR_MAX] = {
+    { "/sys/class/graphics/fb0/overlays", -1, 0, 0, "" },
+    { "/sys/class/graphics/fb1/overlays", -1, 0, 0, "" },
+    { "/sys/class/graphics/fb0/fit_to_screen", -1, 0, 0, "" },
+    { "/sys/devices/platform/omapdss/overlay1/manager", -1, 0, 0, "" },
+    { "/sys/devices/platform/omapdss/overlay1/enabled", -1, 0, 0, "" },
+    { "/sys/devices/platform/omapdss/overlay1/zorder", -1, 0, 0, "" },
+    { "/sys/devices/platform/omapdss/overlay3/enabled", -1, 0, 0, "" },
+};
+
+/* Clone fb0 on overlay1 to the TV, fb1 loses its overlay */
+static const struct sysfs_write g_clone_to_tv[] = {
+    { ATTR_OVERLAY1_ENABLED, "0" },
+    { ATTR_OVERLAY1_MANAGER, "tv" },
+    { ATTR_FB1_OVERLAYS, "" },
+    { ATTR_FB0_OVERLAYS, "0,1" },
+    { ATTR_FB0_FIT_TO_SCREEN, "1" },
+    { ATTR_OVERLAY1_ZORDER, "0" },     /* OMAP_DSS_OVL_ZORDER_0 */
+    { ATTR_OVERLAY1_ENABLED, "1" },
+};
+
+/* Give overlay1 back to fb1 on the secondary LCD */
+static const struct sysfs_write g_clone_stop[] = {
+    { ATTR_OVERLAY1_ENABLED, "0" },
+    { ATTR_FB0_OVERLAYS, "0" },
+    { ATTR_FB0_FIT_TO_SCREEN, "0" },
+    { ATTR_FB1_OVERLAYS, "1" },
+    { ATTR_OVERLAY1_MANAGER, "2lcd" },
+};
+
+static const struct sysfs_write g_disable_ext_video[] = {
+    { ATTR_OVERLAY3_ENABLED, "0" },
+};
+
+#define MAX_TRANSACTION_WRITES 8
+
+static char g_sysfs_root[PROPERTY_VALUE_MAX];
+static int g_sysfs_root_read;
+
+static hwc_hdmi_stats_t g_hdmi_stats;
+static nsecs_t g_clone_start;
+static int g_clone_frame_pending;
+
+/* Strip the newline and terminator sysfs adds when reading back */
+static void sysfs_trim(char *value, ssize_t len)
+{
+    while (len > 0 && (value[len - 1] == '\n' || value[len - 1] == '\0'))
+        len--;
+    value[len] = '\0';
+}
+
+static int sysfs_open(struct sysfs_attr *attr)
+{
+    char path[PATH_MAX];
+
+    if (attr->fd >= 0)
+        return 0;
+
+    /* tests point this at a fake tree */
+    if (!g_sysfs_root_read) {
+        property_get(HWC_HDMI_SYSFS_ROOT_PROPERTY, g_sysfs_root, "");
+        g_sysfs_root_read = 1;
     }
-    size_t written_size = write(fd, buf, size);
-    if (written_size < size) {
-        LOGE("Can't write [%s]", pathname);
-        close(fd);
+    snprintf(path, sizeof(path), "%s%s", g_sysfs_root, attr->path);
+
+    attr->readable = 1;
+    attr->fd = open(path, O_RDWR);
+    if (attr->fd < 0 && errno == EACCES) {
+        attr->readable = 0;
+        attr->fd = open(path, O_WRONLY);
+    }
+
+    if (attr->fd < 0) {
+        LOGE("Can't open [%s]: %s", path, strerror(errno));
+        g_hdmi_stats.failures++;
         return -1;
     }
-    if (close(fd) == -1) {
-        LOGE("cant close [%s]", pathname);
+
+    attr->known = 0;
+    return 0;
+}
+
+/* Read the current contents, someone else may have changed them */
+static void sysfs_refresh(struct sysfs_attr *attr)
+{
+    char value[SYSFS_VALUE_MAX + 1];
+
+    attr->known = 0;
+    if (!attr->readable)
+        return;
+
+    ssize_t len = pread(attr->fd, value, SYSFS_VALUE_MAX, 0);
+    if (len < 0 || len == SYSFS_VALUE_MAX)
+        return;
+
+    sysfs_trim(value, len);
+    strcpy(attr->value, value);
+    attr->known = 1;
+}
+
+static int sysfs_store(struct sysfs_attr *attr, const char *value)
+{
+    /* the terminator is written too, so the empty string is a write */
+    size_t size = strlen(value) + 1;
+
+    if (pwrite(attr->fd, value, size, 0) < (ssize_t) size) {
+        LOGE("Can't write [%s] = %s: %s", attr->path, value, strerror(errno));
+        attr->known = 0;
+        g_hdmi_stats.failures++;
         return -1;
     }
+
+    if (size <= SYSFS_VALUE_MAX) {
+        strcpy(attr->value, value);
+        attr->known = 1;
+    } else {
+        attr->known = 0;
+    }
+    g_hdmi_stats.writes++;
+    return 0;
+}
+
+/*
+ * Apply the writes in order. On failure the writes done so far are undone
+ * in reverse order, as far as the previous values are known
+ */
+static int sysfs_apply(const struct sysfs_write *writes, int count)
+{
+    struct {
+        int attr;
+        int known;
+        char value[SYSFS_VALUE_MAX];
+    } undo[MAX_TRANSACTION_WRITES];
+    int done = 0;
+    int i;
+
+    if (count > MAX_TRANSACTION_WRITES)
+        return -EINVAL;
+
+    for (i = 0; i < count; i++) {
+        if (sysfs_open(&g_attrs[writes[i].attr]))
+            goto rollback;
+    }
+
+    for (i = 0; i < ATTR_MAX; i++) {
+        if (g_attrs[i].fd >= 0)
+            sysfs_refresh(&g_attrs[i]);
+    }
+
+    for (i = 0; i < count; i++) {
+        struct sysfs_attr *attr = &g_attrs[writes[i].attr];
+
+        if (attr->known && !strcmp(attr->value, writes[i].value)) {
+            g_hdmi_stats.skipped++;
+            continue;
+        }
+
+        undo[done].attr = writes[i].attr;
+        undo[done].known = attr->known;
+        strcpy(undo[done].value, attr->value);
+
+        if (sysfs_store(attr, writes[i].value))
+            goto rollback;
+        done++;
+    }
+
     return 0;
+
+rollback:
+    g_hdmi_stats.rollbacks++;
+    while (done-- > 0) {
+        struct sysfs_attr *attr = &g_attrs[undo[done].attr];
+        if (!undo[done].known) {
+            LOGE("Can't restore [%s], previous value unknown", attr->path);
+            continue;
+        }
+        sysfs_store(attr, undo[done].value);
+    }
+    return -1;
 }
 
 /**
@@ -99,65 +290,34 @@ int sysfile_write(const char* pathname, const void* buf, size_t size) {
 static void clone_ui2HDMI(int displayId) {
     LOGD("UiCloningService_CloneUiToDisplay : DisplayId= [%d]", displayId);
 
+    const struct sysfs_write *writes;
+    int count;
+
     // Clone UI on Other Display
     if(displayId == DISPLAYID_TVHDMI) {
-        if (sysfile_write(overlay1Enabled, "0", sizeof("0")) < 0) {
-            LOGE("Failed to set overlay1/enabled = 0");
-            goto end;
-        }
-        if (sysfile_write(overlay1Manager, "tv", sizeof("tv")) < 0) {
-            LOGE("Failed to set overlay/manager = tv");
-            goto end;
-        }
-        if (sysfile_write(fb1Overlays, "", sizeof("")) < 0) {
-            LOGE("Failed to set fb1/overlays = NULL");
-            goto end;
-        }
-        if (sysfile_write(fb0Overlays, "0,1", sizeof("0,2")) < 0) {
-            LOGE("Failed to set fb0/overlays = 0,1");
-            goto end;
-        }
-        if (sysfile_write(fb0FitToScreenOption, "1", sizeof("1")) < 0) {
-            LOGE("Failed to set fb0/fit_to_screen = 1");
-            goto end;
-        }
-        char overlay1ZOrderValue[5];
-        sprintf(overlay1ZOrderValue, "%d", OMAP_DSS_OVL_ZORDER_0);
-        if (sysfile_write(overlay1ZOrder, overlay1ZOrderValue, sizeof("1")) < 0) {
-            LOGE("Failed to set overlay1/zorder = 0");
-            goto end;
-        }
-        if (sysfile_write(overlay1Enabled, "1", sizeof("1")) < 0) {
-            LOGE("Failed to set overlay1/enabled = 1");
-            goto end;
-        }
+        writes = g_clone_to_tv;
+        count = sizeof(g_clone_to_tv) / sizeof(g_clone_to_tv[0]);
     }
     // Stop cloning UI on Other Display
     else if(displayId == DISPLAYID_NONE) {
-        if (sysfile_write(overlay1Enabled, "0", sizeof("0")) < 0) {
-            LOGE("Failed to set overlay1/enabled = 0");
-            goto end;
-        }
-        if (sysfile_write(fb0Overlays, "0", sizeof("0")) < 0) {
-            LOGE("Failed to set fb0/overlays = 0");
-            goto end;
-        }
-        if (sysfile_write(fb0FitToScreenOption, "0", sizeof("0")) < 0) {
-            LOGE("Failed to set fb0/fit_to_screen = 0");
-            goto end;
-        }
-        if (sysfile_write(fb1Overlays, "1", sizeof("1")) < 0) {
-            LOGE("Failed to set fb1/overlays = 1");
-            goto end;
-        }
-        if (sysfile_write(overlay1Manager, "2lcd", sizeof("2lcd")) < 0) {
-            LOGE("Failed to restore overlay/manager = 2lcd");
-            goto end;
-        }
+        writes = g_clone_stop;
+        count = sizeof(g_clone_stop) / sizeof(g_clone_stop[0]);
+    }
+    else {
+        return;
+    }
+
+    g_clone_start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (sysfs_apply(writes, count)) {
+        LOGE("Failed to %s UI cloning", displayId == DISPLAYID_NONE ? "stop" : "start");
+        g_clone_frame_pending = 0;
+        return;
     }
 
-end:
-    return;
+    g_hdmi_stats.changes++;
+    g_hdmi_stats.last_apply_ns = systemTime(SYSTEM_TIME_MONOTONIC) - g_clone_start;
+    g_clone_frame_pending = 1;
 }
 
 
@@ -183,7 +343,36 @@ int hwc_hdmi_clone(bool isStart)
 
 void disable_ext_video()
 {
-    if (sysfile_write(overlay3Enabled, "0", sizeof("0")) < 0) {
-        LOGE("Failed to set overlay1/enabled = 0");
+    if (sysfs_apply(g_disable_ext_video, 1) < 0) {
+        LOGE("Failed to set overlay3/enabled = 0");
+    }
+}
+
+void hwc_hdmi_frame_done(void)
+{
+    if (!g_clone_frame_pending)
+        return;
+
+    g_clone_frame_pending = 0;
+    g_hdmi_stats.last_first_frame_ns = systemTime(SYSTEM_TIME_MONOTONIC) - g_clone_start;
+
+    LOGI("HDMI clone change: sysfs %d us, first frame after %d us",
+         (int)ns2us(g_hdmi_stats.last_apply_ns),
+         (int)ns2us(g_hdmi_stats.last_first_frame_ns));
+}
+
+void get_hdmi_stats(hwc_hdmi_stats_t *stats)
+{
+    *stats = g_hdmi_stats;
+}
+
+void hwc_hdmi_deinit(void)
+{
+    for (int i = 0; i < ATTR_MAX; i++) {
+        if (g_attrs[i].fd >= 0)
+            close(g_attrs[i].fd);
+        g_attrs[i].fd = -1;
+        g_attrs[i].known = 0;
     }
+    g_sysfs_root_read = 0;
 }
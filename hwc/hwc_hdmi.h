@@ -23,13 +23,41 @@
 #ifndef _HWC_HDMI_H
 #define _HWC_HDMI_H
 
+#include <utils/Timers.h>
+
 
 
 /*
- *
+ * UI cloning to the TV through the omapdss sysfs attributes
  */
 
+/* Prefix for the sysfs paths, for testing against a fake tree */
+#define HWC_HDMI_SYSFS_ROOT_PROPERTY "debug.hwc.hdmi.sysfs_root"
+
+typedef struct hwc_hdmi_stats {
+    unsigned int changes;       /* clone configurations applied */
+    unsigned int writes;        /* sysfs writes done */
+    unsigned int skipped;       /* writes of the current value left out */
+    unsigned int failures;
+    unsigned int rollbacks;
+    nsecs_t last_apply_ns;      /* sysfs time of the last change */
+    nsecs_t last_first_frame_ns;    /* last change to the next frame set */
+} hwc_hdmi_stats_t;
+
 int hwc_hdmi_clone(bool isStart);
 void disable_ext_video();
 
+/*
+ * Called after each frame is set, reports the time from a clone change
+ * to the first frame shown with it
+ */
+void hwc_hdmi_frame_done(void);
+
+void get_hdmi_stats(hwc_hdmi_stats_t *stats);
+
+/*
+ * Close the cached sysfs files. Called when the HWC is closed
+ */
+void hwc_hdmi_deinit(void);
+
 #endif // _HWC_HDMI_H
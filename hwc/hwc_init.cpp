@@ -21,6 +21,8 @@
 
 #include <fcntl.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <hardware/hardware.h>
 //#include <hardware/overlay.h>
@@ -28,6 +30,8 @@
 
 #include "hwc_priv.h"
 #include "hwc_dss.h"
+#include "hwc_stats.h"
+#include "hwc_capture.h"
 
 static int hwc_device_open(const hw_module_t* module, const char* name,
                 hw_device_t** device);
@@ -61,6 +65,8 @@ static int hwc_device_close(hw_device_t* device)
     if (hwc_device)
         free(hwc_device);
 
+    hwc_capture_deinit();
+
     return deinit_hwc_dss();
 }
 
@@ -85,10 +91,14 @@ int hwc_device_open(const hw_module_t* module, const char* name,
         hwc_device->base.common.close = hwc_device_close;
         hwc_device->base.prepare = ti_hwc_prepare;
         hwc_device->base.set = ti_hwc_set;
+        hwc_device->base.dump = ti_hwc_dump;
         *device = &hwc_device->base.common;
 
         check_showfps();
+        hwc_stats_init();
         rv = init_hwc_dss();
+        if (rv == 0)
+            hwc_capture_init();
     }
 
     return rv;
@@ -41,6 +41,8 @@ int ti_hwc_prepare(struct hwc_composer_device *dev,
 int ti_hwc_set(struct hwc_composer_device *dev, hwc_display_t dpy,
                hwc_surface_t sur, hwc_layer_list_t* list);
 
+void ti_hwc_dump(struct hwc_composer_device *dev, char *buff, int buff_len);
+
 void check_showfps(void);
 
 #ifndef HAL_PIXEL_FORMAT_NV12
@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <utils/Timers.h>
+
+#include "hwc_priv.h"
+#include "hwc_stats.h"
+#include "hwc_buffers.h"
+#include "hwc_dss.h"
+#include "hwc_hdmi.h"
+
+/*
+ * Intervals longer than this many budgets mean the screen was idle,
+ * SurfaceFlinger only composes when something changed
+ */
+#define HWC_STATS_IDLE_BUDGETS 4
+
+enum {
+    HWC_STAGE_PREPARE = 0,
+    HWC_STAGE_SET,
+    HWC_STAGE_DSS,
+    HWC_STAGE_SWAP,
+    HWC_STAGE_TOTAL,
+    HWC_STAGE_INTERVAL,
+    HWC_STAGE_MAX,
+};
+
+static const char *g_stage_names[HWC_STAGE_MAX] = {
+    "prepare",
+    "set",
+    "dss ioctl",
+    "swap",
+    "total",
+    "interval",
+};
+
+/* Written by the composition thread, read by dump under g_stats_lock */
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static hwc_frame_stats_t g_frames[HWC_STATS_FRAMES];
+static unsigned int g_frame_count;
+static unsigned int g_janks;
+static unsigned int g_over_budget;
+
+/* Frame being composed, only touched by the composition thread */
+static hwc_frame_stats_t g_current;
+static nsecs_t g_last_set_end;
+
+static nsecs_t g_budget = us2ns(HWC_STATS_DEFAULT_BUDGET_US);
+static int g_log_every;
+static char g_stats_file[PROPERTY_VALUE_MAX];
+
+/*
+ * The periodic report is logged and saved by a writer thread so the file
+ * I/O never runs on the composition thread. Requests made while the writer
+ * is still busy are merged into one.
+ */
+static pthread_cond_t g_report_cond = PTHREAD_COND_INITIALIZER;
+static int g_report_pending;
+static pthread_t g_report_thread;
+static int g_report_started;
+
+static nsecs_t stage_time(const hwc_frame_stats_t *f, int stage)
+{
+    switch (stage) {
+        case HWC_STAGE_PREPARE:
+            return f->prepare_end - f->prepare_start;
+        case HWC_STAGE_SET:
+            return f->set_end - f->set_start;
+        case HWC_STAGE_DSS:
+            return f->dss_start ? f->dss_end - f->dss_start : 0;
+        case HWC_STAGE_SWAP:
+            /* eglSwapBuffers follows the DSS update in set */
+            return f->set_end - (f->dss_start ? f->dss_end : f->set_start);
+        case HWC_STAGE_TOTAL:
+            return f->set_end - f->prepare_start;
+        case HWC_STAGE_INTERVAL:
+            return f->interval;
+        default:
+            return 0;
+    }
+}
+
+static void *report_thread(void *arg)
+{
+    char buff[1024];
+
+    for (;;) {
+        pthread_mutex_lock(&g_stats_lock);
+        while (!g_report_pending)
+            pthread_cond_wait(&g_report_cond, &g_stats_lock);
+        g_report_pending = 0;
+        pthread_mutex_unlock(&g_stats_lock);
+
+        hwc_stats_dump(buff, sizeof(buff));
+
+        /* logcat truncates long messages, log line by line */
+        char *save = NULL;
+        for (char *line = strtok_r(buff, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+            LOGI("%s", line);
+
+        if (g_stats_file[0])
+            hwc_stats_save(g_stats_file);
+    }
+
+    return NULL;
+}
+
+static int compare_nsecs(const void *a, const void *b)
+{
+    nsecs_t x = *(const nsecs_t *)a;
+    nsecs_t y = *(const nsecs_t *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+void hwc_stats_init(void)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(HWC_STATS_PROPERTY, value, "0");
+    g_log_every = atoi(value);
+
+    property_get(HWC_STATS_BUDGET_PROPERTY, value, "0");
+    if (atoi(value) > 0)
+        g_budget = us2ns(atoi(value));
+
+    property_get(HWC_STATS_FILE_PROPERTY, g_stats_file, "");
+
+    LOGI_IF(g_log_every, "frame stats every %d frames, budget %d us",
+            g_log_every, (int)ns2us(g_budget));
+
+    /* the HWC may be reopened, the writer outlives it */
+    if (g_log_every > 0 && !g_report_started) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&g_report_thread, &attr, report_thread, NULL) == 0)
+            g_report_started = 1;
+        else
+            LOGE("unable to start the frame stats writer, reports disabled");
+        pthread_attr_destroy(&attr);
+    }
+}
+
+void hwc_stats_prepare_begin(void)
+{
+    memset(&g_current, 0, sizeof(g_current));
+    g_current.prepare_start = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void hwc_stats_prepare_end(hwc_layer_list_t *list)
+{
+    g_current.prepare_end = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (list == NULL)
+        return;
+
+    g_current.num_layers = list->numHwLayers;
+    for (size_t n = 0; n < list->numHwLayers; n++) {
+        if (list->hwLayers[n].compositionType == HWC_OVERLAY) {
+            g_current.num_overlay++;
+            if (n < sizeof(g_current.overlay_mask) * 8)
+                g_current.overlay_mask |= 1U << n;
+        } else {
+            hwc_rect_t *frame = &list->hwLayers[n].displayFrame;
+            g_current.num_fb++;
+            g_current.fb_pixels += (frame->right - frame->left) * (frame->bottom - frame->top);
+        }
+    }
+}
+
+void hwc_stats_set_begin(void)
+{
+    g_current.set_start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    /* set without a prepare, e.g. when the screen is turned off */
+    if (!g_current.prepare_start)
+        g_current.prepare_start = g_current.prepare_end = g_current.set_start;
+}
+
+void hwc_stats_dss_begin(void)
+{
+    g_current.dss_start = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void hwc_stats_dss_end(void)
+{
+    g_current.dss_end = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void hwc_stats_set_end(void)
+{
+    g_current.set_end = systemTime(SYSTEM_TIME_MONOTONIC);
+    g_current.interval = g_last_set_end ? g_current.set_end - g_last_set_end : 0;
+    g_last_set_end = g_current.set_end;
+
+    pthread_mutex_lock(&g_stats_lock);
+
+    g_frames[g_frame_count & (HWC_STATS_FRAMES - 1)] = g_current;
+    g_frame_count++;
+
+    if (g_current.interval > g_budget + g_budget / 2 &&
+        g_current.interval <= g_budget * HWC_STATS_IDLE_BUDGETS)
+        g_janks++;
+
+    if (stage_time(&g_current, HWC_STAGE_TOTAL) > g_budget)
+        g_over_budget++;
+
+    if (g_report_started && (g_frame_count % g_log_every) == 0) {
+        g_report_pending = 1;
+        pthread_cond_signal(&g_report_cond);
+    }
+
+    pthread_mutex_unlock(&g_stats_lock);
+
+    memset(&g_current, 0, sizeof(g_current));
+}
+
+int hwc_stats_dump(char *buff, int buff_len)
+{
+    hwc_frame_stats_t frames[HWC_STATS_FRAMES];
+    nsecs_t values[HWC_STATS_FRAMES];
+    hwc_buffer_stats_t bstats;
+    hwc_dss_commit_stats_t cstats;
+    hwc_hdmi_stats_t hstats;
+    unsigned int count, janks, over_budget;
+    int len = 0;
+
+    if (buff == NULL || buff_len <= 0)
+        return 0;
+
+    pthread_mutex_lock(&g_stats_lock);
+    count = g_frame_count;
+    janks = g_janks;
+    over_budget = g_over_budget;
+    memcpy(frames, g_frames, sizeof(frames));
+    pthread_mutex_unlock(&g_stats_lock);
+
+    get_cached_buffer_stats(&bstats);
+    get_dss_commit_stats(&cstats);
+    get_hdmi_stats(&hstats);
+
+    int n = count < HWC_STATS_FRAMES ? count : HWC_STATS_FRAMES;
+    int overlay = 0, fb = 0;
+    unsigned long long fb_pixels = 0;
+    for (int i = 0; i < n; i++) {
+        overlay += frames[i].num_overlay;
+        fb += frames[i].num_fb;
+        fb_pixels += frames[i].fb_pixels;
+    }
+
+    len += snprintf(buff + len, buff_len - len,
+            "Frame stats: %u frames, budget %d us, %u janks, %u over budget\n",
+            count, (int)ns2us(g_budget), janks, over_budget);
+
+    if (n && len < buff_len) {
+        len += snprintf(buff + len, buff_len - len,
+                "  last %d frames: %d.%02d overlay, %d.%02d gles layers, %u gles pixels per frame\n",
+                n, overlay / n, (overlay * 100 / n) % 100, fb / n, (fb * 100 / n) % 100,
+                (unsigned int)(fb_pixels / n));
+    }
+
+    if (n && len < buff_len) {
+        len += snprintf(buff + len, buff_len - len,
+                "  %-10s %8s %8s %8s %8s (us)\n", "stage", "p50", "p90", "p99", "max");
+    }
+
+    for (int stage = 0; n && stage < HWC_STAGE_MAX && len < buff_len; stage++) {
+        int k = 0;
+        for (int i = 0; i < n; i++) {
+            /* frames without an overlay update or a previous frame */
+            if ((stage == HWC_STAGE_DSS && !frames[i].dss_start) ||
+                (stage == HWC_STAGE_INTERVAL && !frames[i].interval))
+                continue;
+            values[k++] = stage_time(&frames[i], stage);
+        }
+        if (!k)
+            continue;
+
+        qsort(values, k, sizeof(values[0]), compare_nsecs);
+        len += snprintf(buff + len, buff_len - len,
+                "  %-10s %8d %8d %8d %8d\n", g_stage_names[stage],
+                (int)ns2us(values[k / 2]), (int)ns2us(values[k * 9 / 10]),
+                (int)ns2us(values[k * 99 / 100]), (int)ns2us(values[k - 1]));
+    }
+
+    if (len < buff_len) {
+        len += snprintf(buff + len, buff_len - len,
+                "Tiler-1D mappings: %u mapped, %u hits, %u misses, %u maps, "
+                "%u unmaps, %u evictions, %u failures\n",
+                bstats.mapped, bstats.hits, bstats.misses, bstats.maps,
+                bstats.unmaps, bstats.evictions, bstats.failures);
+    }
+
+    if (len < buff_len) {
+        len += snprintf(buff + len, buff_len - len,
+                "DSS commits: %u issued, %u skipped, %u overlays reused\n",
+                cstats.issued, cstats.skipped, cstats.reused);
+    }
+
+    if (hstats.changes && len < buff_len) {
+        len += snprintf(buff + len, buff_len - len,
+                "HDMI clone: %u changes, last sysfs %d us, first frame %d us, "
+                "%u writes, %u skipped, %u failures, %u rollbacks\n",
+                hstats.changes, (int)ns2us(hstats.last_apply_ns),
+                (int)ns2us(hstats.last_first_frame_ns), hstats.writes,
+                hstats.skipped, hstats.failures, hstats.rollbacks);
+    }
+
+    return len < buff_len ? len : buff_len - 1;
+}
+
+int hwc_stats_save(const char *path)
+{
+    hwc_frame_stats_t frames[HWC_STATS_FRAMES];
+    char tmp_path[PATH_MAX];
+    unsigned int count;
+    int rv = 0;
+
+    pthread_mutex_lock(&g_stats_lock);
+    count = g_frame_count;
+    memcpy(frames, g_frames, sizeof(frames));
+    pthread_mutex_unlock(&g_stats_lock);
+
+    /* write to a temporary file first so readers never see a partial trace */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "w");
+    if (f == NULL) {
+        rv = -errno;
+        LOGE("unable to create %s: %s", tmp_path, strerror(errno));
+        return rv;
+    }
+
+    fprintf(f, "frame,prepare_start_ns,prepare_us,set_us,dss_us,swap_us,"
+               "total_us,interval_us,layers,overlay,gles,gles_pixels,overlay_mask\n");
+
+    unsigned int first = count > HWC_STATS_FRAMES ? count - HWC_STATS_FRAMES : 0;
+    for (unsigned int i = first; i < count; i++) {
+        const hwc_frame_stats_t *fr = &frames[i & (HWC_STATS_FRAMES - 1)];
+        fprintf(f, "%u,%lld,%d,%d,%d,%d,%d,%d,%d,%d,%d,%u,%08x\n", i,
+                (long long)fr->prepare_start,
+                (int)ns2us(stage_time(fr, HWC_STAGE_PREPARE)),
+                (int)ns2us(stage_time(fr, HWC_STAGE_SET)),
+                (int)ns2us(stage_time(fr, HWC_STAGE_DSS)),
+                (int)ns2us(stage_time(fr, HWC_STAGE_SWAP)),
+                (int)ns2us(stage_time(fr, HWC_STAGE_TOTAL)),
+                (int)ns2us(stage_time(fr, HWC_STAGE_INTERVAL)),
+                fr->num_layers, fr->num_overlay, fr->num_fb, fr->fb_pixels,
+                fr->overlay_mask);
+    }
+
+    if (fclose(f) != 0 || rename(tmp_path, path) != 0) {
+        rv = -errno;
+        LOGE("unable to write %s: %s", path, strerror(errno));
+        unlink(tmp_path);
+    }
+
+    return rv;
+}
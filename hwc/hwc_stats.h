@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef _HWC_STATS_H
+#define _HWC_STATS_H
+
+#include <utils/Timers.h>
+
+#include "hwc_priv.h"
+
+/*
+ * Frame timing telemetry for the composer.
+ *
+ * Every composed frame gets a record with the time spent in prepare, in set,
+ * in the OMAPDSS_HWC_SET ioctl and in eglSwapBuffers, the interval since the
+ * previous frame and how its layers were split between overlays and GLES.
+ * The last HWC_STATS_FRAMES records are kept in a ring. Frames whose
+ * interval exceeds the frame budget are counted as janks.
+ *
+ * Recording is always on and only costs a few clock reads per frame.
+ * Setting debug.hwc.stats to N logs a summary every N frames, and
+ * debug.hwc.stats.file names a file the ring is written to as CSV at the
+ * same time. Both are done by a writer thread, the composition thread only
+ * wakes it up. The summary is also part of the composer dump.
+ */
+
+/* Frames kept in the ring, must be a power of two */
+#define HWC_STATS_FRAMES 256
+
+/* Default frame budget, one 60Hz refresh period */
+#define HWC_STATS_DEFAULT_BUDGET_US 16667
+
+#define HWC_STATS_PROPERTY "debug.hwc.stats"
+#define HWC_STATS_FILE_PROPERTY "debug.hwc.stats.file"
+#define HWC_STATS_BUDGET_PROPERTY "debug.hwc.stats.budget_us"
+
+typedef struct hwc_frame_stats {
+    nsecs_t prepare_start;
+    nsecs_t prepare_end;
+    nsecs_t set_start;
+    nsecs_t dss_start;      /* 0 if no overlay was updated */
+    nsecs_t dss_end;
+    nsecs_t set_end;
+    nsecs_t interval;       /* set_end of the previous frame to this one */
+    int num_layers;
+    int num_overlay;
+    int num_fb;
+    unsigned int fb_pixels;     /* screen area of the layers composited with GLES */
+    unsigned int overlay_mask;  /* bit n set when layer n went to an overlay */
+} hwc_frame_stats_t;
+
+/* api */
+
+/*
+ * Read the properties. Called when the HWC is opened
+ */
+void hwc_stats_init(void);
+
+/*
+ * Hooks called around the HWC entry points and the DSS ioctl. All of them
+ * run on the SurfaceFlinger composition thread.
+ */
+void hwc_stats_prepare_begin(void);
+void hwc_stats_prepare_end(hwc_layer_list_t *list);
+void hwc_stats_set_begin(void);
+void hwc_stats_dss_begin(void);
+void hwc_stats_dss_end(void);
+void hwc_stats_set_end(void);
+
+/*
+ * Write the summary into buff, returns the number of characters written
+ */
+int hwc_stats_dump(char *buff, int buff_len);
+
+/*
+ * Write the ring as CSV, one frame per line, oldest first
+ *
+ * Return values:
+ * 0    Success
+ * <0   -errno
+ */
+int hwc_stats_save(const char *path);
+
+#endif // _HWC_STATS_H
@@ -4,7 +4,7 @@ ifeq ($(TARGET_BOARD_PLATFORM),omap4)
 LOCAL_PATH:= $(call my-dir)
 
 include $(CLEAR_VARS)
-LOCAL_SRC_FILES := ion.c
+LOCAL_SRC_FILES := ion.c ion_pool.c
 LOCAL_MODULE := libion
 LOCAL_MODULE_TAGS := optional
 LOCAL_SHARED_LIBRARIES := liblog
@@ -24,4 +24,27 @@ LOCAL_MODULE_TAGS := optional tests
 LOCAL_SHARED_LIBRARIES := liblog
 include $(BUILD_HEAPTRACKED_EXECUTABLE)
 
+# The pool and batch tests run on the host against the memfd backed fake
+# device, linux/ion.h and linux/omap_ion.h come from the bionic kernel
+# headers
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := ion.c ion_pool.c ion_fake.c ion_fake_wrap.c ion_pool_test.c
+LOCAL_MODULE := ion_pool_test
+LOCAL_MODULE_TAGS := optional tests
+LOCAL_CFLAGS += -idirafter bionic/libc/kernel/common
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDFLAGS := -Wl,--wrap=open -Wl,--wrap=close -Wl,--wrap=ioctl
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := ion.c ion_fake.c ion_fake_wrap.c ion_batch_test.c
+LOCAL_MODULE := ion_batch_test
+LOCAL_MODULE_TAGS := optional tests
+LOCAL_CFLAGS += -idirafter bionic/libc/kernel/common
+LOCAL_STATIC_LIBRARIES := libcutils liblog
+LOCAL_LDFLAGS := -Wl,--wrap=open -Wl,--wrap=close -Wl,--wrap=ioctl
+LOCAL_LDLIBS := -lpthread -lrt
+include $(BUILD_HOST_EXECUTABLE)
+
 endif
@@ -19,10 +19,13 @@
  */
 #include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #define LOG_TAG "ion"
 #include <cutils/log.h>
@@ -143,3 +146,121 @@ int ion_import(int fd, int share_fd, struct ion_handle **handle) {
     *handle = data.handle;
     return ret;
 }
+
+int ion_alloc_batch(int fd, int count, size_t len, size_t align, unsigned int flags,
+                    struct ion_handle **handles) {
+    int i, ret = 0;
+
+    for (i = 0; i < count; i++) {
+        ret = ion_alloc(fd, len, align, flags, &handles[i]);
+        if (ret < 0)
+            break;
+    }
+    if (ret < 0) {
+        ion_free_batch(fd, i, handles);
+        return ret;
+    }
+    return 0;
+}
+
+int ion_free_batch(int fd, int count, struct ion_handle **handles) {
+    int i, ret = 0;
+
+    for (i = 0; i < count; i++) {
+        int err = ion_free(fd, handles[i]);
+        if (err < 0 && !ret)
+            ret = err;
+        handles[i] = NULL;
+    }
+    return ret;
+}
+
+static size_t batch_stride(size_t length) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return (length + page - 1) & ~(page - 1);
+}
+
+int ion_map_batch(int fd, int count, struct ion_handle **handles, size_t length,
+                  int prot, int flags, unsigned char **ptrs, int *map_fds) {
+    size_t stride = batch_stride(length);
+    unsigned char *base;
+    int i, ret = 0;
+
+    if (count <= 0 || !length)
+        return -EINVAL;
+
+    /* the reservation size must not wrap, nor the rounding of length */
+    if (!stride || (size_t)count > SIZE_MAX / stride)
+        return -EINVAL;
+
+    /* one reservation for the set, the buffers are mapped over it */
+    base = mmap(NULL, stride * count, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        LOGE("mmap reservation failed: %s\n", strerror(errno));
+        return -errno;
+    }
+
+    for (i = 0; i < count; i++) {
+        struct ion_fd_data data = {
+            .handle = handles[i],
+        };
+        ret = ion_ioctl(fd, ION_IOC_MAP, &data);
+        if (ret < 0)
+            break;
+        map_fds[i] = data.fd;
+        if (map_fds[i] < 0) {
+            LOGE("map ioctl returned negative fd\n");
+            ret = -EINVAL;
+            break;
+        }
+        ptrs[i] = mmap(base + i * stride, length, prot, flags | MAP_FIXED, map_fds[i], 0);
+        if (ptrs[i] == MAP_FAILED) {
+            LOGE("mmap failed: %s\n", strerror(errno));
+            ret = -errno;
+            close(map_fds[i]);
+            break;
+        }
+    }
+
+    if (ret < 0) {
+        munmap(base, stride * count);
+        while (i--)
+            close(map_fds[i]);
+        return ret;
+    }
+    return 0;
+}
+
+int ion_unmap_batch(int count, size_t length, unsigned char **ptrs, int *map_fds) {
+    int i, ret = 0;
+
+    if (count <= 0)
+        return -EINVAL;
+
+    if (munmap(ptrs[0], batch_stride(length) * count) < 0)
+        ret = -errno;
+    for (i = 0; i < count; i++) {
+        close(map_fds[i]);
+        ptrs[i] = NULL;
+        map_fds[i] = -1;
+    }
+    return ret;
+}
+
+int ion_share_batch(int fd, int count, struct ion_handle **handles, int *share_fds) {
+    int i, ret = 0;
+
+    for (i = 0; i < count; i++) {
+        ret = ion_share(fd, handles[i], &share_fds[i]);
+        if (ret < 0)
+            break;
+    }
+    if (ret < 0) {
+        while (i--) {
+            close(share_fds[i]);
+            share_fds[i] = -1;
+        }
+        return ret;
+    }
+    return 0;
+}
@@ -33,3 +33,24 @@ int ion_map(int fd, struct ion_handle *handle, size_t length, int prot,
 int ion_share(int fd, struct ion_handle *handle, int *share_fd);
 int ion_import(int fd, int share_fd, struct ion_handle **handle);
 
+/*
+ * Batched versions of the calls above for a set of count buffers of the
+ * same size, e.g. the buffers of a port. Either all buffers are set up or
+ * none is: on failure everything done so far is undone and -errno of the
+ * first failure returned.
+ *
+ * Setup costs the same as the single calls: every buffer still takes its
+ * own ioctl, and ion_map_batch its own mmap. Only teardown is batched,
+ * ion_unmap_batch unmaps all buffers with a single munmap.
+ *
+ * ion_map_batch maps the buffers back to back in one reservation, buffer i
+ * at ptrs[0] + i * length rounded up to a page. ion_unmap_batch removes
+ * the whole reservation with one munmap and closes the map fds.
+ */
+int ion_alloc_batch(int fd, int count, size_t len, size_t align, unsigned int flags,
+                    struct ion_handle **handles);
+int ion_free_batch(int fd, int count, struct ion_handle **handles);
+int ion_map_batch(int fd, int count, struct ion_handle **handles, size_t length,
+                  int prot, int flags, unsigned char **ptrs, int *map_fds);
+int ion_unmap_batch(int count, size_t length, unsigned char **ptrs, int *map_fds);
+int ion_share_batch(int fd, int count, struct ion_handle **handles, int *share_fds);
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Tests of the batched libion calls, run on the host against the memfd
+ * backed fake ion device. Also times setting up and tearing down buffer
+ * sets one call at a time and with the batched calls:
+ *
+ *   ion_batch_test [iterations]
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ion.h"
+#include "ion_fake.h"
+
+#define PAGE 4096
+#define HEAP_MASK (1 << ION_HEAP_TYPE_CARVEOUT)
+#define MAX_BUFFERS 16
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            return 1; \
+        } \
+    } while (0)
+
+static uint32_t live_buffers(void)
+{
+    struct ion_fake_stats stats;
+    ion_fake_get_stats(&stats);
+    return stats.live_buffers;
+}
+
+static int map_test(int fd)
+{
+    struct ion_handle *handles[MAX_BUFFERS];
+    unsigned char *ptrs[MAX_BUFFERS];
+    int map_fds[MAX_BUFFERS];
+    size_t len = 3 * PAGE + 100;
+    int ix;
+
+    CHECK(!ion_alloc_batch(fd, MAX_BUFFERS, len, PAGE, HEAP_MASK, handles));
+    CHECK(live_buffers() == MAX_BUFFERS);
+    CHECK(!ion_map_batch(fd, MAX_BUFFERS, handles, len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, ptrs, map_fds));
+
+    /* back to back, page aligned, each on its own buffer */
+    for (ix = 0; ix < MAX_BUFFERS; ix++)
+    {
+        CHECK(ptrs[ix] == ptrs[0] + ix * 4 * PAGE);
+        memset(ptrs[ix], ix, len);
+    }
+    for (ix = 0; ix < MAX_BUFFERS; ix++)
+    {
+        CHECK(ptrs[ix][0] == ix && ptrs[ix][len - 1] == ix);
+    }
+
+    CHECK(!ion_unmap_batch(MAX_BUFFERS, len, ptrs, map_fds));
+    CHECK(!ion_free_batch(fd, MAX_BUFFERS, handles));
+    CHECK(live_buffers() == 0);
+    return 0;
+}
+
+static int share_test(int fd)
+{
+    struct ion_handle *handles[4], *imported;
+    unsigned char *ptrs[4], *ptr;
+    int map_fds[4], share_fds[4], map_fd, fd2, ix;
+
+    CHECK(!ion_alloc_batch(fd, 4, PAGE, PAGE, HEAP_MASK, handles));
+    CHECK(!ion_map_batch(fd, 4, handles, PAGE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         ptrs, map_fds));
+    CHECK(!ion_share_batch(fd, 4, handles, share_fds));
+
+    /* another client sees each buffer through its share fd */
+    fd2 = ion_open();
+    CHECK(fd2 >= 0);
+    for (ix = 0; ix < 4; ix++)
+    {
+        ptrs[ix][0] = 10 + ix;
+        CHECK(!ion_import(fd2, share_fds[ix], &imported));
+        CHECK(!ion_map(fd2, imported, PAGE, PROT_READ, MAP_SHARED, 0, &ptr, &map_fd));
+        CHECK(ptr[0] == 10 + ix);
+        munmap(ptr, PAGE);
+        close(map_fd);
+        close(share_fds[ix]);
+    }
+    ion_close(fd2);
+
+    CHECK(!ion_unmap_batch(4, PAGE, ptrs, map_fds));
+    CHECK(!ion_free_batch(fd, 4, handles));
+    CHECK(live_buffers() == 0);
+    return 0;
+}
+
+static int rollback_test(int fd)
+{
+    struct ion_handle *handles[8], *bad[2];
+    unsigned char *ptrs[2];
+    int map_fds[2];
+    int ret;
+
+    /* the sixth allocation fails, the first five are freed */
+    ion_fake_set_limit(5 * 16 * PAGE);
+    ret = ion_alloc_batch(fd, 8, 16 * PAGE, PAGE, HEAP_MASK, handles);
+    ion_fake_set_limit(0);
+    CHECK(ret == -ENOMEM);
+    CHECK(live_buffers() == 0);
+
+    /* mapping a bad handle undoes the mapping of the good one */
+    CHECK(!ion_alloc_batch(fd, 1, PAGE, PAGE, HEAP_MASK, bad));
+    bad[1] = (struct ion_handle *) (uintptr_t) 0xdead;
+    ret = ion_map_batch(fd, 2, bad, PAGE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        ptrs, map_fds);
+    CHECK(ret == -EINVAL);
+    CHECK(ion_share_batch(fd, 2, bad, map_fds) == -EINVAL);
+    CHECK(!ion_free_batch(fd, 1, bad));
+    CHECK(live_buffers() == 0);
+
+    /* a reservation size that does not fit a size_t is refused up front */
+    ret = ion_map_batch(fd, 2, bad, SIZE_MAX / 2, PROT_READ, MAP_SHARED,
+                        ptrs, map_fds);
+    CHECK(ret == -EINVAL);
+    ret = ion_map_batch(fd, 1, bad, SIZE_MAX, PROT_READ, MAP_SHARED,
+                        ptrs, map_fds);
+    CHECK(ret == -EINVAL);
+    return 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* one buffer set the way callers do it today */
+static int set_single(int fd, int count, size_t len)
+{
+    struct ion_handle *handles[MAX_BUFFERS];
+    unsigned char *ptrs[MAX_BUFFERS];
+    int map_fds[MAX_BUFFERS], share_fds[MAX_BUFFERS];
+    int ix;
+
+    for (ix = 0; ix < count; ix++)
+    {
+        if (ion_alloc(fd, len, PAGE, HEAP_MASK, handles + ix) ||
+            ion_map(fd, handles[ix], len, PROT_READ | PROT_WRITE, MAP_SHARED, 0,
+                    ptrs + ix, map_fds + ix) ||
+            ion_share(fd, handles[ix], share_fds + ix))
+            return 1;
+    }
+    for (ix = 0; ix < count; ix++)
+    {
+        munmap(ptrs[ix], len);
+        close(map_fds[ix]);
+        close(share_fds[ix]);
+        ion_free(fd, handles[ix]);
+    }
+    return 0;
+}
+
+static int set_batch(int fd, int count, size_t len)
+{
+    struct ion_handle *handles[MAX_BUFFERS];
+    unsigned char *ptrs[MAX_BUFFERS];
+    int map_fds[MAX_BUFFERS], share_fds[MAX_BUFFERS];
+    int ix;
+
+    if (ion_alloc_batch(fd, count, len, PAGE, HEAP_MASK, handles) ||
+        ion_map_batch(fd, count, handles, len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      ptrs, map_fds) ||
+        ion_share_batch(fd, count, handles, share_fds))
+        return 1;
+
+    ion_unmap_batch(count, len, ptrs, map_fds);
+    for (ix = 0; ix < count; ix++)
+    {
+        close(share_fds[ix]);
+    }
+    ion_free_batch(fd, count, handles);
+    return 0;
+}
+
+static void time_sets(int fd, int iterations)
+{
+    static const int counts[] = { 8, 16 };
+    static const size_t lens[] = { 64 * 1024, 1382400 /* 640x480 NV12 x3 */ };
+    unsigned ci, li;
+    int ix;
+
+    printf("%8s %10s %12s %12s\n", "buffers", "bytes", "single us", "batch us");
+    for (ci = 0; ci < sizeof(counts) / sizeof(counts[0]); ci++)
+    {
+        for (li = 0; li < sizeof(lens) / sizeof(lens[0]); li++)
+        {
+            uint64_t single = 0, batch = 0, start;
+            for (ix = 0; ix < iterations; ix++)
+            {
+                /* alternate so drift hits both the same */
+                start = now_ns();
+                set_single(fd, counts[ci], lens[li]);
+                single += now_ns() - start;
+
+                start = now_ns();
+                set_batch(fd, counts[ci], lens[li]);
+                batch += now_ns() - start;
+            }
+            printf("%8d %10zu %12.1f %12.1f\n", counts[ci], lens[li],
+                   single / 1e3 / iterations, batch / 1e3 / iterations);
+        }
+    }
+}
+
+static const struct {
+    const char *name;
+    int (*run)(int fd);
+} tests[] = {
+    { "map", map_test },
+    { "share", share_test },
+    { "rollback", rollback_test },
+};
+
+int main(int argc, char **argv)
+{
+    int fd, ix, failed = 0;
+    int num = sizeof(tests) / sizeof(tests[0]);
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+
+    fd = ion_open();
+    if (fd < 0)
+    {
+        printf("could not open the fake ion device: %s\n", strerror(errno));
+        return 1;
+    }
+
+    for (ix = 0; ix < num; ix++)
+    {
+        int ret = tests[ix].run(fd);
+        printf("%s: %s\n", tests[ix].name, ret ? "FAILED" : "passed");
+        failed += ret != 0;
+    }
+    printf("FAILED: %d, SUCCEEDED: %d\n", failed, num - failed);
+
+    if (!failed && iterations > 0)
+        time_sets(fd, iterations);
+
+    ion_close(fd);
+    return failed != 0;
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <linux/ion.h>
+#include <linux/omap_ion.h>
+
+#include "ion_fake.h"
+
+#define ION_DEVICE_PATH "/dev/ion"
+
+#define MAX_FDS 4096
+#define MAX_HANDLES 4096
+#define MAX_BUFFERS 4096
+
+#define TILER_STRIDE 4096
+
+struct fake_buffer {
+    int handles;            /* 0 if unused */
+    int memfd;
+    size_t len;
+    dev_t dev;
+    ino_t ino;
+};
+
+struct fake_handle {
+    int used;
+    int client;             /* descriptor of the owning client */
+    int buffer;
+};
+
+static struct fake_buffer buffers[MAX_BUFFERS];
+static struct fake_handle handles[MAX_HANDLES];
+static unsigned char clients[MAX_FDS];
+static struct ion_fake_stats stats;
+static size_t limit;
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The program wraps close, and the memfd calls must not come back into
+ * the hooks with the device locked, so they go straight to the kernel.
+ */
+static int sys_memfd(const char *name)
+{
+#ifdef __NR_memfd_create
+    return syscall(__NR_memfd_create, name, 0);
+#else
+    (void) name;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static void sys_close(int fd)
+{
+    syscall(__NR_close, fd);
+}
+
+static int is_client(int fd)
+{
+    return fd >= 0 && fd < MAX_FDS && clients[fd];
+}
+
+/* drops a handle reference, returns the memfd to close or -1 */
+static int put_buffer(int buffer)
+{
+    struct fake_buffer *buf = buffers + buffer;
+    if (--buf->handles)
+        return -1;
+    stats.live_buffers--;
+    stats.live_bytes -= buf->len;
+    return buf->memfd;
+}
+
+static struct ion_handle *new_handle(int client, int buffer)
+{
+    int ix;
+    for (ix = 0; ix < MAX_HANDLES && handles[ix].used; ix++);
+    if (ix == MAX_HANDLES)
+        return NULL;
+    handles[ix].used = 1;
+    handles[ix].client = client;
+    handles[ix].buffer = buffer;
+    buffers[buffer].handles++;
+    stats.live_handles++;
+    return (struct ion_handle *) (uintptr_t) (ix + 1);
+}
+
+/* handle index for a handle of the client, or -1 */
+static int handle_index(int client, struct ion_handle *handle)
+{
+    int ix = (int) (uintptr_t) handle - 1;
+    return ix >= 0 && ix < MAX_HANDLES && handles[ix].used &&
+           handles[ix].client == client ? ix : -1;
+}
+
+static int alloc_handle(int client, size_t len, struct ion_handle **handle)
+{
+    struct fake_buffer *buf;
+    struct stat st;
+    int ix;
+
+    if (!len)
+        return -EINVAL;
+    if (limit && stats.live_bytes + len > limit)
+        return -ENOMEM;
+    for (ix = 0; ix < MAX_BUFFERS && buffers[ix].handles; ix++);
+    if (ix == MAX_BUFFERS)
+        return -ENOMEM;
+
+    buf = buffers + ix;
+    buf->memfd = sys_memfd("ion_fake");
+    if (buf->memfd < 0)
+        return -errno;
+    if (ftruncate(buf->memfd, len) || fstat(buf->memfd, &st))
+    {
+        int err = -errno;
+        sys_close(buf->memfd);
+        return err;
+    }
+    buf->len = len;
+    buf->dev = st.st_dev;
+    buf->ino = st.st_ino;
+
+    /* the handle takes the only reference */
+    *handle = new_handle(client, ix);
+    if (!*handle)
+    {
+        sys_close(buf->memfd);
+        return -ENOMEM;
+    }
+    stats.live_buffers++;
+    stats.live_bytes += len;
+    stats.allocs++;
+    return 0;
+}
+
+static int custom_ioctl(int client, struct ion_custom_data *data)
+{
+    struct omap_ion_tiler_alloc_data *tiler;
+    static const size_t bpp[] = { 1, 2, 4, 1 };
+
+    if (data->cmd != OMAP_ION_TILER_ALLOC)
+        return -EINVAL;
+
+    tiler = (struct omap_ion_tiler_alloc_data *) data->arg;
+    if (tiler->fmt < TILER_PIXEL_FMT_MIN || tiler->fmt > TILER_PIXEL_FMT_MAX)
+        return -EINVAL;
+    tiler->stride = (tiler->w * bpp[tiler->fmt] + TILER_STRIDE - 1) & ~(TILER_STRIDE - 1);
+    return alloc_handle(client, tiler->stride * tiler->h, &tiler->handle);
+}
+
+/* runs with the device locked, the memfd to close is returned in *unused */
+static int fake_ioctl(int client, unsigned int request, void *arg, int *unused)
+{
+    struct ion_allocation_data *alloc = arg;
+    struct ion_handle_data *hdata = arg;
+    struct ion_fd_data *fdata = arg;
+    struct stat st;
+    int ix;
+
+    stats.ioctls++;
+    switch (request)
+    {
+    case ION_IOC_ALLOC:
+        return alloc_handle(client, alloc->len, &alloc->handle);
+
+    case ION_IOC_FREE:
+        ix = handle_index(client, hdata->handle);
+        if (ix < 0)
+            return -EINVAL;
+        *unused = put_buffer(handles[ix].buffer);
+        handles[ix].used = 0;
+        stats.live_handles--;
+        stats.frees++;
+        return 0;
+
+    case ION_IOC_MAP:
+    case ION_IOC_SHARE:
+        ix = handle_index(client, fdata->handle);
+        if (ix < 0)
+            return -EINVAL;
+        fdata->fd = dup(buffers[handles[ix].buffer].memfd);
+        if (fdata->fd < 0)
+            return -errno;
+        if (request == ION_IOC_MAP)
+            stats.maps++;
+        else
+            stats.shares++;
+        return 0;
+
+    case ION_IOC_IMPORT:
+        if (fstat(fdata->fd, &st))
+            return -errno;
+        /* only buffers that still have a handle somewhere are found */
+        for (ix = 0; ix < MAX_BUFFERS; ix++)
+        {
+            if (buffers[ix].handles && buffers[ix].dev == st.st_dev &&
+                buffers[ix].ino == st.st_ino)
+                break;
+        }
+        if (ix == MAX_BUFFERS)
+            return -EINVAL;
+        fdata->handle = new_handle(client, ix);
+        if (!fdata->handle)
+            return -ENOMEM;
+        stats.imports++;
+        return 0;
+
+    case ION_IOC_CUSTOM:
+        return custom_ioctl(client, arg);
+
+    default:
+        return -ENOTTY;
+    }
+}
+
+int ion_fake_open(const char *path, int flags, int *ret)
+{
+    (void) flags;
+    if (strcmp(path, ION_DEVICE_PATH))
+        return 0;
+
+    /* any descriptor will do, the ioctls are recognized by its number */
+    *ret = sys_memfd("ion_fake_client");
+    if (*ret < 0)
+        return 1;
+    if (*ret >= MAX_FDS)
+    {
+        sys_close(*ret);
+        errno = EMFILE;
+        *ret = -1;
+        return 1;
+    }
+
+    pthread_mutex_lock(&mtx);
+    clients[*ret] = 1;
+    stats.live_clients++;
+    pthread_mutex_unlock(&mtx);
+    return 1;
+}
+
+int ion_fake_close(int fd, int *ret)
+{
+    int ix, memfd;
+
+    (void) ret;
+    pthread_mutex_lock(&mtx);
+    if (is_client(fd))
+    {
+        /* the handles of a client go away with it */
+        for (ix = 0; ix < MAX_HANDLES; ix++)
+        {
+            if (handles[ix].used && handles[ix].client == fd)
+            {
+                memfd = put_buffer(handles[ix].buffer);
+                if (memfd >= 0)
+                    sys_close(memfd);
+                handles[ix].used = 0;
+                stats.live_handles--;
+            }
+        }
+        clients[fd] = 0;
+        stats.live_clients--;
+    }
+    pthread_mutex_unlock(&mtx);
+    return 0;
+}
+
+int ion_fake_ioctl(int fd, unsigned long request, void *arg, int *ret)
+{
+    int unused = -1;
+
+    pthread_mutex_lock(&mtx);
+    if (!is_client(fd))
+    {
+        pthread_mutex_unlock(&mtx);
+        return 0;
+    }
+    /* like the kernel, only look at the low 32 bits, libion passes
+       the request as an int */
+    *ret = fake_ioctl(fd, (unsigned int) request, arg, &unused);
+    pthread_mutex_unlock(&mtx);
+
+    if (unused >= 0)
+        sys_close(unused);
+    if (*ret < 0)
+    {
+        errno = -*ret;
+        *ret = -1;
+    }
+    return 1;
+}
+
+void ion_fake_set_limit(size_t max_bytes)
+{
+    pthread_mutex_lock(&mtx);
+    limit = max_bytes;
+    pthread_mutex_unlock(&mtx);
+}
+
+void ion_fake_get_stats(struct ion_fake_stats *out)
+{
+    pthread_mutex_lock(&mtx);
+    *out = stats;
+    pthread_mutex_unlock(&mtx);
+}
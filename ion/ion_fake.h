@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ION_FAKE_H
+#define ION_FAKE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * User space stand-in for /dev/ion, for host tests and benchmarks.
+ *
+ * Every ion_open() gets its own client descriptor. Buffers are memfd
+ * files, and the ION_IOC_MAP and ION_IOC_SHARE descriptors are dups of
+ * them, so they are mapped, passed around and closed with the real calls
+ * and all mappings of a buffer share its memory. One lock covers the
+ * device, as the driver lock does.
+ *
+ * The program links the hooks into its open, close and ioctl wrappers
+ * (-Wl,--wrap=...), ion_fake_wrap.c has them for programs that only need
+ * the ion device. Each hook returns 1 with the result in *ret when the
+ * call was for the fake device, and 0 when the real call should run.
+ * ion_fake_close only drops the handles of a client and always lets the
+ * real close run.
+ */
+
+struct ion_fake_stats {
+    uint32_t ioctls;        /* all ion ioctls */
+    uint32_t allocs;        /* ION_IOC_ALLOC and OMAP_ION_TILER_ALLOC */
+    uint32_t frees;         /* ION_IOC_FREE */
+    uint32_t maps;          /* ION_IOC_MAP */
+    uint32_t shares;        /* ION_IOC_SHARE */
+    uint32_t imports;       /* ION_IOC_IMPORT */
+    uint32_t live_clients;
+    uint32_t live_handles;
+    uint32_t live_buffers;
+    size_t live_bytes;
+};
+
+int ion_fake_open(const char *path, int flags, int *ret);
+int ion_fake_close(int fd, int *ret);
+int ion_fake_ioctl(int fd, unsigned long request, void *arg, int *ret);
+
+/*
+ * Makes allocations fail with ENOMEM past max_bytes of live buffers,
+ * 0 removes the limit
+ */
+void ion_fake_set_limit(size_t max_bytes);
+
+void ion_fake_get_stats(struct ion_fake_stats *stats);
+
+#endif // ION_FAKE_H
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Link time wrappers sending the /dev/ion calls of a host program to the
+ * fake ion device, linked with
+ *
+ *     -Wl,--wrap=open -Wl,--wrap=close -Wl,--wrap=ioctl
+ */
+
+#include <stdarg.h>
+
+#include "ion_fake.h"
+
+int __real_open(const char *path, int flags, int mode);
+int __real_close(int fd);
+int __real_ioctl(int fd, unsigned long request, void *arg);
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode, ret;
+
+    va_start(ap, flags);
+    mode = va_arg(ap, int);
+    va_end(ap);
+    if (ion_fake_open(path, flags, &ret))
+        return ret;
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_close(int fd)
+{
+    int ret;
+    if (ion_fake_close(fd, &ret))
+        return ret;
+    return __real_close(fd);
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+    va_list ap;
+    void *arg;
+    int ret;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+    if (ion_fake_ioctl(fd, request, arg, &ret))
+        return ret;
+    return __real_ioctl(fd, request, arg);
+}
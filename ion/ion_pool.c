@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define LOG_TAG "ion_pool"
+#include <cutils/log.h>
+
+#include "ion_pool.h"
+
+#define POOL_PAGE_SIZE 4096
+#define POOL_PAGE_CLASSES 16
+
+/* what a buffer can be reused for */
+struct ion_pool_key {
+    int tiler;
+    unsigned int flags;
+    size_t len;                 /* size class, or tiler width */
+    size_t align;               /* or tiler height */
+    int fmt;                    /* tiler format */
+};
+
+struct ion_pool_class {
+    struct ion_pool_key key;
+    struct ion_pool_buffer *head;   /* most recently freed first */
+    struct ion_pool_class *next;
+};
+
+struct ion_pool {
+    int fd;
+    int prot;
+    int map_flags;
+    pthread_mutex_t lock;
+    struct ion_pool_class *classes;
+    /* cached buffers, most recently freed at the head */
+    struct ion_pool_buffer *lru_head, *lru_tail;
+    struct ion_pool_stats stats;
+};
+
+static size_t size_class(size_t len) {
+    size_t step = POOL_PAGE_SIZE;
+
+    len = (len + POOL_PAGE_SIZE - 1) & ~(size_t)(POOL_PAGE_SIZE - 1);
+    if (len <= POOL_PAGE_CLASSES * POOL_PAGE_SIZE)
+        return len;
+
+    /* an eighth of the power of two below len */
+    while (step * 16 <= len)
+        step <<= 1;
+    return (len + step - 1) & ~(step - 1);
+}
+
+static int same_key(const struct ion_pool_key *a, const struct ion_pool_key *b) {
+    return a->tiler == b->tiler && a->flags == b->flags && a->len == b->len &&
+           a->align == b->align && a->fmt == b->fmt;
+}
+
+static struct ion_pool_class *find_class(struct ion_pool *pool,
+                                         const struct ion_pool_key *key, int create) {
+    struct ion_pool_class *cls;
+
+    for (cls = pool->classes; cls; cls = cls->next) {
+        if (same_key(&cls->key, key))
+            return cls;
+    }
+    if (!create)
+        return NULL;
+
+    cls = calloc(1, sizeof(*cls));
+    if (!cls)
+        return NULL;
+    cls->key = *key;
+    cls->next = pool->classes;
+    pool->classes = cls;
+    return cls;
+}
+
+/* takes a cached buffer off both lists, the pool must be locked */
+static void cache_unlink(struct ion_pool *pool, struct ion_pool_buffer *buf) {
+    if (buf->lru_prev)
+        buf->lru_prev->lru_next = buf->lru_next;
+    else
+        pool->lru_head = buf->lru_next;
+    if (buf->lru_next)
+        buf->lru_next->lru_prev = buf->lru_prev;
+    else
+        pool->lru_tail = buf->lru_prev;
+
+    if (buf->cls_prev)
+        buf->cls_prev->cls_next = buf->cls_next;
+    else
+        buf->cls->head = buf->cls_next;
+    if (buf->cls_next)
+        buf->cls_next->cls_prev = buf->cls_prev;
+
+    buf->lru_prev = buf->lru_next = buf->cls_prev = buf->cls_next = NULL;
+    pool->stats.cached_buffers--;
+    pool->stats.cached_bytes -= buf->len;
+}
+
+/* adds a buffer at the head of both lists, the pool must be locked */
+static void cache_put(struct ion_pool *pool, struct ion_pool_buffer *buf) {
+    buf->lru_prev = NULL;
+    buf->lru_next = pool->lru_head;
+    if (pool->lru_head)
+        pool->lru_head->lru_prev = buf;
+    else
+        pool->lru_tail = buf;
+    pool->lru_head = buf;
+
+    buf->cls_prev = NULL;
+    buf->cls_next = buf->cls->head;
+    if (buf->cls->head)
+        buf->cls->head->cls_prev = buf;
+    buf->cls->head = buf;
+
+    pool->stats.cached_buffers++;
+    pool->stats.cached_bytes += buf->len;
+}
+
+/*
+ * Takes the least recently freed buffers out of the cache until at most
+ * max_bytes stay, and returns them chained by lru_next. The pool must be
+ * locked, the caller releases the buffers after unlocking it.
+ */
+static struct ion_pool_buffer *cache_evict(struct ion_pool *pool, size_t max_bytes) {
+    struct ion_pool_buffer *victims = NULL, *buf;
+
+    while (pool->stats.cached_bytes > max_bytes && pool->lru_tail) {
+        buf = pool->lru_tail;
+        cache_unlink(pool, buf);
+        buf->lru_next = victims;
+        victims = buf;
+        pool->stats.evictions++;
+    }
+    return victims;
+}
+
+static int release(struct ion_pool *pool, struct ion_pool_buffer *buf) {
+    int ret = 0;
+
+    if (buf->ptr && munmap(buf->ptr, buf->len))
+        ret = -errno;
+    if (buf->map_fd >= 0)
+        close(buf->map_fd);
+    if (buf->handle) {
+        int err = ion_free(pool->fd, buf->handle);
+        if (err && !ret)
+            ret = err;
+    }
+    free(buf);
+    return ret;
+}
+
+static int release_list(struct ion_pool *pool, struct ion_pool_buffer *buf) {
+    int count = 0;
+
+    while (buf) {
+        struct ion_pool_buffer *next = buf->lru_next;
+        release(pool, buf);
+        buf = next;
+        count++;
+    }
+    return count;
+}
+
+/* allocates and maps buf, leaves it empty on failure */
+static int new_buffer(struct ion_pool *pool, const struct ion_pool_key *key,
+                      struct ion_pool_buffer *buf) {
+    int ret;
+
+    if (key->tiler) {
+        ret = ion_alloc_tiler(pool->fd, key->len, key->align, key->fmt, key->flags,
+                              &buf->handle, &buf->stride);
+        buf->len = buf->stride * key->align;
+    } else {
+        ret = ion_alloc(pool->fd, key->len, key->align, key->flags, &buf->handle);
+        buf->len = key->len;
+    }
+    if (ret) {
+        buf->handle = NULL;
+        return ret;
+    }
+
+    ret = ion_map(pool->fd, buf->handle, buf->len, pool->prot, pool->map_flags, 0,
+                  &buf->ptr, &buf->map_fd);
+    if (ret) {
+        /* ion_map leaves the map fd open if only the mmap failed */
+        if (buf->map_fd >= 0)
+            close(buf->map_fd);
+        ion_free(pool->fd, buf->handle);
+        buf->handle = NULL;
+        buf->ptr = NULL;
+        buf->map_fd = -1;
+    }
+    return ret;
+}
+
+static int pool_alloc(struct ion_pool *pool, const struct ion_pool_key *key,
+                      struct ion_pool_buffer **out) {
+    struct ion_pool_class *cls;
+    struct ion_pool_buffer *buf;
+    int ret;
+
+    pthread_mutex_lock(&pool->lock);
+    cls = find_class(pool, key, 1);
+    buf = cls ? cls->head : NULL;
+    if (buf) {
+        cache_unlink(pool, buf);
+        pool->stats.hits++;
+        pthread_mutex_unlock(&pool->lock);
+        *out = buf;
+        return 0;
+    }
+    pool->stats.misses++;
+    pthread_mutex_unlock(&pool->lock);
+
+    buf = calloc(1, sizeof(*buf));
+    if (!buf)
+        return -ENOMEM;
+    buf->map_fd = -1;
+    buf->cls = cls;
+
+    ret = new_buffer(pool, key, buf);
+    if (ret) {
+        /* the cache may hold the memory this allocation needs */
+        struct ion_pool_buffer *victims;
+
+        pthread_mutex_lock(&pool->lock);
+        victims = cache_evict(pool, 0);
+        pthread_mutex_unlock(&pool->lock);
+
+        if (victims) {
+            release_list(pool, victims);
+            ret = new_buffer(pool, key, buf);
+        }
+        if (ret) {
+            LOGE("allocation failed: %d\n", ret);
+            free(buf);
+            return ret;
+        }
+    }
+
+    *out = buf;
+    return 0;
+}
+
+struct ion_pool *ion_pool_create(int fd, size_t max_bytes, int prot, int map_flags) {
+    struct ion_pool *pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    pool->fd = fd;
+    pool->prot = prot;
+    pool->map_flags = map_flags;
+    pool->stats.max_bytes = max_bytes;
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+void ion_pool_destroy(struct ion_pool *pool) {
+    struct ion_pool_class *cls;
+
+    if (!pool)
+        return;
+
+    ion_pool_trim(pool, 0);
+    while ((cls = pool->classes)) {
+        pool->classes = cls->next;
+        free(cls);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+int ion_pool_alloc(struct ion_pool *pool, size_t len, size_t align, unsigned int flags,
+                   struct ion_pool_buffer **buf) {
+    struct ion_pool_key key;
+
+    if (!pool || !buf || !len)
+        return -EINVAL;
+
+    memset(&key, 0, sizeof(key));
+    key.flags = flags;
+    key.len = size_class(len);
+    key.align = align;
+    return pool_alloc(pool, &key, buf);
+}
+
+int ion_pool_alloc_tiler(struct ion_pool *pool, size_t w, size_t h, int fmt,
+                         unsigned int flags, struct ion_pool_buffer **buf) {
+    struct ion_pool_key key;
+
+    if (!pool || !buf || !w || !h)
+        return -EINVAL;
+
+    memset(&key, 0, sizeof(key));
+    key.tiler = 1;
+    key.flags = flags;
+    key.len = w;
+    key.align = h;
+    key.fmt = fmt;
+    return pool_alloc(pool, &key, buf);
+}
+
+int ion_pool_free(struct ion_pool *pool, struct ion_pool_buffer *buf) {
+    struct ion_pool_buffer *victims;
+    int ret = 0;
+
+    if (!pool || !buf)
+        return -EINVAL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (!buf->cls || !buf->ptr || buf->len > pool->stats.max_bytes) {
+        pthread_mutex_unlock(&pool->lock);
+        return release(pool, buf);
+    }
+    victims = cache_evict(pool, pool->stats.max_bytes - buf->len);
+    cache_put(pool, buf);
+    pthread_mutex_unlock(&pool->lock);
+
+    while (victims) {
+        struct ion_pool_buffer *next = victims->lru_next;
+        int err = release(pool, victims);
+        if (err && !ret)
+            ret = err;
+        victims = next;
+    }
+    return ret;
+}
+
+int ion_pool_discard(struct ion_pool *pool, struct ion_pool_buffer *buf) {
+    if (!pool || !buf)
+        return -EINVAL;
+    return release(pool, buf);
+}
+
+int ion_pool_trim(struct ion_pool *pool, size_t max_bytes) {
+    struct ion_pool_buffer *victims;
+
+    if (!pool)
+        return 0;
+
+    pthread_mutex_lock(&pool->lock);
+    victims = cache_evict(pool, max_bytes);
+    pthread_mutex_unlock(&pool->lock);
+
+    return release_list(pool, victims);
+}
+
+void ion_pool_get_stats(struct ion_pool *pool, struct ion_pool_stats *stats) {
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+}
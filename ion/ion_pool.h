@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _ION_POOL_H
+#define _ION_POOL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "ion.h"
+
+/*
+ * An ion pool hands out allocated and mapped buffers. Freed buffers stay
+ * allocated and mapped in the pool, and the next allocation of the same
+ * heap mask, size class and geometry gets one of them back without any
+ * ioctl or mmap.
+ *
+ * Sizes are rounded up to a size class: whole pages up to 16 pages, then
+ * steps of an eighth of the power of two below the size. Tiler buffers
+ * are only reused for the same width, height and format.
+ *
+ * The bytes kept in a pool are limited; freeing past the limit releases
+ * the least recently freed buffers first. ion_pool_trim releases cached
+ * buffers on demand, e.g. when the client goes idle. When an allocation
+ * fails the pool releases its cache and tries once more.
+ *
+ * All calls are thread safe. Reusing a cached buffer only takes the pool
+ * lock, the ioctls and mappings are done outside of it.
+ *
+ * A pooled buffer comes back with the contents it had when freed. Buffers
+ * that were shared with another process must be released with
+ * ion_pool_discard instead of ion_pool_free.
+ */
+
+struct ion_pool;
+
+struct ion_pool_buffer {
+    struct ion_handle *handle;
+    unsigned char *ptr;         /* mapping of the whole buffer */
+    int map_fd;
+    size_t len;                 /* length of the mapping */
+    size_t stride;              /* tiler buffers only */
+
+    /* private to the pool */
+    struct ion_pool_class *cls;
+    struct ion_pool_buffer *lru_prev, *lru_next;
+    struct ion_pool_buffer *cls_prev, *cls_next;
+};
+
+struct ion_pool_stats {
+    uint32_t hits;              /* allocations served from the cache */
+    uint32_t misses;            /* allocations that went to ion */
+    uint32_t evictions;         /* cached buffers released */
+    uint32_t cached_buffers;
+    size_t cached_bytes;
+    size_t max_bytes;
+};
+
+/*
+ * Creates a pool on the ion client fd. Buffers are mapped with prot and
+ * map_flags, and at most max_bytes of freed buffers are kept. The fd
+ * must stay open until the pool is destroyed.
+ *
+ * Returns NULL if out of memory.
+ */
+struct ion_pool *ion_pool_create(int fd, size_t max_bytes, int prot, int map_flags);
+
+/*
+ * Releases the cached buffers and the pool. Buffers still allocated from
+ * the pool must be freed before.
+ */
+void ion_pool_destroy(struct ion_pool *pool);
+
+/*
+ * Allocates and maps a buffer of at least len bytes, like ion_alloc and
+ * ion_map. buf->len is the size class, the length actually mapped.
+ *
+ * Returns 0 on success, -errno on failure.
+ */
+int ion_pool_alloc(struct ion_pool *pool, size_t len, size_t align, unsigned int flags,
+                   struct ion_pool_buffer **buf);
+
+/*
+ * Allocates and maps a 2D tiler buffer, like ion_alloc_tiler and ion_map.
+ *
+ * Returns 0 on success, -errno on failure.
+ */
+int ion_pool_alloc_tiler(struct ion_pool *pool, size_t w, size_t h, int fmt,
+                         unsigned int flags, struct ion_pool_buffer **buf);
+
+/*
+ * Returns a buffer to the pool. It is cached if it fits under the byte
+ * limit, evicting older buffers as needed, and released otherwise.
+ *
+ * Returns 0 on success, -errno if releasing a buffer failed.
+ */
+int ion_pool_free(struct ion_pool *pool, struct ion_pool_buffer *buf);
+
+/*
+ * Unmaps and frees a buffer without caching it.
+ *
+ * Returns 0 on success, -errno on failure.
+ */
+int ion_pool_discard(struct ion_pool *pool, struct ion_pool_buffer *buf);
+
+/*
+ * Releases the least recently freed buffers until at most max_bytes stay
+ * cached. ion_pool_trim(pool, 0) empties the cache.
+ *
+ * Returns the number of buffers released.
+ */
+int ion_pool_trim(struct ion_pool *pool, size_t max_bytes);
+
+void ion_pool_get_stats(struct ion_pool *pool, struct ion_pool_stats *stats);
+
+#endif /* _ION_POOL_H */
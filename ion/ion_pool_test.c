@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Unit tests of the ion pool, run on the host against the memfd backed
+ * fake ion device.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ion.h"
+#include "ion_pool.h"
+#include "ion_fake.h"
+
+#define PAGE 4096
+#define HEAP_MASK (1 << ION_HEAP_TYPE_CARVEOUT)
+#define NUM_THREADS 4
+#define THREAD_OPS 2000
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            return 1; \
+        } \
+    } while (0)
+
+static uint32_t live_buffers(void)
+{
+    struct ion_fake_stats stats;
+    ion_fake_get_stats(&stats);
+    return stats.live_buffers;
+}
+
+static int reuse_test(int fd)
+{
+    struct ion_pool *pool = ion_pool_create(fd, 1 << 20, PROT_READ | PROT_WRITE, MAP_SHARED);
+    struct ion_pool_buffer *a, *b;
+    struct ion_pool_stats stats;
+
+    CHECK(pool);
+    CHECK(!ion_pool_alloc(pool, 10000, PAGE, HEAP_MASK, &a));
+    CHECK(a->len == 3 * PAGE);
+    memset(a->ptr, 0x5a, a->len);
+    CHECK(!ion_pool_free(pool, a));
+
+    /* the same size class comes back with its mapping and contents */
+    CHECK(!ion_pool_alloc(pool, 9000, PAGE, HEAP_MASK, &b));
+    CHECK(b == a);
+    CHECK(b->ptr[0] == 0x5a && b->ptr[b->len - 1] == 0x5a);
+
+    ion_pool_get_stats(pool, &stats);
+    CHECK(stats.hits == 1 && stats.misses == 1);
+    CHECK(stats.cached_buffers == 0 && stats.cached_bytes == 0);
+
+    CHECK(!ion_pool_free(pool, b));
+    ion_pool_destroy(pool);
+    CHECK(live_buffers() == 0);
+    return 0;
+}
+
+static int size_class_test(int fd)
+{
+    struct ion_pool *pool = ion_pool_create(fd, 8 << 20, PROT_READ | PROT_WRITE, MAP_SHARED);
+    struct ion_pool_buffer *a, *b, *c;
+    struct ion_pool_stats stats;
+
+    CHECK(pool);
+    /* past 16 pages, sizes round up to an eighth of the power of two */
+    CHECK(!ion_pool_alloc(pool, 16 * PAGE, PAGE, HEAP_MASK, &a));
+    CHECK(a->len == 16 * PAGE);
+    CHECK(!ion_pool_alloc(pool, 100 * PAGE, PAGE, HEAP_MASK, &b));
+    CHECK(b->len == 104 * PAGE);
+    CHECK(!ion_pool_free(pool, b));
+    CHECK(!ion_pool_alloc(pool, 97 * PAGE, PAGE, HEAP_MASK, &c));
+    CHECK(c == b);
+    CHECK(!ion_pool_free(pool, c));
+
+    /* other heaps and alignments do not share buffers */
+    CHECK(!ion_pool_alloc(pool, 100 * PAGE, PAGE, HEAP_MASK << 1, &c));
+    CHECK(c != b);
+    CHECK(!ion_pool_free(pool, c));
+    CHECK(!ion_pool_alloc(pool, 100 * PAGE, 2 * PAGE, HEAP_MASK, &c));
+    CHECK(c != b);
+    CHECK(!ion_pool_free(pool, c));
+
+    ion_pool_get_stats(pool, &stats);
+    CHECK(stats.hits == 1 && stats.misses == 4);
+    CHECK(stats.cached_buffers == 3);
+
+    CHECK(!ion_pool_free(pool, a));
+    ion_pool_destroy(pool);
+    CHECK(live_buffers() == 0);
+    return 0;
+}
+
+static int tiler_test(int fd)
+{
+    struct ion_pool *pool = ion_pool_create(fd, 8 << 20, PROT_READ | PROT_WRITE, MAP_SHARED);
+    struct ion_pool_buffer *a, *b;
+
+    CHECK(pool);
+    CHECK(!ion_pool_alloc_tiler(pool, 640, 480, TILER_PIXEL_FMT_8BIT,
+                                OMAP_ION_HEAP_TILER_MASK, &a));
+    CHECK(a->stride >= 640);
+    CHECK(a->len == a->stride * 480);
+    CHECK(!ion_pool_free(pool, a));
+
+    /* tiler buffers are only reused for the same geometry */
+    CHECK(!ion_pool_alloc_tiler(pool, 640, 482, TILER_PIXEL_FMT_8BIT,
+                                OMAP_ION_HEAP_TILER_MASK, &b));
+    CHECK(b != a);
+    CHECK(!ion_pool_free(pool, b));
+    CHECK(!ion_pool_alloc_tiler(pool, 640, 480, TILER_PIXEL_FMT_16BIT,
+                                OMAP_ION_HEAP_TILER_MASK, &b));
+    CHECK(b != a);
+    CHECK(!ion_pool_free(pool, b));
+    CHECK(!ion_pool_alloc_tiler(pool, 640, 480, TILER_PIXEL_FMT_8BIT,
+                                OMAP_ION_HEAP_TILER_MASK, &b));
+    CHECK(b == a);
+    CHECK(!ion_pool_free(pool, b));
+
+    ion_pool_destroy(pool);
+    CHECK(live_buffers() == 0);
+    return 0;
+}
+
+static int limit_test(int fd)
+{
+    struct ion_pool *pool = ion_pool_create(fd, 3 * 16 * PAGE, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED);
+    struct ion_pool_buffer *bufs[4], *big, *b;
+    struct ion_pool_stats stats;
+    int ix;
+
+    CHECK(pool);
+    for (ix = 0; ix < 4; ix++)
+    {
+        CHECK(!ion_pool_alloc(pool, 16 * PAGE, PAGE, HEAP_MASK, bufs + ix));
+    }
+    for (ix = 0; ix < 4; ix++)
+    {
+        CHECK(!ion_pool_free(pool, bufs[ix]));
+    }
+
+    /* the first freed buffer made room for the last one */
+    ion_pool_get_stats(pool, &stats);
+    CHECK(stats.evictions == 1);
+    CHECK(stats.cached_buffers == 3 && stats.cached_bytes == 3 * 16 * PAGE);
+    CHECK(live_buffers() == 3);
+
+    /* most recently freed first */
+    CHECK(!ion_pool_alloc(pool, 16 * PAGE, PAGE, HEAP_MASK, &b));
+    CHECK(b == bufs[3]);
+    CHECK(!ion_pool_free(pool, b));
+
+    /* a buffer over the limit is never cached */
+    CHECK(!ion_pool_alloc(pool, 64 * PAGE, PAGE, HEAP_MASK, &big));
+    CHECK(!ion_pool_free(pool, big));
+    ion_pool_get_stats(pool, &stats);
+    CHECK(stats.cached_buffers == 3 && stats.evictions == 1);
+
+    CHECK(ion_pool_trim(pool, 16 * PAGE) == 2);
+    CHECK(live_buffers() == 1);
+    CHECK(ion_pool_trim(pool, 0) == 1);
+    CHECK(live_buffers() == 0);
+
+    ion_pool_destroy(pool);
+    return 0;
+}
+
+static int retry_test(int fd)
+{
+    struct ion_pool *pool = ion_pool_create(fd, 1 << 20, PROT_READ | PROT_WRITE, MAP_SHARED);
+    struct ion_pool_buffer *a, *b;
+    struct ion_pool_stats stats;
+    int ret;
+
+    CHECK(pool);
+    CHECK(!ion_pool_alloc(pool, 64 * PAGE, PAGE, HEAP_MASK, &a));
+    CHECK(!ion_pool_free(pool, a));
+
+    /* the cached buffer is released to make room */
+    ion_fake_set_limit(96 * PAGE);
+    ret = ion_pool_alloc(pool, 48 * PAGE, PAGE, HEAP_MASK, &b);
+    ion_fake_set_limit(0);
+    CHECK(!ret);
+    ion_pool_get_stats(pool, &stats);
+    CHECK(stats.cached_buffers == 0 && stats.evictions == 1);
+    CHECK(live_buffers() == 1);
+
+    /* nothing to release */
+    ion_fake_set_limit(96 * PAGE);
+    ret = ion_pool_alloc(pool, 64 * PAGE, PAGE, HEAP_MASK, &a);
+    ion_fake_set_limit(0);
+    CHECK(ret == -ENOMEM);
+
+    CHECK(!ion_pool_discard(pool, b));
+    ion_pool_get_stats(pool, &stats);
+    CHECK(stats.cached_buffers == 0);
+    CHECK(live_buffers() == 0);
+
+    ion_pool_destroy(pool);
+    return 0;
+}
+
+/* the fake maps every descriptor of a buffer onto the same memory */
+static int shared_memory_test(int fd)
+{
+    struct ion_pool *pool = ion_pool_create(fd, 1 << 20, PROT_READ | PROT_WRITE, MAP_SHARED);
+    struct ion_pool_buffer *a;
+    struct ion_handle *handle;
+    unsigned char *ptr;
+    int share_fd, map_fd, fd2;
+
+    CHECK(pool);
+    CHECK(!ion_pool_alloc(pool, PAGE, PAGE, HEAP_MASK, &a));
+    CHECK(!ion_share(fd, a->handle, &share_fd));
+
+    fd2 = ion_open();
+    CHECK(fd2 >= 0);
+    CHECK(!ion_import(fd2, share_fd, &handle));
+    CHECK(!ion_map(fd2, handle, PAGE, PROT_READ | PROT_WRITE, MAP_SHARED, 0, &ptr, &map_fd));
+    a->ptr[100] = 42;
+    CHECK(ptr[100] == 42);
+    munmap(ptr, PAGE);
+    close(map_fd);
+    close(share_fd);
+    ion_close(fd2);
+
+    /* shared buffers are not cached */
+    CHECK(!ion_pool_discard(pool, a));
+    CHECK(live_buffers() == 0);
+    ion_pool_destroy(pool);
+    return 0;
+}
+
+struct thread_arg {
+    struct ion_pool *pool;
+    unsigned seed;
+    int failures;
+};
+
+static void *thread_run(void *p)
+{
+    struct thread_arg *arg = p;
+    struct ion_pool_buffer *live[8];
+    int ix;
+
+    memset(live, 0, sizeof(live));
+    for (ix = 0; ix < THREAD_OPS; ix++)
+    {
+        struct ion_pool_buffer **slot = live + rand_r(&arg->seed) % 8;
+        if (*slot)
+        {
+            /* nobody else wrote into it while it was ours */
+            if ((*slot)->ptr[0] != (unsigned char) (uintptr_t) slot)
+                arg->failures++;
+            arg->failures += ion_pool_free(arg->pool, *slot) != 0;
+            *slot = NULL;
+        }
+        else if (ion_pool_alloc(arg->pool, (1 + rand_r(&arg->seed) % 64) * PAGE, PAGE,
+                                HEAP_MASK, slot))
+        {
+            arg->failures++;
+        }
+        else
+        {
+            (*slot)->ptr[0] = (unsigned char) (uintptr_t) slot;
+        }
+    }
+    for (ix = 0; ix < 8; ix++)
+    {
+        if (live[ix])
+            arg->failures += ion_pool_free(arg->pool, live[ix]) != 0;
+    }
+    return NULL;
+}
+
+static int thread_test(int fd)
+{
+    struct ion_pool *pool = ion_pool_create(fd, 2 << 20, PROT_READ | PROT_WRITE, MAP_SHARED);
+    struct thread_arg args[NUM_THREADS];
+    pthread_t threads[NUM_THREADS];
+    struct ion_pool_stats stats;
+    int ix;
+
+    CHECK(pool);
+    for (ix = 0; ix < NUM_THREADS; ix++)
+    {
+        args[ix].pool = pool;
+        args[ix].seed = ix + 1;
+        args[ix].failures = 0;
+        CHECK(!pthread_create(threads + ix, NULL, thread_run, args + ix));
+    }
+    for (ix = 0; ix < NUM_THREADS; ix++)
+    {
+        pthread_join(threads[ix], NULL);
+        CHECK(!args[ix].failures);
+    }
+
+    ion_pool_get_stats(pool, &stats);
+    CHECK(stats.hits > 0);
+    CHECK(stats.cached_bytes <= stats.max_bytes);
+    CHECK(live_buffers() == stats.cached_buffers);
+
+    ion_pool_destroy(pool);
+    CHECK(live_buffers() == 0);
+    return 0;
+}
+
+static const struct {
+    const char *name;
+    int (*run)(int fd);
+} tests[] = {
+    { "reuse", reuse_test },
+    { "size classes", size_class_test },
+    { "tiler", tiler_test },
+    { "limit and trim", limit_test },
+    { "retry after release", retry_test },
+    { "shared memory", shared_memory_test },
+    { "threads", thread_test },
+};
+
+int main(void)
+{
+    int fd, ix, failed = 0;
+    int num = sizeof(tests) / sizeof(tests[0]);
+
+    fd = ion_open();
+    if (fd < 0)
+    {
+        printf("could not open the fake ion device: %s\n", strerror(errno));
+        return 1;
+    }
+
+    for (ix = 0; ix < num; ix++)
+    {
+        int ret = tests[ix].run(fd);
+        printf("%s: %s\n", tests[ix].name, ret ? "FAILED" : "passed");
+        failed += ret != 0;
+    }
+    ion_close(fd);
+
+    printf("FAILED: %d, SUCCEEDED: %d\n", failed, num - failed);
+    return failed != 0;
+}
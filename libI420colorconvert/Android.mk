@@ -18,4 +18,22 @@ LOCAL_MODULE := libI420colorconvert
 
 include $(BUILD_HEAPTRACKED_SHARED_LIBRARY)
 
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    ColorConvertBenchmark.cpp
+
+LOCAL_C_INCLUDES:= \
+        $(TOP)/frameworks/base/include/media/stagefright/openmax \
+        $(TOP)/frameworks/media/libvideoeditor/include
+
+LOCAL_SHARED_LIBRARIES := \
+        libI420colorconvert
+
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_MODULE := i420colorconvert_benchmark
+
+include $(BUILD_EXECUTABLE)
+
 endif
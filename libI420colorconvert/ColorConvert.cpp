@@ -18,43 +18,145 @@
 #include <OMX_IVCommon.h>
 #include <string.h>
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Splits one row of interleaved UV samples into separate U and V rows.
+static void deinterleaveRow(const uint8_t *uv, uint8_t *u, uint8_t *v, size_t n) {
+    size_t x = 0;
+#if defined(__ARM_NEON__)
+    for (; x + 16 <= n; x += 16) {
+        uint8x16x2_t s = vld2q_u8(uv + 2 * x);
+        vst1q_u8(u + x, s.val[0]);
+        vst1q_u8(v + x, s.val[1]);
+    }
+#elif defined(__AVX2__)
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    for (; x + 32 <= n; x += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(uv + 2 * x));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(uv + 2 * x + 32));
+        __m256i su = _mm256_packus_epi16(_mm256_and_si256(a, mask),
+                                         _mm256_and_si256(b, mask));
+        __m256i sv = _mm256_packus_epi16(_mm256_srli_epi16(a, 8),
+                                         _mm256_srli_epi16(b, 8));
+        // packus works within 128-bit lanes, restore the sample order
+        _mm256_storeu_si256((__m256i *)(u + x), _mm256_permute4x64_epi64(su, 0xD8));
+        _mm256_storeu_si256((__m256i *)(v + x), _mm256_permute4x64_epi64(sv, 0xD8));
+    }
+#elif defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    for (; x + 16 <= n; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(uv + 2 * x));
+        __m128i b = _mm_loadu_si128((const __m128i *)(uv + 2 * x + 16));
+        _mm_storeu_si128((__m128i *)(u + x),
+                         _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128((__m128i *)(v + x),
+                         _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+#endif
+    for (; x < n; ++x) {
+        u[x] = uv[2 * x];
+        v[x] = uv[2 * x + 1];
+    }
+}
+
+// Merges one row of U and V samples into interleaved UV samples.
+static void interleaveRow(const uint8_t *u, const uint8_t *v, uint8_t *uv, size_t n) {
+    size_t x = 0;
+#if defined(__ARM_NEON__)
+    for (; x + 16 <= n; x += 16) {
+        uint8x16x2_t s;
+        s.val[0] = vld1q_u8(u + x);
+        s.val[1] = vld1q_u8(v + x);
+        vst2q_u8(uv + 2 * x, s);
+    }
+#elif defined(__AVX2__)
+    for (; x + 32 <= n; x += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(u + x));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(v + x));
+        __m256i lo = _mm256_unpacklo_epi8(a, b);
+        __m256i hi = _mm256_unpackhi_epi8(a, b);
+        // unpack works within 128-bit lanes, restore the sample order
+        _mm256_storeu_si256((__m256i *)(uv + 2 * x), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(uv + 2 * x + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+#elif defined(__SSE2__)
+    for (; x + 16 <= n; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(u + x));
+        __m128i b = _mm_loadu_si128((const __m128i *)(v + x));
+        _mm_storeu_si128((__m128i *)(uv + 2 * x), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(uv + 2 * x + 16), _mm_unpackhi_epi8(a, b));
+    }
+#endif
+    for (; x < n; ++x) {
+        uv[2 * x] = u[x];
+        uv[2 * x + 1] = v[x];
+    }
+}
+
 static int getDecoderOutputFormat() {
     return OMX_TI_COLOR_FormatYUV420PackedSemiPlanar;
 }
 
+struct DecoderOutputJob {
+    const uint8_t *srcY;
+    const uint8_t *srcUV;
+    size_t srcStride;
+    uint8_t *dstY;
+    uint8_t *dstU;
+    uint8_t *dstV;
+    size_t dstStrideY;
+    size_t dstStrideUV;
+    size_t chromaWidth;
+    int width;
+    int height;
+};
+
+static void convertDecoderOutputRows(const DecoderOutputJob *job, int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+        memcpy(job->dstY + y * job->dstStrideY, job->srcY + y * job->srcStride, job->width);
+    }
+
+    for (int y = begin / 2; y < (end + 1) / 2; ++y) {
+        deinterleaveRow(job->srcUV + y * job->srcStride,
+                        job->dstU + y * job->dstStrideUV,
+                        job->dstV + y * job->dstStrideUV,
+                        job->chromaWidth);
+    }
+}
+
+// srcWidth is the line stride of the decoder buffer, the UV plane
+// follows srcHeight luma lines. Only srcRect is converted.
+//
+// Odd sizes keep the original layout: (width + 1) / 2 chroma samples on
+// lines of width / 2 and (height + 1) / 2 chroma lines, so neighbouring
+// lines and planes overlap by a sample and only the last write counts.
 static int convertDecoderOutputToI420(
     void* srcBits, int srcWidth, int srcHeight, ARect srcRect, void* dstBits) {
 
-    const uint8_t *pSrc_y = (const uint8_t *)srcBits +
-        srcWidth * srcRect.top + srcRect.left;
-    const uint8_t *pSrc_uv = (const uint8_t *)pSrc_y +
-        srcWidth * (srcHeight - srcRect.top / 2);
-
+    DecoderOutputJob job;
     int dstWidth = srcRect.right - srcRect.left + 1;
     int dstHeight = srcRect.bottom - srcRect.top + 1;
-    size_t dst_y_size = dstWidth * dstHeight;
-    size_t dst_uv_stride = dstWidth / 2;
-    size_t dst_uv_size = dstWidth / 2 * dstHeight / 2;
-    uint8_t *pDst_y = (uint8_t *)dstBits;
-    uint8_t *pDst_u = pDst_y + dst_y_size;
-    uint8_t *pDst_v = pDst_u + dst_uv_size;
-
-    for (int y = 0; y < dstHeight; ++y) {
-        memcpy(pDst_y, pSrc_y, dstWidth);
-        pSrc_y += srcWidth;
-        pDst_y += dstWidth;
-    }
 
-    size_t tmp = (dstWidth + 1) / 2;
-    for (int y = 0; y < (dstHeight + 1) / 2; ++y) {
-        for (size_t x = 0; x < tmp; ++x) {
-            pDst_u[x] = pSrc_uv[2 * x];
-            pDst_v[x] = pSrc_uv[2 * x + 1];
-        }
-        pSrc_uv += srcWidth;
-        pDst_u += dst_uv_stride;
-        pDst_v += dst_uv_stride;
-    }
+    job.srcStride = srcWidth;
+    job.srcY = (const uint8_t *)srcBits + srcWidth * srcRect.top + srcRect.left;
+    job.srcUV = job.srcY + srcWidth * (srcHeight - srcRect.top / 2);
+
+    job.width = dstWidth;
+    job.height = dstHeight;
+    job.dstStrideY = dstWidth;
+    job.dstStrideUV = dstWidth / 2;
+    job.chromaWidth = (dstWidth + 1) / 2;
+    job.dstY = (uint8_t *)dstBits;
+    job.dstU = job.dstY + dstWidth * dstHeight;
+    job.dstV = job.dstU + dstWidth / 2 * dstHeight / 2;
+
+    convertDecoderOutputRows(&job, 0, dstHeight);
     return 0;
 }
 
@@ -62,30 +164,56 @@ static int getEncoderInputFormat() {
     return OMX_TI_COLOR_FormatYUV420PackedSemiPlanar;
 }
 
+struct EncoderInputJob {
+    const uint8_t *srcY;
+    const uint8_t *srcU;
+    const uint8_t *srcV;
+    size_t srcStrideY;
+    size_t srcStrideUV;
+    uint8_t *dstY;
+    uint8_t *dstUV;
+    size_t dstStride;
+    int width;
+    int height;
+};
+
+static void convertEncoderInputRows(const EncoderInputJob *job, int begin, int end) {
+    for (int y = begin; y < end; ++y) {
+        memcpy(job->dstY + y * job->dstStride, job->srcY + y * job->srcStrideY, job->width);
+    }
+
+    for (int y = begin / 2; y < end / 2; ++y) {
+        interleaveRow(job->srcU + y * job->srcStrideUV,
+                      job->srcV + y * job->srcStrideUV,
+                      job->dstUV + y * job->dstStride,
+                      job->width / 2);
+    }
+}
+
+// dstWidth is the line stride of the encoder buffer, the UV plane
+// follows dstHeight luma lines. The whole source frame is copied to the
+// top left corner, dstRect is not used.
 static int convertI420ToEncoderInput(
     void* srcBits, int srcWidth, int srcHeight,
     int dstWidth, int dstHeight, ARect dstRect,
     void* dstBits) {
-    uint8_t *pSrc_y = (uint8_t*) srcBits;
-    uint8_t *pDst_y = (uint8_t*) dstBits;
-    for(int i=0; i < srcHeight; i++) {
-        memcpy(pDst_y, pSrc_y, srcWidth);
-        pSrc_y += srcWidth;
-        pDst_y += dstWidth;
-    }
-    uint8_t* pSrc_u = (uint8_t*)srcBits + (srcWidth * srcHeight);
-    uint8_t* pSrc_v = (uint8_t*)pSrc_u + (srcWidth / 2) * (srcHeight / 2);
-    uint8_t* pDst_uv  = (uint8_t*)dstBits + dstWidth * dstHeight;
-
-    for(int i=0; i < srcHeight / 2; i++) {
-        for(int j=0, k=0; j < srcWidth / 2; j++, k+=2) {
-            pDst_uv[k] = pSrc_u[j];
-            pDst_uv[k+1] = pSrc_v[j];
-        }
-        pDst_uv += dstWidth;
-        pSrc_u += srcWidth / 2;
-        pSrc_v += srcWidth / 2;
-    }
+
+    EncoderInputJob job;
+    (void) dstRect;
+
+    job.srcStrideY = srcWidth;
+    job.srcStrideUV = srcWidth / 2;
+    job.srcY = (const uint8_t *)srcBits;
+    job.srcU = job.srcY + srcWidth * srcHeight;
+    job.srcV = job.srcU + (srcWidth / 2) * (srcHeight / 2);
+
+    job.width = srcWidth;
+    job.height = srcHeight;
+    job.dstStride = dstWidth;
+    job.dstY = (uint8_t *)dstBits;
+    job.dstUV = (uint8_t *)dstBits + dstWidth * dstHeight;
+
+    convertEncoderInputRows(&job, 0, srcHeight);
     return 0;
 }
 
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times the libI420colorconvert converters against the original
+ * byte-at-a-time loops and checks that both produce the same output,
+ * also for crop offsets and odd frame sizes.
+ *
+ * usage: i420colorconvert_benchmark [iterations]
+ */
+
+#include "II420ColorConverter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+extern "C" void getI420ColorConverter(II420ColorConverter *converter);
+
+/* The converters as they were before they were vectorized */
+static int refDecoderOutputToI420(
+    void* srcBits, int srcWidth, int srcHeight, ARect srcRect, void* dstBits) {
+
+    const uint8_t *pSrc_y = (const uint8_t *)srcBits +
+        srcWidth * srcRect.top + srcRect.left;
+    const uint8_t *pSrc_uv = (const uint8_t *)pSrc_y +
+        srcWidth * (srcHeight - srcRect.top / 2);
+
+    int dstWidth = srcRect.right - srcRect.left + 1;
+    int dstHeight = srcRect.bottom - srcRect.top + 1;
+    size_t dst_y_size = dstWidth * dstHeight;
+    size_t dst_uv_stride = dstWidth / 2;
+    size_t dst_uv_size = dstWidth / 2 * dstHeight / 2;
+    uint8_t *pDst_y = (uint8_t *)dstBits;
+    uint8_t *pDst_u = pDst_y + dst_y_size;
+    uint8_t *pDst_v = pDst_u + dst_uv_size;
+
+    for (int y = 0; y < dstHeight; ++y) {
+        memcpy(pDst_y, pSrc_y, dstWidth);
+        pSrc_y += srcWidth;
+        pDst_y += dstWidth;
+    }
+
+    size_t tmp = (dstWidth + 1) / 2;
+    for (int y = 0; y < (dstHeight + 1) / 2; ++y) {
+        for (size_t x = 0; x < tmp; ++x) {
+            pDst_u[x] = pSrc_uv[2 * x];
+            pDst_v[x] = pSrc_uv[2 * x + 1];
+        }
+        pSrc_uv += srcWidth;
+        pDst_u += dst_uv_stride;
+        pDst_v += dst_uv_stride;
+    }
+    return 0;
+}
+
+static int refI420ToEncoderInput(
+    void* srcBits, int srcWidth, int srcHeight,
+    int dstWidth, int dstHeight, ARect dstRect,
+    void* dstBits) {
+    (void) dstRect;
+    uint8_t *pSrc_y = (uint8_t*) srcBits;
+    uint8_t *pDst_y = (uint8_t*) dstBits;
+    for(int i=0; i < srcHeight; i++) {
+        memcpy(pDst_y, pSrc_y, srcWidth);
+        pSrc_y += srcWidth;
+        pDst_y += dstWidth;
+    }
+    uint8_t* pSrc_u = (uint8_t*)srcBits + (srcWidth * srcHeight);
+    uint8_t* pSrc_v = (uint8_t*)pSrc_u + (srcWidth / 2) * (srcHeight / 2);
+    uint8_t* pDst_uv  = (uint8_t*)dstBits + dstWidth * dstHeight;
+
+    for(int i=0; i < srcHeight / 2; i++) {
+        for(int j=0, k=0; j < srcWidth / 2; j++, k+=2) {
+            pDst_uv[k] = pSrc_u[j];
+            pDst_uv[k+1] = pSrc_v[j];
+        }
+        pDst_uv += dstWidth;
+        pSrc_u += srcWidth / 2;
+        pSrc_v += srcWidth / 2;
+    }
+    return 0;
+}
+
+static double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void fill(uint8_t *buf, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t)(rand() >> 4);
+    }
+}
+
+struct FrameSize {
+    int width;
+    int height;
+    int stride;
+};
+
+static const FrameSize sizes[] = {
+    { 640, 480, 640 },
+    { 1280, 720, 1280 },
+    { 1280, 720, 1536 },    /* padded decoder/encoder buffers */
+    { 1920, 1080, 2048 },
+};
+
+/* Decoder buffer geometry and the crop rectangle converted from it */
+struct DecoderCrop {
+    int stride;
+    int height;
+    ARect rect;     /* left, top, right, bottom */
+};
+
+static const DecoderCrop decoderCrops[] = {
+    { 640, 480, { 16, 8, 335, 247 } },
+    { 640, 480, { 3, 5, 323, 245 } },         /* odd offsets and size */
+    { 1536, 736, { 1, 2, 1281, 721 } },       /* odd offset and width */
+    { 1536, 736, { 32, 3, 1311, 723 } },      /* odd offset and height */
+    { 2048, 1104, { 0, 1, 1919, 1081 } },     /* odd height */
+    { 2048, 1104, { 2, 4, 1921, 1083 } },     /* 1080p crop */
+};
+
+/* Source frame size and encoder buffer geometry */
+struct EncoderCrop {
+    int width;
+    int height;
+    int stride;
+    int bufferHeight;
+    ARect rect;     /* ignored by the converter */
+};
+
+static const EncoderCrop encoderCrops[] = {
+    { 320, 240, 640, 480, { 16, 8, 335, 247 } },
+    { 321, 241, 384, 256, { 3, 5, 323, 245 } },   /* odd size */
+    { 1281, 720, 1536, 736, { 1, 2, 1281, 721 } },
+    { 1920, 1081, 2048, 1088, { 0, 1, 1919, 1081 } },
+};
+
+/* Converted frames may spill past the planes, leave room for it */
+#define SLACK(stride) (2 * (stride) + 64)
+
+static int checkDecoderCrops(II420ColorConverter &converter) {
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(decoderCrops) / sizeof(decoderCrops[0]); i++) {
+        const DecoderCrop &c = decoderCrops[i];
+        int width = c.rect.right - c.rect.left + 1;
+        int height = c.rect.bottom - c.rect.top + 1;
+        size_t srcSize = c.stride * c.height * 3 / 2 + SLACK(c.stride);
+        size_t dstSize = width * height * 3 / 2 + SLACK(width);
+        uint8_t *src = (uint8_t *)malloc(srcSize);
+        uint8_t *refOut = (uint8_t *)malloc(dstSize);
+        uint8_t *newOut = (uint8_t *)malloc(dstSize);
+
+        if (!src || !refOut || !newOut) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+
+        fill(src, srcSize);
+        memset(refOut, 0, dstSize);
+        memset(newOut, 0, dstSize);
+
+        refDecoderOutputToI420(src, c.stride, c.height, c.rect, refOut);
+        converter.convertDecoderOutputToI420(src, c.stride, c.height, c.rect, newOut);
+
+        if (memcmp(refOut, newOut, dstSize)) {
+            printf("decoder output %dx%d at %d,%d in %dx%d MISMATCH\n",
+                   width, height, c.rect.left, c.rect.top, c.stride, c.height);
+            failures++;
+        }
+
+        free(src);
+        free(refOut);
+        free(newOut);
+    }
+
+    return failures;
+}
+
+static int checkEncoderCrops(II420ColorConverter &converter) {
+    int failures = 0;
+
+    for (size_t i = 0; i < sizeof(encoderCrops) / sizeof(encoderCrops[0]); i++) {
+        const EncoderCrop &c = encoderCrops[i];
+        size_t srcSize = c.width * c.height * 3 / 2 + SLACK(c.width);
+        size_t dstSize = c.stride * c.bufferHeight * 3 / 2 + SLACK(c.stride);
+        uint8_t *src = (uint8_t *)malloc(srcSize);
+        uint8_t *refOut = (uint8_t *)malloc(dstSize);
+        uint8_t *newOut = (uint8_t *)malloc(dstSize);
+
+        if (!src || !refOut || !newOut) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+
+        fill(src, srcSize);
+        memset(refOut, 0, dstSize);
+        memset(newOut, 0, dstSize);
+
+        refI420ToEncoderInput(src, c.width, c.height, c.stride, c.bufferHeight, c.rect, refOut);
+        converter.convertI420ToEncoderInput(src, c.width, c.height, c.stride, c.bufferHeight,
+                                            c.rect, newOut);
+
+        if (memcmp(refOut, newOut, dstSize)) {
+            printf("encoder input %dx%d in %dx%d, rect at %d,%d MISMATCH\n",
+                   c.width, c.height, c.stride, c.bufferHeight, c.rect.left, c.rect.top);
+            failures++;
+        }
+
+        free(src);
+        free(refOut);
+        free(newOut);
+    }
+
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    II420ColorConverter converter;
+    int iterations = argc > 1 ? atoi(argv[1]) : 100;
+    int failures = 0;
+
+    if (iterations <= 0) {
+        iterations = 100;
+    }
+
+    getI420ColorConverter(&converter);
+
+    failures += checkDecoderCrops(converter);
+    failures += checkEncoderCrops(converter);
+
+    printf("%-16s %-12s %12s %12s %8s\n", "frame", "converter", "orig (us)", "new (us)", "speedup");
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        const FrameSize &fs = sizes[i];
+        size_t nv12Size = fs.stride * fs.height * 3 / 2;
+        size_t i420Size = fs.width * fs.height * 3 / 2;
+        uint8_t *nv12 = (uint8_t *)malloc(nv12Size);
+        uint8_t *i420 = (uint8_t *)malloc(i420Size);
+        uint8_t *refOut = (uint8_t *)malloc(nv12Size > i420Size ? nv12Size : i420Size);
+        uint8_t *newOut = (uint8_t *)malloc(nv12Size > i420Size ? nv12Size : i420Size);
+        char name[32];
+        ARect rect;
+        double t0, tRef, tNew;
+
+        if (!nv12 || !i420 || !refOut || !newOut) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+
+        fill(nv12, nv12Size);
+        fill(i420, i420Size);
+        rect.left = 0;
+        rect.top = 0;
+        rect.right = fs.width - 1;
+        rect.bottom = fs.height - 1;
+        snprintf(name, sizeof(name), "%dx%d/%d", fs.width, fs.height, fs.stride);
+
+        /* decoder output (NV12 with stride) to I420 */
+        t0 = now_us();
+        for (int n = 0; n < iterations; n++) {
+            refDecoderOutputToI420(nv12, fs.stride, fs.height, rect, refOut);
+        }
+        tRef = (now_us() - t0) / iterations;
+
+        t0 = now_us();
+        for (int n = 0; n < iterations; n++) {
+            converter.convertDecoderOutputToI420(nv12, fs.stride, fs.height, rect, newOut);
+        }
+        tNew = (now_us() - t0) / iterations;
+
+        if (memcmp(refOut, newOut, i420Size)) {
+            printf("%-16s decoder output MISMATCH\n", name);
+            failures++;
+        }
+        printf("%-16s %-12s %12.1f %12.1f %7.2fx\n", name, "nv12->i420", tRef, tNew, tRef / tNew);
+
+        /* I420 to encoder input (NV12 with stride) */
+        memset(refOut, 0, nv12Size);
+        memset(newOut, 0, nv12Size);
+
+        t0 = now_us();
+        for (int n = 0; n < iterations; n++) {
+            refI420ToEncoderInput(i420, fs.width, fs.height, fs.stride, fs.height, rect, refOut);
+        }
+        tRef = (now_us() - t0) / iterations;
+
+        t0 = now_us();
+        for (int n = 0; n < iterations; n++) {
+            converter.convertI420ToEncoderInput(i420, fs.width, fs.height, fs.stride, fs.height,
+                                                rect, newOut);
+        }
+        tNew = (now_us() - t0) / iterations;
+
+        if (memcmp(refOut, newOut, nv12Size)) {
+            printf("%-16s encoder input MISMATCH\n", name);
+            failures++;
+        }
+        printf("%-16s %-12s %12.1f %12.1f %7.2fx\n", name, "i420->nv12", tRef, tNew, tRef / tNew);
+
+        free(nv12);
+        free(i420);
+        free(refOut);
+        free(newOut);
+    }
+
+    return failures ? 1 : 0;
+}
@@ -8,6 +8,7 @@ LOCAL_PRELINK_MODULE := false
 
 LOCAL_SRC_FILES:= \
     DebugUtils.cpp \
+    BinaryLog.cpp \
     MessageQueue.cpp \
     Semaphore.cpp \
     ErrorUtils.cpp
@@ -37,7 +38,24 @@ ifdef TI_UTILS_MESSAGE_QUEUE_DEBUG_FUNCTION_NAMES
     LOCAL_CFLAGS += -DTI_UTILS_FUNCTION_LOGGER_ENABLE
 endif
 
+ifdef TI_UTILS_MESSAGE_QUEUE_DEBUG_BINARY_LOG
+    # Record debug logs into per-thread binary rings instead of logcat
+    LOCAL_CFLAGS += -DTI_UTILS_BINARY_LOG_ENABLE
+endif
+
 LOCAL_MODULE:= libtiutils
 LOCAL_MODULE_TAGS:= optional
 
 include $(BUILD_HEAPTRACKED_SHARED_LIBRARY)
+
+################################################
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    binlog_decode.cpp
+
+LOCAL_MODULE:= tiutils-binlog-decode
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_HOST_EXECUTABLE)
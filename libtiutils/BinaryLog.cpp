@@ -0,0 +1,529 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TiBinaryLog"
+
+#include "DebugUtils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+
+
+
+namespace Ti {
+
+
+
+
+using namespace BinaryLogFile;
+
+
+
+
+// records kept for each thread, must be a power of two
+static const uint32_t kBinaryLogRingRecords = 512;
+
+// call sites are looked up without locking, so they live in a fixed table
+static const int kBinaryLogMaxSites = 8192;
+
+static const int kBinaryLogFallbackMessageSize = 256;
+
+
+
+
+struct BinaryLogRing
+{
+    volatile uint32_t head;
+    Record records[kBinaryLogRingRecords];
+};
+
+
+struct BinaryLogSite
+{
+    int priority;
+    int line;
+    int argCount;
+    uint8_t argTypes[kMaxArgs];
+    android::String8 tag;
+    android::String8 file;
+    android::String8 function;
+    android::String8 format;
+};
+
+
+
+
+// protects site registration and ring allocation, so dump() sees both complete
+static android::Mutex sBinaryLogMutex;
+
+// entry i holds site id i + 1, published before the id is stored at the call site
+static BinaryLogSite * sBinaryLogSites[kBinaryLogMaxSites];
+static int sBinaryLogSiteCount = 0;
+
+
+
+
+static bool encodeArgs(const BinaryLogSite * const site, uint8_t * out, uint8_t * const end, va_list args)
+{
+    for ( int i = 0; i < site->argCount; ++i )
+    {
+        switch ( site->argTypes[i] )
+        {
+            case ARG_INT32:
+            {
+                const int32_t value = va_arg(args, int32_t);
+                if ( end - out < int(sizeof(value)) )
+                    return false;
+                memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+                break;
+            }
+
+            case ARG_INT64:
+            {
+                const int64_t value = va_arg(args, int64_t);
+                if ( end - out < int(sizeof(value)) )
+                    return false;
+                memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+                break;
+            }
+
+            case ARG_DOUBLE:
+            {
+                const double value = va_arg(args, double);
+                if ( end - out < int(sizeof(value)) )
+                    return false;
+                memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+                break;
+            }
+
+            case ARG_POINTER:
+            {
+                const uint64_t value = reinterpret_cast<uintptr_t>(va_arg(args, void *));
+                if ( end - out < int(sizeof(value)) )
+                    return false;
+                memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+                break;
+            }
+
+            case ARG_STRING:
+            {
+                const char * const value = va_arg(args, const char *);
+                if ( end - out < 1 )
+                    return false;
+
+                if ( !value )
+                {
+                    *out++ = kNullString;
+                    break;
+                }
+
+                // long strings are cut to what is left of the record
+                int length = 0;
+                const int maxLength = end - out - 1 < kNullString ? end - out - 1 : kNullString - 1;
+                while ( length < maxLength && value[length] )
+                    ++length;
+
+                *out++ = uint8_t(length);
+                memcpy(out, value, length);
+                out += length;
+                break;
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+
+Record * BinaryLog::beginRecord(const int32_t site, const uint8_t kind, BinaryLogRing ** const ringOut)
+{
+    Debug::ThreadInfo * const threadInfo = Debug::instance()->findCurrentThreadInfo();
+
+    // only the owning thread writes its ring, so it is read without locking
+    BinaryLogRing * ring = threadInfo->binaryLogRing;
+    if ( !ring )
+    {
+        ring = new BinaryLogRing;
+        memset(ring, 0, sizeof(BinaryLogRing));
+
+        android::Mutex::Autolock locker(sBinaryLogMutex);
+        (void)locker;
+
+        threadInfo->binaryLogRing = ring;
+    }
+
+    Record * const record = ring->records + (ring->head & (kBinaryLogRingRecords - 1));
+
+    // zero sequence marks the record as being written for dump()
+    android_atomic_acquire_store(0, reinterpret_cast<volatile int32_t *>(&record->seq));
+
+    record->threadId = threadInfo->threadId;
+    record->timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    record->site = uint16_t(site);
+    record->indent = threadInfo->callOffset > 0xff ? 0xff : uint8_t(threadInfo->callOffset);
+    record->flags = kind;
+
+    *ringOut = ring;
+    return record;
+}
+
+
+void BinaryLog::commitRecord(BinaryLogRing * const ring)
+{
+    const uint32_t head = ring->head;
+    Record * const record = ring->records + (head & (kBinaryLogRingRecords - 1));
+
+    android_atomic_release_store(head + 1, reinterpret_cast<volatile int32_t *>(&record->seq));
+    android_atomic_release_store(head + 1, reinterpret_cast<volatile int32_t *>(&ring->head));
+}
+
+
+int32_t BinaryLog::registerSite(int32_t * const site, const char * const tag, const int priority,
+        const char * const file, const int line, const char * const function, const char * const format)
+{
+    android::Mutex::Autolock locker(sBinaryLogMutex);
+    (void)locker;
+
+    // another thread may have registered the site while we waited
+    if ( *site != 0 )
+        return *site;
+
+    int32_t id = -1;
+
+    BinaryLogSite * const info = new BinaryLogSite;
+    info->priority = priority;
+    info->line = line;
+    info->argCount = 0;
+
+    bool supported = sBinaryLogSiteCount < kBinaryLogMaxSites;
+
+    Conversion conversion;
+    const char * p = format;
+    while ( supported && nextConversion(p, &conversion) )
+    {
+        if ( conversion.type == ARG_INVALID ||
+             info->argCount + conversion.stars + 1 > kMaxArgs )
+        {
+            supported = false;
+            break;
+        }
+
+        // '*' width and precision are passed before the value
+        for ( int i = 0; i < conversion.stars; ++i )
+            info->argTypes[info->argCount++] = ARG_INT32;
+        info->argTypes[info->argCount++] = conversion.type;
+
+        p = conversion.end;
+    }
+
+    if ( supported )
+    {
+        info->tag = tag;
+        info->file = file;
+        info->function = function;
+        info->format = format;
+
+        sBinaryLogSites[sBinaryLogSiteCount++] = info;
+        id = sBinaryLogSiteCount;
+    }
+    else
+    {
+        // the call site falls back to formatting on the spot
+        delete info;
+    }
+
+    android_atomic_release_store(id, site);
+
+    return id;
+}
+
+
+void BinaryLog::log(int32_t * const site, const char * const tag, const int priority,
+        const char * const file, const int line, const char * const function, const char * const format, ...)
+{
+    int32_t id = android_atomic_acquire_load(site);
+    if ( id == 0 )
+        id = registerSite(site, tag, priority, file, line, function, format);
+
+    va_list args;
+    va_start(args, format);
+
+    if ( id < 0 )
+    {
+        char message[kBinaryLogFallbackMessageSize];
+        vsnprintf(message, sizeof(message), format, args);
+        __android_log_print(priority, tag, "(%x) %s:%d %s - %s",
+                reinterpret_cast<int>(androidGetThreadId()), file, line, function, message);
+    }
+    else
+    {
+        writeRecord(id, args);
+    }
+
+    va_end(args);
+}
+
+
+void BinaryLog::logAndFormat(int32_t * const site, const char * const tag, const int priority,
+        const char * const file, const int line, const char * const function,
+        char * const message, const size_t messageSize, const char * const format, ...)
+{
+    int32_t id = android_atomic_acquire_load(site);
+    if ( id == 0 )
+        id = registerSite(site, tag, priority, file, line, function, format);
+
+    va_list args;
+    va_start(args, format);
+
+    va_list textArgs;
+    va_copy(textArgs, args);
+    vsnprintf(message, messageSize, format, textArgs);
+    va_end(textArgs);
+
+    // without a site the caller's text log is all there is
+    if ( id > 0 )
+        writeRecord(id, args);
+
+    va_end(args);
+}
+
+
+void BinaryLog::writeRecord(const int32_t id, va_list args)
+{
+    BinaryLogRing * ring;
+    Record * const record = beginRecord(id, RECORD_LOG, &ring);
+
+    if ( !encodeArgs(sBinaryLogSites[id - 1], record->payload,
+                record->payload + sizeof(record->payload), args) )
+        record->flags |= kRecordTruncated;
+
+    commitRecord(ring);
+}
+
+
+void BinaryLog::functionEnter(int32_t * const site, const char * const tag,
+        const char * const file, const int line, const char * const function)
+{
+    int32_t id = android_atomic_acquire_load(site);
+    if ( id == 0 )
+        id = registerSite(site, tag, ANDROID_LOG_DEBUG, file, line, function, "");
+    if ( id < 0 )
+        return;
+
+    BinaryLogRing * ring;
+    beginRecord(id, RECORD_ENTER, &ring);
+    commitRecord(ring);
+}
+
+
+void BinaryLog::functionExit(const int32_t * const site, const int exitLine)
+{
+    const int32_t id = android_atomic_acquire_load(site);
+    if ( id <= 0 )
+        return;
+
+    BinaryLogRing * ring;
+    Record * const record = beginRecord(id, RECORD_EXIT, &ring);
+
+    const int32_t line = exitLine;
+    memcpy(record->payload, &line, sizeof(line));
+
+    commitRecord(ring);
+}
+
+
+
+
+static bool writeAll(const int fd, const void * const data, const size_t size)
+{
+    const char * p = static_cast<const char *>(data);
+    size_t left = size;
+    while ( left > 0 )
+    {
+        const ssize_t written = write(fd, p, left);
+        if ( written < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            return false;
+        }
+        p += written;
+        left -= written;
+    }
+    return true;
+}
+
+
+static bool writeString(const int fd, const android::String8 & string)
+{
+    return writeAll(fd, string.string(), string.length());
+}
+
+
+android::status_t BinaryLog::dump(const int fd)
+{
+    android::Mutex::Autolock locker(sBinaryLogMutex);
+    (void)locker;
+
+    // every slot that ever logged has a ring, live thread or not
+    android::sp<Debug::Data> data = Debug::instance()->mData;
+    android::Vector<BinaryLogRing*> rings;
+    for ( int i = 0; i < int(data->threads.size()); ++i )
+    {
+        BinaryLogRing * const ring = data->threads.itemAt(i)->binaryLogRing;
+        if ( ring )
+            rings.add(ring);
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.recordSize = sizeof(Record);
+    header.siteCount = sBinaryLogSiteCount;
+    header.ringCount = rings.size();
+    header.ringRecords = kBinaryLogRingRecords;
+
+    if ( !writeAll(fd, &header, sizeof(header)) )
+        return -errno;
+
+    for ( int i = 0; i < sBinaryLogSiteCount; ++i )
+    {
+        const BinaryLogSite * const info = sBinaryLogSites[i];
+
+        Site site;
+        memset(&site, 0, sizeof(site));
+        site.id = uint16_t(i + 1);
+        site.priority = uint8_t(info->priority);
+        site.argCount = uint8_t(info->argCount);
+        site.line = info->line;
+        site.tagLength = uint16_t(info->tag.length());
+        site.fileLength = uint16_t(info->file.length());
+        site.functionLength = uint16_t(info->function.length());
+        site.formatLength = uint16_t(info->format.length());
+
+        if ( !writeAll(fd, &site, sizeof(site)) ||
+             !writeAll(fd, info->argTypes, info->argCount) ||
+             !writeString(fd, info->tag) ||
+             !writeString(fd, info->file) ||
+             !writeString(fd, info->function) ||
+             !writeString(fd, info->format) )
+            return -errno;
+    }
+
+    Record * const records = new Record[kBinaryLogRingRecords];
+
+    for ( int i = 0; i < int(rings.size()); ++i )
+    {
+        BinaryLogRing * const ring = rings.itemAt(i);
+
+        Ring fileRing;
+        memset(&fileRing, 0, sizeof(fileRing));
+        fileRing.head = android_atomic_acquire_load(reinterpret_cast<volatile int32_t *>(&ring->head));
+
+        // the owning thread keeps logging while we copy, drop records it touched
+        for ( uint32_t r = 0; r < kBinaryLogRingRecords; ++r )
+        {
+            volatile int32_t * const seq = reinterpret_cast<volatile int32_t *>(&ring->records[r].seq);
+            const int32_t before = android_atomic_acquire_load(seq);
+
+            memcpy(&records[r], &ring->records[r], sizeof(Record));
+
+            if ( before == 0 || android_atomic_release_cas(before, before, seq) != 0 )
+                memset(&records[r], 0, sizeof(Record));
+            else
+                records[r].seq = before;
+        }
+
+        if ( !writeAll(fd, &fileRing, sizeof(fileRing)) ||
+             !writeAll(fd, records, sizeof(Record) * kBinaryLogRingRecords) )
+        {
+            delete [] records;
+            return -errno;
+        }
+    }
+
+    delete [] records;
+
+    return android::NO_ERROR;
+}
+
+
+android::status_t BinaryLog::save(const char * const path)
+{
+    if ( !path )
+        return android::BAD_VALUE;
+
+    // write to a temporary file first so readers never see a partial log
+    char tmpPath[PATH_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    const int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 )
+    {
+        LOGE("Unable to create binary log file %s: %s", tmpPath, strerror(errno));
+        return -errno;
+    }
+
+    android::status_t ret = dump(fd);
+    close(fd);
+
+    if ( ret == android::NO_ERROR && rename(tmpPath, path) != 0 )
+        ret = -errno;
+
+    if ( ret != android::NO_ERROR )
+    {
+        LOGE("Unable to save binary log to %s: %d", path, ret);
+        unlink(tmpPath);
+    }
+
+    return ret;
+}
+
+
+void BinaryLog::saveIfRequested()
+{
+    char path[PROPERTY_VALUE_MAX];
+
+    property_get(TI_UTILS_BINARY_LOG_FILE_PROPERTY, path, "");
+    if ( path[0] != '\0' )
+        save(path);
+}
+
+
+
+
+} // namespace Ti
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BINARY_LOG_FORMAT_H
+#define BINARY_LOG_FORMAT_H
+
+// Layout of the binary log file, shared between Ti::BinaryLog and the host
+// decoder. Only plain C headers may be included here.
+
+#include <stdint.h>
+#include <string.h>
+
+
+
+
+namespace Ti {
+namespace BinaryLogFile {
+
+
+
+
+static const uint32_t kMagic = 0x474c4254; // "TBLG"
+static const uint32_t kVersion = 1;
+
+static const int kRecordSize = 128;
+static const int kMaxArgs = 16;
+
+enum RecordKind
+{
+    RECORD_LOG = 0,
+    RECORD_ENTER,
+    RECORD_EXIT
+};
+
+// record flags
+static const uint8_t kRecordKindMask = 0x03;
+static const uint8_t kRecordTruncated = 0x80;
+
+enum ArgType
+{
+    ARG_INT32 = 0,
+    ARG_INT64,
+    ARG_DOUBLE,
+    ARG_POINTER,
+    ARG_STRING,
+    ARG_INVALID
+};
+
+// string arguments are stored as a length byte followed by the characters,
+// this length marks a null pointer
+static const uint8_t kNullString = 0xff;
+
+
+
+
+// The file is a Header, followed by siteCount Site entries and ringCount
+// Ring entries. All fields are in the byte order of the device.
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t siteCount;
+    uint32_t ringCount;
+    uint32_t ringRecords;
+};
+
+// One per logging call site. Followed by argCount ArgType bytes and the tag,
+// file, function and format strings, without terminators.
+struct Site
+{
+    uint16_t id;
+    uint8_t priority;
+    uint8_t argCount;
+    int32_t line;
+    uint16_t tagLength;
+    uint16_t fileLength;
+    uint16_t functionLength;
+    uint16_t formatLength;
+};
+
+// One per thread slot. Followed by ringRecords Record entries, records with
+// a zero sequence number were never written.
+struct Ring
+{
+    uint32_t head;
+    uint32_t reserved;
+};
+
+struct Record
+{
+    uint32_t seq;
+    int32_t threadId;
+    int64_t timestamp;
+    uint16_t site;
+    uint8_t indent;
+    uint8_t flags;
+    uint8_t payload[kRecordSize - 20];
+};
+
+
+
+
+// A printf conversion located in a format string
+struct Conversion
+{
+    const char * start;
+    const char * end;
+    int stars;
+    ArgType type;
+};
+
+
+// Finds the next conversion in format, skipping literal text and "%%".
+// Returns false at the end of the string. Integer conversions are sized
+// by the ABI of the caller, so the decoder relies on the types stored in
+// the file rather than parsing the format again.
+inline bool nextConversion(const char * format, Conversion * const conversion)
+{
+    const char * p = format;
+    for ( ;; )
+    {
+        p = strchr(p, '%');
+        if ( !p )
+            return false;
+        if ( p[1] != '%' )
+            break;
+        p += 2;
+    }
+
+    conversion->start = p++;
+    conversion->stars = 0;
+
+    while ( *p && strchr("-+ #0'", *p) )
+        ++p;
+
+    if ( *p == '*' )
+    {
+        ++conversion->stars;
+        ++p;
+    }
+    else
+    {
+        while ( *p >= '0' && *p <= '9' )
+            ++p;
+    }
+
+    if ( *p == '.' )
+    {
+        ++p;
+        if ( *p == '*' )
+        {
+            ++conversion->stars;
+            ++p;
+        }
+        else
+        {
+            while ( *p >= '0' && *p <= '9' )
+                ++p;
+        }
+    }
+
+    int longs = 0;
+    bool sizeModifier = false;
+    while ( *p && strchr("hlLqjzt", *p) )
+    {
+        if ( *p == 'l' )
+            ++longs;
+        else if ( *p == 'q' || *p == 'L' || *p == 'j' )
+            longs = 2;
+        else if ( *p == 'z' || *p == 't' )
+            sizeModifier = true;
+        ++p;
+    }
+
+    switch ( *p )
+    {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            if ( longs >= 2 )
+                conversion->type = ARG_INT64;
+            else if ( longs == 1 )
+                conversion->type = sizeof(long) == 8 ? ARG_INT64 : ARG_INT32;
+            else if ( sizeModifier )
+                conversion->type = sizeof(size_t) == 8 ? ARG_INT64 : ARG_INT32;
+            else
+                conversion->type = ARG_INT32;
+            break;
+
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            conversion->type = longs >= 2 ? ARG_INVALID : ARG_DOUBLE;
+            break;
+
+        case 'p':
+            conversion->type = ARG_POINTER;
+            break;
+
+        case 's':
+            conversion->type = ARG_STRING;
+            break;
+
+        default:
+            // %n, wide characters and anything unknown
+            conversion->type = ARG_INVALID;
+            break;
+    }
+
+    if ( *p )
+        ++p;
+    conversion->end = p;
+
+    return true;
+}
+
+
+
+
+} // namespace BinaryLogFile
+} // namespace Ti
+
+
+
+
+#endif // BINARY_LOG_FORMAT_H
@@ -47,6 +47,7 @@ Debug Debug::sInstance;
 
 Debug::Debug()
 {
+    pthread_key_create(&mThreadKey, releaseThread);
     grow();
 }
 
@@ -91,6 +92,47 @@ Debug::ThreadInfo * Debug::registerThread(Data * const data, const int32_t threa
 }
 
 
+Debug::ThreadInfo * Debug::registerCurrentThread()
+{
+    const int32_t threadId = reinterpret_cast<int32_t>(androidGetThreadId());
+
+    // retain reference to threads data
+    android::sp<Data> data = mData;
+
+    // this thread has not been registered yet,
+    // try to find empty thread info slot
+    while ( true )
+    {
+        ThreadInfo * const threadInfo = registerThread(data.get(), threadId);
+        if ( threadInfo )
+        {
+            pthread_setspecific(mThreadKey, threadInfo);
+            return threadInfo;
+        }
+
+        // failed registering thread, because all slots are occupied
+        // grow the data and try again
+        grow();
+
+        data = mData;
+    }
+
+    // should never reach here
+    _DBGUTILS_PLAIN_ASSERT(false);
+    return 0;
+}
+
+
+void Debug::releaseThread(void * const data)
+{
+    ThreadInfo * const threadInfo = static_cast<ThreadInfo*>(data);
+
+    // the slot, including its binary log ring, is handed to the next new thread
+    threadInfo->callOffset = 0;
+    android_atomic_release_store(0, &threadInfo->threadId);
+}
+
+
 
 
 } // namespace Ti
@@ -17,10 +17,15 @@
 #ifndef DEBUG_UTILS_H
 #define DEBUG_UTILS_H
 
+#include <pthread.h>
+#include <stdarg.h>
 #include <android/log.h>
+#include <utils/Errors.h>
 #include <utils/threads.h>
 #include <utils/Vector.h>
 
+#include "BinaryLogFormat.h"
+
 
 
 
@@ -53,6 +58,11 @@ private:
 
 
 
+struct BinaryLogRing;
+
+
+
+
 class Debug
 {
 public:
@@ -66,11 +76,15 @@ private:
     {
     public:
         ThreadInfo() :
-            threadId(0), callOffset(0)
+            threadId(0), callOffset(0), binaryLogRing(0)
         {}
 
         volatile int32_t threadId;
         int callOffset;
+
+        // allocated by the owning thread on its first binary log record,
+        // kept when the slot is reused so records survive thread exit
+        BinaryLogRing * volatile binaryLogRing;
     };
 
     class Data : public android::RefBase
@@ -89,18 +103,69 @@ private:
 
     void grow();
     ThreadInfo * registerThread(Data * data, int32_t threadId);
+    ThreadInfo * registerCurrentThread();
     ThreadInfo * findCurrentThreadInfo();
     void addOffsetForCurrentThread(int offset);
 
+    static void releaseThread(void * threadInfo);
+
 private:
     static Debug sInstance;
 
     mutable android::Mutex mMutex;
     android::sp<Data> mData;
 
+    // per thread ThreadInfo, so lookups don't have to scan mData
+    pthread_key_t mThreadKey;
+
     friend class FunctionLogger;
+    friend class BinaryLog;
+};
+
+
+
+
+// Deferred logging backend, selected with TI_UTILS_BINARY_LOG_ENABLE.
+// Instead of formatting, a log call stores its call site id, a timestamp
+// and the raw arguments into a ring owned by the calling thread. Call sites
+// are registered once, the first time they are hit. The rings are written
+// with save() and turned back into text on the host by tiutils-binlog-decode.
+class BinaryLog
+{
+public:
+    static void log(int32_t * site, const char * tag, int priority,
+            const char * file, int line, const char * function, const char * format, ...);
+
+    // records like log() and also formats the message into message, so a
+    // caller logging the text as well evaluates its arguments only once
+    static void logAndFormat(int32_t * site, const char * tag, int priority,
+            const char * file, int line, const char * function,
+            char * message, size_t messageSize, const char * format, ...);
+
+    static void functionEnter(int32_t * site, const char * tag,
+            const char * file, int line, const char * function);
+    static void functionExit(const int32_t * site, int exitLine);
+
+    static android::status_t dump(int fd);
+    static android::status_t save(const char * path);
+
+    // saves to the path in TI_UTILS_BINARY_LOG_FILE_PROPERTY, if it is set
+    static void saveIfRequested();
+
+private:
+    static BinaryLogFile::Record * beginRecord(int32_t site, uint8_t kind, BinaryLogRing ** ring);
+    static void commitRecord(BinaryLogRing * ring);
+    static void writeRecord(int32_t id, va_list args);
+
+    static int32_t registerSite(int32_t * site, const char * tag, int priority,
+            const char * file, int line, const char * function, const char * format);
 };
 
+#define TI_UTILS_BINARY_LOG_FILE_PROPERTY "debug.tiutils.binlog.file"
+
+// longest error text logged alongside its binary record
+#define TI_UTILS_BINARY_LOG_TEXT_SIZE 256
+
 
 
 
@@ -108,11 +173,14 @@ class FunctionLogger
 {
 public:
     FunctionLogger(const char * file, int line, const char * function);
+    FunctionLogger(int32_t * binaryLogSite, const char * tag,
+            const char * file, int line, const char * function);
     ~FunctionLogger();
 
     void setExitLine(int line);
 
 private:
+    int32_t * const mBinaryLogSite;
     const char * const mFile;
     const int mLine;
     const char * const mFunction;
@@ -123,7 +191,12 @@ private:
 
 
 
-#ifdef TI_UTILS_FUNCTION_LOGGER_ENABLE
+#if defined(TI_UTILS_FUNCTION_LOGGER_ENABLE) && defined(TI_UTILS_BINARY_LOG_ENABLE)
+#   define LOG_FUNCTION_NAME \
+        static int32_t __function_logger_site = 0; \
+        Ti::FunctionLogger __function_logger_instance(&__function_logger_site, LOG_TAG, __FILE__, __LINE__, __FUNCTION__);
+#   define LOG_FUNCTION_NAME_EXIT __function_logger_instance.setExitLine(__LINE__);
+#elif defined(TI_UTILS_FUNCTION_LOGGER_ENABLE)
 #   define LOG_FUNCTION_NAME Ti::FunctionLogger __function_logger_instance(__FILE__, __LINE__, __FUNCTION__);
 #   define LOG_FUNCTION_NAME_EXIT __function_logger_instance.setExitLine(__LINE__);
 #else
@@ -154,10 +227,43 @@ private:
                 file, line, function, __VA_ARGS__);                           \
     } while (0)
 
-#define DBGUTILS_LOGV(...) DBGUTILS_LOGV_FULL(ANDROID_LOG_VERBOSE, __FILE__, __LINE__, __FUNCTION__, TI_UTILS_DEBUG_TIMESTAMP_TOKEN "(%x) %s  %s:%d %s - " __VA_ARGS__, "")
-#define DBGUTILS_LOGD(...) DBGUTILS_LOGV_FULL(ANDROID_LOG_DEBUG,   __FILE__, __LINE__, __FUNCTION__, TI_UTILS_DEBUG_TIMESTAMP_TOKEN "(%x) %s  %s:%d %s - " __VA_ARGS__, "")
-#define DBGUTILS_LOGE(...) DBGUTILS_LOGV_FULL(ANDROID_LOG_ERROR,   __FILE__, __LINE__, __FUNCTION__, TI_UTILS_DEBUG_TIMESTAMP_TOKEN "(%x) %s  %s:%d %s - " __VA_ARGS__, "")
-#define DBGUTILS_LOGF(...) DBGUTILS_LOGV_FULL(ANDROID_LOG_FATAL,   __FILE__, __LINE__, __FUNCTION__, TI_UTILS_DEBUG_TIMESTAMP_TOKEN "(%x) %s  %s:%d %s - " __VA_ARGS__, "")
+#define DBGUTILS_LOGV_BINARY(priority, file, line, function, format, ...)     \
+    do                                                                        \
+    {                                                                         \
+        static int32_t __dbgutils_binary_log_site = 0;                        \
+        Ti::BinaryLog::log(&__dbgutils_binary_log_site, LOG_TAG, priority,    \
+                file, line, function, format, __VA_ARGS__);                   \
+    } while (0)
+
+// the arguments are evaluated once, for both the record and the text
+#define DBGUTILS_LOGV_BINARY_AND_TEXT(priority, format, ...)                  \
+    do                                                                        \
+    {                                                                         \
+        static int32_t __dbgutils_binary_log_site = 0;                        \
+        char __dbgutils_message[TI_UTILS_BINARY_LOG_TEXT_SIZE];               \
+        Ti::BinaryLog::logAndFormat(&__dbgutils_binary_log_site, LOG_TAG,     \
+                priority, __FILE__, __LINE__, __FUNCTION__,                   \
+                __dbgutils_message, sizeof(__dbgutils_message),               \
+                format, __VA_ARGS__);                                         \
+        DBGUTILS_LOGV_FULL(priority, __FILE__, __LINE__, __FUNCTION__,        \
+                TI_UTILS_DEBUG_TIMESTAMP_TOKEN "(%x) %s  %s:%d %s - %s",      \
+                __dbgutils_message);                                          \
+    } while (0)
+
+#define _DBGUTILS_LOGV_TEXT(priority, ...) DBGUTILS_LOGV_FULL(priority, __FILE__, __LINE__, __FUNCTION__, TI_UTILS_DEBUG_TIMESTAMP_TOKEN "(%x) %s  %s:%d %s - " __VA_ARGS__, "")
+
+#ifdef TI_UTILS_BINARY_LOG_ENABLE
+    // errors are recorded and still sent to logcat, so they are never lost
+#   define DBGUTILS_LOGV(...) DBGUTILS_LOGV_BINARY(ANDROID_LOG_VERBOSE, __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__, "")
+#   define DBGUTILS_LOGD(...) DBGUTILS_LOGV_BINARY(ANDROID_LOG_DEBUG,   __FILE__, __LINE__, __FUNCTION__, __VA_ARGS__, "")
+#   define DBGUTILS_LOGE(...) DBGUTILS_LOGV_BINARY_AND_TEXT(ANDROID_LOG_ERROR, __VA_ARGS__, "")
+#   define DBGUTILS_LOGF(...) DBGUTILS_LOGV_BINARY_AND_TEXT(ANDROID_LOG_FATAL, __VA_ARGS__, "")
+#else
+#   define DBGUTILS_LOGV(...) _DBGUTILS_LOGV_TEXT(ANDROID_LOG_VERBOSE, __VA_ARGS__)
+#   define DBGUTILS_LOGD(...) _DBGUTILS_LOGV_TEXT(ANDROID_LOG_DEBUG,   __VA_ARGS__)
+#   define DBGUTILS_LOGE(...) _DBGUTILS_LOGV_TEXT(ANDROID_LOG_ERROR,   __VA_ARGS__)
+#   define DBGUTILS_LOGF(...) _DBGUTILS_LOGV_TEXT(ANDROID_LOG_FATAL,   __VA_ARGS__)
+#endif
 
 #define DBGUTILS_LOGVA DBGUTILS_LOGV
 #define DBGUTILS_LOGVB DBGUTILS_LOGV
@@ -250,39 +356,12 @@ inline Debug * Debug::instance()
 
 inline Debug::ThreadInfo * Debug::findCurrentThreadInfo()
 {
-    // retain reference to threads data
-    android::sp<Data> data = mData;
-
-    // iterate over threads to locate thread id,
-    // this is safe from race conditions because each thread
-    // is able to modify only his own ThreadInfo structure
-    const int32_t threadId = reinterpret_cast<int32_t>(androidGetThreadId());
-    const int size = int(data->threads.size());
-    for ( int i = 0; i < size; ++i )
-    {
-        ThreadInfo * const threadInfo = data->threads.itemAt(i);
-        if ( threadInfo->threadId == threadId )
-            return threadInfo;
-    }
-
-    // this thread has not been registered yet,
-    // try to fing empty thread info slot
-    while ( true )
-    {
-        ThreadInfo * const threadInfo = registerThread(data.get(), threadId);
-        if ( threadInfo )
-            return threadInfo;
-
-        // failed registering thread, because all slots are occupied
-        // grow the data and try again
-        grow();
+    // each thread keeps its own ThreadInfo slot until it exits
+    ThreadInfo * const threadInfo = static_cast<ThreadInfo*>(pthread_getspecific(mThreadKey));
+    if ( threadInfo )
+        return threadInfo;
 
-        data = mData;
-    }
-
-    // should never reach here
-    _DBGUTILS_PLAIN_ASSERT(false);
-    return 0;
+    return registerCurrentThread();
 }
 
 
@@ -295,12 +374,6 @@ inline void Debug::addOffsetForCurrentThread(const int offset)
     _DBGUTILS_PLAIN_ASSERT(threadInfo);
 
     threadInfo->callOffset += offset;
-
-    if ( threadInfo->callOffset == 0 )
-    {
-        // thread call stack has dropped to zero, unregister it
-        android_atomic_acquire_store(0, &threadInfo->threadId);
-    }
 }
 
 
@@ -345,7 +418,7 @@ inline void Debug::log(const int priority, const char * const format, ...)
 
 
 inline FunctionLogger::FunctionLogger(const char * const file, const int line, const char * const function) :
-    mFile(file), mLine(line), mFunction(function), mThreadId(androidGetThreadId()), mExitLine(-1)
+    mBinaryLogSite(0), mFile(file), mLine(line), mFunction(function), mThreadId(androidGetThreadId()), mExitLine(-1)
 {
     Debug * const debug = Debug::instance();
     debug->increaseOffsetForCurrentThread();
@@ -356,9 +429,26 @@ inline FunctionLogger::FunctionLogger(const char * const file, const int line, c
 }
 
 
+inline FunctionLogger::FunctionLogger(int32_t * const binaryLogSite, const char * const tag,
+        const char * const file, const int line, const char * const function) :
+    mBinaryLogSite(binaryLogSite), mFile(file), mLine(line), mFunction(function),
+    mThreadId(androidGetThreadId()), mExitLine(-1)
+{
+    Debug::instance()->increaseOffsetForCurrentThread();
+    BinaryLog::functionEnter(mBinaryLogSite, tag, mFile, mLine, mFunction);
+}
+
+
 inline FunctionLogger::~FunctionLogger()
 {
     Debug * const debug = Debug::instance();
+    if ( mBinaryLogSite )
+    {
+        BinaryLog::functionExit(mBinaryLogSite, mExitLine == -1 ? mLine : mExitLine);
+        debug->decreaseOffsetForCurrentThread();
+        return;
+    }
+
     LOGD(TI_UTILS_DEBUG_TIMESTAMP_TOKEN "(%x) %s- %s:%d %s - EXIT",
             TI_UTILS_DEBUG_TIMESTAMP_VARIABLE
             (int)mThreadId, IndentString<>(debug->offsetForCurrentThread()).string(),
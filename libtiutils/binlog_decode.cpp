@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host tool turning a Ti::BinaryLog file back into text, one line per
+// record in timestamp order, formatted like the text DBGUTILS logs:
+//
+//     tiutils-binlog-decode [-t <thread id>] <file>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BinaryLogFormat.h"
+
+using namespace Ti::BinaryLogFile;
+
+
+
+
+struct SiteInfo
+{
+    int priority;
+    int line;
+    std::vector<uint8_t> argTypes;
+    std::string tag;
+    std::string file;
+    std::string function;
+    std::string format;
+};
+
+
+static bool recordBefore(const Record & a, const Record & b)
+{
+    if ( a.timestamp != b.timestamp )
+        return a.timestamp < b.timestamp;
+    return a.seq < b.seq;
+}
+
+
+static char priorityChar(const int priority)
+{
+    static const char kChars[] = "??VDIWEFS";
+    return priority >= 0 && priority < int(sizeof(kChars) - 1) ? kChars[priority] : '?';
+}
+
+
+// appends literal format text, collapsing "%%"
+static void appendLiteral(std::string & out, const char * p, const char * const end)
+{
+    while ( p < end )
+    {
+        out += *p;
+        p += p[0] == '%' && p + 1 < end && p[1] == '%' ? 2 : 1;
+    }
+}
+
+
+// rebuilds a conversion for the host ABI, with the length modifier
+// matching the stored argument size
+static std::string hostConversion(const Conversion & conversion, const uint8_t type)
+{
+    std::string spec;
+    for ( const char * p = conversion.start; p < conversion.end - 1; ++p )
+        if ( !strchr("hlLqjzt", *p) )
+            spec += *p;
+
+    if ( type == ARG_INT64 )
+        spec += "ll";
+    spec += conversion.end[-1];
+
+    return spec;
+}
+
+
+template <typename T>
+static void appendFormatted(std::string & out, const std::string & spec,
+        const int * const stars, const int starCount, const T value)
+{
+    char buffer[512];
+    if ( starCount == 2 )
+        snprintf(buffer, sizeof(buffer), spec.c_str(), stars[0], stars[1], value);
+    else if ( starCount == 1 )
+        snprintf(buffer, sizeof(buffer), spec.c_str(), stars[0], value);
+    else
+        snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+    out += buffer;
+}
+
+
+class PayloadReader
+{
+public:
+    PayloadReader(const Record & record) :
+        mPos(record.payload), mEnd(record.payload + sizeof(record.payload))
+    {}
+
+    template <typename T>
+    bool read(T * const value)
+    {
+        if ( mEnd - mPos < int(sizeof(T)) )
+            return false;
+        memcpy(value, mPos, sizeof(T));
+        mPos += sizeof(T);
+        return true;
+    }
+
+    bool readString(std::string * const value, bool * const isNull)
+    {
+        uint8_t length;
+        if ( !read(&length) )
+            return false;
+
+        *isNull = length == kNullString;
+        if ( *isNull )
+            return true;
+
+        if ( mEnd - mPos < length )
+            return false;
+        value->assign(reinterpret_cast<const char *>(mPos), length);
+        mPos += length;
+        return true;
+    }
+
+private:
+    const uint8_t * mPos;
+    const uint8_t * const mEnd;
+};
+
+
+static std::string formatMessage(const SiteInfo & site, const Record & record)
+{
+    std::string out;
+    PayloadReader reader(record);
+
+    const char * p = site.format.c_str();
+    size_t arg = 0;
+    Conversion conversion;
+    while ( nextConversion(p, &conversion) )
+    {
+        appendLiteral(out, p, conversion.start);
+        p = conversion.end;
+
+        int stars[2] = { 0, 0 };
+        bool ok = conversion.stars <= 2;
+        for ( int i = 0; ok && i < conversion.stars; ++i, ++arg )
+            ok = arg < site.argTypes.size() && reader.read(&stars[i]);
+
+        if ( !ok || arg >= site.argTypes.size() )
+        {
+            out += record.flags & kRecordTruncated ? "<truncated>" : "<?>";
+            out += p;
+            return out;
+        }
+
+        const uint8_t type = site.argTypes[arg++];
+        const std::string spec = hostConversion(conversion, type);
+        switch ( type )
+        {
+            case ARG_INT32:
+            {
+                int32_t value;
+                ok = reader.read(&value);
+                if ( ok )
+                    appendFormatted(out, spec, stars, conversion.stars, value);
+                break;
+            }
+
+            case ARG_INT64:
+            {
+                int64_t value;
+                ok = reader.read(&value);
+                if ( ok )
+                    appendFormatted(out, spec, stars, conversion.stars, static_cast<long long>(value));
+                break;
+            }
+
+            case ARG_DOUBLE:
+            {
+                double value;
+                ok = reader.read(&value);
+                if ( ok )
+                    appendFormatted(out, spec, stars, conversion.stars, value);
+                break;
+            }
+
+            case ARG_POINTER:
+            {
+                uint64_t value;
+                ok = reader.read(&value);
+                if ( ok )
+                    appendFormatted(out, "0x%llx", stars, 0, static_cast<unsigned long long>(value));
+                break;
+            }
+
+            case ARG_STRING:
+            {
+                std::string value;
+                bool isNull = false;
+                ok = reader.readString(&value, &isNull);
+                if ( ok )
+                    appendFormatted(out, spec, stars, conversion.stars, isNull ? "(null)" : value.c_str());
+                break;
+            }
+
+            default:
+                ok = false;
+                break;
+        }
+
+        if ( !ok )
+        {
+            out += record.flags & kRecordTruncated ? "<truncated>" : "<?>";
+            return out;
+        }
+    }
+
+    appendLiteral(out, p, p + strlen(p));
+
+    return out;
+}
+
+
+static bool readExact(FILE * const file, void * const data, const size_t size)
+{
+    return size == 0 || fread(data, size, 1, file) == 1;
+}
+
+
+static bool readString(FILE * const file, const size_t length, std::string * const value)
+{
+    value->resize(length);
+    return length == 0 || readExact(file, &(*value)[0], length);
+}
+
+
+static void usage(const char * const name)
+{
+    fprintf(stderr, "usage: %s [-t <thread id>] <file>\n", name);
+}
+
+
+int main(int argc, char ** argv)
+{
+    const char * path = 0;
+    bool filterThread = false;
+    int32_t thread = 0;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( !strcmp(argv[i], "-t") && i + 1 < argc )
+        {
+            filterThread = true;
+            thread = int32_t(strtoul(argv[++i], 0, 16));
+        }
+        else if ( argv[i][0] != '-' && !path )
+        {
+            path = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if ( !path )
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE * const file = fopen(path, "rb");
+    if ( !file )
+    {
+        perror(path);
+        return 1;
+    }
+
+    Header header;
+    if ( !readExact(file, &header, sizeof(header)) ||
+         header.magic != kMagic || header.version != kVersion ||
+         header.recordSize != sizeof(Record) )
+    {
+        fprintf(stderr, "%s: not a binary log file of version %u\n", path, kVersion);
+        fclose(file);
+        return 1;
+    }
+
+    std::map<int, SiteInfo> sites;
+    for ( uint32_t i = 0; i < header.siteCount; ++i )
+    {
+        Site site;
+        SiteInfo info;
+        if ( !readExact(file, &site, sizeof(site)) )
+            break;
+
+        info.priority = site.priority;
+        info.line = site.line;
+        info.argTypes.resize(site.argCount);
+        if ( !readExact(file, info.argTypes.data(), site.argCount) ||
+             !readString(file, site.tagLength, &info.tag) ||
+             !readString(file, site.fileLength, &info.file) ||
+             !readString(file, site.functionLength, &info.function) ||
+             !readString(file, site.formatLength, &info.format) )
+        {
+            fprintf(stderr, "%s: truncated site table\n", path);
+            fclose(file);
+            return 1;
+        }
+
+        sites[site.id] = info;
+    }
+
+    std::vector<Record> records;
+    for ( uint32_t i = 0; i < header.ringCount; ++i )
+    {
+        Ring ring;
+        if ( !readExact(file, &ring, sizeof(ring)) )
+            break;
+
+        for ( uint32_t r = 0; r < header.ringRecords; ++r )
+        {
+            Record record;
+            if ( !readExact(file, &record, sizeof(record)) )
+                break;
+
+            // the ring may have been overwritten while it was saved
+            if ( record.seq == 0 || ring.head - record.seq >= header.ringRecords )
+                continue;
+            if ( filterThread && record.threadId != thread )
+                continue;
+
+            records.push_back(record);
+        }
+    }
+
+    fclose(file);
+
+    std::sort(records.begin(), records.end(), recordBefore);
+
+    const int64_t start = records.empty() ? 0 : records.front().timestamp;
+    for ( size_t i = 0; i < records.size(); ++i )
+    {
+        const Record & record = records[i];
+        std::map<int, SiteInfo>::const_iterator site = sites.find(record.site);
+        if ( site == sites.end() )
+            continue;
+
+        const SiteInfo & info = site->second;
+        const std::string indent(record.indent * 2, ' ');
+        const int64_t micros = (record.timestamp - start) / 1000;
+        const int kind = record.flags & kRecordKindMask;
+
+        printf("[%6lld.%06lld] %c/%s (%x) %s", static_cast<long long>(micros / 1000000),
+                static_cast<long long>(micros % 1000000), priorityChar(info.priority),
+                info.tag.c_str(), record.threadId, indent.c_str());
+
+        if ( kind == RECORD_ENTER )
+        {
+            printf("+ %s:%d %s - ENTER\n", info.file.c_str(), info.line, info.function.c_str());
+        }
+        else if ( kind == RECORD_EXIT )
+        {
+            int32_t line = info.line;
+            memcpy(&line, record.payload, sizeof(line));
+            printf("- %s:%d %s - EXIT\n", info.file.c_str(), line, info.function.c_str());
+        }
+        else
+        {
+            printf("  %s:%d %s - %s\n", info.file.c_str(), info.line, info.function.c_str(),
+                    formatMessage(info, record).c_str());
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+
+TILER_PATH:= ../../tiler
+ION_PATH:= ../../ion
+
+# The allocators are built into the benchmark rather than linked from
+# libtimemmgr and libion, so the lock wrappers also see their locks
+LOCAL_SRC_FILES:= \
+	alloc_bench.c \
+	lock_stats.c \
+	$(TILER_PATH)/memmgr.c \
+	$(ION_PATH)/ion.c \
+	$(ION_PATH)/ion_pool.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/$(TILER_PATH) \
+	$(LOCAL_PATH)/$(ION_PATH)
+
+LOCAL_SHARED_LIBRARIES:= \
+	liblog
+
+LOCAL_LDFLAGS:= \
+	-Wl,--wrap=pthread_mutex_lock \
+	-Wl,--wrap=pthread_rwlock_rdlock \
+	-Wl,--wrap=pthread_rwlock_wrlock
+
+LOCAL_MODULE:= alloc_bench
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -O2
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+TILER_PATH:= ../../tiler
+ION_PATH:= ../../ion
+
+# The same benchmark against the fake tiler and ion drivers, so it runs
+# on the host
+LOCAL_SRC_FILES:= \
+	alloc_bench.c \
+	lock_stats.c \
+	$(TILER_PATH)/memmgr.c \
+	$(TILER_PATH)/tiler_fake.c \
+	$(ION_PATH)/ion.c \
+	$(ION_PATH)/ion_pool.c \
+	$(ION_PATH)/ion_fake.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/$(TILER_PATH) \
+	$(LOCAL_PATH)/$(ION_PATH)
+
+LOCAL_STATIC_LIBRARIES:= \
+	libcutils \
+	liblog
+
+LOCAL_LDFLAGS:= \
+	-Wl,--wrap=open \
+	-Wl,--wrap=close \
+	-Wl,--wrap=ioctl \
+	-Wl,--wrap=mmap \
+	-Wl,--wrap=munmap \
+	-Wl,--wrap=pthread_mutex_lock \
+	-Wl,--wrap=pthread_rwlock_rdlock \
+	-Wl,--wrap=pthread_rwlock_wrlock
+
+LOCAL_LDLIBS:= -lpthread -lrt
+
+LOCAL_MODULE:= alloc_bench_fake
+LOCAL_MODULE_TAGS:= tests
+
+# linux/ion.h and linux/omap_ion.h come from the bionic kernel headers,
+# after the host ones
+LOCAL_CFLAGS += -Wall -O2 -DALLOC_BENCH_FAKE -idirafter bionic/libc/kernel/common
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,585 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Multithreaded stress and latency benchmark for the tiler memory
+ * allocator (MemMgr_*) and libion.
+ *
+ * Each thread acts as one client (camera, decoder, compositor...) with
+ * its own ion descriptor and a few buffer slots. Every operation picks a
+ * random slot: a live buffer is freed, an empty slot gets a new buffer of
+ * a random kind and size. The threads start together, and the run
+ * reports the throughput, the latency percentiles of each call and the
+ * most contended locks:
+ *
+ *   alloc_bench [-t threads] [-n ops per thread] [-l live buffers per
+ *               thread] [-b tiler|ion|both] [-p tiler pool bytes]
+ *               [-H ion heap mask] [-P ion pool bytes] [-s seed]
+ *
+ * With -P every thread allocates its ion buffers from an ion_pool
+ * holding up to that many bytes of freed buffers.
+ *
+ * alloc_bench runs against /dev/tiler and /dev/ion. alloc_bench_fake is
+ * the same program linked with the fake drivers, so it runs on any Linux
+ * host; its numbers show the user space cost and the locking only.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "memmgr.h"
+#include "ion.h"
+#include "ion_pool.h"
+#include "lock_stats.h"
+
+#ifdef ALLOC_BENCH_FAKE
+#include "tiler_fake.h"
+#include "ion_fake.h"
+
+/* ion buffers are memfds, so only the device calls are faked */
+static const struct tiler_fake_device ion_device = {
+    ion_fake_open,
+    ion_fake_close,
+    ion_fake_ioctl,
+    NULL,
+};
+#endif
+
+#define MAX_SLOTS 64
+#define PAGE 4096
+#define TOP_LOCKS 8
+
+enum op {
+    OP_MEMMGR_ALLOC_2D,
+    OP_MEMMGR_ALLOC_1D,
+    OP_MEMMGR_MAP,
+    OP_MEMMGR_FREE,
+    OP_MEMMGR_UNMAP,
+    OP_ION_ALLOC,
+    OP_ION_ALLOC_TILER,
+    OP_ION_MAP,
+    OP_ION_FREE,
+    OP_ION_POOL_ALLOC,
+    OP_ION_POOL_ALLOC_TILER,
+    OP_ION_POOL_FREE,
+    NUM_OPS
+};
+
+static const char *op_names[NUM_OPS] = {
+    "MemMgr_Alloc 2D",
+    "MemMgr_Alloc 1D",
+    "MemMgr_Map",
+    "MemMgr_Free",
+    "MemMgr_UnMap",
+    "ion_alloc",
+    "ion_alloc_tiler",
+    "ion_map",
+    "ion_free",
+    "ion_pool_alloc",
+    "ion_pool_alloc_t",
+    "ion_pool_free",
+};
+
+/* the resolutions allocated as NV12 */
+static const struct { int width, height; } resolutions[] = {
+    { 176, 144 }, { 640, 480 }, { 1280, 720 }, { 1920, 1080 },
+};
+#define NUM_RESOLUTIONS (int)(sizeof(resolutions) / sizeof(resolutions[0]))
+
+enum slot_kind {
+    SLOT_EMPTY,
+    SLOT_TILER_ALLOC,
+    SLOT_TILER_MAP,
+    SLOT_ION,
+    SLOT_ION_POOL,
+};
+
+struct slot {
+    enum slot_kind kind;
+    void *ptr;                  /* tiler buffer */
+    void *user;                 /* user pages of a tiler mapping */
+    size_t len;
+    struct ion_handle *handle;
+    unsigned char *map;
+    int map_fd;
+    struct ion_pool_buffer *pooled;
+};
+
+struct samples {
+    uint32_t *ns;
+    int num;
+    int failures;
+};
+
+struct thread {
+    pthread_t thread;
+    int index;
+    unsigned seed;
+    int ion_fd;
+    struct ion_pool *ion_pool;
+    struct slot slots[MAX_SLOTS];
+    struct samples samples[NUM_OPS];
+};
+
+static struct {
+    int threads;
+    int ops;
+    int live;
+    int tiler;
+    int ion;
+    unsigned ion_heap_mask;
+    size_t ion_pool_bytes;
+} cfg = { 4, 10000, 8, 1, 1, 1 << ION_HEAP_TYPE_CARVEOUT, 0 };
+
+static pthread_barrier_t start_barrier;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void record(struct thread *t, enum op op, uint64_t start, int ok)
+{
+    struct samples *s = t->samples + op;
+    s->ns[s->num++] = (uint32_t) (now_ns() - start);
+    if (!ok)
+        s->failures++;
+}
+
+static void *alloc_NV12(struct thread *t, int width, int height)
+{
+    MemAllocBlock blocks[2];
+    memset(blocks, 0, sizeof(blocks));
+    blocks[0].pixelFormat = PIXEL_FMT_8BIT;
+    blocks[0].dim.area.width = width;
+    blocks[0].dim.area.height = height;
+    blocks[1].pixelFormat = PIXEL_FMT_16BIT;
+    blocks[1].dim.area.width = width >> 1;
+    blocks[1].dim.area.height = height >> 1;
+
+    uint64_t start = now_ns();
+    void *ptr = MemMgr_Alloc(blocks, 2);
+    record(t, OP_MEMMGR_ALLOC_2D, start, ptr != NULL);
+    return ptr;
+}
+
+static void tiler_fill(struct thread *t, struct slot *slot)
+{
+    int kind = rand_r(&t->seed) % 4;
+    uint64_t start;
+
+    if (kind < 2)
+    {
+        int res = rand_r(&t->seed) % NUM_RESOLUTIONS;
+        slot->ptr = alloc_NV12(t, resolutions[res].width, resolutions[res].height);
+        slot->kind = slot->ptr ? SLOT_TILER_ALLOC : SLOT_EMPTY;
+    }
+    else if (kind == 2)
+    {
+        MemAllocBlock block;
+        memset(&block, 0, sizeof(block));
+        block.pixelFormat = PIXEL_FMT_PAGE;
+        block.dim.len = (1 + rand_r(&t->seed) % 256) * PAGE;
+
+        start = now_ns();
+        slot->ptr = MemMgr_Alloc(&block, 1);
+        record(t, OP_MEMMGR_ALLOC_1D, start, slot->ptr != NULL);
+        slot->kind = slot->ptr ? SLOT_TILER_ALLOC : SLOT_EMPTY;
+    }
+    else
+    {
+        /* map user pages, as a codec does with a client buffer */
+        MemAllocBlock block;
+        slot->len = (1 + rand_r(&t->seed) % 256) * PAGE;
+        slot->user = mmap(NULL, slot->len, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (slot->user == MAP_FAILED)
+        {
+            slot->user = NULL;
+            return;
+        }
+
+        memset(&block, 0, sizeof(block));
+        block.pixelFormat = PIXEL_FMT_PAGE;
+        block.dim.len = slot->len;
+        block.ptr = slot->user;
+
+        start = now_ns();
+        slot->ptr = MemMgr_Map(&block, 1);
+        record(t, OP_MEMMGR_MAP, start, slot->ptr != NULL);
+        if (slot->ptr)
+        {
+            slot->kind = SLOT_TILER_MAP;
+        }
+        else
+        {
+            munmap(slot->user, slot->len);
+            slot->user = NULL;
+        }
+    }
+}
+
+static void ion_pool_fill(struct thread *t, struct slot *slot)
+{
+    uint64_t start;
+    int ret;
+
+    if (rand_r(&t->seed) % 2)
+    {
+        size_t len = (1 + rand_r(&t->seed) % 256) * PAGE;
+        start = now_ns();
+        ret = ion_pool_alloc(t->ion_pool, len, PAGE, cfg.ion_heap_mask, &slot->pooled);
+        record(t, OP_ION_POOL_ALLOC, start, !ret);
+    }
+    else
+    {
+        int res = rand_r(&t->seed) % NUM_RESOLUTIONS;
+        start = now_ns();
+        ret = ion_pool_alloc_tiler(t->ion_pool, resolutions[res].width,
+                                   resolutions[res].height, TILER_PIXEL_FMT_8BIT,
+                                   OMAP_ION_HEAP_TILER_MASK, &slot->pooled);
+        record(t, OP_ION_POOL_ALLOC_TILER, start, !ret);
+    }
+    if (!ret)
+        slot->kind = SLOT_ION_POOL;
+}
+
+static void ion_fill(struct thread *t, struct slot *slot)
+{
+    uint64_t start;
+    int ret;
+
+    if (t->ion_pool)
+    {
+        ion_pool_fill(t, slot);
+        return;
+    }
+
+    if (rand_r(&t->seed) % 2)
+    {
+        slot->len = (1 + rand_r(&t->seed) % 256) * PAGE;
+        start = now_ns();
+        ret = ion_alloc(t->ion_fd, slot->len, PAGE, cfg.ion_heap_mask, &slot->handle);
+        record(t, OP_ION_ALLOC, start, !ret);
+    }
+    else
+    {
+        int res = rand_r(&t->seed) % NUM_RESOLUTIONS;
+        size_t stride = 0;
+        start = now_ns();
+        ret = ion_alloc_tiler(t->ion_fd, resolutions[res].width, resolutions[res].height,
+                              TILER_PIXEL_FMT_8BIT, OMAP_ION_HEAP_TILER_MASK,
+                              &slot->handle, &stride);
+        record(t, OP_ION_ALLOC_TILER, start, !ret);
+        slot->len = stride * resolutions[res].height;
+    }
+    if (ret)
+        return;
+
+    start = now_ns();
+    ret = ion_map(t->ion_fd, slot->handle, slot->len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED, 0, &slot->map, &slot->map_fd);
+    record(t, OP_ION_MAP, start, !ret);
+    if (ret)
+    {
+        slot->map = NULL;
+        slot->map_fd = -1;
+    }
+    slot->kind = SLOT_ION;
+}
+
+static void release(struct thread *t, struct slot *slot)
+{
+    uint64_t start = now_ns();
+    int ret;
+
+    switch (slot->kind)
+    {
+    case SLOT_TILER_ALLOC:
+        ret = MemMgr_Free(slot->ptr);
+        record(t, OP_MEMMGR_FREE, start, !ret);
+        break;
+
+    case SLOT_TILER_MAP:
+        ret = MemMgr_UnMap(slot->ptr);
+        record(t, OP_MEMMGR_UNMAP, start, !ret);
+        munmap(slot->user, slot->len);
+        break;
+
+    case SLOT_ION:
+        /* a buffer is done with when it is unmapped and freed */
+        ret = 0;
+        if (slot->map)
+        {
+            ret |= munmap(slot->map, slot->len);
+            ret |= close(slot->map_fd);
+        }
+        ret |= ion_free(t->ion_fd, slot->handle);
+        record(t, OP_ION_FREE, start, !ret);
+        break;
+
+    case SLOT_ION_POOL:
+        ret = ion_pool_free(t->ion_pool, slot->pooled);
+        record(t, OP_ION_POOL_FREE, start, !ret);
+        break;
+
+    default:
+        break;
+    }
+    memset(slot, 0, sizeof(*slot));
+}
+
+static void *run(void *arg)
+{
+    struct thread *t = arg;
+    int ix;
+
+    pthread_barrier_wait(&start_barrier);
+    for (ix = 0; ix < cfg.ops; ix++)
+    {
+        struct slot *slot = t->slots + rand_r(&t->seed) % cfg.live;
+        if (slot->kind != SLOT_EMPTY)
+            release(t, slot);
+        else if (cfg.tiler && (!cfg.ion || rand_r(&t->seed) % 2))
+            tiler_fill(t, slot);
+        else
+            ion_fill(t, slot);
+    }
+
+    for (ix = 0; ix < cfg.live; ix++)
+    {
+        release(t, t->slots + ix);
+    }
+    return NULL;
+}
+
+static int by_value(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_us(uint32_t *ns, int num, int pct)
+{
+    int ix = (int) ((int64_t) num * pct / 100);
+    if (ix >= num)
+        ix = num - 1;
+    return ns[ix] / 1000.0;
+}
+
+static void report(struct thread *threads, uint64_t elapsed_ns)
+{
+    struct lock_stats locks[TOP_LOCKS];
+    uint64_t total = 0;
+    int op, ix, num;
+
+    printf("%-16s %8s %7s %9s %9s %9s\n", "call", "count", "failed",
+           "p50 us", "p99 us", "max us");
+    for (op = 0; op < NUM_OPS; op++)
+    {
+        int count = 0, failures = 0;
+        for (ix = 0; ix < cfg.threads; ix++)
+        {
+            count += threads[ix].samples[op].num;
+            failures += threads[ix].samples[op].failures;
+        }
+        if (!count)
+            continue;
+
+        uint32_t *all = malloc(count * sizeof(*all));
+        if (!all)
+            continue;
+        for (num = ix = 0; ix < cfg.threads; ix++)
+        {
+            memcpy(all + num, threads[ix].samples[op].ns,
+                   threads[ix].samples[op].num * sizeof(*all));
+            num += threads[ix].samples[op].num;
+        }
+        qsort(all, count, sizeof(*all), by_value);
+
+        printf("%-16s %8d %7d %9.1f %9.1f %9.1f\n", op_names[op], count, failures,
+               percentile_us(all, count, 50), percentile_us(all, count, 99),
+               all[count - 1] / 1000.0);
+        total += count;
+        free(all);
+    }
+
+    printf("%d threads, %llu calls in %.3f s, %.0f calls/s\n", cfg.threads,
+           (unsigned long long) total, elapsed_ns / 1e9,
+           elapsed_ns ? total * 1e9 / elapsed_ns : 0.0);
+
+    if (cfg.ion && cfg.ion_pool_bytes)
+    {
+        uint32_t hits = 0, misses = 0, evictions = 0;
+        for (ix = 0; ix < cfg.threads; ix++)
+        {
+            struct ion_pool_stats ps;
+            ion_pool_get_stats(threads[ix].ion_pool, &ps);
+            hits += ps.hits;
+            misses += ps.misses;
+            evictions += ps.evictions;
+        }
+        printf("ion pools: %u hits, %u misses, %u evictions\n", hits, misses, evictions);
+    }
+
+    num = lock_stats_get(locks, TOP_LOCKS);
+    if (!num)
+        return;
+    printf("%-18s %-18s %10s %10s %10s\n", "lock", "first taken at",
+           "acquired", "contended", "wait ms");
+    for (ix = 0; ix < num; ix++)
+    {
+        printf("%-18p %-18p %10llu %9.1f%% %10.2f\n", locks[ix].lock, locks[ix].caller,
+               (unsigned long long) locks[ix].acquired,
+               locks[ix].contended * 100.0 / locks[ix].acquired,
+               locks[ix].wait_ns / 1e6);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-t threads] [-n ops per thread] [-l live buffers per thread]\n"
+            "       [-b tiler|ion|both] [-p tiler pool bytes] [-H ion heap mask]\n"
+            "       [-P ion pool bytes] [-s seed]\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    struct thread *threads;
+    unsigned seed = (unsigned) time(NULL);
+    uint64_t start;
+    int c, ix, op, res = 0;
+
+    while ((c = getopt(argc, argv, "t:n:l:b:p:H:P:s:")) != -1)
+    {
+        switch (c)
+        {
+        case 't': cfg.threads = atoi(optarg); break;
+        case 'n': cfg.ops = atoi(optarg); break;
+        case 'l': cfg.live = atoi(optarg); break;
+        case 'p': MemMgr_SetPoolBudget(strtoul(optarg, NULL, 0)); break;
+        case 'H': cfg.ion_heap_mask = strtoul(optarg, NULL, 0); break;
+        case 'P': cfg.ion_pool_bytes = strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        case 'b':
+            cfg.tiler = !strcmp(optarg, "tiler") || !strcmp(optarg, "both");
+            cfg.ion = !strcmp(optarg, "ion") || !strcmp(optarg, "both");
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (cfg.threads < 1 || cfg.ops < 1 || cfg.live < 1 || cfg.live > MAX_SLOTS ||
+        (!cfg.tiler && !cfg.ion))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+#ifdef ALLOC_BENCH_FAKE
+    tiler_fake_set_next(&ion_device);
+#endif
+
+    threads = calloc(cfg.threads, sizeof(*threads));
+    if (!threads)
+        return 1;
+
+    printf("seed %u\n", seed);
+    for (ix = 0; ix < cfg.threads; ix++)
+    {
+        threads[ix].index = ix;
+        threads[ix].seed = seed + ix;
+        threads[ix].ion_fd = -1;
+        if (cfg.ion && (threads[ix].ion_fd = ion_open()) < 0)
+        {
+            res = 1;
+            goto DONE;
+        }
+        if (cfg.ion && cfg.ion_pool_bytes &&
+            !(threads[ix].ion_pool = ion_pool_create(threads[ix].ion_fd, cfg.ion_pool_bytes,
+                                                     PROT_READ | PROT_WRITE, MAP_SHARED)))
+        {
+            res = 1;
+            goto DONE;
+        }
+        for (op = 0; op < NUM_OPS; op++)
+        {
+            /* every operation records at most one sample per call, plus
+               the releases at the end */
+            threads[ix].samples[op].ns = malloc((cfg.ops + cfg.live) * sizeof(uint32_t));
+            if (!threads[ix].samples[op].ns)
+            {
+                res = 1;
+                goto DONE;
+            }
+        }
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, cfg.threads + 1);
+    for (ix = 0; ix < cfg.threads; ix++)
+    {
+        if (pthread_create(&threads[ix].thread, NULL, run, threads + ix))
+        {
+            fprintf(stderr, "could not start thread %d\n", ix);
+            exit(1);
+        }
+    }
+
+    lock_stats_reset();
+    pthread_barrier_wait(&start_barrier);
+    start = now_ns();
+    for (ix = 0; ix < cfg.threads; ix++)
+    {
+        pthread_join(threads[ix].thread, NULL);
+    }
+    report(threads, now_ns() - start);
+    pthread_barrier_destroy(&start_barrier);
+
+    for (ix = 0; ix < cfg.threads; ix++)
+    {
+        for (op = 0; op < NUM_OPS; op++)
+        {
+            res |= threads[ix].samples[op].failures != 0;
+        }
+    }
+
+DONE:
+    for (ix = 0; ix < cfg.threads; ix++)
+    {
+        ion_pool_destroy(threads[ix].ion_pool);
+        if (threads[ix].ion_fd >= 0)
+            ion_close(threads[ix].ion_fd);
+        for (op = 0; op < NUM_OPS; op++)
+        {
+            free(threads[ix].samples[op].ns);
+        }
+    }
+    free(threads);
+    MemMgr_SetPoolBudget(0);
+    return res;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lock_stats.h"
+
+int __real_pthread_mutex_lock(pthread_mutex_t *mutex);
+int __real_pthread_rwlock_rdlock(pthread_rwlock_t *lock);
+int __real_pthread_rwlock_wrlock(pthread_rwlock_t *lock);
+
+/* open addressed by lock address, entries are claimed with a CAS and
+   never released, so lookups need no lock */
+static struct lock_stats table[LOCK_STATS_MAX];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct lock_stats *entry(const void *lock, const void *caller)
+{
+    unsigned ix = ((uintptr_t) lock >> 3) % LOCK_STATS_MAX;
+    unsigned n;
+    for (n = 0; n < LOCK_STATS_MAX; n++, ix = (ix + 1) % LOCK_STATS_MAX)
+    {
+        const void *cur = table[ix].lock;
+        if (cur == lock)
+            return table + ix;
+        if (!cur && __sync_bool_compare_and_swap(&table[ix].lock, NULL, lock))
+        {
+            table[ix].caller = caller;
+            return table + ix;
+        }
+        /* lost the race for this slot, look at it again */
+        if (!cur && table[ix].lock == lock)
+            return table + ix;
+    }
+    return NULL;
+}
+
+static void count(struct lock_stats *e, uint64_t start)
+{
+    if (!e)
+        return;
+    __sync_fetch_and_add(&e->acquired, 1);
+    if (start)
+    {
+        __sync_fetch_and_add(&e->contended, 1);
+        __sync_fetch_and_add(&e->wait_ns, now_ns() - start);
+    }
+}
+
+int __wrap_pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+    struct lock_stats *e = entry(mutex, __builtin_return_address(0));
+    if (!pthread_mutex_trylock(mutex))
+    {
+        count(e, 0);
+        return 0;
+    }
+
+    uint64_t start = now_ns();
+    int ret = __real_pthread_mutex_lock(mutex);
+    if (!ret)
+        count(e, start);
+    return ret;
+}
+
+int __wrap_pthread_rwlock_rdlock(pthread_rwlock_t *lock)
+{
+    struct lock_stats *e = entry(lock, __builtin_return_address(0));
+    if (!pthread_rwlock_tryrdlock(lock))
+    {
+        count(e, 0);
+        return 0;
+    }
+
+    uint64_t start = now_ns();
+    int ret = __real_pthread_rwlock_rdlock(lock);
+    if (!ret)
+        count(e, start);
+    return ret;
+}
+
+int __wrap_pthread_rwlock_wrlock(pthread_rwlock_t *lock)
+{
+    struct lock_stats *e = entry(lock, __builtin_return_address(0));
+    if (!pthread_rwlock_trywrlock(lock))
+    {
+        count(e, 0);
+        return 0;
+    }
+
+    uint64_t start = now_ns();
+    int ret = __real_pthread_rwlock_wrlock(lock);
+    if (!ret)
+        count(e, start);
+    return ret;
+}
+
+void lock_stats_reset(void)
+{
+    int ix;
+    for (ix = 0; ix < LOCK_STATS_MAX; ix++)
+    {
+        table[ix].acquired = 0;
+        table[ix].contended = 0;
+        table[ix].wait_ns = 0;
+    }
+}
+
+static int by_wait(const void *a, const void *b)
+{
+    const struct lock_stats *la = a, *lb = b;
+    if (la->wait_ns != lb->wait_ns)
+        return la->wait_ns < lb->wait_ns ? 1 : -1;
+    return la->acquired < lb->acquired ? 1 : la->acquired > lb->acquired ? -1 : 0;
+}
+
+int lock_stats_get(struct lock_stats *stats, int max)
+{
+    struct lock_stats all[LOCK_STATS_MAX];
+    int ix, num = 0;
+    for (ix = 0; ix < LOCK_STATS_MAX; ix++)
+    {
+        if (table[ix].lock && table[ix].acquired)
+            all[num++] = table[ix];
+    }
+    qsort(all, num, sizeof(all[0]), by_wait);
+    if (num > max)
+        num = max;
+    memcpy(stats, all, num * sizeof(all[0]));
+    return num;
+}
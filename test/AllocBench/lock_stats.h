@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOCK_STATS_H
+#define LOCK_STATS_H
+
+#include <stdint.h>
+
+/*
+ * Lock contention counters for the allocators.
+ *
+ * The program is linked with
+ *
+ *     -Wl,--wrap=pthread_mutex_lock -Wl,--wrap=pthread_rwlock_rdlock
+ *     -Wl,--wrap=pthread_rwlock_wrlock
+ *
+ * so the locks taken by the sources built into it (libtimemmgr, libion
+ * and the fake drivers) go through a trylock first. A lock is contended
+ * when the trylock fails, and the time spent waiting for it is added up.
+ * Locks taken inside shared libraries are not seen.
+ */
+
+#define LOCK_STATS_MAX 64
+
+struct lock_stats {
+    const void *lock;
+    const void *caller;     /* return address of the first acquisition */
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t wait_ns;
+};
+
+/*
+ * Clear the counters
+ */
+void lock_stats_reset(void);
+
+/*
+ * Copy the counters of up to max locks into stats, most waited for first.
+ * Returns the number of locks copied.
+ */
+int lock_stats_get(struct lock_stats *stats, int max);
+
+#endif // LOCK_STATS_H
@@ -0,0 +1,39 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+
+CAMERA_HAL_PATH:= ../../camera
+
+# The kernels are built from the HAL sources so the numbers track the
+# code that ships in camera.$(TARGET_BOARD_PLATFORM)
+LOCAL_SRC_FILES:= \
+	camera_kernel_bench.cpp \
+	$(CAMERA_HAL_PATH)/CameraKernels.cpp \
+	$(CAMERA_HAL_PATH)/Encoder_libjpeg.cpp \
+	$(CAMERA_HAL_PATH)/NV12_resize.c
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/$(CAMERA_HAL_PATH)/inc \
+	$(LOCAL_PATH)/../../include \
+	$(LOCAL_PATH)/../../libtiutils \
+	frameworks/base/include/ui \
+	frameworks/base/include/utils \
+	external/jpeg \
+	external/jhead
+
+LOCAL_SHARED_LIBRARIES:= \
+	libui \
+	libbinder \
+	libutils \
+	libcutils \
+	libtiutils \
+	libcamera_client \
+	libjpeg \
+	libexif
+
+LOCAL_MODULE:= camera_kernel_bench
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -fno-short-enums -O2 -DLOG_TAG=\"CameraKernelBench\"
+
+include $(BUILD_HEAPTRACKED_EXECUTABLE)
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Micro-benchmark for the camera HAL pixel kernels and the libjpeg encoder.
+ *
+ * Every kernel is run over a sweep of resolutions (VGA to 12 MP), line
+ * strides (packed and 4 KiB aligned, as for 2D tiler buffers) and formats.
+ * Results are written as JSON so they can be compared across releases:
+ *
+ *   { "benchmark": "camera_kernels", "version": 1, "cpu_mhz": 1200,
+ *     "results": [ { "kernel": "copy2Dto1D", "format": "yuv420sp",
+ *                    "width": 1920, "height": 1080, "stride": 4096,
+ *                    "iterations": 40, "ns_per_frame": 2120000,
+ *                    "mb_per_s": 1467.9, "ns_per_pixel": 1.02,
+ *                    "cycles_per_pixel": 1.23 }, ... ] }
+ *
+ * MB/s counts the bytes of the source frame. Cycles per pixel are derived
+ * from the CPU frequency (cpufreq of cpu0, or -m), so pin the governor to
+ * "performance" for stable numbers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <camera/CameraParameters.h>
+#include <utils/Timers.h>
+
+#include "CameraHal.h"
+#include "CameraKernels.h"
+#include "Encoder_libjpeg.h"
+#include "NV12_resize.h"
+
+using namespace android;
+
+#define TILER_STRIDE_ALIGN 4096
+#define JPEG_QUALITY 90
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+struct Resolution {
+    const char *name;
+    int width;
+    int height;
+};
+
+static const Resolution gResolutions[] = {
+    { "vga", 640, 480 },
+    { "720p", 1280, 720 },
+    { "1080p", 1920, 1080 },
+    { "5mp", 2592, 1944 },
+    { "8mp", 3264, 2448 },
+    { "12mp", 4000, 3000 },
+};
+
+/* One kernel invocation over a whole frame */
+struct Case {
+    const char *kernel;
+    const char *format;
+    int width;
+    int height;
+    int stride;             /* source line stride in bytes */
+    size_t srcBytes;        /* bytes read per frame, used for MB/s */
+    uint8_t *src;
+    uint8_t *uv;            /* second plane for semi-planar sources */
+    uint8_t *dst;
+    size_t dstSize;
+};
+
+typedef void (*KernelFn)(Case &c);
+
+static void run_copy2Dto1D(Case &c)
+{
+    unsigned int y_uv[2] = { (unsigned int) c.src, (unsigned int) c.uv };
+    int bytesPerPixel = strcmp(c.format, CameraParameters::PIXEL_FORMAT_YUV422I) ? 1 : 2;
+
+    copy2Dto1D(c.dst, y_uv, c.width, c.height, c.stride, 0, bytesPerPixel,
+               c.stride * c.height, c.format);
+}
+
+static void run_nv21_to_yuv(Case &c)
+{
+    uint8_t *y = c.src;
+    uint8_t *uv = c.uv;
+
+    for (int i = 0; i < c.height; i++) {
+        nv21_to_yuv(c.dst, y, uv, c.width);
+        y += c.stride;
+        if (i & 1) {
+            uv += c.stride;
+        }
+    }
+}
+
+static void run_uyvy_to_yuv(Case &c)
+{
+    uint8_t *src = c.src;
+
+    for (int i = 0; i < c.height; i++) {
+        uyvy_to_yuv(c.dst, (uint32_t *) src, c.width);
+        src += c.stride;
+    }
+}
+
+static void run_resize(Case &c)
+{
+    structConvImage in, out;
+
+    in.uWidth = c.width;
+    in.uHeight = c.height;
+    in.uStride = c.stride;
+    in.eFormat = IC_FORMAT_YCbCr420_lp;
+    in.imgPtr = c.src;
+    in.clrPtr = c.uv;
+    in.uOffset = 0;
+
+    /* Half size, as for the preview sized postview and thumbnails */
+    out.uWidth = c.width / 2;
+    out.uHeight = c.height / 2;
+    out.uStride = out.uWidth;
+    out.eFormat = IC_FORMAT_YCbCr420_lp;
+    out.imgPtr = c.dst;
+    out.clrPtr = c.dst + out.uWidth * out.uHeight;
+    out.uOffset = 0;
+
+    VT_resizeFrame_Video_opt2_lp(&in, &out, NULL, 0);
+}
+
+static void run_yuyv_to_uyvy(Case &c)
+{
+    convertYUYVtoUYVY(c.dst, c.stride, c.src, c.stride, c.width, c.height);
+}
+
+static void run_copyFrame(Case &c)
+{
+    /* Driver buffer at the negotiated stride to a tiler buffer */
+    copyFrame(c.dst, TILER_STRIDE_ALIGN * 2, c.src, c.stride, c.width * 2, c.height);
+}
+
+static void run_jpeg(Case &c)
+{
+    Encoder_libjpeg::params params;
+
+    memset(&params, 0, sizeof(params));
+    params.src = c.src;
+    params.src_size = c.srcBytes;
+    params.dst = c.dst;
+    params.dst_size = c.dstSize;
+    params.quality = JPEG_QUALITY;
+    params.in_width = params.out_width = c.width;
+    params.in_height = params.out_height = c.height;
+    params.format = c.format;
+
+    /* The encoder drops its own reference when threadLoop() completes */
+    sp<Encoder_libjpeg> encoder = new Encoder_libjpeg(&params, NULL, NULL,
+                                                      CameraFrame::IMAGE_FRAME,
+                                                      NULL, NULL, NULL);
+    encoder->run();
+    encoder->join();
+}
+
+enum SourceLayout {
+    LAYOUT_NV12,            /* Y plane followed by interleaved UV, both at stride */
+    LAYOUT_PACKED422,       /* 2 bytes per pixel at stride */
+};
+
+struct Kernel {
+    const char *name;
+    const char *format;
+    SourceLayout layout;
+    bool stridedOnly;       /* only meaningful with tiler strides */
+    bool packedOnly;        /* the kernel assumes packed lines */
+    KernelFn fn;
+};
+
+static const Kernel gKernels[] = {
+    { "copy2Dto1D", CameraParameters::PIXEL_FORMAT_YUV420SP, LAYOUT_NV12, true, false, run_copy2Dto1D },
+    { "copy2Dto1D", CameraParameters::PIXEL_FORMAT_YUV420P, LAYOUT_NV12, true, false, run_copy2Dto1D },
+    { "copy2Dto1D", CameraParameters::PIXEL_FORMAT_YUV422I, LAYOUT_PACKED422, true, false, run_copy2Dto1D },
+    { "nv21_to_yuv", CameraParameters::PIXEL_FORMAT_YUV420SP, LAYOUT_NV12, false, false, run_nv21_to_yuv },
+    { "uyvy_to_yuv", CameraParameters::PIXEL_FORMAT_YUV422I, LAYOUT_PACKED422, false, false, run_uyvy_to_yuv },
+    { "VT_resizeFrame_Video_opt2_lp", CameraParameters::PIXEL_FORMAT_YUV420SP, LAYOUT_NV12, false, false, run_resize },
+    { "convertYUYVtoUYVY", "yuyv", LAYOUT_PACKED422, false, false, run_yuyv_to_uyvy },
+    { "copyFrame", CameraParameters::PIXEL_FORMAT_YUV422I, LAYOUT_PACKED422, false, false, run_copyFrame },
+    { "Encoder_libjpeg::encode", CameraParameters::PIXEL_FORMAT_YUV420SP, LAYOUT_NV12, false, true, run_jpeg },
+    { "Encoder_libjpeg::encode", CameraParameters::PIXEL_FORMAT_YUV422I, LAYOUT_PACKED422, false, true, run_jpeg },
+};
+
+static int cpuMHz()
+{
+    FILE *f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", "r");
+    int khz = 0;
+
+    if (f) {
+        if (fscanf(f, "%d", &khz) != 1) {
+            khz = 0;
+        }
+        fclose(f);
+    }
+
+    return khz / 1000;
+}
+
+static void fillPattern(uint8_t *buf, size_t size)
+{
+    /* Pseudo random content, so the JPEG encoder does not see flat blocks */
+    uint32_t seed = 0x12345678;
+
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = seed >> 24;
+    }
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [options]\n"
+           "  -k <name>     only run kernels whose name contains <name>\n"
+           "  -r <name>     only run one resolution (vga, 720p, 1080p, 5mp, 8mp, 12mp)\n"
+           "  -t <ms>       minimum measuring time per case (200)\n"
+           "  -m <MHz>      CPU frequency for cycles per pixel (cpufreq of cpu0)\n"
+           "  -o <file>     write the JSON report to <file> instead of stdout\n",
+           name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *kernelFilter = NULL;
+    const char *resolutionFilter = NULL;
+    const char *output = NULL;
+    nsecs_t minTime = ms2ns(200);
+    int mhz = 0;
+    bool first = true;
+    FILE *out = stdout;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "k:r:t:m:o:h")) != -1) {
+        switch (opt) {
+        case 'k': kernelFilter = optarg; break;
+        case 'r': resolutionFilter = optarg; break;
+        case 't': minTime = ms2ns(atoi(optarg)); break;
+        case 'm': mhz = atoi(optarg); break;
+        case 'o': output = optarg; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (!mhz) {
+        mhz = cpuMHz();
+    }
+
+    if (output && !(out = fopen(output, "w"))) {
+        fprintf(stderr, "cannot open %s\n", output);
+        return 2;
+    }
+
+    fprintf(out, "{\n  \"benchmark\": \"camera_kernels\",\n  \"version\": 1,\n"
+                 "  \"cpu_mhz\": %d,\n  \"results\": [", mhz);
+
+    for (size_t r = 0; r < sizeof(gResolutions) / sizeof(gResolutions[0]); r++) {
+        const Resolution &res = gResolutions[r];
+
+        if (resolutionFilter && strcmp(resolutionFilter, res.name)) {
+            continue;
+        }
+
+        for (size_t k = 0; k < sizeof(gKernels) / sizeof(gKernels[0]); k++) {
+            const Kernel &kernel = gKernels[k];
+            int bpp = kernel.layout == LAYOUT_NV12 ? 1 : 2;
+            int packed = res.width * bpp;
+
+            if (kernelFilter && !strstr(kernel.name, kernelFilter)) {
+                continue;
+            }
+
+            for (int s = 0; s < 2; s++) {
+                int stride = s ? ALIGN_UP(packed, TILER_STRIDE_ALIGN) : packed;
+                size_t planeSize = (size_t) stride * res.height;
+                size_t srcSize = kernel.layout == LAYOUT_NV12 ? planeSize * 3 / 2 : planeSize;
+                Case c;
+
+                if ((kernel.stridedOnly && !s) || (kernel.packedOnly && s)) {
+                    continue;
+                }
+
+                memset(&c, 0, sizeof(c));
+                c.kernel = kernel.name;
+                c.format = kernel.format;
+                c.width = res.width;
+                c.height = res.height;
+                c.stride = stride;
+                c.srcBytes = kernel.layout == LAYOUT_NV12 ? packed * res.height * 3 / 2
+                                                           : packed * res.height;
+                /* Large enough for a YUV444 line, a strided copy or a JPEG */
+                c.dstSize = ALIGN_UP(packed, TILER_STRIDE_ALIGN) * 2 * res.height;
+                c.src = (uint8_t *) memalign(TILER_STRIDE_ALIGN, srcSize);
+                c.dst = (uint8_t *) memalign(TILER_STRIDE_ALIGN, c.dstSize);
+                if (!c.src || !c.dst) {
+                    fprintf(stderr, "out of memory for %s %s\n", kernel.name, res.name);
+                    free(c.src);
+                    free(c.dst);
+                    continue;
+                }
+                c.uv = c.src + planeSize;
+                fillPattern(c.src, srcSize);
+                memset(c.dst, 0, c.dstSize);
+
+                /* Warm up caches and lazily mapped pages */
+                kernel.fn(c);
+
+                int iterations = 0;
+                nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+                nsecs_t elapsed;
+                do {
+                    kernel.fn(c);
+                    iterations++;
+                    elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+                } while (elapsed < minTime);
+
+                double nsPerFrame = (double) elapsed / iterations;
+                double pixels = (double) res.width * res.height;
+                double nsPerPixel = nsPerFrame / pixels;
+
+                fprintf(out, "%s\n    { \"kernel\": \"%s\", \"format\": \"%s\", "
+                             "\"width\": %d, \"height\": %d, \"stride\": %d, "
+                             "\"iterations\": %d, \"ns_per_frame\": %.0f, "
+                             "\"mb_per_s\": %.1f, \"ns_per_pixel\": %.3f, "
+                             "\"cycles_per_pixel\": %.3f }",
+                        first ? "" : ",", kernel.name, kernel.format,
+                        res.width, res.height, stride, iterations, nsPerFrame,
+                        c.srcBytes * 1e3 / nsPerFrame, nsPerPixel,
+                        nsPerPixel * mhz / 1e3);
+                fflush(out);
+                first = false;
+
+                free(c.src);
+                free(c.dst);
+            }
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    return 0;
+}
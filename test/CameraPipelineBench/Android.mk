@@ -0,0 +1,25 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	camera_pipeline_bench.cpp
+
+LOCAL_SHARED_LIBRARIES:= \
+	libhardware \
+	libui \
+	libutils \
+	libcutils \
+	libcamera_client
+
+LOCAL_C_INCLUDES += \
+	frameworks/base/include/ui \
+	frameworks/base/include/camera \
+	hardware/ti/omap4xxx/camera/inc/SyntheticCameraAdapter
+
+LOCAL_MODULE:= camera_pipeline_bench
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -fno-short-enums -O2 -D___ANDROID___
+
+include $(BUILD_HEAPTRACKED_EXECUTABLE)
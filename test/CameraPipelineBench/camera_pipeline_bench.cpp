@@ -0,0 +1,735 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Drives the camera HAL in-process through preview, recording and still
+ * capture, using a stub preview window instead of SurfaceFlinger, and
+ * reports per-stage latency, throughput and CPU time per frame.
+ *
+ * Meant to run against the HAL built with OMAP4_CAMERA_HAL_USES := SYNTHETIC,
+ * whose frames carry a SyntheticFrameStamp so that latency can be measured
+ * from frame generation to each consumer. Against a real sensor only
+ * throughput, CPU and capture latencies are meaningful.
+ *
+ * Exits with 1 if one of the --min-fps / --max-p99 gates is missed, which
+ * makes it usable as a regression check for changes in camera/.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <hardware/hardware.h>
+#include <hardware/camera.h>
+#include <camera/CameraParameters.h>
+#include <ui/GraphicBufferAllocator.h>
+#include <ui/GraphicBufferMapper.h>
+#include <ui/Rect.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "SyntheticFrameStamp.h"
+
+using namespace android;
+
+#define MAX_WINDOW_BUFFERS 16
+#define CAPTURE_TIMEOUT_NS s2ns(10)
+
+/* ------------------------------------------------------------------------ */
+/* Latency statistics                                                        */
+/* ------------------------------------------------------------------------ */
+
+struct Stage {
+    const char *name;
+    Vector<nsecs_t> samples;
+};
+
+enum {
+    STAGE_DISPLAY = 0,      /* frame generated -> enqueued to the window */
+    STAGE_PREVIEW_CB,       /* frame generated -> preview data callback */
+    STAGE_VIDEO_CB,         /* frame generated -> video data callback */
+    STAGE_SHUTTER,          /* take_picture() -> shutter notification */
+    STAGE_JPEG,             /* take_picture() -> compressed image callback */
+    STAGE_COUNT
+};
+
+static Stage gStages[STAGE_COUNT] = {
+    { "display", Vector<nsecs_t>() },
+    { "preview_cb", Vector<nsecs_t>() },
+    { "video_cb", Vector<nsecs_t>() },
+    { "shutter", Vector<nsecs_t>() },
+    { "jpeg", Vector<nsecs_t>() },
+};
+
+static pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gCond = PTHREAD_COND_INITIALIZER;
+
+static void record(int stage, nsecs_t latency)
+{
+    pthread_mutex_lock(&gLock);
+    gStages[stage].samples.add(latency);
+    pthread_mutex_unlock(&gLock);
+}
+
+static int compareNsecs(const void *a, const void *b)
+{
+    nsecs_t x = *(const nsecs_t *) a;
+    nsecs_t y = *(const nsecs_t *) b;
+    return (x > y) - (x < y);
+}
+
+static nsecs_t percentile(const Vector<nsecs_t> &sorted, int pct)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    size_t i = (sorted.size() - 1) * pct / 100;
+    return sorted[i];
+}
+
+/* ------------------------------------------------------------------------ */
+/* Stub preview window                                                       */
+/* ------------------------------------------------------------------------ */
+
+enum BufferState {
+    BUFFER_FREE = 0,
+    BUFFER_DEQUEUED,
+    BUFFER_DISPLAYED,
+};
+
+struct StubWindow {
+    preview_stream_ops_t ops;   /* must stay first, the HAL passes &ops back */
+    int width;
+    int height;
+    int format;
+    int usage;
+    int count;
+    buffer_handle_t handles[MAX_WINDOW_BUFFERS];
+    int stride[MAX_WINDOW_BUFFERS];
+    BufferState state[MAX_WINDOW_BUFFERS];
+    unsigned int enqueued;
+};
+
+static StubWindow gWindow;
+
+static int windowIndex(buffer_handle_t *buffer)
+{
+    for (int i = 0; i < gWindow.count; i++) {
+        if (&gWindow.handles[i] == buffer) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void freeWindowBuffers()
+{
+    for (int i = 0; i < gWindow.count; i++) {
+        if (gWindow.handles[i]) {
+            GraphicBufferAllocator::get().free(gWindow.handles[i]);
+            gWindow.handles[i] = NULL;
+        }
+    }
+}
+
+static int allocWindowBuffers()
+{
+    freeWindowBuffers();
+
+    for (int i = 0; i < gWindow.count; i++) {
+        status_t err = GraphicBufferAllocator::get().alloc(gWindow.width, gWindow.height,
+                                                           gWindow.format, gWindow.usage,
+                                                           &gWindow.handles[i],
+                                                           &gWindow.stride[i]);
+        if (err != NO_ERROR) {
+            fprintf(stderr, "gralloc alloc %dx%d fmt 0x%x failed: %d\n",
+                    gWindow.width, gWindow.height, gWindow.format, err);
+            return err;
+        }
+        gWindow.state[i] = BUFFER_FREE;
+    }
+
+    return NO_ERROR;
+}
+
+static int window_dequeue_buffer(preview_stream_ops_t *w, buffer_handle_t **buffer, int *stride)
+{
+    int ret = -EBUSY;
+
+    pthread_mutex_lock(&gLock);
+
+    if (!gWindow.handles[0] && allocWindowBuffers() != NO_ERROR) {
+        pthread_mutex_unlock(&gLock);
+        return -ENOMEM;
+    }
+
+    for (;;) {
+        for (int i = 0; i < gWindow.count; i++) {
+            if (gWindow.state[i] == BUFFER_FREE) {
+                gWindow.state[i] = BUFFER_DEQUEUED;
+                *buffer = &gWindow.handles[i];
+                *stride = gWindow.stride[i];
+                ret = 0;
+                break;
+            }
+        }
+        if (ret == 0) {
+            break;
+        }
+        pthread_cond_wait(&gCond, &gLock);
+    }
+
+    pthread_mutex_unlock(&gLock);
+
+    return ret;
+}
+
+static int window_enqueue_buffer(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    int i = windowIndex(buffer);
+    void *y_uv[2] = { NULL, NULL };
+    Rect bounds(gWindow.width, gWindow.height);
+
+    if (i < 0) {
+        return -EINVAL;
+    }
+
+    if (GraphicBufferMapper::get().lock(*buffer, GRALLOC_USAGE_SW_READ_OFTEN,
+                                        bounds, y_uv) == NO_ERROR) {
+        SyntheticFrameStamp stamp;
+        memcpy(&stamp, y_uv[0], sizeof(stamp));
+        GraphicBufferMapper::get().unlock(*buffer);
+
+        if (stamp.magic == SYNTHETIC_FRAME_STAMP_MAGIC) {
+            record(STAGE_DISPLAY, now - stamp.generated);
+        }
+    }
+
+    /* Like a real display, the last buffer stays on screen until the next one arrives */
+    pthread_mutex_lock(&gLock);
+    for (int j = 0; j < gWindow.count; j++) {
+        if (gWindow.state[j] == BUFFER_DISPLAYED) {
+            gWindow.state[j] = BUFFER_FREE;
+        }
+    }
+    gWindow.state[i] = BUFFER_DISPLAYED;
+    gWindow.enqueued++;
+    pthread_cond_broadcast(&gCond);
+    pthread_mutex_unlock(&gLock);
+
+    return 0;
+}
+
+static int window_cancel_buffer(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    int i = windowIndex(buffer);
+
+    if (i < 0) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&gLock);
+    gWindow.state[i] = BUFFER_FREE;
+    pthread_cond_broadcast(&gCond);
+    pthread_mutex_unlock(&gLock);
+
+    return 0;
+}
+
+static int window_set_buffer_count(preview_stream_ops_t *w, int count)
+{
+    if (count <= 0 || count > MAX_WINDOW_BUFFERS) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&gLock);
+    freeWindowBuffers();
+    gWindow.count = count;
+    pthread_mutex_unlock(&gLock);
+
+    return 0;
+}
+
+static int window_set_buffers_geometry(preview_stream_ops_t *w, int width, int height, int format)
+{
+    pthread_mutex_lock(&gLock);
+    freeWindowBuffers();
+    gWindow.width = width;
+    gWindow.height = height;
+    gWindow.format = format;
+    pthread_mutex_unlock(&gLock);
+
+    return 0;
+}
+
+static int window_set_crop(preview_stream_ops_t *w, int left, int top, int right, int bottom)
+{
+    return 0;
+}
+
+static int window_set_usage(preview_stream_ops_t *w, int usage)
+{
+    gWindow.usage = usage;
+    return 0;
+}
+
+static int window_set_swap_interval(preview_stream_ops_t *w, int interval)
+{
+    return 0;
+}
+
+static int window_get_min_undequeued_buffer_count(const preview_stream_ops_t *w, int *count)
+{
+    /* The buffer on screen */
+    *count = 1;
+    return 0;
+}
+
+static int window_lock_buffer(preview_stream_ops_t *w, buffer_handle_t *buffer)
+{
+    return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* HAL callbacks                                                             */
+/* ------------------------------------------------------------------------ */
+
+static camera_device_t *gDevice;
+static nsecs_t gCaptureStart;
+static bool gCaptureDone;
+static size_t gJpegSize;
+static nsecs_t gLastVideoTimestamp;
+static unsigned int gVideoFrames;
+static unsigned int gVideoCadenceErrors;
+static nsecs_t gFramePeriod;
+
+struct BenchMemory {
+    camera_memory_t mem;
+    size_t size;
+    bool mapped;
+};
+
+static void releaseMemory(camera_memory_t *mem)
+{
+    BenchMemory *m = (BenchMemory *) mem;
+
+    if (m->mapped) {
+        munmap(m->mem.data, m->size);
+    } else {
+        free(m->mem.data);
+    }
+    free(m);
+}
+
+static camera_memory_t *requestMemory(int fd, size_t buf_size, unsigned int num_bufs, void *user)
+{
+    BenchMemory *m = (BenchMemory *) calloc(1, sizeof(BenchMemory));
+
+    if (!m) {
+        return NULL;
+    }
+
+    m->size = buf_size * num_bufs;
+    if (fd >= 0) {
+        m->mem.data = mmap(NULL, m->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        m->mapped = m->mem.data != MAP_FAILED;
+        if (!m->mapped) {
+            m->mem.data = NULL;
+        }
+    }
+    if (!m->mem.data) {
+        m->mem.data = calloc(1, m->size);
+    }
+    if (!m->mem.data) {
+        free(m);
+        return NULL;
+    }
+
+    m->mem.size = buf_size;
+    m->mem.handle = m;
+    m->mem.release = releaseMemory;
+
+    return &m->mem;
+}
+
+static bool frameStamp(const camera_memory_t *data, unsigned int index, SyntheticFrameStamp &stamp)
+{
+    if (!data || !data->data || data->size < sizeof(stamp)) {
+        return false;
+    }
+
+    memcpy(&stamp, (const uint8_t *) data->data + index * data->size, sizeof(stamp));
+
+    return stamp.magic == SYNTHETIC_FRAME_STAMP_MAGIC;
+}
+
+static void notifyCallback(int32_t msg_type, int32_t ext1, int32_t ext2, void *user)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (msg_type == CAMERA_MSG_SHUTTER) {
+        record(STAGE_SHUTTER, now - gCaptureStart);
+    } else if (msg_type == CAMERA_MSG_ERROR) {
+        fprintf(stderr, "camera error %d %d\n", ext1, ext2);
+    }
+}
+
+static void dataCallback(int32_t msg_type, const camera_memory_t *data, unsigned int index,
+                         camera_frame_metadata_t *metadata, void *user)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    SyntheticFrameStamp stamp;
+
+    if (msg_type & CAMERA_MSG_PREVIEW_FRAME) {
+        if (frameStamp(data, index, stamp)) {
+            record(STAGE_PREVIEW_CB, now - stamp.generated);
+        }
+    }
+
+    if (msg_type & CAMERA_MSG_COMPRESSED_IMAGE) {
+        record(STAGE_JPEG, now - gCaptureStart);
+
+        pthread_mutex_lock(&gLock);
+        gJpegSize = data ? data->size : 0;
+        gCaptureDone = true;
+        pthread_cond_broadcast(&gCond);
+        pthread_mutex_unlock(&gLock);
+    }
+}
+
+static void dataTimestampCallback(nsecs_t timestamp, int32_t msg_type, const camera_memory_t *data,
+                                  unsigned int index, void *user)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    SyntheticFrameStamp stamp;
+
+    if (frameStamp(data, index, stamp)) {
+        record(STAGE_VIDEO_CB, now - stamp.generated);
+    }
+
+    /* Synthetic timestamps advance by exactly one frame period per frame */
+    pthread_mutex_lock(&gLock);
+    if (gVideoFrames && gFramePeriod &&
+        ((timestamp - gLastVideoTimestamp) % gFramePeriod) != 0) {
+        gVideoCadenceErrors++;
+    }
+    gLastVideoTimestamp = timestamp;
+    gVideoFrames++;
+    pthread_mutex_unlock(&gLock);
+
+    gDevice->ops->release_recording_frame(gDevice, data->data);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Phases                                                                    */
+/* ------------------------------------------------------------------------ */
+
+struct PhaseResult {
+    nsecs_t wall;
+    nsecs_t cpu;
+    unsigned int frames;
+};
+
+static nsecs_t cpuTime()
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+
+    return s2ns(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+           us2ns(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+static void resetStats()
+{
+    pthread_mutex_lock(&gLock);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        gStages[i].samples.clear();
+    }
+    gWindow.enqueued = 0;
+    gVideoFrames = 0;
+    gVideoCadenceErrors = 0;
+    pthread_mutex_unlock(&gLock);
+}
+
+static void beginPhase(PhaseResult &r)
+{
+    resetStats();
+    r.wall = systemTime(SYSTEM_TIME_MONOTONIC);
+    r.cpu = cpuTime();
+}
+
+static void endPhase(PhaseResult &r)
+{
+    r.wall = systemTime(SYSTEM_TIME_MONOTONIC) - r.wall;
+    r.cpu = cpuTime() - r.cpu;
+    pthread_mutex_lock(&gLock);
+    r.frames = gWindow.enqueued;
+    pthread_mutex_unlock(&gLock);
+}
+
+struct Gates {
+    double minFps;
+    nsecs_t maxP99;
+};
+
+static int report(const char *phase, const PhaseResult &r, const Gates &gates)
+{
+    int failures = 0;
+    double fps = r.wall ? r.frames * 1e9 / r.wall : 0;
+
+    printf("%-8s frames %u in %lld ms, %.2f fps, cpu %lld us/frame\n",
+           phase, r.frames, ns2ms(r.wall), fps,
+           r.frames ? ns2us(r.cpu / r.frames) : 0);
+
+    if (gates.minFps > 0 && r.frames && fps < gates.minFps) {
+        printf("%-8s FAIL fps %.2f < %.2f\n", phase, fps, gates.minFps);
+        failures++;
+    }
+
+    pthread_mutex_lock(&gLock);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        Vector<nsecs_t> sorted(gStages[i].samples);
+        if (sorted.isEmpty()) {
+            continue;
+        }
+        qsort(sorted.editArray(), sorted.size(), sizeof(nsecs_t), compareNsecs);
+
+        nsecs_t p99 = percentile(sorted, 99);
+        printf("%-8s %-10s n %5u  p50 %7lld us  p99 %7lld us  max %7lld us\n",
+               phase, gStages[i].name, sorted.size(),
+               ns2us(percentile(sorted, 50)), ns2us(p99), ns2us(sorted[sorted.size() - 1]));
+
+        if (gates.maxP99 > 0 && i <= STAGE_VIDEO_CB && p99 > gates.maxP99) {
+            printf("%-8s FAIL %s p99 %lld us > %lld us\n",
+                   phase, gStages[i].name, ns2us(p99), ns2us(gates.maxP99));
+            failures++;
+        }
+    }
+    if (gVideoFrames) {
+        printf("%-8s video frames %u, timestamp cadence errors %u\n",
+               phase, gVideoFrames, gVideoCadenceErrors);
+    }
+    pthread_mutex_unlock(&gLock);
+
+    return failures;
+}
+
+static bool waitForCapture()
+{
+    struct timespec deadline;
+    bool done;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += CAPTURE_TIMEOUT_NS / s2ns(1);
+
+    pthread_mutex_lock(&gLock);
+    while (!gCaptureDone) {
+        if (pthread_cond_timedwait(&gCond, &gLock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    done = gCaptureDone;
+    pthread_mutex_unlock(&gLock);
+
+    return done;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [options]\n"
+           "  -c <id>          camera id (0)\n"
+           "  -s <WxH>         preview and video size (1280x720)\n"
+           "  -f <format>      preview format, yuv420sp or yuv422i-yuyv (yuv420sp)\n"
+           "  -r <fps>         preview frame rate (30)\n"
+           "  -p <WxH>         picture size (1920x1080)\n"
+           "  -d <seconds>     duration of the preview and record phases (5)\n"
+           "  -n <count>       number of still captures (3)\n"
+           "  -b               enable preview data callbacks\n"
+           "  --min-fps <fps>  fail if a streaming phase runs slower\n"
+           "  --max-p99 <us>   fail if a per-frame stage p99 latency is higher\n",
+           name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *cameraId = "0";
+    const char *previewSize = "1280x720";
+    const char *previewFormat = CameraParameters::PIXEL_FORMAT_YUV420SP;
+    const char *pictureSize = "1920x1080";
+    int fps = 30;
+    int duration = 5;
+    int captures = 3;
+    bool previewCallbacks = false;
+    Gates gates = { 0, 0 };
+    int failures = 0;
+    camera_module_t *module;
+    PhaseResult r;
+    int width, height, opt;
+
+    static const struct option longOptions[] = {
+        { "min-fps", required_argument, NULL, 'F' },
+        { "max-p99", required_argument, NULL, 'P' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    while ((opt = getopt_long(argc, argv, "c:s:f:r:p:d:n:bh", longOptions, NULL)) != -1) {
+        switch (opt) {
+        case 'c': cameraId = optarg; break;
+        case 's': previewSize = optarg; break;
+        case 'f': previewFormat = optarg; break;
+        case 'r': fps = atoi(optarg); break;
+        case 'p': pictureSize = optarg; break;
+        case 'd': duration = atoi(optarg); break;
+        case 'n': captures = atoi(optarg); break;
+        case 'b': previewCallbacks = true; break;
+        case 'F': gates.minFps = atof(optarg); break;
+        case 'P': gates.maxP99 = us2ns(atoll(optarg)); break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (sscanf(previewSize, "%dx%d", &width, &height) != 2 || fps <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    gFramePeriod = s2ns(1) / fps;
+
+    if (hw_get_module(CAMERA_HARDWARE_MODULE_ID, (const hw_module_t **) &module) != 0) {
+        fprintf(stderr, "camera HAL module not found\n");
+        return 2;
+    }
+
+    // a HAL that enumerates no camera fails every open, say so instead
+    const int numCameras = module->get_number_of_cameras();
+    if (numCameras <= 0 || atoi(cameraId) < 0 || atoi(cameraId) >= numCameras) {
+        fprintf(stderr, "camera %s not enumerated, the HAL reports %d camera(s)\n",
+                cameraId, numCameras);
+        return 2;
+    }
+
+    if (module->common.methods->open(&module->common, cameraId,
+                                     (hw_device_t **) &gDevice) != 0) {
+        fprintf(stderr, "camera %s open failed\n", cameraId);
+        return 2;
+    }
+
+    char *flat = gDevice->ops->get_parameters(gDevice);
+    CameraParameters params;
+    params.unflatten(String8(flat));
+    gDevice->ops->put_parameters(gDevice, flat);
+
+    params.setPreviewSize(width, height);
+    params.setPreviewFormat(previewFormat);
+    params.setPreviewFrameRate(fps);
+    params.set(CameraParameters::KEY_VIDEO_SIZE, previewSize);
+    params.set(CameraParameters::KEY_PICTURE_SIZE, pictureSize);
+    gDevice->ops->set_parameters(gDevice, params.flatten().string());
+
+    memset(&gWindow, 0, sizeof(gWindow));
+    gWindow.ops.dequeue_buffer = window_dequeue_buffer;
+    gWindow.ops.enqueue_buffer = window_enqueue_buffer;
+    gWindow.ops.cancel_buffer = window_cancel_buffer;
+    gWindow.ops.set_buffer_count = window_set_buffer_count;
+    gWindow.ops.set_buffers_geometry = window_set_buffers_geometry;
+    gWindow.ops.set_crop = window_set_crop;
+    gWindow.ops.set_usage = window_set_usage;
+    gWindow.ops.set_swap_interval = window_set_swap_interval;
+    gWindow.ops.get_min_undequeued_buffer_count = window_get_min_undequeued_buffer_count;
+    gWindow.ops.lock_buffer = window_lock_buffer;
+
+    gDevice->ops->set_callbacks(gDevice, notifyCallback, dataCallback, dataTimestampCallback,
+                                requestMemory, NULL);
+    gDevice->ops->enable_msg_type(gDevice, CAMERA_MSG_ERROR | CAMERA_MSG_SHUTTER |
+                                  CAMERA_MSG_COMPRESSED_IMAGE);
+    if (previewCallbacks) {
+        gDevice->ops->enable_msg_type(gDevice, CAMERA_MSG_PREVIEW_FRAME);
+    }
+    gDevice->ops->set_preview_window(gDevice, &gWindow.ops);
+
+    printf("camera %s: preview %s %s @ %d fps, picture %s\n",
+           cameraId, previewSize, previewFormat, fps, pictureSize);
+
+    /* Preview */
+    if (gDevice->ops->start_preview(gDevice) != 0) {
+        fprintf(stderr, "start_preview failed\n");
+        failures++;
+        goto exit;
+    }
+    beginPhase(r);
+    sleep(duration);
+    endPhase(r);
+    failures += report("preview", r, gates);
+
+    /* Recording */
+    gDevice->ops->enable_msg_type(gDevice, CAMERA_MSG_VIDEO_FRAME);
+    beginPhase(r);
+    if (gDevice->ops->start_recording(gDevice) == 0) {
+        sleep(duration);
+        gDevice->ops->stop_recording(gDevice);
+        endPhase(r);
+        failures += report("record", r, gates);
+    } else {
+        fprintf(stderr, "start_recording failed\n");
+        failures++;
+    }
+    gDevice->ops->disable_msg_type(gDevice, CAMERA_MSG_VIDEO_FRAME);
+
+    /* Still capture */
+    beginPhase(r);
+    for (int i = 0; i < captures; i++) {
+        pthread_mutex_lock(&gLock);
+        gCaptureDone = false;
+        pthread_mutex_unlock(&gLock);
+
+        gCaptureStart = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (gDevice->ops->take_picture(gDevice) != 0 || !waitForCapture()) {
+            fprintf(stderr, "capture %d failed\n", i);
+            failures++;
+            break;
+        }
+
+        /* The HAL stops preview for the capture, restart it like an application would */
+        gDevice->ops->start_preview(gDevice);
+    }
+    endPhase(r);
+    r.frames = 0;
+    failures += report("capture", r, gates);
+    printf("capture  last jpeg %u bytes\n", gJpegSize);
+
+exit:
+    gDevice->ops->stop_preview(gDevice);
+    gDevice->ops->set_preview_window(gDevice, NULL);
+    gDevice->ops->release(gDevice);
+    gDevice->common.close(&gDevice->common);
+
+    pthread_mutex_lock(&gLock);
+    freeWindowBuffers();
+    pthread_mutex_unlock(&gLock);
+
+    printf("%s\n", failures ? "FAIL" : "PASS");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+
+HWC_PATH:= ../../hwc
+
+# The composer is built from the HAL sources, the framebuffer device,
+# Tiler-1D, EGL and the properties are mocked so it runs on the host
+LOCAL_SRC_FILES:= \
+	hwc_replay.cpp \
+	hwc_replay_mocks.cpp \
+	$(HWC_PATH)/hwc_init.cpp \
+	$(HWC_PATH)/hwc.cpp \
+	$(HWC_PATH)/hwc_dss.cpp \
+	$(HWC_PATH)/hwc_buffers.cpp \
+	$(HWC_PATH)/hwc_hdmi.cpp \
+	$(HWC_PATH)/hwc_stats.cpp \
+	$(HWC_PATH)/hwc_capture.cpp
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/$(HWC_PATH) \
+	hardware/ti/tiler \
+	hardware/ti/omap4xxx/include \
+	frameworks/base/opengl/include
+
+LOCAL_STATIC_LIBRARIES:= \
+	libutils \
+	libcutils \
+	liblog
+
+LOCAL_LDFLAGS:= \
+	-Wl,--wrap=open \
+	-Wl,--wrap=close \
+	-Wl,--wrap=ioctl \
+	-Wl,--wrap=property_get
+
+LOCAL_LDLIBS:= -lpthread -lrt
+
+LOCAL_MODULE:= hwc_replay
+LOCAL_MODULE_TAGS:= tests
+
+# The device handle layout of the gralloc this composer is built against
+LOCAL_CFLAGS += -Wall -O2 -DLOG_TAG=\"ti_hwc\" -DUSE_MOTOROLA_CODE
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+HWC_PATH:= ../../hwc
+
+# The HDMI clone sysfs transactions, run against a fake sysfs tree
+LOCAL_SRC_FILES:= \
+	hdmi_sysfs_test.cpp \
+	hwc_replay_mocks.cpp \
+	$(HWC_PATH)/hwc_hdmi.cpp
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/$(HWC_PATH) \
+	hardware/ti/tiler \
+	hardware/ti/omap4xxx/include \
+	frameworks/base/opengl/include
+
+LOCAL_STATIC_LIBRARIES:= \
+	libutils \
+	libcutils \
+	liblog
+
+LOCAL_LDFLAGS:= \
+	-Wl,--wrap=open \
+	-Wl,--wrap=close \
+	-Wl,--wrap=ioctl \
+	-Wl,--wrap=property_get
+
+LOCAL_LDLIBS:= -lpthread -lrt
+
+LOCAL_MODULE:= hwc_hdmi_sysfs_test
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -O2 -DLOG_TAG=\"ti_hwc\" -DUSE_MOTOROLA_CODE
+
+include $(BUILD_HOST_EXECUTABLE)
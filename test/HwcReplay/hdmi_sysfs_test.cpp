@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the HDMI UI cloning sysfs transactions against a fake sysfs tree,
+ * by default on tmpfs under /dev/shm, and checks the resulting attribute
+ * values, the skipped writes and the rollback when an attribute fails.
+ *
+ *   hwc_hdmi_sysfs_test [-d <directory for the fake tree>]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include <utils/Timers.h>
+
+#include "hwc_hdmi.h"
+#include "hwc_replay.h"
+
+struct fake_attr {
+    const char *path;
+    const char *initial;
+};
+
+/* Values of a device booted with fb1 on the secondary LCD */
+static const struct fake_attr g_fake_attrs[] = {
+    { "/sys/class/graphics/fb0/overlays", "0" },
+    { "/sys/class/graphics/fb1/overlays", "1" },
+    { "/sys/class/graphics/fb0/fit_to_screen", "0" },
+    { "/sys/devices/platform/omapdss/overlay1/manager", "2lcd" },
+    { "/sys/devices/platform/omapdss/overlay1/enabled", "1" },
+    { "/sys/devices/platform/omapdss/overlay1/zorder", "1" },
+    { "/sys/devices/platform/omapdss/overlay3/enabled", "1" },
+};
+
+#define NUM_FAKE_ATTRS (int)(sizeof(g_fake_attrs) / sizeof(g_fake_attrs[0]))
+
+static char g_root[256];
+static int g_failures;
+
+static void make_dirs(const char *path)
+{
+    char dir[512];
+
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *p = dir + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(dir, 0755);
+            *p = '/';
+        }
+    }
+}
+
+static void write_attr(const char *path, const char *value)
+{
+    char full[512];
+
+    snprintf(full, sizeof(full), "%s%s", g_root, path);
+    make_dirs(full);
+
+    /* sysfs shows values with a trailing newline */
+    FILE *f = fopen(full, "w");
+    if (f == NULL) {
+        fprintf(stderr, "%s: %s\n", full, strerror(errno));
+        exit(2);
+    }
+    fprintf(f, "%s\n", value);
+    fclose(f);
+}
+
+static void read_attr(const char *path, char *value, int size)
+{
+    char full[512];
+    int len = 0;
+
+    snprintf(full, sizeof(full), "%s%s", g_root, path);
+    FILE *f = fopen(full, "r");
+    if (f != NULL) {
+        len = fread(value, 1, size - 1, f);
+        fclose(f);
+    }
+    value[len] = '\0';
+
+    /* the composer writes the terminator, a shorter value leaves the tail */
+    value[strcspn(value, "\n")] = '\0';
+}
+
+static void expect(const char *step, const char *path, const char *expected)
+{
+    char value[64];
+
+    read_attr(path, value, sizeof(value));
+    if (strcmp(value, expected)) {
+        printf("FAIL %s: %s is \"%s\", expected \"%s\"\n", step, path, value, expected);
+        g_failures++;
+    }
+}
+
+static void expect_count(const char *step, const char *what, unsigned int value, unsigned int expected)
+{
+    if (value != expected) {
+        printf("FAIL %s: %u %s, expected %u\n", step, value, what, expected);
+        g_failures++;
+    }
+}
+
+static void expect_clone_stopped(const char *step, int check_fit)
+{
+    expect(step, g_fake_attrs[0].path, "0");
+    expect(step, g_fake_attrs[1].path, "1");
+    if (check_fit)
+        expect(step, g_fake_attrs[2].path, "0");
+    expect(step, g_fake_attrs[3].path, "2lcd");
+    expect(step, g_fake_attrs[4].path, "0");
+}
+
+static void expect_clone_started(const char *step)
+{
+    expect(step, g_fake_attrs[0].path, "0,1");
+    expect(step, g_fake_attrs[1].path, "");
+    expect(step, g_fake_attrs[2].path, "1");
+    expect(step, g_fake_attrs[3].path, "tv");
+    expect(step, g_fake_attrs[4].path, "1");
+    expect(step, g_fake_attrs[5].path, "0");
+}
+
+static void remove_tree(const char *dir)
+{
+    char cmd[512];
+
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", dir);
+    if (system(cmd))
+        fprintf(stderr, "unable to remove %s\n", dir);
+}
+
+int main(int argc, char **argv)
+{
+    const char *base = access("/dev/shm", W_OK) ? "/tmp" : "/dev/shm";
+    hwc_hdmi_stats_t before, after;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:h")) != -1) {
+        switch (opt) {
+        case 'd': base = optarg; break;
+        default:
+            printf("usage: %s [-d <directory for the fake tree>]\n", argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    snprintf(g_root, sizeof(g_root), "%s/hwc_sysfs.XXXXXX", base);
+    if (mkdtemp(g_root) == NULL) {
+        fprintf(stderr, "%s: %s\n", g_root, strerror(errno));
+        return 2;
+    }
+
+    for (int i = 0; i < NUM_FAKE_ATTRS; i++)
+        write_attr(g_fake_attrs[i].path, g_fake_attrs[i].initial);
+    mock_set_property(HWC_HDMI_SYSFS_ROOT_PROPERTY, g_root);
+
+    /* hotplug: every attribute changes */
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    hwc_hdmi_clone(true);
+    nsecs_t cold = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    get_hdmi_stats(&after);
+    expect_clone_started("start");
+    expect_count("start", "writes", after.writes, 7);
+    expect_count("start", "skipped", after.skipped, 0);
+
+    /* unplug: overlay1 is written twice while starting, nothing to skip */
+    before = after;
+    hwc_hdmi_clone(false);
+    get_hdmi_stats(&after);
+    expect_clone_stopped("stop", 1);
+    expect_count("stop", "writes", after.writes - before.writes, 5);
+
+    /* replug: overlay1 is already disabled and its zorder still set */
+    before = after;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    hwc_hdmi_clone(true);
+    nsecs_t warm = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    get_hdmi_stats(&after);
+    expect_clone_started("replug");
+    expect_count("replug", "skipped", after.skipped - before.skipped, 2);
+    expect_count("replug", "writes", after.writes - before.writes, 5);
+
+    /* the first frame after a change reports the latency */
+    hwc_hdmi_frame_done();
+    get_hdmi_stats(&after);
+    if (after.last_first_frame_ns < after.last_apply_ns) {
+        printf("FAIL first frame: %lld ns before the change was applied\n",
+               (long long) after.last_first_frame_ns);
+        g_failures++;
+    }
+
+    hwc_hdmi_clone(false);
+
+    /*
+     * Writing fit_to_screen fails, it is a fifo which can't be written at
+     * an offset: the writes before it are undone
+     */
+    hwc_hdmi_deinit();
+    char fit[512];
+    snprintf(fit, sizeof(fit), "%s%s", g_root, g_fake_attrs[2].path);
+    unlink(fit);
+    if (mkfifo(fit, 0644)) {
+        fprintf(stderr, "%s: %s\n", fit, strerror(errno));
+        return 2;
+    }
+
+    get_hdmi_stats(&before);
+    hwc_hdmi_clone(true);
+    get_hdmi_stats(&after);
+    expect_clone_stopped("rollback", 0);
+    expect_count("rollback", "writes", after.writes - before.writes, 6);
+    expect_count("rollback", "rollbacks", after.rollbacks - before.rollbacks, 1);
+
+    hwc_hdmi_deinit();
+    remove_tree(g_root);
+
+    printf("hotplug: %d us with opening the attributes, %d us with them cached\n",
+           (int) ns2us(cold), (int) ns2us(warm));
+    printf("%s\n", g_failures ? "FAILED" : "PASSED");
+
+    return g_failures ? 1 : 0;
+}
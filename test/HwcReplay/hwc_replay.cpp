@@ -0,0 +1,460 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays captured layer lists through the composer on a Linux host.
+ *
+ * The composer sources are built with mocks for the framebuffer device,
+ * Tiler-1D and EGL (hwc_replay_mocks.cpp), opened through the HAL module
+ * like SurfaceFlinger does, and given every frame of a capture to prepare
+ * and set. Captures are written on a device with debug.hwc.capture, the
+ * format is described in hwc/hwc_capture.h. Sample captures are in
+ * traces/.
+ *
+ * The summary reports the CPU time of prepare and set, the Tiler-1D
+ * map/unmap traffic, how many video pipelines were used and how much of
+ * the screen was still composited with GLES:
+ *
+ *   hwc_replay -l 10 traces/video_playback.txt
+ *
+ * RGB layers only reach the overlays, and Tiler-1D, with RGB overlays
+ * enabled:
+ *
+ *   hwc_replay -p debug.hwc.rgb_overlays=1 traces/game_bgra.txt
+ *
+ * The exit status is 1 if the mock DSS rejected a configuration, a layer
+ * was marked HWC_OVERLAY without being programmed into a pipeline, or a
+ * buffer was unmapped while the DSS showed it, so the harness can gate
+ * composition policy changes in CI.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <hardware/hardware.h>
+#include <hardware/hwcomposer.h>
+
+#include "hwc_priv.h"
+#include "hwc_dss.h"
+#include "hwc_capture.h"
+#include "hwc_replay.h"
+
+#define LINE_MAX_LEN 512
+
+/* hwc_init.cpp */
+extern ti_hwc_module_t HAL_MODULE_INFO_SYM;
+
+/* One captured layer, handle is an index into g_handles or -1 */
+struct replay_layer {
+    int handle;
+    uint32_t transform;
+    int32_t blending;
+    uint32_t flags;
+    hwc_rect_t crop;
+    hwc_rect_t frame;
+    int visible_rects;
+};
+
+struct replay_frame {
+    uint32_t flags;
+    int first_layer;
+    int num_layers;
+};
+
+/* Mock gralloc buffer, keyed by the handle value of the capture */
+struct replay_handle {
+    unsigned long id;
+    IMG_native_handle_t handle;
+};
+
+struct frame_result {
+    long prepare_ns;
+    long set_ns;
+    int overlays;
+    int lost_overlays;      /* overlay layers and pipelines that differ */
+    int gles_layers;
+    unsigned int gles_pixels;
+};
+
+static struct replay_handle *g_handles;
+static int g_num_handles;
+
+static struct replay_layer *g_layers;
+static int g_num_layers;
+
+static struct replay_frame *g_frames;
+static int g_num_frames;
+
+static int g_max_layers;
+static int g_max_rects;
+
+static void *grow(void *array, int count, size_t size)
+{
+    /* doubles at powers of two */
+    if (count & (count - 1))
+        return array;
+
+    void *p = realloc(array, (count ? count * 2 : 16) * size);
+    if (p == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(2);
+    }
+    return p;
+}
+
+static int find_handle(unsigned long id)
+{
+    for (int i = 0; i < g_num_handles; i++) {
+        if (g_handles[i].id == id)
+            return i;
+    }
+    return -1;
+}
+
+static int add_handle(unsigned long id, unsigned long vptr, int format, int width,
+                      int height, unsigned int bpp, int size)
+{
+    int i = find_handle(id);
+    if (i >= 0)
+        return i;
+
+    g_handles = (struct replay_handle *) grow(g_handles, g_num_handles, sizeof(*g_handles));
+    i = g_num_handles++;
+
+    struct replay_handle *h = &g_handles[i];
+    memset(h, 0, sizeof(*h));
+    h->id = id;
+    h->handle.base.version = sizeof(native_handle_t);
+    h->handle.iFormat = format;
+    h->handle.iWidth = width;
+    h->handle.iHeight = height;
+    h->handle.uiBpp = bpp;
+    h->handle.m_size = size;
+    h->handle.vptr = (void *) vptr;
+    /* one allocation per captured handle, in one client process */
+    h->handle.ui64Stamp = id;
+    h->handle.pid = 1;
+
+    return i;
+}
+
+static int load_capture(const char *path, struct mock_config *config)
+{
+    char line[LINE_MAX_LEN];
+    int line_no = 0;
+    int version = 0;
+    int remaining = 0;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        struct replay_layer l;
+        unsigned long id, vptr;
+        int format, width, height, size, bpp_int;
+        unsigned int bpp, flags;
+        int n;
+
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+
+        if (sscanf(line, "hwc-capture %d", &version) == 1) {
+            if (version != HWC_CAPTURE_VERSION)
+                break;
+        } else if (sscanf(line, "display %d %d %d", &width, &height, &bpp_int) == 3) {
+            config->width = width;
+            config->height = height;
+            config->bpp = bpp_int;
+        } else if (sscanf(line, "frame %x %d", &flags, &n) == 2 && !remaining && n >= 0) {
+            g_frames = (struct replay_frame *) grow(g_frames, g_num_frames, sizeof(*g_frames));
+            g_frames[g_num_frames].flags = flags;
+            g_frames[g_num_frames].first_layer = g_num_layers;
+            g_frames[g_num_frames].num_layers = n;
+            g_num_frames++;
+            remaining = n;
+            if (n > g_max_layers)
+                g_max_layers = n;
+        } else if (sscanf(line, "layer %lx %lx %d %d %d %u %d %u %x %x %d %d %d %d %d %d %d %d %d",
+                          &id, &vptr, &format, &width, &height, &bpp, &size,
+                          &l.transform, (unsigned int *) &l.blending, &l.flags,
+                          &l.crop.left, &l.crop.top, &l.crop.right, &l.crop.bottom,
+                          &l.frame.left, &l.frame.top, &l.frame.right, &l.frame.bottom,
+                          &l.visible_rects) == 19 && remaining) {
+            l.handle = id ? add_handle(id, vptr, format, width, height, bpp, size) : -1;
+            g_layers = (struct replay_layer *) grow(g_layers, g_num_layers, sizeof(*g_layers));
+            g_layers[g_num_layers++] = l;
+            remaining--;
+            if (l.visible_rects > g_max_rects)
+                g_max_rects = l.visible_rects;
+        } else {
+            fprintf(stderr, "%s:%d: unexpected line\n", path, line_no);
+            fclose(f);
+            return -1;
+        }
+    }
+
+    fclose(f);
+
+    if (version != HWC_CAPTURE_VERSION) {
+        fprintf(stderr, "%s: not a version %d layer capture\n", path, HWC_CAPTURE_VERSION);
+        return -1;
+    }
+
+    if (remaining) {
+        fprintf(stderr, "%s: truncated frame %d\n", path, g_num_frames - 1);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Rebuild a frame the way SurfaceFlinger hands it to the HWC */
+static void build_list(struct replay_frame *frame, hwc_layer_list_t *list, hwc_rect_t *rects)
+{
+    list->flags = frame->flags;
+    list->numHwLayers = frame->num_layers;
+
+    for (int n = 0; n < frame->num_layers; n++) {
+        struct replay_layer *l = &g_layers[frame->first_layer + n];
+        hwc_layer_t *layer = &list->hwLayers[n];
+        hwc_rect_t *visible = &rects[n * g_max_rects];
+
+        memset(layer, 0, sizeof(*layer));
+        layer->compositionType = HWC_FRAMEBUFFER;
+        layer->handle = l->handle >= 0 ? (buffer_handle_t) &g_handles[l->handle].handle : NULL;
+        layer->transform = l->transform;
+        layer->blending = l->blending;
+        layer->flags = l->flags;
+        layer->sourceCrop = l->crop;
+        layer->displayFrame = l->frame;
+
+        /* only the number of rectangles is captured */
+        for (int r = 0; r < l->visible_rects; r++)
+            visible[r] = l->frame;
+        layer->visibleRegionScreen.numRects = l->visible_rects;
+        layer->visibleRegionScreen.rects = visible;
+    }
+}
+
+static long thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static int compare_long(const void *a, const void *b)
+{
+    long x = *(const long *) a;
+    long y = *(const long *) b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void print_percentiles(const char *name, long *values, int count)
+{
+    qsort(values, count, sizeof(values[0]), compare_long);
+    printf("  %-12s %8.1f %8.1f %8.1f %8.1f\n", name,
+           values[count / 2] / 1000.0, values[count * 9 / 10] / 1000.0,
+           values[count * 99 / 100] / 1000.0, values[count - 1] / 1000.0);
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [options] <capture>\n"
+           "  -l <loops>      replay the capture <loops> times (1)\n"
+           "  -p <name=value> set a property for the composer, may be repeated\n"
+           "  -t <pages>      Tiler-1D pages available for mappings (4096)\n"
+           "  -c <file>       write per frame results as CSV\n"
+           "  -h              this help\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *csv_path = NULL;
+    int loops = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:p:t:c:h")) != -1) {
+        switch (opt) {
+        case 'l': loops = atoi(optarg); break;
+        case 't': g_mock_config.tiler_1d_pages = atoi(optarg); break;
+        case 'c': csv_path = optarg; break;
+        case 'p': {
+            char *eq = strchr(optarg, '=');
+            if (eq == NULL || eq == optarg) {
+                usage(argv[0]);
+                return 2;
+            }
+            *eq = '\0';
+            if (mock_set_property(optarg, eq + 1)) {
+                fprintf(stderr, "too many properties\n");
+                return 2;
+            }
+            break;
+        }
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (optind != argc - 1 || loops < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char *path = argv[optind];
+    if (load_capture(path, &g_mock_config))
+        return 2;
+
+    if (!g_num_frames) {
+        fprintf(stderr, "%s: no frames\n", path);
+        return 2;
+    }
+
+    hw_device_t *device = NULL;
+    const hw_module_t *module = &HAL_MODULE_INFO_SYM.base.common;
+    if (module->methods->open(module, HWC_HARDWARE_COMPOSER, &device)) {
+        fprintf(stderr, "unable to open the composer\n");
+        return 2;
+    }
+    hwc_composer_device_t *hwc = (hwc_composer_device_t *) device;
+
+    size_t list_size = sizeof(hwc_layer_list_t) + g_max_layers * sizeof(hwc_layer_t);
+    hwc_layer_list_t *list = (hwc_layer_list_t *) malloc(list_size);
+    hwc_rect_t *rects = (hwc_rect_t *) calloc(g_max_layers * g_max_rects + 1, sizeof(hwc_rect_t));
+    int total = g_num_frames * loops;
+    struct frame_result *results = (struct frame_result *) calloc(total, sizeof(*results));
+    long *values = (long *) malloc(total * sizeof(long));
+    if (!list || !rects || !results || !values) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    /* any non-null display and surface, eglSwapBuffers is mocked */
+    hwc_display_t dpy = (hwc_display_t) 1;
+    hwc_surface_t sur = (hwc_surface_t) 1;
+
+    for (int i = 0; i < total; i++) {
+        struct replay_frame *frame = &g_frames[i % g_num_frames];
+        struct frame_result *r = &results[i];
+
+        build_list(frame, list, rects);
+
+        hwc_dss_commit_stats_t before, after;
+        get_dss_commit_stats(&before);
+
+        long start = thread_cpu_ns();
+        hwc->prepare(hwc, list);
+        long mid = thread_cpu_ns();
+        hwc->set(hwc, dpy, sur, list);
+        long end = thread_cpu_ns();
+
+        /* an unchanged composition is skipped and stays on screen */
+        get_dss_commit_stats(&after);
+        int committed = after.issued != before.issued || after.skipped != before.skipped;
+        int programmed = committed ? (int) g_mock_stats.dss_shown : 0;
+
+        r->prepare_ns = mid - start;
+        r->set_ns = end - mid;
+
+        for (size_t n = 0; n < list->numHwLayers; n++) {
+            hwc_layer_t *layer = &list->hwLayers[n];
+            if (layer->compositionType == HWC_OVERLAY) {
+                r->overlays++;
+            } else if (layer->handle) {
+                r->gles_layers++;
+                r->gles_pixels += (layer->displayFrame.right - layer->displayFrame.left) *
+                                  (layer->displayFrame.bottom - layer->displayFrame.top);
+            }
+        }
+
+        if (r->overlays != programmed) {
+            fprintf(stderr, "frame %d: %d overlay layers, %d programmed\n",
+                    i, r->overlays, programmed);
+            r->lost_overlays = abs(r->overlays - programmed);
+        }
+    }
+
+    /* closing the composer unmaps everything, blank the display first */
+    mock_dss_blank();
+    device->close(device);
+
+    if (csv_path) {
+        FILE *csv = fopen(csv_path, "w");
+        if (csv == NULL) {
+            fprintf(stderr, "%s: %s\n", csv_path, strerror(errno));
+            return 2;
+        }
+        fprintf(csv, "frame,prepare_ns,set_ns,overlays,gles_layers,gles_pixels\n");
+        for (int i = 0; i < total; i++) {
+            fprintf(csv, "%d,%ld,%ld,%d,%d,%u\n", i, results[i].prepare_ns, results[i].set_ns,
+                    results[i].overlays, results[i].gles_layers, results[i].gles_pixels);
+        }
+        fclose(csv);
+    }
+
+    unsigned long long overlays = 0, gles_layers = 0, gles_pixels = 0;
+    int overlay_frames = 0;
+    unsigned int lost_overlays = 0;
+    for (int i = 0; i < total; i++) {
+        overlays += results[i].overlays;
+        lost_overlays += results[i].lost_overlays;
+        gles_layers += results[i].gles_layers;
+        gles_pixels += results[i].gles_pixels;
+        overlay_frames += results[i].overlays > 0;
+    }
+
+    unsigned int screen = g_mock_config.width * g_mock_config.height;
+
+    printf("%s: %d frames x %d loops, %d buffers, display %dx%d\n", path,
+           g_num_frames, loops, g_num_handles, g_mock_config.width, g_mock_config.height);
+
+    printf("  %-12s %8s %8s %8s %8s (us cpu)\n", "stage", "p50", "p90", "p99", "max");
+    for (int i = 0; i < total; i++)
+        values[i] = results[i].prepare_ns;
+    print_percentiles("prepare", values, total);
+    for (int i = 0; i < total; i++)
+        values[i] = results[i].set_ns;
+    print_percentiles("set", values, total);
+
+    printf("  overlays: %.2f of %d pipelines per frame (%.0f%%), %d%% of frames use one\n",
+           (double) overlays / total, MOCK_DSS_PIPES,
+           100.0 * overlays / total / MOCK_DSS_PIPES, overlay_frames * 100 / total);
+    printf("  gles: %.2f layers, %.0f pixels (%.2f screens) per frame\n",
+           (double) gles_layers / total, (double) gles_pixels / total,
+           (double) gles_pixels / total / screen);
+    printf("  tiler-1d: %u maps, %u unmaps, %u failures, peak %d pages, %u unmapped on screen\n",
+           g_mock_stats.maps, g_mock_stats.unmaps, g_mock_stats.map_failures,
+           g_mock_stats.peak_pages, g_mock_stats.shown_unmaps);
+    printf("  dss: %u sets, %u overlays programmed, %u rejected, %u overlay layers lost\n",
+           g_mock_stats.dss_sets, g_mock_stats.dss_overlays, g_mock_stats.dss_rejects,
+           lost_overlays);
+
+    free(values);
+    free(results);
+    free(rects);
+    free(list);
+
+    return g_mock_stats.dss_rejects || lost_overlays || g_mock_stats.shown_unmaps ? 1 : 0;
+}
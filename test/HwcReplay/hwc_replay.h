@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HWC_REPLAY_H
+#define HWC_REPLAY_H
+
+/*
+ * State shared between the replay harness and the mocks standing in for
+ * the framebuffer device, Tiler-1D and EGL
+ */
+
+/* Video pipelines the mock DSS offers, as on OMAP4 */
+#define MOCK_DSS_PIPES 3
+
+struct mock_config {
+    int width;              /* framebuffer size and depth */
+    int height;
+    int bpp;
+    int tiler_1d_pages;     /* Tiler-1D space for mapped buffers */
+};
+
+struct mock_stats {
+    /* OMAPDSS_HWC_SET */
+    unsigned int dss_sets;
+    unsigned int dss_overlays;
+    unsigned int dss_rejects;
+    unsigned int dss_shown;     /* overlays of the last accepted set */
+
+    /* Tiler-1D */
+    unsigned int maps;
+    unsigned int unmaps;
+    unsigned int map_failures;
+    int mapped_pages;
+    int peak_pages;
+    unsigned int shown_unmaps;  /* unmaps of a buffer the DSS still shows */
+
+    unsigned int swaps;
+};
+
+extern struct mock_config g_mock_config;
+extern struct mock_stats g_mock_stats;
+
+/*
+ * Override a system property for the composer, returns -1 if too many
+ * properties are set
+ */
+int mock_set_property(const char *name, const char *value);
+
+/*
+ * Forget the configuration the DSS shows, as when the display is turned
+ * off. Buffers may be unmapped freely afterwards.
+ */
+void mock_dss_blank(void);
+
+#endif // HWC_REPLAY_H
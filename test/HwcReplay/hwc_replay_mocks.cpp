@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) Texas Instruments - http://www.ti.com/
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Mocks for the pieces of the device the composer talks to. The harness is
+ * linked with --wrap for open, close, ioctl and property_get so the
+ * composer sources build unchanged:
+ *
+ * - the framebuffer device answers the screen info ioctls and validates
+ *   OMAPDSS_HWC_SET like the DSS would, including that every buffer
+ *   other than NV12 lies in a live Tiler-1D mapping,
+ * - Tiler-1D maps buffers into a fake address range of a fixed size and
+ *   reports unmaps of buffers the DSS is still showing,
+ * - eglSwapBuffers only counts frames,
+ * - property_get returns the values given with -p.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/fb.h>
+
+#include <EGL/egl.h>
+#include <cutils/properties.h>
+
+extern "C" {
+#include <memmgr.h>
+}
+
+#include "hwc_priv.h"
+#include "hwc_dss.h"
+#include "ti_hwc_ioctl.h"
+#include "hwc_replay.h"
+
+#define MOCK_FB_FD 0x7fb0
+
+/*
+ * Fake Tiler-1D container, mapped buffers are never dereferenced. It is
+ * kept clear of the Tiler-2D addresses NV12 buffers have in captures.
+ */
+#define MOCK_TILER_1D_BASE 0x20000000
+#define MOCK_TILER_1D_END 0x40000000
+#define MOCK_MAPPINGS 64
+#define MOCK_PROPERTIES 16
+
+#define PAGE_SIZE_4K 4096
+
+struct mock_mapping {
+    unsigned long addr;
+    int pages;
+};
+
+struct mock_property {
+    char name[PROPERTY_KEY_MAX];
+    char value[PROPERTY_VALUE_MAX];
+};
+
+struct mock_config g_mock_config = { 1280, 720, 32, 4096 };
+struct mock_stats g_mock_stats;
+
+static struct mock_mapping g_mappings[MOCK_MAPPINGS];
+static unsigned long g_next_addr = MOCK_TILER_1D_BASE;
+
+/* buffers of the last configuration the DSS accepted */
+static unsigned long g_shown[MOCK_DSS_PIPES];
+
+static struct mock_property g_properties[MOCK_PROPERTIES];
+static int g_num_properties;
+
+extern "C" {
+int __real_open(const char *path, int flags, ...);
+int __real_close(int fd);
+int __real_ioctl(int fd, unsigned long request, ...);
+int __real_property_get(const char *key, char *value, const char *default_value);
+}
+
+/* Returns the live mapping addr lies in, or NULL */
+static struct mock_mapping *find_mapping(unsigned long addr)
+{
+    for (int slot = 0; slot < MOCK_MAPPINGS; slot++) {
+        struct mock_mapping *m = &g_mappings[slot];
+        if (m->addr && addr >= m->addr &&
+            addr < m->addr + (unsigned long) m->pages * PAGE_SIZE_4K)
+            return m;
+    }
+    return NULL;
+}
+
+/* Check an overlay configuration against the OMAP4 DSS limits */
+static int check_overlay(struct dss_hwc_ovl_info *o, unsigned int *pipes, unsigned int *zorders)
+{
+    if (o->ix < 1 || o->ix > MOCK_DSS_PIPES || (*pipes & (1 << o->ix)))
+        return -EINVAL;
+    if (o->zorder > 3 || (*zorders & (1 << o->zorder)))
+        return -EINVAL;
+    *pipes |= 1 << o->ix;
+    *zorders |= 1 << o->zorder;
+
+    if (!o->out_width || !o->out_height || !o->crop_w || !o->crop_h)
+        return -EINVAL;
+    if (o->pos_x < 0 || o->pos_y < 0 ||
+        o->pos_x + o->out_width > g_mock_config.width ||
+        o->pos_y + o->out_height > g_mock_config.height)
+        return -EINVAL;
+    if (!o->handle)
+        return -EINVAL;
+
+    /* NV12 buffers are in Tiler-2D, anything else must be mapped */
+    if (o->color_mode == OMAP_DSS_COLOR_NV12) {
+        if (o->handle >= MOCK_TILER_1D_BASE && o->handle < MOCK_TILER_1D_END)
+            return -EFAULT;
+    } else if (!find_mapping(o->handle)) {
+        return -EFAULT;
+    }
+
+    return 0;
+}
+
+static int mock_dss_set(struct dss_hwc_set_info *s)
+{
+    unsigned int pipes = 0, zorders = 0;
+
+    g_mock_stats.dss_sets++;
+
+    if (s->num_ovls > MOCK_DSS_PIPES) {
+        g_mock_stats.dss_rejects++;
+        return -EINVAL;
+    }
+
+    for (unsigned int i = 0; i < s->num_ovls; i++) {
+        if (check_overlay(&s->ovls[i], &pipes, &zorders)) {
+            fprintf(stderr, "mock dss: rejected ovl%u\n", s->ovls[i].ix);
+            g_mock_stats.dss_rejects++;
+            return -EINVAL;
+        }
+    }
+
+    g_mock_stats.dss_overlays += s->num_ovls;
+    g_mock_stats.dss_shown = s->num_ovls;
+    for (unsigned int i = 0; i < MOCK_DSS_PIPES; i++)
+        g_shown[i] = i < s->num_ovls ? s->ovls[i].handle : 0;
+    return 0;
+}
+
+void mock_dss_blank(void)
+{
+    g_mock_stats.dss_shown = 0;
+    memset(g_shown, 0, sizeof(g_shown));
+}
+
+extern "C" int __wrap_open(const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode;
+
+    if (!strcmp(path, FB_DEV_NAME) || !strcmp(path, FB_DEV_NAME_FALLBACK))
+        return MOCK_FB_FD;
+
+    va_start(ap, flags);
+    mode = va_arg(ap, int);
+    va_end(ap);
+
+    return __real_open(path, flags, mode);
+}
+
+extern "C" int __wrap_close(int fd)
+{
+    if (fd == MOCK_FB_FD)
+        return 0;
+
+    return __real_close(fd);
+}
+
+extern "C" int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+    va_list ap;
+    void *arg;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (fd != MOCK_FB_FD)
+        return __real_ioctl(fd, request, arg);
+
+    switch (request) {
+        case FBIOGET_FSCREENINFO: {
+            struct fb_fix_screeninfo *fix = (struct fb_fix_screeninfo *) arg;
+            memset(fix, 0, sizeof(*fix));
+            fix->line_length = g_mock_config.width * g_mock_config.bpp / 8;
+            return 0;
+        }
+        case FBIOGET_VSCREENINFO: {
+            struct fb_var_screeninfo *var = (struct fb_var_screeninfo *) arg;
+            memset(var, 0, sizeof(*var));
+            var->xres = var->xres_virtual = g_mock_config.width;
+            var->yres = var->yres_virtual = g_mock_config.height;
+            var->bits_per_pixel = g_mock_config.bpp;
+            return 0;
+        }
+        case OMAPDSS_HWC_SET:
+            return mock_dss_set((struct dss_hwc_set_info *) arg);
+        default:
+            errno = ENOTTY;
+            return -1;
+    }
+}
+
+int mock_set_property(const char *name, const char *value)
+{
+    for (int i = 0; i < g_num_properties; i++) {
+        if (!strcmp(g_properties[i].name, name)) {
+            strncpy(g_properties[i].value, value, PROPERTY_VALUE_MAX - 1);
+            return 0;
+        }
+    }
+
+    if (g_num_properties == MOCK_PROPERTIES)
+        return -1;
+
+    strncpy(g_properties[g_num_properties].name, name, PROPERTY_KEY_MAX - 1);
+    strncpy(g_properties[g_num_properties].value, value, PROPERTY_VALUE_MAX - 1);
+    g_num_properties++;
+    return 0;
+}
+
+extern "C" int __wrap_property_get(const char *key, char *value, const char *default_value)
+{
+    for (int i = 0; i < g_num_properties; i++) {
+        if (!strcmp(g_properties[i].name, key)) {
+            strcpy(value, g_properties[i].value);
+            return strlen(value);
+        }
+    }
+
+    return __real_property_get(key, value, default_value);
+}
+
+extern "C" void *MemMgr_Map(MemAllocBlock blocks[], int num_blocks)
+{
+    int pages = 0;
+    int slot;
+
+    for (int i = 0; i < num_blocks; i++)
+        pages += (blocks[i].dim.len + PAGE_SIZE_4K - 1) / PAGE_SIZE_4K;
+
+    for (slot = 0; slot < MOCK_MAPPINGS && g_mappings[slot].addr; slot++)
+        ;
+
+    if (slot == MOCK_MAPPINGS ||
+        g_mock_stats.mapped_pages + pages > g_mock_config.tiler_1d_pages) {
+        g_mock_stats.map_failures++;
+        return NULL;
+    }
+
+    /* addresses are not reused, so a stale address fails the DSS checks */
+    if (g_next_addr + pages * PAGE_SIZE_4K > MOCK_TILER_1D_END)
+        g_next_addr = MOCK_TILER_1D_BASE;
+    g_mappings[slot].addr = g_next_addr;
+    g_mappings[slot].pages = pages;
+    g_next_addr += pages * PAGE_SIZE_4K;
+
+    g_mock_stats.maps++;
+    g_mock_stats.mapped_pages += pages;
+    if (g_mock_stats.mapped_pages > g_mock_stats.peak_pages)
+        g_mock_stats.peak_pages = g_mock_stats.mapped_pages;
+
+    return (void *) g_mappings[slot].addr;
+}
+
+extern "C" int MemMgr_UnMap(void *bufPtr)
+{
+    for (int slot = 0; slot < MOCK_MAPPINGS; slot++) {
+        if (g_mappings[slot].addr == (unsigned long) bufPtr) {
+            for (int i = 0; i < MOCK_DSS_PIPES; i++) {
+                if (g_shown[i] && find_mapping(g_shown[i]) == &g_mappings[slot]) {
+                    fprintf(stderr, "mock tiler: unmap of buffer %p shown by the DSS\n", bufPtr);
+                    g_mock_stats.shown_unmaps++;
+                }
+            }
+            g_mock_stats.unmaps++;
+            g_mock_stats.mapped_pages -= g_mappings[slot].pages;
+            g_mappings[slot].addr = 0;
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "mock tiler: unmap of unknown buffer %p\n", bufPtr);
+    return -EFAULT;
+}
+
+EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
+{
+    (void) dpy;
+    (void) surface;
+
+    g_mock_stats.swaps++;
+    return EGL_TRUE;
+}
@@ -59,4 +59,35 @@ LOCAL_MODULE    := tiler_ptest
 LOCAL_MODULE_TAGS := optional tests
 include $(BUILD_EXECUTABLE)
 
+include $(CLEAR_VARS)
+LOCAL_PRELINK_MODULE := false
+LOCAL_ARM_MODE := arm
+LOCAL_SRC_FILES := memmgr_stats.c
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/ \
+
+LOCAL_SHARED_LIBRARIES := libtimemmgr
+LOCAL_MODULE    := memmgr_stats
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_PRELINK_MODULE := false
+LOCAL_ARM_MODE := arm
+# built against the fake tiler driver, not the library
+LOCAL_SRC_FILES := memmgr_pool_test.c memmgr.c tiler_fake.c testlib.c
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/ \
+
+LOCAL_LDFLAGS := \
+	-Wl,--wrap=open \
+	-Wl,--wrap=close \
+	-Wl,--wrap=ioctl \
+	-Wl,--wrap=mmap \
+	-Wl,--wrap=munmap
+
+LOCAL_MODULE    := memmgr_pool_test
+LOCAL_MODULE_TAGS := optional tests
+include $(BUILD_EXECUTABLE)
+
 endif
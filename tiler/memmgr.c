@@ -33,6 +33,9 @@
  *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/* the library is built with -ansi, ask for the reader/writer locks */
+#define _XOPEN_SOURCE 600
+
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -43,6 +46,7 @@
 #include <stdint.h>
 #include <pthread.h>
 #include <errno.h>
+#include <time.h>
 
 #define BUF_ALLOCED 1
 #define BUF_MAPPED  2
@@ -66,41 +70,53 @@ typedef struct tiler_block_info tiler_block_info;
 #include "tilermem_utils.h"
 #include "memmgr.h"
 
-/* list of allocations */
+/* records of the allocations, sorted by bufPtr.  Buffers never
+   overlap, so the record containing a pointer is found by a binary
+   search for the last record starting at or below it. */
 struct _AllocData {
     void     *bufPtr;
     bytes_t   size;
     uint32_t  tiler_id;
     int       buf_type;
-    struct _AllocList {
-        struct _AllocList *next, *last;
-        struct _AllocData *me;
+};
+typedef struct _AllocData _AllocData;
+
+/* initial number of records, the array doubles when full */
+#define BUF_CACHE_MIN 32
+
+static _AllocData *bufs = NULL;
+static int num_bufs = 0;
+static int max_bufs = 0;
+
+/* recycling pool of freed 2D buffers that are kept registered and mapped,
+   most recently freed first.  Each pooled buffer holds a reference. */
+struct _PoolData {
+    void     *bufPtr;
+    bytes_t   size;
+    struct tiler_buf_info buf;
+    struct _PoolList {
+        struct _PoolList *next, *last;
+        struct _PoolData *me;
     } link;
 };
-static struct _AllocList bufs = {0};
-static int bufs_inited = 0;
+typedef struct _PoolList _PoolList;
+typedef struct _PoolData _PoolData;
 
-typedef struct _AllocList _AllocList;
-typedef struct _AllocData _AllocData;
+static _PoolList pool = { &pool, &pool, NULL };
+static MemMgrPoolStats pool_stats = {0};
 
 static int refCnt = 0;
 static int td = -1;
 static pthread_mutex_t ref_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t che_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* queries only take the read lock so lookups do not serialize */
+static pthread_rwlock_t che_lock = PTHREAD_RWLOCK_INITIALIZER;
+/* taken before che_lock when both are needed */
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-/**
- * Initializes the static structures
- *
- * @author a0194118 (9/8/2009)
- */
-static void init()
-{
-    if (!bufs_inited)
-    {
-        DLIST_INIT(bufs);
-        bufs_inited = 1;
-    }
-}
+/* usage statistics, blocks are live while their buffer is registered */
+static MemMgrUsageStats usage_stats;
+/* taken last */
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /**
  * Increases the reference count.  Initialized tiler if this was
@@ -118,8 +134,6 @@ static int inc_ref()
     int res = MEMMGR_ERR_NONE;
 
     if (!refCnt++) {
-        /* initialize lists */
-        init();
 #ifndef STUB_TILER
         td = open("/dev/tiler", O_RDWR | O_SYNC);
         if (NOT_I(td,>=,0)) res = MEMMGR_ERR_GENERIC;
@@ -208,6 +222,28 @@ static bytes_t def_size(tiler_block_info *blk)
             blk->dim.area.height * def_stride(blk->dim.area.width * def_bpp(blk->fmt)));
 }
 
+/**
+ * Returns the index of the last record that starts at or below
+ * ptr.  The caller must hold che_lock.
+ *
+ * @param ptr    Pointer
+ *
+ * @return Record index, or -1 if all records start above ptr.
+ */
+static int buf_cache_find(void *ptr)
+{
+    int lo = 0, hi = num_bufs;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        if (bufs[mid].bufPtr <= ptr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
+
 /**
  * Records a buffer-pointer -- tiler-ID mapping for a specific
  * buffer type.
@@ -223,18 +259,34 @@ static bytes_t def_size(tiler_block_info *blk)
 static int buf_cache_add(void *bufPtr, bytes_t size, uint32_t tiler_id,
                           int buf_type)
 {
-    pthread_mutex_lock(&che_mutex);
-    _AllocData *ad = NEW(_AllocData);
-    if (ad)
+    int ret = 0;
+    pthread_rwlock_wrlock(&che_lock);
+    if (num_bufs == max_bufs)
     {
-	    ad->bufPtr = bufPtr;
-	    ad->size = size;
-	    ad->tiler_id = tiler_id;
-	    ad->buf_type = buf_type;
-	    DLIST_MADD_BEFORE(bufs, ad, link);
+        int max = max_bufs ? max_bufs * 2 : BUF_CACHE_MIN;
+        _AllocData *new_bufs = realloc(bufs, max * sizeof(*bufs));
+        if (new_bufs)
+        {
+            bufs = new_bufs;
+            max_bufs = max;
+        }
+        else
+        {
+            ret = -ENOMEM;
+        }
     }
-    pthread_mutex_unlock(&che_mutex);
-    return ad == NULL ? -ENOMEM : 0;
+    if (!ret)
+    {
+        int ix = buf_cache_find(bufPtr) + 1;
+        memmove(bufs + ix + 1, bufs + ix, (num_bufs - ix) * sizeof(*bufs));
+        bufs[ix].bufPtr = bufPtr;
+        bufs[ix].size = size;
+        bufs[ix].tiler_id = tiler_id;
+        bufs[ix].buf_type = buf_type;
+        num_bufs++;
+    }
+    pthread_rwlock_unlock(&che_lock);
+    return ret;
 }
 
 /**
@@ -254,29 +306,19 @@ static uint32_t buf_cache_query(void *ptr, int buf_type_mask,
 {
     IN;
     if(0) DP("in(p=%p,t=%d,bp*=%p)", ptr, buf_type_mask, bufPtr);
-    _AllocData *ad;
-    pthread_mutex_lock(&che_mutex);
-    DLIST_MLOOP(bufs, ad, link) {
-        if(0) {
-            DP("got(%p-%p,%d)", ad->bufPtr, ad->bufPtr + ad->size, ad->buf_type);
-            CHK_P(ad->bufPtr,<=,ptr);
-            CHK_P(ptr,<,ad->bufPtr + ad->size);
-            CHK_I(ad->buf_type & buf_type_mask,!=,0);
-            CHK_P(bufPtr,!=,0);
-        }
-        if ((ad->buf_type & buf_type_mask) &&
-            ad->bufPtr <= ptr && ptr < ad->bufPtr + ad->size) {
-            if (bufPtr)
-            {
-                *bufPtr = ad->bufPtr;
-            }
-            uint32_t tiler_id = ad->tiler_id;
-            pthread_mutex_unlock(&che_mutex);
-            return R_UP(tiler_id);
+    uint32_t tiler_id = 0;
+    pthread_rwlock_rdlock(&che_lock);
+    int ix = buf_cache_find(ptr);
+    if (ix >= 0 && (bufs[ix].buf_type & buf_type_mask) &&
+        ptr < bufs[ix].bufPtr + bufs[ix].size) {
+        if (bufPtr)
+        {
+            *bufPtr = bufs[ix].bufPtr;
         }
+        tiler_id = bufs[ix].tiler_id;
     }
-    pthread_mutex_unlock(&che_mutex);
-    return R_UP(0);
+    pthread_rwlock_unlock(&che_lock);
+    return R_UP(tiler_id);
 }
 
 /**
@@ -293,19 +335,22 @@ static uint32_t buf_cache_query(void *ptr, int buf_type_mask,
  */
 static uint32_t buf_cache_del(void *bufPtr, int buf_type)
 {
-    _AllocData *ad;
-    pthread_mutex_lock(&che_mutex);
-    DLIST_MLOOP(bufs, ad, link) {
-        if (ad->bufPtr == bufPtr && ad->buf_type == buf_type) {
-            uint32_t tiler_id = ad->tiler_id;
-            DLIST_REMOVE(ad->link);
-            FREE(ad);
-            pthread_mutex_unlock(&che_mutex);
-            return tiler_id;
+    uint32_t tiler_id = 0;
+    pthread_rwlock_wrlock(&che_lock);
+    int ix = buf_cache_find(bufPtr);
+    if (ix >= 0 && bufs[ix].bufPtr == bufPtr && bufs[ix].buf_type == buf_type) {
+        tiler_id = bufs[ix].tiler_id;
+        num_bufs--;
+        memmove(bufs + ix, bufs + ix + 1, (num_bufs - ix) * sizeof(*bufs));
+        /* release the records once the last buffer is gone */
+        if (!num_bufs)
+        {
+            FREE(bufs);
+            max_bufs = 0;
         }
     }
-    pthread_mutex_unlock(&che_mutex);
-    return 0;
+    pthread_rwlock_unlock(&che_lock);
+    return tiler_id;
 }
 
 /**
@@ -319,16 +364,99 @@ static uint32_t buf_cache_del(void *bufPtr, int buf_type)
  */
 static int cache_check()
 {
-    int num_bufs = 0;
-    pthread_mutex_lock(&che_mutex);
+    pthread_mutex_lock(&pool_mutex);
+    pthread_rwlock_rdlock(&che_lock);
+    int ok = num_bufs + (int) pool_stats.num_bufs == refCnt;
+    pthread_rwlock_unlock(&che_lock);
+    pthread_mutex_unlock(&pool_mutex);
+    return ok ? MEMMGR_ERR_NONE : MEMMGR_ERR_GENERIC;
+}
 
-    init();
+/**
+ * Returns the monotonic time in microseconds.
+ */
+static uint64_t stats_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-    _AllocData *ad;
-    DLIST_MLOOP(bufs, ad, link) { num_bufs++; }
+/**
+ * Accounts for the blocks of a buffer that was registered
+ * (dir > 0) or released (dir < 0).
+ *
+ * @param blks        Pointer to array of block info structures
+ * @param num_blocks  Number of blocks
+ * @param dir         1 for registered, -1 for released
+ */
+static void stats_buf(struct tiler_block_info *blks, int num_blocks, int dir)
+{
+    int ix;
+    pthread_mutex_lock(&stats_mutex);
+    for (ix = 0; ix < num_blocks; ix++)
+    {
+        if (blks[ix].fmt < TILFMT_8BIT || blks[ix].fmt > TILFMT_PAGE)
+            continue;
 
-    pthread_mutex_unlock(&che_mutex);
-    return (num_bufs == refCnt) ? MEMMGR_ERR_NONE : MEMMGR_ERR_GENERIC;
+        MemMgrFormatStats *fs = usage_stats.formats + blks[ix].fmt - TILFMT_8BIT;
+        bytes_t size = def_size(blks + ix);
+        if (dir > 0)
+        {
+            fs->blocks++;
+            fs->bytes += size;
+            usage_stats.bytes += size;
+            if (fs->bytes > fs->peak_bytes) fs->peak_bytes = fs->bytes;
+        }
+        else
+        {
+            fs->blocks--;
+            fs->bytes -= size;
+            usage_stats.bytes -= size;
+        }
+    }
+    if (usage_stats.bytes > usage_stats.peak_bytes)
+    {
+        usage_stats.peak_bytes = usage_stats.bytes;
+    }
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+/**
+ * Counts a block the tiler driver could not allocate or map.
+ */
+static void stats_block_failed(struct tiler_block_info *blk)
+{
+    if (blk->fmt < TILFMT_8BIT || blk->fmt > TILFMT_PAGE) return;
+    pthread_mutex_lock(&stats_mutex);
+    usage_stats.formats[blk->fmt - TILFMT_8BIT].failures++;
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+/**
+ * Counts an alloc or map call and its latency.
+ *
+ * @param calls     Call counter
+ * @param failures  Failure counter
+ * @param latency   Latency histogram
+ * @param start     Time the call started, from stats_now_us()
+ * @param ok        Whether the call succeeded
+ */
+static void stats_call(uint32_t *calls, uint32_t *failures, uint32_t *latency,
+                       uint64_t start, bool ok)
+{
+    uint64_t us = stats_now_us() - start;
+    int bucket = 0;
+    while (bucket < MEMMGR_LATENCY_BUCKETS - 1 && (us >> (bucket + 1)))
+    {
+        bucket++;
+    }
+
+    pthread_mutex_lock(&stats_mutex);
+    (*calls)++;
+    if (!ok) (*failures)++;
+    latency[bucket]++;
+    pthread_mutex_unlock(&stats_mutex);
 }
 
 static void dump_block(struct tiler_block_info *blk, char *prefix, char *suffix)
@@ -385,30 +513,26 @@ static enum tiler_fmt tiler_get_fmt(SSPtr ssptr)
             ssptr < TILER_MEM_PAGED ? TILFMT_32BIT :
             ssptr < TILER_MEM_END   ? TILFMT_PAGE : TILFMT_NONE);
 #else
-    /* if emulating, we need to get through all allocated memory segments */
-    pthread_mutex_lock(&che_mutex);
-    init();
-    _AllocData *ad;
+    /* if emulating, we need to look through the blocks of the segment */
     void *ptr = (void *) ssptr;
     if (!ptr) return TILFMT_INVALID;
-    /* P("?%p", (void *)ssptr); */
-    DLIST_MLOOP(bufs, ad, link) {
-        int ix;
-        struct tiler_buf_info *buf = (struct tiler_buf_info *) ad->tiler_id;
-        /* P("buf[%d]", buf->num_blocks); */
+    enum tiler_fmt fmt = TILFMT_NONE;
+    pthread_rwlock_rdlock(&che_lock);
+    int ix, bx = buf_cache_find(ptr);
+    if (bx >= 0)
+    {
+        struct tiler_buf_info *buf = (struct tiler_buf_info *) bufs[bx].tiler_id;
         for (ix = 0; ix < buf->num_blocks; ix++)
         {
-            /* P("block[%p-%p]", buf->blocks[ix].ptr, buf->blocks[ix].ptr + def_size(buf->blocks + ix)); */
             if (ptr >= buf->blocks[ix].ptr &&
                 ptr < buf->blocks[ix].ptr + def_size(buf->blocks + ix)) {
-                enum tiler_fmt fmt = buf->blocks[ix].fmt;
-                pthread_mutex_unlock(&che_mutex);
-                return fmt;
+                fmt = buf->blocks[ix].fmt;
+                break;
             }
         }
     }
-    pthread_mutex_unlock(&che_mutex);
-    return TILFMT_NONE;
+    pthread_rwlock_unlock(&che_lock);
+    return fmt;
 #endif
 }
 
@@ -425,7 +549,13 @@ static SSPtr tiler_alloc(struct tiler_block_info *blk)
 {
     if (0) dump_block(blk, "=(ta)=>", "");
     blk->ptr = NULL;
-    R_I(ioctl(td, TILIOC_GBUF, blk));
+    if (R_I(ioctl(td, TILIOC_GBUF, blk)) || !blk->ssptr)
+    {
+#ifndef STUB_TILER
+        /* there is no driver to fail when emulating */
+        stats_block_failed(blk);
+#endif
+    }
     if (blk->fmt != PIXEL_FMT_PAGE)
     {
         blk->stride = def_stride(blk->dim.area.width * def_bpp(blk->fmt));
@@ -461,6 +591,7 @@ static SSPtr tiler_map(struct tiler_block_info *blk)
 {
     dump_block(blk, "=(tm)=>", "");
     R_I(ioctl(td, TILIOC_MBUF, blk));
+    if (!blk->ssptr) stats_block_failed(blk);
     return R_UP(blk->ssptr);
 }
 
@@ -499,6 +630,32 @@ static bytes_t tiler_size(struct tiler_block_info *blks, int num_blocks)
     return size;
 }
 
+/**
+ * Fills out the pointers of the blocks of a buffer mapped at
+ * bufPtr.
+ *
+ * @param blks        Pointer to array of block info structures
+ * @param num_blocks  Number of blocks
+ * @param bufPtr      Pointer to the buffer
+ */
+static void set_block_ptrs(struct tiler_block_info *blks, int num_blocks,
+                           void *bufPtr)
+{
+    bytes_t size = 0;
+    int ix;
+    for (ix = 0; ix < num_blocks; ix++)
+    {
+        blks[ix].ptr = bufPtr + size;
+        /* P("   [0x%p]", blks[ix].ptr); */
+        size += def_size(blks + ix);
+#ifdef STUB_TILER
+        blks[ix].ssptr = (uint32_t) blks[ix].ptr;
+#else
+        blks[ix].ptr = (void *)((((uint32_t)blks[ix].ptr) & ~(PAGE_SIZE - 1)) | (blks[ix].ssptr & (PAGE_SIZE - 1)));
+#endif
+    }
+}
+
 /**
  * Registers a buffer structure with tiler, and maps the buffer
  * into memory using tiler. On success, it writes the tiler ID
@@ -580,18 +737,8 @@ static void *tiler_mmap(struct tiler_block_info *blks, int num_blocks,
     /* otherwise, fill out pointers */
     else
     {
-        /* fill out pointers */
-        for (size = ix = 0; ix < num_blocks; ix++)
-        {
-            blks[ix].ptr = bufPtr + size;
-            /* P("   [0x%p]", blks[ix].ptr); */
-            size += def_size(blks + ix);
-#ifdef STUB_TILER
-            blks[ix].ssptr = (uint32_t) blks[ix].ptr;
-#else
-            blks[ix].ptr = (void *)((((uint32_t)blks[ix].ptr) & ~(PAGE_SIZE - 1)) | (blks[ix].ssptr & (PAGE_SIZE - 1)));
-#endif
-        }
+        set_block_ptrs(blks, num_blocks, bufPtr);
+        stats_buf(blks, num_blocks, 1);
     }
 
     return R_P(bufPtr);
@@ -702,6 +849,253 @@ static void reset_blocks(struct tiler_block_info *blks, int num_blocks)
 
 }
 
+#ifndef STUB_TILER
+/**
+ * Unregisters a buffer, frees its tiler blocks and unmaps it
+ * from the process space.  Tries all steps even if there is an
+ * error.
+ *
+ * @param bufPtr    Pointer to the buffer
+ * @param buf       Buffer information as returned by
+ *                  TILIOC_QBUF
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+static int release_buf(void *bufPtr, struct tiler_buf_info *buf)
+{
+    dump_buf(buf, "==(URBUF)=>");
+    int ret = A_I(ioctl(td, TILIOC_URBUF, buf),==,0);
+    dump_buf(buf, "<=(URBUF)==");
+
+    /* free each block */
+    int ix;
+    for (ix = 0; ix < buf->num_blocks; ix++)
+    {
+        ERR_ADD(ret, tiler_free(buf->blocks + ix));
+    }
+
+    /* unmap buffer */
+    bytes_t size = tiler_size(buf->blocks, buf->num_blocks);
+    bufPtr = (void *)((uint32_t)bufPtr & ~(PAGE_SIZE - 1));
+    ERR_ADD(ret, munmap(bufPtr, size));
+
+    stats_buf(buf->blocks, buf->num_blocks, -1);
+    return ret;
+}
+#endif
+
+/**
+ * Releases the least recently pooled buffers until the pool
+ * holds at most max_bytes.
+ *
+ * @param max_bytes  Number of bytes the pool may keep
+ *
+ * @return Number of buffers released.
+ */
+static int pool_evict(bytes_t max_bytes)
+{
+    _PoolList victims = { &victims, &victims, NULL };
+    _PoolData *pd, *pd_safe;
+    int num = 0;
+
+    pthread_mutex_lock(&pool_mutex);
+    while (pool_stats.bytes > max_bytes)
+    {
+        pd = DLIST_LAST(pool);
+        DLIST_REMOVE(pd->link);
+        DLIST_MADD_BEFORE(victims, pd, link);
+        pool_stats.num_bufs--;
+        pool_stats.bytes -= pd->size;
+        pool_stats.evicted++;
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    /* release outside of the lock as this goes to the driver */
+    DLIST_SAFE_MLOOP(victims, pd, pd_safe, link) {
+#ifndef STUB_TILER
+        A_I(release_buf(pd->bufPtr, &pd->buf),==,0);
+#endif
+        A_I(dec_ref(),==,0);
+        FREE(pd);
+        num++;
+    }
+    return num;
+}
+
+#ifndef STUB_TILER
+/**
+ * Keeps a freed buffer registered and mapped in the pool if it
+ * consists of 2D blocks only and fits in the pool budget.  The
+ * buffer keeps its reference.  Evicts the least recently pooled
+ * buffers if the pool grows over the budget.
+ *
+ * @param bufPtr    Pointer to the buffer
+ * @param buf       Buffer information as returned by
+ *                  TILIOC_QBUF
+ *
+ * @return 1 if the buffer was pooled, 0 if it must be released.
+ */
+static int pool_put(void *bufPtr, struct tiler_buf_info *buf)
+{
+    int ix;
+    for (ix = 0; ix < buf->num_blocks; ix++)
+    {
+        if (buf->blocks[ix].fmt == TILFMT_PAGE) return 0;
+    }
+
+    bytes_t size = tiler_size(buf->blocks, buf->num_blocks);
+    bytes_t budget;
+    _PoolData *pd = NULL;
+
+    pthread_mutex_lock(&pool_mutex);
+    budget = pool_stats.budget;
+    if (size <= budget) pd = NEW(_PoolData);
+    if (pd)
+    {
+        pd->bufPtr = bufPtr;
+        pd->size = size;
+        memcpy(&pd->buf, buf, sizeof(*buf));
+        DLIST_MADD_AFTER(pool, pd, link);
+        pool_stats.num_bufs++;
+        pool_stats.bytes += size;
+        pool_stats.recycled++;
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    if (pd) pool_evict(budget);
+    return pd != NULL;
+}
+
+/**
+ * Checks if a pooled block can serve a requested block.  The
+ * format and dimensions must match, and the requested stride
+ * must be 0 or the stride of the pooled block.
+ */
+static bool pool_match(struct tiler_block_info *blk,
+                       struct tiler_block_info *pooled)
+{
+    return blk->fmt == pooled->fmt &&
+           blk->dim.area.width == pooled->dim.area.width &&
+           blk->dim.area.height == pooled->dim.area.height &&
+           (!blk->stride || blk->stride == pooled->stride);
+}
+
+/**
+ * Takes the most recently pooled buffer with the same geometry
+ * out of the pool, registers it as allocated and fills out the
+ * block information as MemMgr_Alloc would.
+ *
+ * @param blks        Pointer to array of block info structures
+ * @param num_blocks  Number of blocks
+ *
+ * @return Pointer to the buffer, or NULL if no buffer matched.
+ */
+static void *pool_get(struct tiler_block_info *blks, int num_blocks)
+{
+    int ix;
+    for (ix = 0; ix < num_blocks; ix++)
+    {
+        if (blks[ix].fmt == TILFMT_PAGE) return NULL;
+    }
+
+    void *bufPtr = NULL;
+    _PoolData *pd;
+
+    pthread_mutex_lock(&pool_mutex);
+    if (!pool_stats.budget) goto DONE;
+
+    DLIST_MLOOP(pool, pd, link) {
+        if (pd->buf.num_blocks != num_blocks) continue;
+        for (ix = 0; ix < num_blocks && pool_match(blks + ix, pd->buf.blocks + ix); ix++);
+        if (ix == num_blocks) break;
+    }
+
+    if (!pd)
+    {
+        pool_stats.misses++;
+    }
+    else if (!NOT_I(buf_cache_add(pd->bufPtr, pd->size, pd->buf.offset, BUF_ALLOCED),==,0))
+    {
+        DLIST_REMOVE(pd->link);
+        pool_stats.num_bufs--;
+        pool_stats.bytes -= pd->size;
+        pool_stats.hits++;
+
+        for (ix = 0; ix < num_blocks; ix++)
+        {
+            blks[ix].stride = pd->buf.blocks[ix].stride;
+            blks[ix].ssptr = pd->buf.blocks[ix].ssptr;
+        }
+        set_block_ptrs(blks, num_blocks, pd->bufPtr);
+        bufPtr = pd->bufPtr;
+        FREE(pd);
+    }
+DONE:
+    pthread_mutex_unlock(&pool_mutex);
+    return bufPtr;
+}
+#endif
+
+#ifndef STUB_TILER
+/* bounding box of the live blocks in a container */
+struct _Extent {
+    uint32_t num;
+    uint32_t x0, y0, x1, y1;
+};
+typedef struct _Extent _Extent;
+
+/**
+ * Grows the extents by a block.  2D blocks are placed by their
+ * row and byte column in the container, page mode blocks by
+ * their offset.
+ *
+ * @param ext    Extents, indexed by pixel format
+ * @param blk    Pointer to the block info
+ */
+static void extent_add(_Extent *ext, struct tiler_block_info *blk)
+{
+    uint32_t x, y, w, h, stride;
+    switch (blk->fmt)
+    {
+    case TILFMT_8BIT:  stride = TILER_STRIDE_8BIT;  x = blk->ssptr - TILER_MEM_8BIT;  break;
+    case TILFMT_16BIT: stride = TILER_STRIDE_16BIT; x = blk->ssptr - TILER_MEM_16BIT; break;
+    case TILFMT_32BIT: stride = TILER_STRIDE_32BIT; x = blk->ssptr - TILER_MEM_32BIT; break;
+    case TILFMT_PAGE:  stride = 0;                  x = blk->ssptr - TILER_MEM_PAGED; break;
+    default: return;
+    }
+
+    if (stride)
+    {
+        y = x / stride;
+        x %= stride;
+        w = def_stride(blk->dim.area.width * def_bpp(blk->fmt));
+        h = blk->dim.area.height;
+    }
+    else
+    {
+        y = 0;
+        w = def_size(blk);
+        h = 1;
+    }
+
+    ext += blk->fmt - TILFMT_8BIT;
+    if (!ext->num++)
+    {
+        ext->x0 = x;
+        ext->y0 = y;
+        ext->x1 = x + w;
+        ext->y1 = y + h;
+    }
+    else
+    {
+        if (x < ext->x0) ext->x0 = x;
+        if (y < ext->y0) ext->y0 = y;
+        if (x + w > ext->x1) ext->x1 = x + w;
+        if (y + h > ext->y1) ext->y1 = y + h;
+    }
+}
+#endif
+
 bytes_t MemMgr_PageSize()
 {
     return PAGE_SIZE;
@@ -711,22 +1105,33 @@ void *MemMgr_Alloc(MemAllocBlock blocks[], int num_blocks)
 {
     IN;
     void *bufPtr = NULL;
+    uint64_t start = stats_now_us();
 
     /* need to access ssptrs */
     struct tiler_block_info *blks = (tiler_block_info *) blocks;
 
-    /* check block allocation params, and state */
-    if (NOT_I(check_blocks(blks, num_blocks, num_blocks - 1),==,0) ||
-        NOT_I(inc_ref(),==,0)) goto DONE;
+    /* check block allocation params */
+    if (NOT_I(check_blocks(blks, num_blocks, num_blocks - 1),==,0)) goto DONE;
+
+#ifndef STUB_TILER
+    /* reuse a recently freed buffer of the same geometry */
+    bufPtr = pool_get(blks, num_blocks);
+    if (bufPtr) goto DONE;
+#endif
+
+    /* check state */
+    if (NOT_I(inc_ref(),==,0)) goto DONE;
 
     /* ----- begin recoverable portion ----- */
     int ix;
+    bool retried = false;
 
+RETRY_ALLOC:
     /* allocate each buffer using tiler driver and initialize block info */
     for (ix = 0; ix < num_blocks; ix++)
     {
         CHK_I(blks[ix].ptr,==,NULL);
-        if (NOT_I(tiler_alloc(blks + ix),>=,0)) goto FAIL_ALLOC;
+        if (NOT_I(tiler_alloc(blks + ix),!=,0)) goto FAIL_ALLOC;
     }
 
     bufPtr = tiler_mmap(blks, num_blocks, BUF_ALLOCED);
@@ -742,8 +1147,18 @@ FAIL_ALLOC:
     /* clear ssptr and ptr fields for all blocks */
     reset_blocks(blks, num_blocks);
 
+    /* pooled buffers may hold the tiler space we need, release them and
+       try once more */
+    if (!retried && pool_evict(0))
+    {
+        retried = true;
+        goto RETRY_ALLOC;
+    }
+
     A_I(dec_ref(),==,0);
 DONE:
+    stats_call(&usage_stats.allocs, &usage_stats.alloc_failures,
+               usage_stats.alloc_latency, start, bufPtr != NULL);
     CHK_I(cache_check(),==,0);
     return R_P(bufPtr);
 }
@@ -768,34 +1183,31 @@ int MemMgr_Free(void *bufPtr)
         ret = A_I(ioctl(td, TILIOC_QBUF, &buf),==,0);
         dump_buf(&buf, "<=(QBUF)==");
 
+        /* keep the buffer for reuse if the pool takes it, it keeps its
+           reference */
+        if (!ret && pool_put(bufPtr, &buf))
+        {
+            goto DONE;
+        }
+
         /* unregister buffer, and free tiler chunks even if there is an
            error */
         if (!ret)
         {
-            dump_buf(&buf, "==(URBUF)=>");
-            ret = A_I(ioctl(td, TILIOC_URBUF, &buf),==,0);
-            dump_buf(&buf, "<=(URBUF)==");
-
-            /* free each block */
-            int ix;
-            for (ix = 0; ix < buf.num_blocks; ix++)
-            {
-                ERR_ADD(ret, tiler_free(buf.blocks + ix));
-            }
-
-            /* unmap buffer */
-            bytes_t size = tiler_size(buf.blocks, buf.num_blocks);
-            bufPtr = (void *)((uint32_t)bufPtr & ~(PAGE_SIZE - 1));
-            ERR_ADD(ret, munmap(bufPtr, size));
+            ret = release_buf(bufPtr, &buf);
         }
 #else
-        void *ptr = (void *) buf.offset;
+        struct tiler_buf_info *ptr = (struct tiler_buf_info *) buf.offset;
+        stats_buf(ptr->blocks, ptr->num_blocks, -1);
         FREE(ptr);
         ret = MEMMGR_ERR_NONE;
 #endif
         ERR_ADD(ret, dec_ref());
     }
 
+#ifndef STUB_TILER
+DONE:
+#endif
     CHK_I(cache_check(),==,0);
     return R_I(ret);
 }
@@ -804,6 +1216,7 @@ void *MemMgr_Map(MemAllocBlock blocks[], int num_blocks)
 {
     IN;
     void *bufPtr = NULL;
+    uint64_t start = stats_now_us();
 
     /* need to access ssptrs */
     struct tiler_block_info *blks = (tiler_block_info *) blocks;
@@ -849,6 +1262,8 @@ FAIL:
 
     A_I(dec_ref(),==,0);
 DONE:
+    stats_call(&usage_stats.maps, &usage_stats.map_failures,
+               usage_stats.map_latency, start, bufPtr != NULL);
     CHK_I(cache_check(),==,0);
     return R_P(bufPtr);
 }
@@ -892,9 +1307,12 @@ int MemMgr_UnMap(void *bufPtr)
             bytes_t size = tiler_size(buf.blocks, buf.num_blocks);
             bufPtr = (void *)((uint32_t)bufPtr & ~(PAGE_SIZE - 1));
             ERR_ADD(ret, munmap(bufPtr, size));
+
+            stats_buf(buf.blocks, buf.num_blocks, -1);
         }
 #else
         struct tiler_buf_info *ptr = (struct tiler_buf_info *) buf.offset;
+        stats_buf(ptr->blocks, ptr->num_blocks, -1);
         FREE(ptr[1].blocks[0].ptr);
         FREE(ptr);
         ret = MEMMGR_ERR_NONE;
@@ -978,27 +1396,25 @@ bytes_t MemMgr_GetStride(void *ptr)
     }
     A_I(dec_ref(),==,0);
 #else
-    /* if emulating, we need to get through all allocated memory segments */
-    pthread_mutex_lock(&che_mutex);
-    init();
-
-    _AllocData *ad;
+    /* if emulating, we need to look through the blocks of the segment */
     if (!ptr) return R_UP(0);
-    DLIST_MLOOP(bufs, ad, link) {
-        int ix;
-        struct tiler_buf_info *buf = (struct tiler_buf_info *) ad->tiler_id;
+    pthread_rwlock_rdlock(&che_lock);
+    int ix, bx = buf_cache_find(ptr);
+    if (bx >= 0)
+    {
+        struct tiler_buf_info *buf = (struct tiler_buf_info *) bufs[bx].tiler_id;
         for (ix = 0; ix < buf->num_blocks; ix++)
         {
             if (ptr >= buf->blocks[ix].ptr &&
                 ptr < buf->blocks[ix].ptr + def_size(buf->blocks + ix))
             {
                 bytes_t stride = buf->blocks[ix].stride;
-                pthread_mutex_unlock(&che_mutex);
+                pthread_rwlock_unlock(&che_lock);
                 return R_UP(stride);
             }
         }
     }
-    pthread_mutex_unlock(&che_mutex);
+    pthread_rwlock_unlock(&che_lock);
 #endif
     return R_UP(PAGE_SIZE);
 }
@@ -1031,6 +1447,128 @@ SSPtr TilerMem_VirtToPhys(void *ptr)
 #endif
 }
 
+void MemMgr_SetPoolBudget(bytes_t max_bytes)
+{
+    IN;
+    pthread_mutex_lock(&pool_mutex);
+    pool_stats.budget = max_bytes;
+    pthread_mutex_unlock(&pool_mutex);
+
+    pool_evict(max_bytes);
+    CHK_I(cache_check(),==,0);
+}
+
+int MemMgr_TrimPool(bytes_t max_bytes)
+{
+    IN;
+    int num = pool_evict(max_bytes);
+    CHK_I(cache_check(),==,0);
+    return R_I(num);
+}
+
+void MemMgr_GetPoolStats(MemMgrPoolStats *stats)
+{
+    pthread_mutex_lock(&pool_mutex);
+    *stats = pool_stats;
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+int MemMgr_GetUsageStats(MemMgrUsageStats *stats)
+{
+    IN;
+    int ret = MEMMGR_ERR_NONE;
+    int ix;
+
+    pthread_mutex_lock(&stats_mutex);
+    *stats = usage_stats;
+    pthread_mutex_unlock(&stats_mutex);
+
+    /* buffers, from the records and the pool */
+    pthread_mutex_lock(&pool_mutex);
+    pthread_rwlock_rdlock(&che_lock);
+    stats->num_bufs = num_bufs + pool_stats.num_bufs;
+#ifndef STUB_TILER
+    _Extent ext[PIXEL_FMT_MAX - PIXEL_FMT_MIN + 1];
+    _PoolData *pd;
+    int num_ids = num_bufs;
+    uint32_t *ids = num_ids ? NEWN(uint32_t, num_ids) : NULL;
+
+    ZERO(ext);
+    if (num_ids && NOT_P(ids,!=,NULL))
+    {
+        num_ids = 0;
+        ret = MEMMGR_ERR_GENERIC;
+    }
+    for (ix = 0; ix < num_ids; ix++)
+    {
+        ids[ix] = bufs[ix].tiler_id;
+    }
+
+    /* pooled buffers keep their block information */
+    DLIST_MLOOP(pool, pd, link) {
+        int bx;
+        for (bx = 0; bx < pd->buf.num_blocks; bx++)
+        {
+            extent_add(ext, pd->buf.blocks + bx);
+        }
+    }
+#endif
+    pthread_rwlock_unlock(&che_lock);
+    pthread_mutex_unlock(&pool_mutex);
+
+#ifndef STUB_TILER
+    /* query the blocks of the other buffers.  Buffers freed in the
+       meantime fail the query and are skipped. */
+    if (num_ids && !NOT_I(inc_ref(),==,0))
+    {
+        for (ix = 0; ix < num_ids; ix++)
+        {
+            struct tiler_buf_info buf;
+            ZERO(buf);
+            buf.offset = ids[ix];
+            if (ioctl(td, TILIOC_QBUF, &buf)) continue;
+
+            int bx;
+            for (bx = 0; bx < buf.num_blocks; bx++)
+            {
+                extent_add(ext, buf.blocks + bx);
+            }
+        }
+        A_I(dec_ref(),==,0);
+    }
+    FREE(ids);
+
+    for (ix = 0; ix <= PIXEL_FMT_MAX - PIXEL_FMT_MIN; ix++)
+    {
+        stats->formats[ix].extent = ext[ix].num ?
+            (bytes_t) (ext[ix].x1 - ext[ix].x0) * (ext[ix].y1 - ext[ix].y0) : 0;
+    }
+#else
+    for (ix = 0; ix <= PIXEL_FMT_MAX - PIXEL_FMT_MIN; ix++)
+    {
+        stats->formats[ix].extent = 0;
+    }
+#endif
+    return R_I(ret);
+}
+
+void MemMgr_ResetUsageStats()
+{
+    int ix;
+    pthread_mutex_lock(&stats_mutex);
+    for (ix = 0; ix <= PIXEL_FMT_MAX - PIXEL_FMT_MIN; ix++)
+    {
+        usage_stats.formats[ix].peak_bytes = usage_stats.formats[ix].bytes;
+        usage_stats.formats[ix].failures = 0;
+    }
+    usage_stats.peak_bytes = usage_stats.bytes;
+    usage_stats.allocs = usage_stats.alloc_failures = 0;
+    usage_stats.maps = usage_stats.map_failures = 0;
+    ZERO(usage_stats.alloc_latency);
+    ZERO(usage_stats.map_latency);
+    pthread_mutex_unlock(&stats_mutex);
+}
+
 /**
  * Internal Unit Test.  Tests the static methods of this
  * library.  Assumes an unitialized state as well.
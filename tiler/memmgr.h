@@ -304,4 +304,122 @@ bool MemMgr_Is2DBlock(void *ptr);
  */
 bytes_t MemMgr_GetStride(void *ptr);
 
+/**
+ * Recycling pool statistics
+ *
+ * 2D buffers freed with MemMgr_Free() can be kept registered
+ * and mapped in a recycling pool, so that a later MemMgr_Alloc()
+ * of the same geometry (number of blocks, and pixel format,
+ * width and height of each block) reuses them without going to
+ * the tiler driver.  Buffers with 1D blocks are never pooled.
+ */
+struct MemMgrPoolStats {
+    bytes_t  budget;    /* bytes the pool may hold, 0 if disabled */
+    bytes_t  bytes;     /* bytes held by the pool */
+    uint32_t num_bufs;  /* buffers held by the pool */
+    uint32_t hits;      /* allocations served from the pool */
+    uint32_t misses;    /* 2D allocations the pool could not serve */
+    uint32_t recycled;  /* freed buffers taken by the pool */
+    uint32_t evicted;   /* pooled buffers released to the driver */
+};
+
+typedef struct MemMgrPoolStats MemMgrPoolStats;
+
+/**
+ * Sets the number of bytes the recycling pool may hold, and
+ * releases the least recently freed buffers over this budget.
+ * The pool is disabled (budget of 0) by default.
+ * <p>
+ * A buffer served from the pool is not cleared, it holds
+ * whatever its previous user left in it.
+ *
+ * @param max_bytes  Pool budget in bytes.  0 disables the pool
+ *                   and releases all pooled buffers.
+ */
+void MemMgr_SetPoolBudget(bytes_t max_bytes);
+
+/**
+ * Releases the least recently freed buffers from the recycling
+ * pool until it holds at most max_bytes.  The budget is not
+ * changed.
+ *
+ * @param max_bytes  Number of bytes the pool may keep.  Use 0
+ *                   to release every pooled buffer.
+ *
+ * @return Number of buffers released.
+ */
+int MemMgr_TrimPool(bytes_t max_bytes);
+
+/**
+ * Retrieves the recycling pool statistics.
+ *
+ * @param stats  Pointer to the statistics to fill out
+ */
+void MemMgr_GetPoolStats(MemMgrPoolStats *stats);
+
+/* number of buckets of the latency histograms */
+#define MEMMGR_LATENCY_BUCKETS 16
+
+/**
+ * Usage of one tiler container (pixel format) by this process
+ *
+ * The extent is the smallest range (page mode) or rectangle (2D
+ * formats) of the container that holds all live blocks, in the
+ * same units as bytes.  The closer bytes is to the extent, the
+ * more tightly packed the blocks are.
+ */
+struct MemMgrFormatStats {
+    uint32_t blocks;      /* live blocks */
+    bytes_t  bytes;       /* bytes of the live blocks */
+    bytes_t  peak_bytes;  /* highest bytes seen */
+    bytes_t  extent;      /* bytes spanned by the live blocks, 0 when
+                             emulating the tiler */
+    uint32_t failures;    /* blocks the driver could not allocate or map */
+};
+
+typedef struct MemMgrFormatStats MemMgrFormatStats;
+
+/**
+ * Tiler usage statistics of this process
+ *
+ * Blocks are counted from the time the tiler driver allocates or
+ * maps them until they are released, so buffers kept in the
+ * recycling pool are live.  Bucket n of a latency histogram
+ * counts the calls that took at least 2^n and less than 2^(n+1)
+ * microseconds; the first bucket also counts faster calls and the
+ * last one slower calls.
+ */
+struct MemMgrUsageStats {
+    MemMgrFormatStats formats[PIXEL_FMT_MAX - PIXEL_FMT_MIN + 1];
+                          /* by pixel format, from PIXEL_FMT_MIN */
+    uint32_t num_bufs;    /* live buffers, including pooled ones */
+    bytes_t  bytes;       /* bytes of all live blocks */
+    bytes_t  peak_bytes;  /* highest bytes seen */
+    uint32_t allocs;      /* MemMgr_Alloc() calls */
+    uint32_t alloc_failures; /* MemMgr_Alloc() calls that failed */
+    uint32_t maps;        /* MemMgr_Map() calls */
+    uint32_t map_failures;   /* MemMgr_Map() calls that failed */
+    uint32_t alloc_latency[MEMMGR_LATENCY_BUCKETS]; /* of MemMgr_Alloc() */
+    uint32_t map_latency[MEMMGR_LATENCY_BUCKETS];   /* of MemMgr_Map() */
+};
+
+typedef struct MemMgrUsageStats MemMgrUsageStats;
+
+/**
+ * Retrieves the tiler usage statistics of this process.  The
+ * extents are computed from the allocator records, which takes
+ * a query to the tiler driver per live buffer.
+ *
+ * @param stats  Pointer to the statistics to fill out
+ *
+ * @return 0 on success, non-0 error value on failure.
+ */
+int MemMgr_GetUsageStats(MemMgrUsageStats *stats);
+
+/**
+ * Clears the peak usage, the call and failure counts and the
+ * latency histograms.  Peaks restart from the current usage.
+ */
+void MemMgr_ResetUsageStats();
+
 #endif
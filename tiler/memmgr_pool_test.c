@@ -0,0 +1,536 @@
+/*
+ *  memmgr_pool_test.c
+ *
+ *  Memory Allocator recycling pool tests, run against the fake tiler driver.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* retrieve type definitions */
+#define __DEBUG__
+#undef __DEBUG_ENTRY__
+#define __DEBUG_ASSERT__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <utils.h>
+#include <debug_utils.h>
+#include <memmgr.h>
+#include <tilermem.h>
+#include <tilermem_utils.h>
+#include <testlib.h>
+#include "tiler_fake.h"
+
+#define NV12_SIZE(w, h) (def_stride(w) * (h) * 3 / 2)
+
+#define TESTS\
+    T(pool_disabled_test(1920, 1080))\
+    T(pool_reuse_test(1920, 1080))\
+    T(pool_geometry_test(1920, 1080))\
+    T(pool_budget_test(1280, 720))\
+    T(pool_1D_test(65536))\
+    T(pool_trim_test(640, 480))\
+    T(pool_full_test(1920, 1080))\
+    T(pool_bench_test(1920, 1080, 1000))\
+    T(pool_bench_test(640, 480, 1000))\
+
+/* this is defined in memmgr.c, but not exported as it is for internal
+   use only */
+extern int __test__MemMgr();
+
+/**
+ * Returns the default page stride for a width in bytes.
+ */
+static bytes_t def_stride(bytes_t width)
+{
+    return (PAGE_SIZE - 1 + width) & ~(PAGE_SIZE - 1);
+}
+
+/**
+ * Returns the monotonic time in microseconds.
+ */
+static uint64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Allocates an NV12 buffer.
+ *
+ * @param width    Buffer width
+ * @param height   Buffer height
+ * @param blocks   Block information, 2 entries
+ *
+ * @return pointer to the buffer, or NULL on failure
+ */
+static void *get_NV12(pixels_t width, pixels_t height, MemAllocBlock *blocks)
+{
+    memset(blocks, 0, 2 * sizeof(*blocks));
+    blocks[0].pixelFormat = PIXEL_FMT_8BIT;
+    blocks[0].dim.area.width  = width;
+    blocks[0].dim.area.height = height;
+    blocks[1].pixelFormat = PIXEL_FMT_16BIT;
+    blocks[1].dim.area.width  = width >> 1;
+    blocks[1].dim.area.height = height >> 1;
+
+    return MemMgr_Alloc(blocks, 2);
+}
+
+/**
+ * Allocates an NV12 buffer and checks the block information
+ * that MemMgr_Alloc filled out.
+ *
+ * @param width    Buffer width
+ * @param height   Buffer height
+ * @param blocks   Block information, 2 entries
+ *
+ * @return pointer to the buffer, or NULL on failure
+ */
+static void *alloc_NV12(pixels_t width, pixels_t height, MemAllocBlock *blocks)
+{
+    void *bufPtr = get_NV12(width, height, blocks);
+    if (bufPtr &&
+        (NOT_P(blocks[0].ptr,==,bufPtr) ||
+         NOT_P(blocks[1].ptr,==,bufPtr + blocks[0].stride * height) ||
+         NOT_I(blocks[0].stride,==,def_stride(width)) ||
+         NOT_I(blocks[1].stride,==,def_stride(width)) ||
+         NOT_I(MemMgr_Is2DBlock(blocks[1].ptr),!=,0) ||
+         NOT_I(MemMgr_GetStride(blocks[1].ptr),==,blocks[1].stride) ||
+         NOT_P(TilerMem_VirtToPhys(bufPtr),==,blocks[0].reserved) ||
+         NOT_P(TilerMem_VirtToPhys(blocks[1].ptr),==,blocks[1].reserved)))
+    {
+        MemMgr_Free(bufPtr);
+        return NULL;
+    }
+    return bufPtr;
+}
+
+/**
+ * Releases the pool and checks that no buffer is left with the
+ * driver.
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+static int pool_reset()
+{
+    struct tiler_fake_stats fs;
+    MemMgrPoolStats ps;
+
+    MemMgr_SetPoolBudget(0);
+    MemMgr_GetPoolStats(&ps);
+    tiler_fake_get_stats(&fs);
+
+    int ret = NOT_I(ps.num_bufs,==,0);
+    ret |= NOT_I(ps.bytes,==,0);
+    ret |= NOT_I(fs.live_blocks,==,0);
+    ret |= NOT_I(fs.live_bufs,==,0);
+    ret |= NOT_I(fs.mmaps,==,fs.munmaps);
+    return ret;
+}
+
+/**
+ * Checks that freed buffers are released right away when the
+ * pool is disabled.
+ */
+int pool_disabled_test(pixels_t width, pixels_t height)
+{
+    printf("Free %ux%u NV12 buffer with the pool disabled\n", width, height);
+
+    struct tiler_fake_stats before, after;
+    MemMgrPoolStats ps0, ps;
+    MemAllocBlock blocks[2];
+
+    MemMgr_SetPoolBudget(0);
+    MemMgr_GetPoolStats(&ps0);
+    tiler_fake_get_stats(&before);
+    void *bufPtr = alloc_NV12(width, height, blocks);
+    if (NOT_P(bufPtr,!=,NULL)) return 1;
+    int ret = MemMgr_Free(bufPtr);
+    tiler_fake_get_stats(&after);
+    MemMgr_GetPoolStats(&ps);
+
+    ret |= NOT_I(after.allocs - before.allocs,==,2);
+    ret |= NOT_I(after.frees - before.frees,==,2);
+    ret |= NOT_I(after.unregisters - before.unregisters,==,1);
+    ret |= NOT_I(after.munmaps - before.munmaps,==,1);
+    ret |= NOT_I(ps.recycled - ps0.recycled,==,0);
+    ret |= NOT_I(ps.misses - ps0.misses,==,0);
+    ret |= pool_reset();
+    return ret;
+}
+
+/**
+ * Checks that a freed buffer is reused for the next allocation
+ * of the same geometry without going to the driver, and that
+ * it still works as an allocated buffer.
+ */
+int pool_reuse_test(pixels_t width, pixels_t height)
+{
+    printf("Reuse %ux%u NV12 buffer from the pool\n", width, height);
+
+    struct tiler_fake_stats before, after;
+    MemMgrPoolStats ps0, ps;
+    MemAllocBlock blocks[2], blocks2[2];
+
+    MemMgr_SetPoolBudget(NV12_SIZE(width, height));
+    void *bufPtr = alloc_NV12(width, height, blocks);
+    if (NOT_P(bufPtr,!=,NULL)) return 1;
+    memset(bufPtr, 0x5a, 64);
+
+    MemMgr_GetPoolStats(&ps0);
+    tiler_fake_get_stats(&before);
+    int ret = MemMgr_Free(bufPtr);
+    void *bufPtr2 = get_NV12(width, height, blocks2);
+    tiler_fake_get_stats(&after);
+    MemMgr_GetPoolStats(&ps);
+
+    /* same buffer and blocks, only the QBUF of the free went to the
+       driver */
+    ret |= NOT_P(bufPtr2,==,bufPtr);
+    ret |= NOT_I(blocks2[0].reserved,==,blocks[0].reserved);
+    ret |= NOT_I(blocks2[1].reserved,==,blocks[1].reserved);
+    ret |= NOT_P(blocks2[1].ptr,==,blocks[1].ptr);
+    ret |= NOT_I(blocks2[1].stride,==,blocks[1].stride);
+    ret |= NOT_I(after.ioctls - before.ioctls,==,1);
+    ret |= NOT_I(after.mmaps - before.mmaps,==,0);
+    ret |= NOT_I(after.munmaps - before.munmaps,==,0);
+    ret |= NOT_I(ps.hits - ps0.hits,==,1);
+    ret |= NOT_I(ps.recycled - ps0.recycled,==,1);
+    ret |= NOT_I(ps.num_bufs,==,0);
+
+    /* and it is tracked as an allocated buffer again */
+    ret |= NOT_I(MemMgr_GetStride(blocks2[1].ptr),==,blocks2[1].stride);
+    ret |= NOT_P(TilerMem_VirtToPhys(blocks2[1].ptr),==,blocks2[1].reserved);
+
+    /* the contents are not cleared */
+    ret |= NOT_I(*(uint8_t *)bufPtr2,==,0x5a);
+
+    /* freeing twice must still fail */
+    ret |= MemMgr_Free(bufPtr2);
+    ret |= NOT_I(MemMgr_Free(bufPtr2),!=,0);
+    ret |= pool_reset();
+    return ret;
+}
+
+/**
+ * Checks that pooled buffers only serve allocations of the same
+ * geometry.
+ */
+int pool_geometry_test(pixels_t width, pixels_t height)
+{
+    printf("Allocate other geometries than a pooled %ux%u NV12 buffer\n", width, height);
+
+    MemMgrPoolStats ps0, ps;
+    MemAllocBlock blocks[2];
+
+    MemMgr_SetPoolBudget(NV12_SIZE(width, height));
+    void *bufPtr = alloc_NV12(width, height, blocks);
+    if (NOT_P(bufPtr,!=,NULL)) return 1;
+    int ret = MemMgr_Free(bufPtr);
+    MemMgr_GetPoolStats(&ps0);
+
+    /* smaller NV12 */
+    void *ptr = alloc_NV12(width / 2, height / 2, blocks);
+    ret |= NOT_P(ptr,!=,NULL);
+    ret |= NOT_P(ptr,!=,bufPtr);
+    ERR_ADD(ret, MemMgr_Free(ptr));
+
+    /* the luma block alone */
+    memset(blocks, 0, sizeof(blocks));
+    blocks[0].pixelFormat = PIXEL_FMT_8BIT;
+    blocks[0].dim.area.width  = width;
+    blocks[0].dim.area.height = height;
+    ptr = MemMgr_Alloc(blocks, 1);
+    ret |= NOT_P(ptr,!=,NULL);
+    ret |= NOT_P(ptr,!=,bufPtr);
+    ERR_ADD(ret, MemMgr_Free(ptr));
+
+    /* same dimensions, other pixel format */
+    memset(blocks, 0, sizeof(blocks));
+    blocks[0].pixelFormat = PIXEL_FMT_16BIT;
+    blocks[0].dim.area.width  = width;
+    blocks[0].dim.area.height = height;
+    blocks[1].pixelFormat = PIXEL_FMT_16BIT;
+    blocks[1].dim.area.width  = width >> 1;
+    blocks[1].dim.area.height = height >> 1;
+    ptr = MemMgr_Alloc(blocks, 2);
+    ret |= NOT_P(ptr,!=,NULL);
+    ret |= NOT_P(ptr,!=,bufPtr);
+    ERR_ADD(ret, MemMgr_Free(ptr));
+
+    MemMgr_GetPoolStats(&ps);
+    ret |= NOT_I(ps.hits - ps0.hits,==,0);
+    ret |= NOT_I(ps.misses - ps0.misses,==,3);
+    ret |= pool_reset();
+    return ret;
+}
+
+/**
+ * Checks that the pool stays within its budget by releasing
+ * the least recently freed buffers.
+ */
+int pool_budget_test(pixels_t width, pixels_t height)
+{
+    printf("Keep 2 of 4 freed %ux%u NV12 buffers in the pool\n", width, height);
+
+    MemMgrPoolStats ps0, ps;
+    MemAllocBlock blocks[2];
+    void *bufs[4];
+    int ix, ret = 0;
+
+    MemMgr_SetPoolBudget(NV12_SIZE(width, height) * 5 / 2);
+    MemMgr_GetPoolStats(&ps0);
+    for (ix = 0; ix < 4; ix++)
+    {
+        bufs[ix] = alloc_NV12(width, height, blocks);
+        if (NOT_P(bufs[ix],!=,NULL)) return 1;
+    }
+    for (ix = 0; ix < 4; ix++)
+    {
+        ERR_ADD(ret, MemMgr_Free(bufs[ix]));
+    }
+
+    MemMgr_GetPoolStats(&ps);
+    ret |= NOT_I(ps.num_bufs,==,2);
+    ret |= NOT_I(ps.bytes,==,2 * NV12_SIZE(width, height));
+    ret |= NOT_I(ps.evicted - ps0.evicted,==,2);
+
+    /* the most recently freed buffers are served, newest first */
+    void *ptr = alloc_NV12(width, height, blocks);
+    ret |= NOT_P(ptr,==,bufs[3]);
+    void *ptr2 = alloc_NV12(width, height, blocks);
+    ret |= NOT_P(ptr2,==,bufs[2]);
+    ERR_ADD(ret, MemMgr_Free(ptr));
+    ERR_ADD(ret, MemMgr_Free(ptr2));
+
+    /* a buffer larger than the budget is released */
+    MemMgr_SetPoolBudget(NV12_SIZE(width, height) / 2);
+    MemMgr_GetPoolStats(&ps);
+    ret |= NOT_I(ps.num_bufs,==,0);
+    ptr = alloc_NV12(width, height, blocks);
+    ERR_ADD(ret, MemMgr_Free(ptr));
+    MemMgr_GetPoolStats(&ps);
+    ret |= NOT_I(ps.num_bufs,==,0);
+
+    ret |= pool_reset();
+    return ret;
+}
+
+/**
+ * Checks that buffers with 1D blocks are never pooled.
+ */
+int pool_1D_test(bytes_t length)
+{
+    printf("Free %ub 1D buffer with the pool enabled\n", length);
+
+    MemMgrPoolStats ps0, ps;
+    MemAllocBlock block;
+    memset(&block, 0, sizeof(block));
+    block.pixelFormat = PIXEL_FMT_PAGE;
+    block.dim.len = length;
+
+    MemMgr_SetPoolBudget(length * 4);
+    MemMgr_GetPoolStats(&ps0);
+    void *bufPtr = MemMgr_Alloc(&block, 1);
+    if (NOT_P(bufPtr,!=,NULL)) return 1;
+    int ret = MemMgr_Free(bufPtr);
+
+    MemMgr_GetPoolStats(&ps);
+    ret |= NOT_I(ps.num_bufs,==,0);
+    ret |= NOT_I(ps.recycled - ps0.recycled,==,0);
+    ret |= pool_reset();
+    return ret;
+}
+
+/**
+ * Checks that trimming releases the least recently freed
+ * buffers and keeps the budget.
+ */
+int pool_trim_test(pixels_t width, pixels_t height)
+{
+    printf("Trim a pool of 3 %ux%u NV12 buffers\n", width, height);
+
+    MemMgrPoolStats ps;
+    MemAllocBlock blocks[2];
+    void *bufs[3];
+    int ix, ret = 0;
+
+    MemMgr_SetPoolBudget(NV12_SIZE(width, height) * 8);
+    for (ix = 0; ix < 3; ix++)
+    {
+        bufs[ix] = alloc_NV12(width, height, blocks);
+        if (NOT_P(bufs[ix],!=,NULL)) return 1;
+    }
+    for (ix = 0; ix < 3; ix++)
+    {
+        ERR_ADD(ret, MemMgr_Free(bufs[ix]));
+    }
+
+    ret |= NOT_I(MemMgr_TrimPool(NV12_SIZE(width, height)),==,2);
+    MemMgr_GetPoolStats(&ps);
+    ret |= NOT_I(ps.num_bufs,==,1);
+    ret |= NOT_I(ps.budget,==,NV12_SIZE(width, height) * 8);
+
+    void *ptr = alloc_NV12(width, height, blocks);
+    ret |= NOT_P(ptr,==,bufs[2]);
+    ERR_ADD(ret, MemMgr_Free(ptr));
+
+    ret |= NOT_I(MemMgr_TrimPool(0),==,1);
+    ret |= pool_reset();
+    return ret;
+}
+
+/**
+ * Checks that an allocation that does not fit in the container
+ * releases the pooled buffers and retries once.
+ */
+int pool_full_test(pixels_t width, pixels_t height)
+{
+    printf("Allocate in a container filled by pooled %ux%u 8-bit buffers\n",
+           width, height);
+
+    MemMgrPoolStats ps0, ps;
+    MemAllocBlock block;
+    void *bufs[256];
+    int num, ix, ret = 0;
+
+    /* fill the 8-bit container, every buffer goes to the pool */
+    MemMgr_SetPoolBudget(0xffffffff);
+    for (num = 0; num < 256; num++)
+    {
+        memset(&block, 0, sizeof(block));
+        block.pixelFormat = PIXEL_FMT_8BIT;
+        block.dim.area.width  = width;
+        block.dim.area.height = height;
+        bufs[num] = MemMgr_Alloc(&block, 1);
+        if (!bufs[num]) break;
+    }
+    if (NOT_I(num,<,256) || NOT_I(num,>,0)) return 1;
+    for (ix = 0; ix < num; ix++)
+    {
+        ERR_ADD(ret, MemMgr_Free(bufs[ix]));
+    }
+    MemMgr_GetPoolStats(&ps0);
+    ret |= NOT_I(ps0.num_bufs,==,num);
+
+    /* a taller block matches no pooled buffer and only fits once the
+       pool is released */
+    memset(&block, 0, sizeof(block));
+    block.pixelFormat = PIXEL_FMT_8BIT;
+    block.dim.area.width  = width;
+    block.dim.area.height = height + 8;
+    void *ptr = MemMgr_Alloc(&block, 1);
+    ret |= NOT_P(ptr,!=,NULL);
+    ERR_ADD(ret, MemMgr_Free(ptr));
+
+    MemMgr_GetPoolStats(&ps);
+    ret |= NOT_I(ps.evicted - ps0.evicted,==,num);
+    ret |= NOT_I(ps.misses - ps0.misses,==,1);
+
+    ret |= pool_reset();
+    return ret;
+}
+
+/**
+ * Measures alloc/free cycles of an NV12 buffer, as done on
+ * every preview or codec restart, with and without the pool.
+ * Prints the driver calls and the time per cycle.
+ */
+int pool_bench_test(pixels_t width, pixels_t height, int cycles)
+{
+    printf("Alloc & Free %ux%u NV12 buffer %d times with and without the pool\n",
+           width, height, cycles);
+
+    MemAllocBlock blocks[2];
+    int pass, ix, ret = 0;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        struct tiler_fake_stats before, after;
+        MemMgr_SetPoolBudget(pass ? NV12_SIZE(width, height) : 0);
+
+        tiler_fake_get_stats(&before);
+        uint64_t t = now_us();
+        for (ix = 0; ix < cycles; ix++)
+        {
+            void *bufPtr = get_NV12(width, height, blocks);
+            if (NOT_P(bufPtr,!=,NULL))
+            {
+                ret = 1;
+                break;
+            }
+            ERR_ADD(ret, MemMgr_Free(bufPtr));
+        }
+        t = now_us() - t;
+        tiler_fake_get_stats(&after);
+
+        P(":: pool %s: %u ioctls, %u mmaps, %u ns per cycle",
+          pass ? "on " : "off", after.ioctls - before.ioctls,
+          after.mmaps - before.mmaps, (uint32_t) (t * 1000 / cycles));
+    }
+
+    ret |= pool_reset();
+    return ret;
+}
+
+DEFINE_TESTS(TESTS)
+
+/**
+ * We run the same identity check before and after running the
+ * tests.
+ */
+void memmgr_identity_test(void *ptr)
+{
+    /* also execute internal unit tests - this also verifies that we did not
+       keep any references */
+    __test__MemMgr();
+}
+
+/**
+ * Main test function. Checks arguments for test case ranges,
+ * runs tests and prints usage or test list if required.
+ *
+ * @param argc   Number of arguments
+ * @param argv   Arguments
+ *
+ * @return -1 on usage or test list, otherwise # of failed
+ *         tests.
+ */
+int main(int argc, char **argv)
+{
+    return TestLib_Run(argc, argv,
+                       memmgr_identity_test, memmgr_identity_test, NULL);
+}
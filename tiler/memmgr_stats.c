@@ -0,0 +1,234 @@
+/*
+ *  memmgr_stats.c
+ *
+ *  Prints the tiler usage of a set of buffers.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocates the buffers given on the command line, prints the tiler usage
+ * statistics and frees them again, to see how a use case (e.g. 1080p video
+ * plus camera plus UI) fills the containers:
+ *
+ *     memmgr_stats [-c <cycles>] [-p <pool bytes>] <buffer>...
+ *
+ * where <buffer> is [<count>x]<format>:<size>.  <format> is 8, 16, 32 or
+ * nv12 with a <width>x<height> size, or 1d with a size in bytes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef HAVE_CONFIG_H
+    #include "config.h"
+#endif
+#include <utils.h>
+#include <debug_utils.h>
+#include <memmgr.h>
+
+#define MAX_BUFS 256
+
+static const char *fmt_names[] = { "8bit", "16bit", "32bit", "page" };
+
+struct buf_spec {
+    int count;
+    int num_blocks;
+    MemAllocBlock blocks[2];
+};
+
+/**
+ * Parses a buffer description.
+ *
+ * @return 0 on success, non-0 if the description is malformed
+ */
+static int parse_buf(const char *arg, struct buf_spec *spec)
+{
+    char fmt[8];
+    unsigned count = 1, width = 0, height = 0;
+    const char *p = strchr(arg, 'x');
+    const char *colon = strchr(arg, ':');
+
+    memset(spec, 0, sizeof(*spec));
+    if (!colon) return 1;
+    if (p && p < colon)
+    {
+        if (sscanf(arg, "%ux", &count) != 1) return 1;
+        arg = p + 1;
+    }
+    if (colon - arg >= (int) sizeof(fmt)) return 1;
+    memcpy(fmt, arg, colon - arg);
+    fmt[colon - arg] = '\0';
+
+    spec->count = count;
+    spec->num_blocks = 1;
+    if (!strcmp(fmt, "1d"))
+    {
+        spec->blocks[0].pixelFormat = PIXEL_FMT_PAGE;
+        spec->blocks[0].dim.len = strtoul(colon + 1, NULL, 0);
+        return !spec->blocks[0].dim.len;
+    }
+
+    if (sscanf(colon + 1, "%ux%u", &width, &height) != 2 || !width || !height)
+        return 1;
+
+    if (!strcmp(fmt, "nv12"))
+    {
+        spec->num_blocks = 2;
+        spec->blocks[0].pixelFormat = PIXEL_FMT_8BIT;
+        spec->blocks[1].pixelFormat = PIXEL_FMT_16BIT;
+        spec->blocks[1].dim.area.width  = width >> 1;
+        spec->blocks[1].dim.area.height = height >> 1;
+    }
+    else if (!strcmp(fmt, "8"))  spec->blocks[0].pixelFormat = PIXEL_FMT_8BIT;
+    else if (!strcmp(fmt, "16")) spec->blocks[0].pixelFormat = PIXEL_FMT_16BIT;
+    else if (!strcmp(fmt, "32")) spec->blocks[0].pixelFormat = PIXEL_FMT_32BIT;
+    else return 1;
+
+    spec->blocks[0].dim.area.width  = width;
+    spec->blocks[0].dim.area.height = height;
+    return 0;
+}
+
+static void print_latency(const char *name, uint32_t calls, uint32_t failures,
+                          uint32_t *latency)
+{
+    int ix;
+    printf("%s: %u calls, %u failed\n", name, calls, failures);
+    for (ix = 0; ix < MEMMGR_LATENCY_BUCKETS; ix++)
+    {
+        if (!latency[ix]) continue;
+        if (ix == MEMMGR_LATENCY_BUCKETS - 1)
+            printf("  >= %6u us: %u\n", 1u << ix, latency[ix]);
+        else
+            printf("  < %7u us: %u\n", 2u << ix, latency[ix]);
+    }
+}
+
+/**
+ * Prints a usage snapshot
+ */
+static void print_stats(MemMgrUsageStats *stats)
+{
+    int ix;
+    printf("%u buffers, %u bytes live, %u bytes peak\n",
+           stats->num_bufs, stats->bytes, stats->peak_bytes);
+    printf("format  blocks      bytes       peak     extent  packed  failed\n");
+    for (ix = 0; ix <= PIXEL_FMT_MAX - PIXEL_FMT_MIN; ix++)
+    {
+        MemMgrFormatStats *fs = stats->formats + ix;
+        printf("%6s %7u %10u %10u %10u", fmt_names[ix], fs->blocks, fs->bytes,
+               fs->peak_bytes, fs->extent);
+        if (fs->extent)
+            printf("  %5u%%", (uint32_t) ((uint64_t) fs->bytes * 100 / fs->extent));
+        else
+            printf("       -");
+        printf("  %6u\n", fs->failures);
+    }
+    print_latency("alloc", stats->allocs, stats->alloc_failures, stats->alloc_latency);
+    print_latency("map", stats->maps, stats->map_failures, stats->map_latency);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-c <cycles>] [-p <pool bytes>] <buffer>...\n"
+            "  <buffer> is [<count>x]<format>:<size>, <format> is 8, 16, 32 or\n"
+            "  nv12 with a <width>x<height> size, or 1d with a size in bytes\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    static struct buf_spec specs[MAX_BUFS];
+    static void *bufs[MAX_BUFS];
+    int num_specs = 0, num_bufs = 0, cycles = 1;
+    int ix, jx, cx, res = 0;
+
+    for (ix = 1; ix < argc; ix++)
+    {
+        if (!strcmp(argv[ix], "-c") && ix + 1 < argc)
+        {
+            cycles = atoi(argv[++ix]);
+        }
+        else if (!strcmp(argv[ix], "-p") && ix + 1 < argc)
+        {
+            MemMgr_SetPoolBudget(strtoul(argv[++ix], NULL, 0));
+        }
+        else if (argv[ix][0] != '-' && num_specs < MAX_BUFS &&
+                 !parse_buf(argv[ix], specs + num_specs))
+        {
+            num_specs++;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!num_specs || cycles < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* allocate everything, keep it for the snapshot of the last cycle */
+    for (cx = 0; cx < cycles; cx++)
+    {
+        num_bufs = 0;
+        for (ix = 0; ix < num_specs; ix++)
+        {
+            for (jx = 0; jx < specs[ix].count && num_bufs < MAX_BUFS; jx++)
+            {
+                MemAllocBlock blocks[2];
+                memcpy(blocks, specs[ix].blocks, sizeof(blocks));
+                bufs[num_bufs] = MemMgr_Alloc(blocks, specs[ix].num_blocks);
+                if (bufs[num_bufs]) num_bufs++;
+                else res = 1;
+            }
+        }
+
+        if (cx == cycles - 1)
+        {
+            MemMgrUsageStats stats;
+            if (NOT_I(MemMgr_GetUsageStats(&stats),==,0)) res = 1;
+            else print_stats(&stats);
+        }
+
+        while (num_bufs)
+        {
+            if (NOT_I(MemMgr_Free(bufs[--num_bufs]),==,0)) res = 1;
+        }
+    }
+
+    MemMgr_SetPoolBudget(0);
+    return res;
+}
@@ -46,6 +46,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
 
 #ifdef HAVE_CONFIG_H
     #include "config.h"
@@ -167,6 +168,12 @@
     T(star_tiler_test(1000, 30))\
     T(star_test(100, 10))\
     T(star_test(1000, 10))\
+    T(lookup_scaling_test(4096, 16, 100000))\
+    T(lookup_scaling_test(4096, 64, 100000))\
+    T(lookup_scaling_test(4096, 256, 100000))\
+    T(lookup_scaling_test(4096, MAX_ALLOCS, 100000))\
+    T(usage_stats_test(1920, 1080))\
+    T(usage_stats_test(176, 144))\
 
 /* this is defined in memmgr.c, but not exported as it is for internal
    use only */
@@ -1062,6 +1069,234 @@ int maxmap_1D_test(bytes_t length, int max_maps)
     return res;
 }
 
+/**
+ * Returns the monotonic time in microseconds.
+ */
+static uint64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * This method measures how buffer lookups scale with the number
+ * of buffers tracked.  It allocates num_bufs 1D buffers, looks
+ * up random pointers inside them num_lookups times using
+ * MemMgr_GetStride and MemMgr_Is1DBlock, then frees the buffers
+ * in random order.  The lookup results are verified, and the
+ * average times are printed so that runs with different buffer
+ * counts can be compared.
+ *
+ * @param length       Buffer length
+ * @param num_bufs     Number of buffers to allocate
+ * @param num_lookups  Number of lookups to time
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int lookup_scaling_test(bytes_t length, int num_bufs, int num_lookups)
+{
+    printf("Look up %d pointers in %d %ub 1D buffers\n", num_lookups, num_bufs, length);
+
+    struct data {
+        void    *bufPtr;
+        bytes_t  stride;
+    } *mem;
+
+    mem = NEWN(struct data, num_bufs);
+    if (NOT_P(mem,!=,NULL)) return 1;
+
+    /* allocate the buffers */
+    int ix, res = 0;
+    uint64_t t_alloc = now_us();
+    for (ix = 0; ix < num_bufs; ix++)
+    {
+        MemAllocBlock block;
+        memset(&block, 0, sizeof(block));
+        block.pixelFormat = PIXEL_FMT_PAGE;
+        block.dim.len = length;
+
+        mem[ix].bufPtr = MemMgr_Alloc(&block, 1);
+        if (!mem[ix].bufPtr) break;
+        mem[ix].stride = block.stride;
+    }
+    t_alloc = now_us() - t_alloc;
+
+    if (NOT_I(ix,==,num_bufs))
+    {
+        res = 1;
+        num_bufs = ix;
+    }
+
+    /* look up random pointers within the buffers */
+    uint64_t t_lookup = now_us();
+    for (ix = 0; num_bufs && ix < num_lookups; ix++)
+    {
+        struct data *d = mem + rand() % num_bufs;
+        void *ptr = d->bufPtr + rand() % length;
+        if (NOT_I(MemMgr_GetStride(ptr),==,d->stride) ||
+            NOT_I(MemMgr_Is1DBlock(ptr),!=,0))
+        {
+            res = 1;
+            break;
+        }
+    }
+    t_lookup = now_us() - t_lookup;
+
+    /* free in random order so records are removed from the middle */
+    for (ix = num_bufs - 1; ix > 0; ix--)
+    {
+        int jx = rand() % (ix + 1);
+        struct data tmp = mem[ix];
+        mem[ix] = mem[jx];
+        mem[jx] = tmp;
+    }
+
+    uint64_t t_free = now_us();
+    for (ix = 0; ix < num_bufs; ix++)
+    {
+        ERR_ADD(res, MemMgr_Free(mem[ix].bufPtr));
+    }
+    t_free = now_us() - t_free;
+
+    if (num_bufs)
+    {
+        P(":: %d buffers: %llu ns per lookup, %llu ns per alloc, %llu ns per free",
+          num_bufs, t_lookup * 1000 / num_lookups,
+          t_alloc * 1000 / num_bufs, t_free * 1000 / num_bufs);
+    }
+
+    FREE(mem);
+    return res;
+}
+
+/**
+ * Prints a usage statistics snapshot.
+ *
+ * @param stats  Usage statistics
+ */
+static void print_usage_stats(MemMgrUsageStats *stats)
+{
+    static const char *names[] = { "8-bit", "16-bit", "32-bit", "page" };
+    int ix;
+
+    P(":: %u buffers, %u bytes, %u bytes peak, %u/%u allocs failed, %u/%u maps failed",
+      stats->num_bufs, stats->bytes, stats->peak_bytes, stats->alloc_failures,
+      stats->allocs, stats->map_failures, stats->maps);
+    for (ix = 0; ix <= PIXEL_FMT_MAX - PIXEL_FMT_MIN; ix++)
+    {
+        MemMgrFormatStats *fs = stats->formats + ix;
+        P(":: %6s: %u blocks, %u bytes, %u bytes peak, %u bytes extent, %u failed",
+          names[ix], fs->blocks, fs->bytes, fs->peak_bytes, fs->extent, fs->failures);
+    }
+    for (ix = 0; ix < MEMMGR_LATENCY_BUCKETS; ix++)
+    {
+        if (stats->alloc_latency[ix] || stats->map_latency[ix])
+        {
+            P(":: %s %u us: %u allocs, %u maps",
+              ix == MEMMGR_LATENCY_BUCKETS - 1 ? ">=" : "<",
+              ix == MEMMGR_LATENCY_BUCKETS - 1 ? 1u << ix : 2u << ix,
+              stats->alloc_latency[ix], stats->map_latency[ix]);
+        }
+    }
+}
+
+/**
+ * Returns the number of calls counted in a latency histogram.
+ */
+static uint32_t latency_calls(uint32_t *latency)
+{
+    uint32_t calls = 0;
+    int ix;
+    for (ix = 0; ix < MEMMGR_LATENCY_BUCKETS; ix++)
+    {
+        calls += latency[ix];
+    }
+    return calls;
+}
+
+/**
+ * This method verifies the usage statistics.  It allocates an
+ * NV12, a 32-bit 2D and a 1D buffer of the given size, checks
+ * that each container accounts for its blocks, prints a
+ * snapshot, then checks that freeing the buffers returns the
+ * live usage to where it was while keeping the peak.
+ *
+ * @param width    Buffer width
+ * @param height   Buffer height
+ *
+ * @return 0 on success, non-0 error value on failure
+ */
+int usage_stats_test(pixels_t width, pixels_t height)
+{
+    printf("Usage statistics of %ux%u NV12, 32-bit and 1D buffers\n", width, height);
+
+    MemMgrUsageStats before, during, after;
+    bytes_t sizes[PIXEL_FMT_MAX - PIXEL_FMT_MIN + 1];
+    uint32_t blocks[PIXEL_FMT_MAX - PIXEL_FMT_MIN + 1] = { 1, 1, 1, 1 };
+    bytes_t length = width * height;
+    uint16_t val = (uint16_t) rand();
+    int ix, ret = 0;
+
+    sizes[0] = height * def_stride(width);
+    sizes[1] = (height >> 1) * def_stride((width >> 1) * 2);
+    sizes[2] = height * def_stride(width * 4);
+    sizes[3] = length;
+
+    if (NOT_I(MemMgr_GetUsageStats(&before),==,0)) return 1;
+
+    void *nv12 = alloc_NV12(width, height, val);
+    void *rgb = alloc_2D(width, height, PIXEL_FMT_32BIT, 0, val);
+    void *raw = alloc_1D(length, 0, val);
+    if (NOT_P(nv12,!=,NULL) || NOT_P(rgb,!=,NULL) || NOT_P(raw,!=,NULL))
+    {
+        ret = 1;
+        goto FREE;
+    }
+
+    ret |= NOT_I(MemMgr_GetUsageStats(&during),==,0);
+    print_usage_stats(&during);
+
+    bytes_t bytes = 0;
+    for (ix = 0; ix <= PIXEL_FMT_MAX - PIXEL_FMT_MIN; ix++)
+    {
+        MemMgrFormatStats *b = before.formats + ix, *d = during.formats + ix;
+        ret |= NOT_I(d->blocks - b->blocks,==,blocks[ix]);
+        ret |= NOT_I(d->bytes - b->bytes,==,sizes[ix]);
+        ret |= NOT_I(d->peak_bytes,>=,d->bytes);
+        ret |= NOT_I(d->failures,==,b->failures);
+#ifndef STUB_TILER
+        ret |= NOT_I(d->extent,>=,sizes[ix]);
+#endif
+        bytes += sizes[ix];
+    }
+    ret |= NOT_I(during.num_bufs - before.num_bufs,==,3);
+    ret |= NOT_I(during.bytes - before.bytes,==,bytes);
+    ret |= NOT_I(during.peak_bytes,>=,during.bytes);
+    ret |= NOT_I(during.allocs - before.allocs,==,3);
+    ret |= NOT_I(during.alloc_failures,==,before.alloc_failures);
+    ret |= NOT_I(latency_calls(during.alloc_latency) - latency_calls(before.alloc_latency),==,3);
+
+FREE:
+    if (nv12) ERR_ADD(ret, free_NV12(width, height, val, nv12));
+    if (rgb) ERR_ADD(ret, free_2D(width, height, PIXEL_FMT_32BIT, 0, val, rgb));
+    if (raw) ERR_ADD(ret, free_1D(length, 0, val, raw));
+    if (ret) return ret;
+
+    /* live usage is back, the peak stays */
+    ret |= NOT_I(MemMgr_GetUsageStats(&after),==,0);
+    for (ix = 0; ix <= PIXEL_FMT_MAX - PIXEL_FMT_MIN; ix++)
+    {
+        ret |= NOT_I(after.formats[ix].blocks,==,before.formats[ix].blocks);
+        ret |= NOT_I(after.formats[ix].bytes,==,before.formats[ix].bytes);
+        ret |= NOT_I(after.formats[ix].peak_bytes,>=,during.formats[ix].bytes);
+    }
+    ret |= NOT_I(after.num_bufs,==,before.num_bufs);
+    ret |= NOT_I(after.bytes,==,before.bytes);
+    ret |= NOT_I(after.peak_bytes,>=,during.bytes);
+    return ret;
+}
+
 /**
  * This stress tests allocates/maps/frees/unmaps buffers at
  * least num_ops times.  The test maintains a set of slots that
@@ -0,0 +1,409 @@
+/*
+ *  tiler_fake.c
+ *
+ *  Stand-in for the tiler driver used by the host tests.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "tiler.h"
+#include "tilermem_utils.h"
+#include "tiler_fake.h"
+
+/* the allocator keeps pointers in 32 bits, keep the mappings below 4GB on
+   64-bit hosts */
+#ifndef MAP_32BIT
+#define MAP_32BIT 0
+#endif
+
+/* descriptor returned for TILER_DEVICE_PATH */
+#define FAKE_FD 0x7111
+
+#define MAX_BUFS 4096
+#define MAX_MAPPINGS 4096
+
+int __real_open(const char *path, int flags, ...);
+int __real_close(int fd);
+int __real_ioctl(int fd, unsigned long request, ...);
+void *__real_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off);
+int __real_munmap(void *addr, size_t len);
+
+/* registered buffers, the offset of a buffer is (index + 1) pages */
+static struct {
+    int used;
+    struct tiler_buf_info info;
+} bufs[MAX_BUFS];
+
+static struct {
+    void    *addr;
+    size_t   len;
+    uint32_t offset;
+} mappings[MAX_MAPPINGS];
+
+/* each container is handed out in pages, first fit.  2D containers are
+   rows of container_stride bytes, and a 2D block takes a rectangle of
+   page columns, so page n of a container is at row n / columns. */
+#define CONTAINER_PAGES ((TILER_MEM_16BIT - TILER_MEM_8BIT) / TILER_PAGE)
+
+static const uint32_t base_ssptr[TILFMT_MAX + 1] = {
+    0, TILER_MEM_8BIT, TILER_MEM_16BIT, TILER_MEM_32BIT, TILER_MEM_PAGED
+};
+static const uint32_t container_stride[TILFMT_MAX + 1] = {
+    0, TILER_STRIDE_8BIT, TILER_STRIDE_16BIT, TILER_STRIDE_32BIT, 0
+};
+static uint8_t used_pages[TILFMT_MAX + 1][CONTAINER_PAGES];
+
+static struct tiler_fake_stats stats;
+static const struct tiler_fake_device *next;
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* stride of a 2D block in the process space, as the allocator maps it */
+static uint32_t block_stride(struct tiler_block_info *blk)
+{
+    static const uint32_t bpp[TILFMT_MAX + 1] = { 0, 1, 2, 4, 1 };
+    return (blk->dim.area.width * bpp[blk->fmt] + TILER_PAGE - 1) &
+           ~(TILER_PAGE - 1);
+}
+
+/* size of a block in the process space */
+static uint32_t block_size(struct tiler_block_info *blk)
+{
+    if (blk->fmt == TILFMT_PAGE)
+        return blk->dim.len;
+    return blk->dim.area.height * block_stride(blk);
+}
+
+/* page columns and rows of a block, a page mode block is one long row */
+static void block_rect(struct tiler_block_info *blk, uint32_t *cols, uint32_t *rows)
+{
+    if (blk->fmt == TILFMT_PAGE)
+    {
+        *cols = (blk->dim.len + TILER_PAGE - 1) / TILER_PAGE;
+        *rows = 1;
+    }
+    else
+    {
+        *cols = block_stride(blk) / TILER_PAGE;
+        *rows = blk->dim.area.height;
+    }
+}
+
+static int rect_free(uint8_t *used, uint32_t start, uint32_t width,
+                     uint32_t cols, uint32_t rows)
+{
+    uint32_t y, x;
+    for (y = 0; y < rows; y++)
+        for (x = 0; x < cols; x++)
+            if (used[start + y * width + x])
+                return 0;
+    return 1;
+}
+
+static void rect_set(uint8_t *used, uint32_t start, uint32_t width,
+                     uint32_t cols, uint32_t rows, uint8_t value)
+{
+    uint32_t y;
+    for (y = 0; y < rows; y++)
+        memset(used + start + y * width, value, cols);
+}
+
+/* container width in pages, the page container is one long row */
+static uint32_t container_width(int fmt)
+{
+    return container_stride[fmt] ? container_stride[fmt] / TILER_PAGE : CONTAINER_PAGES;
+}
+
+/* hands out a page aligned address in the container of the block */
+static uint32_t get_ssptr(struct tiler_block_info *blk)
+{
+    if (blk->fmt < TILFMT_8BIT || blk->fmt > TILFMT_PAGE)
+        return 0;
+
+    uint8_t *used = used_pages[blk->fmt];
+    uint32_t width = container_width(blk->fmt);
+    uint32_t height = CONTAINER_PAGES / width;
+    uint32_t cols, rows, x, y;
+    block_rect(blk, &cols, &rows);
+    if (!cols || !rows || cols > width || rows > height)
+        return 0;
+
+    for (y = 0; y + rows <= height; y++)
+    {
+        for (x = 0; x + cols <= width; x++)
+        {
+            if (rect_free(used, y * width + x, width, cols, rows))
+            {
+                rect_set(used, y * width + x, width, cols, rows, 1);
+                return base_ssptr[blk->fmt] + (y * width + x) * TILER_PAGE;
+            }
+        }
+    }
+    return 0;
+}
+
+/* returns the pages of a block to its container */
+static int put_ssptr(struct tiler_block_info *blk)
+{
+    if (blk->fmt < TILFMT_8BIT || blk->fmt > TILFMT_PAGE ||
+        blk->ssptr < base_ssptr[blk->fmt])
+        return -EINVAL;
+
+    uint32_t start = (blk->ssptr - base_ssptr[blk->fmt]) / TILER_PAGE;
+    uint32_t width = container_width(blk->fmt);
+    uint32_t cols, rows;
+    block_rect(blk, &cols, &rows);
+    if (start % width + cols > width ||
+        start + (rows - 1) * width + cols > CONTAINER_PAGES ||
+        !used_pages[blk->fmt][start])
+        return -EINVAL;
+
+    rect_set(used_pages[blk->fmt], start, width, cols, rows, 0);
+    return 0;
+}
+
+static int find_buf(uint32_t offset)
+{
+    int ix = (int)(offset / TILER_PAGE) - 1;
+    return (offset % TILER_PAGE == 0 && ix >= 0 && ix < MAX_BUFS && bufs[ix].used) ? ix : -1;
+}
+
+/* system space address for a pointer in a tiler mapping, or 0 */
+static uint32_t get_phys(uintptr_t ptr)
+{
+    int ix, bx;
+    for (ix = 0; ix < MAX_MAPPINGS; ix++)
+    {
+        uintptr_t start = (uintptr_t) mappings[ix].addr;
+        if (!start || ptr < start || ptr >= start + mappings[ix].len)
+            continue;
+
+        int buf = find_buf(mappings[ix].offset);
+        if (buf < 0)
+            return 0;
+
+        uint32_t off = ptr - start;
+        for (bx = 0; bx < bufs[buf].info.num_blocks; bx++)
+        {
+            struct tiler_block_info *blk = bufs[buf].info.blocks + bx;
+            if (off < block_size(blk))
+                return blk->fmt == TILFMT_PAGE ? blk->ssptr + off :
+                       blk->ssptr + off / block_stride(blk) * container_stride[blk->fmt] +
+                       off % block_stride(blk);
+            off -= block_size(blk);
+        }
+        return 0;
+    }
+    return 0;
+}
+
+static int fake_ioctl(unsigned long request, void *arg)
+{
+    struct tiler_block_info *blk = arg;
+    struct tiler_buf_info *buf = arg;
+    int ix;
+
+    stats.ioctls++;
+    switch (request)
+    {
+    case TILIOC_GBUF:
+    case TILIOC_MBUF:
+        if (request == TILIOC_MBUF)
+            blk->fmt = TILFMT_PAGE;
+        blk->ssptr = get_ssptr(blk);
+        if (!blk->ssptr)
+            return -ENOMEM;
+        if (request == TILIOC_GBUF)
+            stats.allocs++;
+        else
+            stats.maps++;
+        stats.live_blocks++;
+        return 0;
+
+    case TILIOC_FBUF:
+    case TILIOC_UMBUF:
+        if (put_ssptr(blk))
+            return -EINVAL;
+        if (request == TILIOC_FBUF)
+            stats.frees++;
+        else
+            stats.unmaps++;
+        stats.live_blocks--;
+        return 0;
+
+    case TILIOC_GSSP:
+        return get_phys((uintptr_t) arg);
+
+    case TILIOC_RBUF:
+        for (ix = 0; ix < MAX_BUFS && bufs[ix].used; ix++);
+        if (ix == MAX_BUFS)
+            return -ENOMEM;
+        bufs[ix].used = 1;
+        buf->offset = (ix + 1) * TILER_PAGE;
+        memcpy(&bufs[ix].info, buf, sizeof(*buf));
+        stats.registers++;
+        stats.live_bufs++;
+        return 0;
+
+    case TILIOC_QBUF:
+        ix = find_buf(buf->offset);
+        if (ix < 0)
+            return -EINVAL;
+        buf->num_blocks = bufs[ix].info.num_blocks;
+        memcpy(buf->blocks, bufs[ix].info.blocks, sizeof(buf->blocks));
+        return 0;
+
+    case TILIOC_URBUF:
+        ix = find_buf(buf->offset);
+        if (ix < 0)
+            return -EINVAL;
+        bufs[ix].used = 0;
+        stats.unregisters++;
+        stats.live_bufs--;
+        return 0;
+
+    default:
+        return -EINVAL;
+    }
+}
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    va_list ap;
+    va_start(ap, flags);
+    int mode = va_arg(ap, int);
+    va_end(ap);
+
+    int ret;
+    if (!strcmp(path, TILER_DEVICE_PATH))
+        return FAKE_FD;
+    if (next && next->open && next->open(path, flags, &ret))
+        return ret;
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_close(int fd)
+{
+    int ret;
+    if (fd == FAKE_FD)
+        return 0;
+    if (next && next->close && next->close(fd, &ret))
+        return ret;
+    return __real_close(fd);
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+
+    int ret;
+    if (fd != FAKE_FD)
+    {
+        if (next && next->ioctl && next->ioctl(fd, request, arg, &ret))
+            return ret;
+        return __real_ioctl(fd, request, arg);
+    }
+
+    pthread_mutex_lock(&mtx);
+    ret = fake_ioctl(request, arg);
+    pthread_mutex_unlock(&mtx);
+    if (ret < 0)
+    {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+void *__wrap_mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off)
+{
+    void *ptr = MAP_FAILED;
+    if (fd != FAKE_FD)
+    {
+        if (next && next->mmap && next->mmap(len, prot, flags, fd, off, &ptr))
+            return ptr;
+        return __real_mmap(addr, len, prot, flags, fd, off);
+    }
+
+    pthread_mutex_lock(&mtx);
+    int ix;
+    for (ix = 0; ix < MAX_MAPPINGS && mappings[ix].addr; ix++);
+    if (ix < MAX_MAPPINGS && find_buf(off) >= 0)
+    {
+        ptr = __real_mmap(NULL, len, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+        if (ptr != MAP_FAILED)
+        {
+            mappings[ix].addr = ptr;
+            mappings[ix].len = len;
+            mappings[ix].offset = off;
+            stats.mmaps++;
+        }
+    }
+    pthread_mutex_unlock(&mtx);
+    return ptr;
+}
+
+int __wrap_munmap(void *addr, size_t len)
+{
+    int ix;
+    pthread_mutex_lock(&mtx);
+    for (ix = 0; ix < MAX_MAPPINGS && mappings[ix].addr != addr; ix++);
+    if (ix < MAX_MAPPINGS)
+    {
+        mappings[ix].addr = NULL;
+        stats.munmaps++;
+    }
+    pthread_mutex_unlock(&mtx);
+    return __real_munmap(addr, len);
+}
+
+void tiler_fake_get_stats(struct tiler_fake_stats *out)
+{
+    pthread_mutex_lock(&mtx);
+    *out = stats;
+    pthread_mutex_unlock(&mtx);
+}
+
+void tiler_fake_set_next(const struct tiler_fake_device *dev)
+{
+    next = dev;
+}
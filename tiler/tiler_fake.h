@@ -0,0 +1,106 @@
+/*
+ *  tiler_fake.h
+ *
+ *  Stand-in for the tiler driver used by the host tests.
+ *
+ *  Copyright (C) 2009-2011 Texas Instruments, Inc.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *  *  Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  *  Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ *  *  Neither the name of Texas Instruments Incorporated nor the names of
+ *     its contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ *  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ *  PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ *  CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ *  EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ *  PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ *  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ *  WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ *  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ *  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TILER_FAKE_H_
+#define _TILER_FAKE_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * The fake driver replaces /dev/tiler in a test program so the
+ * memory allocator can be exercised and benchmarked without
+ * hardware.  The test is linked with memmgr.c (not the
+ * library) and tiler_fake.c, using
+ *
+ *     -Wl,--wrap=open -Wl,--wrap=close -Wl,--wrap=ioctl
+ *     -Wl,--wrap=mmap -Wl,--wrap=munmap
+ *
+ * Opening TILER_DEVICE_PATH returns a fake descriptor.  The
+ * tiler ioctls used by the allocator hand out system space
+ * addresses in the right container, and the registered buffers
+ * are mapped to anonymous memory below 4GB, as the allocator
+ * keeps pointers in 32 bits.  TILIOC_MBUF hands out an address
+ * but the mapping does not alias the user pages.  All other
+ * calls go to libc.
+ */
+
+/**
+ * Driver call counters
+ */
+struct tiler_fake_stats {
+    uint32_t ioctls;       /* all tiler ioctls */
+    uint32_t allocs;       /* TILIOC_GBUF */
+    uint32_t frees;        /* TILIOC_FBUF */
+    uint32_t maps;         /* TILIOC_MBUF */
+    uint32_t unmaps;       /* TILIOC_UMBUF */
+    uint32_t registers;    /* TILIOC_RBUF */
+    uint32_t unregisters;  /* TILIOC_URBUF */
+    uint32_t mmaps;        /* mmap of the tiler device */
+    uint32_t munmaps;      /* munmap of a tiler mapping */
+    uint32_t live_blocks;  /* blocks allocated or mapped */
+    uint32_t live_bufs;    /* registered buffers */
+};
+
+/**
+ * Retrieves the driver call counters.
+ *
+ * @param stats  Pointer to the counters to fill out
+ */
+void tiler_fake_get_stats(struct tiler_fake_stats *stats);
+
+/**
+ * Another fake device linked into the same program.  Calls that
+ * are not for the tiler are offered to it before they go to
+ * libc.  A hook returns non-0 if it handled the call, with the
+ * result in *ret.  NULL hooks are skipped.
+ */
+struct tiler_fake_device {
+    int (*open)(const char *path, int flags, int *ret);
+    int (*close)(int fd, int *ret);
+    int (*ioctl)(int fd, unsigned long request, void *arg, int *ret);
+    int (*mmap)(size_t len, int prot, int flags, int fd, off_t off,
+                void **ret);
+};
+
+/**
+ * Chains another fake device behind the tiler.  Call it before
+ * other threads use the wrapped calls.
+ *
+ * @param dev  The device, or NULL to remove it
+ */
+void tiler_fake_set_next(const struct tiler_fake_device *dev);
+
+#endif